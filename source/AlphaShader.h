@@ -5,8 +5,11 @@
 class AlphaShader : public Shader
 {
 public:
-	bool InitAlphaShader(ID3D11Device* device, WCHAR* vsFilename, WCHAR* psFilename);
-	bool SetAlphaShaderParameters(ID3D11DeviceContext* context,
+	AlphaShader();
+
+	bool InitAlphaShader(RenderDevice* device, WCHAR* vsFilename, WCHAR* psFilename);
+	void Shutdown() override;
+	bool SetAlphaShaderParameters(RenderContext* context,
 		DirectX::SimpleMath::Matrix* world,
 		DirectX::SimpleMath::Matrix* view,
 		DirectX::SimpleMath::Matrix* projection,
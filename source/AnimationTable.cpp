@@ -0,0 +1,54 @@
+#include "pch.h"
+#include "AnimationTable.h"
+
+AnimationTable::AnimationTable()
+{
+	m_builds = 0;
+	m_reads = 0;
+}
+
+void AnimationTable::clear()
+{
+	m_animations.clear();
+	m_worlds.clear();
+	m_builds = 0;
+	m_reads = 0;
+}
+
+int AnimationTable::add(const Animation& animation)
+{
+	m_animations.push_back(animation);
+	m_worlds.push_back(DirectX::SimpleMath::Matrix::Identity);
+
+	return (int)m_animations.size()-1;
+}
+
+void AnimationTable::Update(float time)
+{
+	for (int i = 0; i < (int)m_animations.size(); i++)
+		m_worlds[i] = m_animations[i](time);
+
+	m_builds = (int)m_animations.size();
+	m_reads = 0;
+}
+
+const DirectX::SimpleMath::Matrix& AnimationTable::get(int slot)
+{
+	m_reads.fetch_add(1, std::memory_order_relaxed);
+	return m_worlds[slot];
+}
+
+int AnimationTable::getCount()
+{
+	return (int)m_animations.size();
+}
+
+int AnimationTable::getBuildCount()
+{
+	return m_builds;
+}
+
+int AnimationTable::getReadCount()
+{
+	return m_reads;
+}
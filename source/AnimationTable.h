@@ -0,0 +1,31 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <vector>
+
+// World matrices that follow time (e.g. specimens bobbing in their jars), each evaluated once a frame into a table every pass then reads.
+// NB: Reads are counted, as what evaluating on every draw would have cost; they may come from any thread recording faces
+class AnimationTable
+{
+public:
+	typedef std::function<DirectX::SimpleMath::Matrix(float)> Animation;	// Given the time, in seconds
+
+	AnimationTable();
+
+	void									clear();
+	int										add(const Animation& animation);	// Returns its slot
+
+	void									Update(float time);			// Evaluates every animation, and starts the frame's counts afresh
+	const DirectX::SimpleMath::Matrix&		get(int slot);
+
+	int										getCount();
+	// This frame's
+	int										getBuildCount();
+	int										getReadCount();
+
+private:
+	std::vector<Animation>					m_animations;
+	std::vector<DirectX::SimpleMath::Matrix>	m_worlds;
+	int										m_builds;
+	std::atomic<int>						m_reads;
+};
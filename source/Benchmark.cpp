@@ -0,0 +1,324 @@
+#include "pch.h"
+#include "Benchmark.h"
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+namespace
+{
+	struct Statistics
+	{
+		double	mean;
+		double	p50;
+		double	p95;
+		double	p99;
+	};
+
+	Statistics Summarise(std::vector<double> samples)
+	{
+		Statistics statistics = { 0.0, 0.0, 0.0, 0.0 };
+		if (samples.empty())
+			return statistics;
+
+		std::sort(samples.begin(), samples.end());
+		for (int i = 0; i < (int)samples.size(); i++)
+			statistics.mean += samples[i];
+		statistics.mean /= samples.size();
+
+		statistics.p50 = samples[(int)(0.50*(samples.size()-1))];
+		statistics.p95 = samples[(int)(0.95*(samples.size()-1))];
+		statistics.p99 = samples[(int)(0.99*(samples.size()-1))];
+		return statistics;
+	}
+
+	std::string Escape(const std::string& name)
+	{
+		std::string escaped;
+		for (int i = 0; i < (int)name.size(); i++)
+		{
+			if (name[i] == '"' || name[i] == '\\')
+				escaped += '\\';
+			escaped += name[i];
+		}
+
+		return escaped;
+	}
+
+	std::string Quote(const std::string& name)
+	{
+		std::string quoted = "\"";
+		for (int i = 0; i < (int)name.size(); i++)
+			quoted += (name[i] == '"') ? "\"\"" : std::string(1, name[i]);
+
+		return quoted+"\"";
+	}
+
+	bool ReadFile(const std::string& filename, std::string& contents)
+	{
+		FILE* file = fopen(filename.c_str(), "rb");
+		if (!file)
+			return false;
+
+		char buffer[4096];
+		size_t read;
+		contents.clear();
+		while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			contents.append(buffer, read);
+		fclose(file);
+
+		return true;
+	}
+
+	// Reads the "metrics" object of a summary, in order; only as much JSON as saveSummary writes is understood
+	bool ReadMetrics(const std::string& filename, std::vector<std::pair<std::string, double>>& metrics)
+	{
+		std::string json;
+		if (!ReadFile(filename, json))
+			return false;
+
+		size_t position = json.find("\"metrics\"");
+		if (position == std::string::npos)
+			return false;
+		position = json.find('{', position);
+		if (position == std::string::npos)
+			return false;
+
+		metrics.clear();
+		while (true)
+		{
+			position = json.find_first_of("\"}", position+1);
+			if (position == std::string::npos || json[position] == '}')
+				break;
+
+			std::string name;
+			for (position++; position < json.size() && json[position] != '"'; position++)
+			{
+				if (json[position] == '\\')
+					position++;
+				name += json[position];
+			}
+
+			position = json.find(':', position);
+			if (position == std::string::npos)
+				return false;
+
+			char* end;
+			double value = strtod(json.c_str()+position+1, &end);
+			metrics.push_back(std::make_pair(name, value));
+			position = end-json.c_str();
+		}
+
+		return true;
+	}
+}
+
+Benchmark::Benchmark()
+{
+	m_profiler = nullptr;
+	m_warmupFrames = 0;
+	m_measuredFrames = 0;
+	m_frame = 0;
+	m_eventCount = 0;
+}
+
+void Benchmark::Initialise(Profiler* profiler, int warmupFrames, int measuredFrames)
+{
+	m_profiler = profiler;
+	m_warmupFrames = warmupFrames;
+	m_measuredFrames = measuredFrames;
+	m_frame = 0;
+
+	m_eventCount = m_profiler->getEventCount();
+	m_passes.clear();
+	m_records.clear();
+}
+
+bool Benchmark::getFinished()
+{
+	return m_frame >= m_warmupFrames+m_measuredFrames+DrainFrames;
+}
+
+int Benchmark::getFrame()
+{
+	return m_frame;
+}
+
+void Benchmark::beginFrame()
+{
+	m_frameStart = std::chrono::high_resolution_clock::now();
+}
+
+void Benchmark::endFrame()
+{
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now()-m_frameStart).count();
+
+	if (m_frame >= m_warmupFrames && m_frame < m_warmupFrames+m_measuredFrames)
+		m_records.push_back({ m_profiler->getFrame(), milliseconds, std::vector<double>(), std::vector<double>() });
+
+	collectEvents();
+	m_frame++;
+}
+
+bool Benchmark::saveFrames(const std::string& filename)
+{
+	FILE* file = fopen(filename.c_str(), "w");
+	if (!file)
+		return false;
+
+	fprintf(file, "frame,ms");
+	for (int i = 0; i < (int)m_passes.size(); i++)
+		fprintf(file, ",%s,%s", Quote("cpu "+m_passes[i]).c_str(), Quote("gpu "+m_passes[i]).c_str());
+	fprintf(file, "\n");
+
+	// NB: Passes first seen after a frame have nothing recorded for it, so are written as zero
+	for (int i = 0; i < (int)m_records.size(); i++)
+	{
+		const FrameRecord& record = m_records[i];
+		fprintf(file, "%d,%.4f", i, record.milliseconds);
+		for (int j = 0; j < (int)m_passes.size(); j++)
+			fprintf(file, ",%.4f,%.4f", (j < (int)record.cpu.size()) ? record.cpu[j] : 0.0, (j < (int)record.gpu.size()) ? record.gpu[j] : 0.0);
+		fprintf(file, "\n");
+	}
+
+	return fclose(file) == 0;
+}
+
+bool Benchmark::saveSummary(const std::string& filename)
+{
+	FILE* file = fopen(filename.c_str(), "w");
+	if (!file)
+		return false;
+
+	std::string summary = getSummary();
+	bool written = fwrite(summary.data(), 1, summary.size(), file) == summary.size();
+
+	return (fclose(file) == 0) && written;
+}
+
+std::string Benchmark::getSummary()
+{
+	std::vector<std::pair<std::string, Statistics>> rows;
+
+	std::vector<double> samples;
+	for (int i = 0; i < (int)m_records.size(); i++)
+		samples.push_back(m_records[i].milliseconds);
+	rows.push_back(std::make_pair(std::string("frame"), Summarise(samples)));
+
+	// NB: A pass that never ran on a side (e.g. anything on the GPU without timestamp queries) is left out
+	for (int side = 0; side < 2; side++)
+	{
+		for (int i = 0; i < (int)m_passes.size(); i++)
+		{
+			bool ran = false;
+			samples.clear();
+			for (int j = 0; j < (int)m_records.size(); j++)
+			{
+				const std::vector<double>& times = (side == 0) ? m_records[j].cpu : m_records[j].gpu;
+				samples.push_back((i < (int)times.size()) ? times[i] : 0.0);
+				ran = ran || samples.back() > 0.0;
+			}
+
+			if (ran)
+				rows.push_back(std::make_pair(std::string((side == 0) ? "cpu " : "gpu ")+m_passes[i], Summarise(samples)));
+		}
+	}
+
+	std::string summary = "{\n\t\"warmupFrames\": " + std::to_string(m_warmupFrames) + ",\n\t\"measuredFrames\": " + std::to_string(m_records.size()) + ",\n\t\"metrics\": {";
+	for (int i = 0; i < (int)rows.size(); i++)
+	{
+		const char* statisticNames[4] = { "mean", "p50", "p95", "p99" };
+		double statistics[4] = { rows[i].second.mean, rows[i].second.p50, rows[i].second.p95, rows[i].second.p99 };
+		for (int j = 0; j < 4; j++)
+		{
+			char value[64];
+			snprintf(value, sizeof(value), "%.4f", statistics[j]);
+			summary += std::string((i == 0 && j == 0) ? "\n" : ",\n") + "\t\t\"" + Escape(rows[i].first) + "." + statisticNames[j] + "\": " + value;
+		}
+	}
+	summary += "\n\t}\n}\n";
+
+	return summary;
+}
+
+bool Benchmark::compare(const std::string& baseline, const std::string& current, double threshold, std::string& report)
+{
+	std::vector<std::pair<std::string, double>> baselineMetrics, currentMetrics;
+	if (!ReadMetrics(baseline, baselineMetrics) || !ReadMetrics(current, currentMetrics))
+	{
+		report = "Could not read " + baseline + " and " + current + " as benchmark summaries\n";
+		return true;
+	}
+
+	int regressions = 0;
+	report.clear();
+	for (int i = 0; i < (int)baselineMetrics.size(); i++)
+	{
+		const std::string& name = baselineMetrics[i].first;
+		double before = baselineMetrics[i].second;
+
+		int j = 0;
+		while (j < (int)currentMetrics.size() && currentMetrics[j].first != name)
+			j++;
+		if (j == (int)currentMetrics.size())
+		{
+			report += "  missing     " + name + "\n";
+			continue;
+		}
+
+		// NB: Only what got slower counts; anything new in current has nothing to regress from
+		double after = currentMetrics[j].second;
+		if (after > before*(1.0+threshold) && after-before > MinimumRegression)
+		{
+			char line[256];
+			snprintf(line, sizeof(line), "  REGRESSION  %s: %.3f -> %.3f ms (%+.1f%%)\n", name.c_str(), before, after, (before > 0.0) ? 100.0*(after-before)/before : 100.0);
+			report += line;
+			regressions++;
+		}
+	}
+
+	report = std::to_string(regressions) + " regression(s) of over " + std::to_string((int)(100.0*threshold)) + "% against " + baseline + "\n" + report;
+	return regressions > 0;
+}
+
+int Benchmark::getPass(const char* name)
+{
+	for (int i = 0; i < (int)m_passes.size(); i++)
+		if (m_passes[i] == name)
+			return i;
+
+	m_passes.push_back(name);
+	return (int)m_passes.size()-1;
+}
+
+void Benchmark::collectEvents()
+{
+	unsigned long long count = m_profiler->getEventCount();
+	if (count < m_eventCount)
+		m_eventCount = 0;	// The profiler was reinitialised (e.g. on losing the device)
+
+	std::vector<Profiler::Event> events = m_profiler->getLatestEvents((int)std::min(count-m_eventCount, (unsigned long long)INT_MAX));
+	m_eventCount = count;
+
+	// NB: GPU timings arrive frames after their CPU ones, so may belong to any record still in reach
+	unsigned int device = m_profiler->getDeviceThread();
+	for (int i = 0; i < (int)events.size(); i++)
+	{
+		const Profiler::Event& event = events[i];
+		if (event.depth > 1 || (event.thread != device && event.thread != Profiler::GpuThread))
+			continue;
+
+		int record = (int)m_records.size()-1;
+		while (record >= 0 && m_records[record].frame > event.frame)
+			record--;
+		if (record < 0 || m_records[record].frame != event.frame)
+			continue;
+
+		int pass = getPass(event.name);
+		std::vector<double>& times = (event.thread == device) ? m_records[record].cpu : m_records[record].gpu;
+		if ((int)times.size() <= pass)
+			times.resize(pass+1, 0.0);
+		times[pass] += event.duration/1000.0;
+	}
+}
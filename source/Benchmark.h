@@ -0,0 +1,54 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+#include "Profiler.h"
+
+// Times a fixed run of frames: warm-up frames first, then measured frames whose times and passes are written out.
+// Summaries are flat JSON, so one run can be compared against a stored baseline to flag regressions
+class Benchmark
+{
+public:
+	static const int				DrainFrames = 8;	// Run after measuring, for the last frames' GPU timings to come in
+
+	Benchmark();
+
+	void							Initialise(Profiler* profiler, int warmupFrames, int measuredFrames);
+	bool							getFinished();
+	int								getFrame();		// Frames ended so far, warm-up included
+
+	// Bracket every frame; endFrame goes after the profiler's own
+	void							beginFrame();
+	void							endFrame();
+
+	bool							saveFrames(const std::string& filename);	// CSV, a row per measured frame: its time, then each pass's CPU and GPU times
+	bool							saveSummary(const std::string& filename);	// JSON: mean, p50, p95 and p99 of the frame and of each pass
+	std::string						getSummary();
+
+	// Flags every time in current over baseline by more than threshold (e.g. 0.1 for 10%), returning whether any were.
+	// NB: Differences of under MinimumRegression milliseconds are taken as noise, however large relatively
+	static bool						compare(const std::string& baseline, const std::string& current, double threshold, std::string& report);
+	static constexpr double			MinimumRegression = 0.05;
+
+private:
+	struct FrameRecord
+	{
+		unsigned int			frame;			// The profiler's number for it
+		double					milliseconds;
+		std::vector<double>		cpu;			// Per pass
+		std::vector<double>		gpu;
+	};
+
+	int								getPass(const char* name);
+	void							collectEvents();	// Files the profiler's events since the last call under their frames
+
+	Profiler*						m_profiler;
+	int								m_warmupFrames;
+	int								m_measuredFrames;
+	int								m_frame;
+	std::chrono::high_resolution_clock::time_point	m_frameStart;
+
+	unsigned long long				m_eventCount;	// The profiler's, when last collected
+	std::vector<std::string>		m_passes;		// Every scope seen at depth 0 or 1 on the device thread, in order of first appearance
+	std::vector<FrameRecord>		m_records;
+};
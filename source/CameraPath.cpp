@@ -0,0 +1,100 @@
+#include "pch.h"
+#include "CameraPath.h"
+#include <cstdio>
+
+CameraPath::CameraPath()
+{
+}
+
+bool CameraPath::load(const std::string& filename)
+{
+	FILE* file = fopen(filename.c_str(), "r");
+	if (!file)
+		return false;
+
+	clear();
+
+	char line[256];
+	while (fgets(line, sizeof(line), file))
+	{
+		for (char* c = line; *c; c++)
+			if (*c == '#')
+				*c = '\0';
+
+		// NB: Blank lines (and comments) are skipped; so is anything that would put the keys out of order
+		Key key;
+		if (sscanf(line, "%lf %f %f %f %f %f %f", &key.time, &key.position[0], &key.position[1], &key.position[2], &key.rotation[0], &key.rotation[1], &key.rotation[2]) == 7)
+			if (m_keys.empty() || key.time >= m_keys.back().time)
+				m_keys.push_back(key);
+	}
+	fclose(file);
+
+	return !m_keys.empty();
+}
+
+bool CameraPath::save(const std::string& filename)
+{
+	FILE* file = fopen(filename.c_str(), "w");
+	if (!file)
+		return false;
+
+	fprintf(file, "# time x y z pitch yaw roll\n");
+	for (int i = 0; i < (int)m_keys.size(); i++)
+	{
+		const Key& key = m_keys[i];
+		fprintf(file, "%.4f %.4f %.4f %.4f %.4f %.4f %.4f\n", key.time, key.position[0], key.position[1], key.position[2], key.rotation[0], key.rotation[1], key.rotation[2]);
+	}
+
+	return fclose(file) == 0;
+}
+
+void CameraPath::clear()
+{
+	m_keys.clear();
+}
+
+void CameraPath::add(const Key& key)
+{
+	m_keys.push_back(key);
+}
+
+CameraPath::Key CameraPath::sample(double time)
+{
+	if (m_keys.empty())
+		return { time, { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+
+	// Find the first key after time, i.e. the end of the span time falls in
+	int next = 0;
+	while (next < (int)m_keys.size() && m_keys[next].time <= time)
+		next++;
+
+	if (next == 0)
+		return m_keys.front();
+	if (next == (int)m_keys.size())
+		return m_keys.back();
+
+	const Key& a = m_keys[next-1];
+	const Key& b = m_keys[next];
+	float t = (float)((time-a.time)/(b.time-a.time));
+
+	// NB: Rotations are blended as they are, so a path should not wrap yaw between keys
+	Key key;
+	key.time = time;
+	for (int i = 0; i < 3; i++)
+	{
+		key.position[i] = a.position[i]+t*(b.position[i]-a.position[i]);
+		key.rotation[i] = a.rotation[i]+t*(b.rotation[i]-a.rotation[i]);
+	}
+
+	return key;
+}
+
+double CameraPath::getDuration()
+{
+	return (m_keys.empty()) ? 0.0 : m_keys.back().time;
+}
+
+int CameraPath::getKeyCount()
+{
+	return (int)m_keys.size();
+}
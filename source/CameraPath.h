@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// A camera's position and rotation over time, as keyframes scripted by hand or recorded while flying about.
+// Saved as text, one "time x y z pitch yaw roll" key per line; anything after a # is a comment
+class CameraPath
+{
+public:
+	struct Key
+	{
+		double	time;			// Seconds
+		float	position[3];
+		float	rotation[3];	// Degrees, as Camera takes them
+	};
+
+	CameraPath();
+
+	bool							load(const std::string& filename);	// False if the file is missing or has no keys
+	bool							save(const std::string& filename);
+	void							clear();
+
+	void							add(const Key& key);	// NB: Keys must be added in time order
+	Key								sample(double time);	// Interpolated linearly, and held at either end
+
+	double							getDuration();
+	int								getKeyCount();
+
+private:
+	std::vector<Key>				m_keys;
+};
@@ -0,0 +1,605 @@
+#include "pch.h"
+#include "CommandBuffer.h"
+#include <cstdio>
+#include <cstring>
+#include <cwchar>
+
+namespace
+{
+	const unsigned int	FileMagic = 0x42444D43;	// "CMDB"
+	const unsigned int	FileVersion = 1;
+	const unsigned int	NoPayload = 0xFFFFFFFF;
+}
+
+CommandBuffer::CommandBuffer()
+{
+	m_context = nullptr;
+	m_target = nullptr;
+	m_ring = nullptr;
+	m_viewport = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+	m_mapped = nullptr;
+
+	Reset();
+}
+
+void CommandBuffer::Begin(RenderContext* context)
+{
+	Reset();
+
+	m_context = context;
+	m_target = context->getBackend();
+	m_ring = context->getConstantRing();
+
+	context->Invalidate();
+	context->setConstantRing(nullptr);
+	context->setBackend(this);
+}
+
+void CommandBuffer::End()
+{
+	// NB: Everything was passed on as it was recorded, so the context's shadow still holds
+	m_context->setBackend(m_target);
+	m_context->setConstantRing(m_ring);
+
+	m_context = nullptr;
+	m_target = nullptr;
+	m_ring = nullptr;
+	m_recorded = true;
+}
+
+void CommandBuffer::Reset()
+{
+	m_commands.clear();
+	m_payload.clear();
+	m_handles.clear();
+	m_handleIndices.clear();
+	m_patches.clear();
+	m_recorded = false;
+
+	handle(nullptr);
+}
+
+bool CommandBuffer::getRecorded()
+{
+	return m_recorded;
+}
+
+void CommandBuffer::addPatch(ID3D11Buffer* buffer, unsigned int offset, const void* source, unsigned int bytes)
+{
+	m_patches.push_back({ handle(buffer), offset, source, bytes });
+}
+
+void CommandBuffer::Replay(RenderContext* context)
+{
+	for (int i = 0; i < (int)m_commands.size(); i++)
+	{
+		const Command& command = m_commands[i];
+		const unsigned int* a = command.args;
+
+		switch (command.type)
+		{
+		case InputLayout:
+			context->IASetInputLayout(resolve<ID3D11InputLayout>(a[0]));
+			break;
+		case VertexBuffers:
+		{
+			// Payload: count handles, then count strides, then count offsets
+			ID3D11Buffer* buffers[16];
+			const unsigned int* handles = payload<unsigned int>(a[2]);
+			for (unsigned int j = 0; j < a[1] && j < 16; j++)
+				buffers[j] = resolve<ID3D11Buffer>(handles[j]);
+			context->IASetVertexBuffers(a[0], a[1], buffers, handles+a[1], handles+2*a[1]);
+			break;
+		}
+		case IndexBuffer:
+			context->IASetIndexBuffer(resolve<ID3D11Buffer>(a[0]), (int)a[1], a[2]);
+			break;
+		case PrimitiveTopology:
+			context->IASetPrimitiveTopology((int)a[0]);
+			break;
+		case VertexShader:
+			context->VSSetShader(resolve<ID3D11VertexShader>(a[0]), 0, 0);
+			break;
+		case PixelShader:
+			context->PSSetShader(resolve<ID3D11PixelShader>(a[0]), 0, 0);
+			break;
+		case VertexConstantBuffers:
+		case PixelConstantBuffers:
+		case VertexConstantBuffers1:
+		case PixelConstantBuffers1:
+		{
+			// Payload: count handles, then (windowed only) count first constants and count constant counts
+			bool windowed = (command.type == VertexConstantBuffers1 || command.type == PixelConstantBuffers1);
+			bool pixel = (command.type == PixelConstantBuffers || command.type == PixelConstantBuffers1);
+			const unsigned int* handles = payload<unsigned int>(a[2]);
+			for (unsigned int j = 0; j < a[1]; j++)
+			{
+				ConstantBinding binding = { resolve<ID3D11Buffer>(handles[j]), (windowed) ? handles[a[1]+j] : 0, (windowed) ? handles[2*a[1]+j] : 0 };
+				if (pixel)
+					context->PSSetConstants(a[0]+j, binding);
+				else
+					context->VSSetConstants(a[0]+j, binding);
+			}
+			break;
+		}
+		case ShaderResources:
+		{
+			ID3D11ShaderResourceView* views[RenderContext::ShaderResourceSlots];
+			const unsigned int* handles = payload<unsigned int>(a[2]);
+			for (unsigned int j = 0; j < a[1] && j < RenderContext::ShaderResourceSlots; j++)
+				views[j] = resolve<ID3D11ShaderResourceView>(handles[j]);
+			context->PSSetShaderResources(a[0], a[1], views);
+			break;
+		}
+		case Samplers:
+		{
+			ID3D11SamplerState* samplers[RenderContext::SamplerSlots];
+			const unsigned int* handles = payload<unsigned int>(a[2]);
+			for (unsigned int j = 0; j < a[1] && j < RenderContext::SamplerSlots; j++)
+				samplers[j] = resolve<ID3D11SamplerState>(handles[j]);
+			context->PSSetSamplers(a[0], a[1], samplers);
+			break;
+		}
+		case RasterizerState:
+			context->RSSetState(resolve<ID3D11RasterizerState>(a[0]));
+			break;
+		case Viewports:
+			context->RSSetViewports(a[0], payload<RenderViewport>(a[1]));
+			break;
+		case BlendState:
+			context->OMSetBlendState(resolve<ID3D11BlendState>(a[0]), (a[1] == NoPayload) ? nullptr : payload<float>(a[1]), a[2]);
+			break;
+		case DepthStencilState:
+			context->OMSetDepthStencilState(resolve<ID3D11DepthStencilState>(a[0]), a[1]);
+			break;
+		case RenderTargets:
+		{
+			ID3D11RenderTargetView* targets[RenderContext::RenderTargetSlots];
+			const unsigned int* handles = payload<unsigned int>(a[1]);
+			for (unsigned int j = 0; j < a[0] && j < RenderContext::RenderTargetSlots; j++)
+				targets[j] = resolve<ID3D11RenderTargetView>(handles[j]);
+			context->OMSetRenderTargets(a[0], targets, resolve<ID3D11DepthStencilView>(a[2]));
+			break;
+		}
+		case Write:
+		{
+			// a: buffer, discard, payload offset, bytes, offset within the buffer
+			ID3D11Buffer* buffer = resolve<ID3D11Buffer>(a[0]);
+			unsigned char* mapped = (unsigned char*)context->Map(buffer, a[3], a[1] != 0, a[4]);
+			memcpy(mapped, payload<unsigned char>(a[2]), a[3]);
+
+			for (int j = 0; j < (int)m_patches.size(); j++)
+			{
+				const Patch& patch = m_patches[j];
+				if (patch.buffer == a[0] && patch.offset >= a[4] && patch.offset+patch.bytes <= a[4]+a[3])
+					memcpy(mapped+(patch.offset-a[4]), patch.source, patch.bytes);
+			}
+
+			context->Unmap(buffer);
+			break;
+		}
+		case ClearRenderTarget:
+			context->ClearRenderTargetView(resolve<ID3D11RenderTargetView>(a[0]), payload<float>(a[1]));
+			break;
+		case ClearDepthStencil:
+		{
+			float depth;
+			memcpy(&depth, &a[2], sizeof(depth));
+			context->ClearDepthStencilView(resolve<ID3D11DepthStencilView>(a[0]), a[1], depth, (unsigned char)a[3]);
+			break;
+		}
+		case Copy:
+			context->CopyResource(resolve<ID3D11Resource>(a[0]), resolve<ID3D11Resource>(a[1]));
+			break;
+		case Draw:
+			context->DrawIndexed(a[0], a[1], (int)a[2]);
+			break;
+		case DrawInstanced:
+			context->DrawIndexedInstanced(a[0], a[1], a[2], (int)a[3], a[4]);
+			break;
+		case Text:
+		{
+			float x, y;
+			memcpy(&x, &a[1], sizeof(x));
+			memcpy(&y, &a[2], sizeof(y));
+			context->DrawString(payload<wchar_t>(a[0]), x, y);
+			break;
+		}
+		}
+	}
+}
+
+bool CommandBuffer::save(const std::string& filename)
+{
+	FILE* file = fopen(filename.c_str(), "wb");
+	if (!file)
+		return false;
+
+	// Header, then the commands and payload as they are in memory (handles are already indices)
+	unsigned int header[5] = { FileMagic, FileVersion, (unsigned int)m_commands.size(), (unsigned int)m_payload.size(), (unsigned int)m_handles.size() };
+	bool written = fwrite(header, sizeof(header), 1, file) == 1;
+	written &= m_commands.empty() || fwrite(m_commands.data(), sizeof(Command), m_commands.size(), file) == m_commands.size();
+	written &= m_payload.empty() || fwrite(m_payload.data(), 1, m_payload.size(), file) == m_payload.size();
+
+	fclose(file);
+	return written;
+}
+
+bool CommandBuffer::load(const std::string& filename)
+{
+	FILE* file = fopen(filename.c_str(), "rb");
+	if (!file)
+		return false;
+
+	Reset();
+
+	unsigned int header[5];
+	bool read = fread(header, sizeof(header), 1, file) == 1 && header[0] == FileMagic && header[1] == FileVersion;
+	if (read)
+	{
+		m_commands.resize(header[2]);
+		m_payload.resize(header[3]);
+		read &= m_commands.empty() || fread(m_commands.data(), sizeof(Command), m_commands.size(), file) == m_commands.size();
+		read &= m_payload.empty() || fread(m_payload.data(), 1, m_payload.size(), file) == m_payload.size();
+	}
+	fclose(file);
+
+	if (!read)
+	{
+		Reset();
+		return false;
+	}
+
+	// NB: Stand-in handles, distinct and non-null, that only a null backend can be given
+	for (unsigned int i = 1; i < header[4]; i++)
+		m_handles.push_back((const void*)(size_t)(16*i));
+
+	m_recorded = true;
+	return true;
+}
+
+std::string CommandBuffer::getListing()
+{
+	std::string listing;
+	for (int i = 0; i < (int)m_commands.size(); i++)
+	{
+		const Command& command = m_commands[i];
+		const unsigned int* a = command.args;
+
+		char line[160];
+		switch (command.type)
+		{
+		case VertexBuffers:
+		case VertexConstantBuffers:
+		case VertexConstantBuffers1:
+		case PixelConstantBuffers:
+		case PixelConstantBuffers1:
+		case ShaderResources:
+		case Samplers:
+		{
+			std::string handles;
+			for (unsigned int j = 0; j < a[1]; j++)
+				handles += " #" + std::to_string(payload<unsigned int>(a[2])[j]);
+			snprintf(line, sizeof(line), "%-24s %u:%s", getTypeName((Type)command.type), a[0], handles.c_str());
+			break;
+		}
+		case RenderTargets:
+			snprintf(line, sizeof(line), "%-24s %u target(s), #%u first, depth #%u", getTypeName((Type)command.type), a[0], (a[0] > 0) ? payload<unsigned int>(a[1])[0] : 0, a[2]);
+			break;
+		case Viewports:
+		{
+			const RenderViewport* viewport = payload<RenderViewport>(a[1]);
+			snprintf(line, sizeof(line), "%-24s %gx%g", getTypeName((Type)command.type), viewport->Width, viewport->Height);
+			break;
+		}
+		case Write:
+			snprintf(line, sizeof(line), "%-24s #%u %u bytes at %u%s", getTypeName((Type)command.type), a[0], a[3], a[4], (a[1]) ? "" : " (no overwrite)");
+			break;
+		case Draw:
+			snprintf(line, sizeof(line), "%-24s %u indices", getTypeName((Type)command.type), a[0]);
+			break;
+		case DrawInstanced:
+			snprintf(line, sizeof(line), "%-24s %u indices x %u", getTypeName((Type)command.type), a[0], a[1]);
+			break;
+		case Text:
+			snprintf(line, sizeof(line), "%-24s %u character(s)", getTypeName((Type)command.type), (unsigned int)wcslen(payload<wchar_t>(a[0])));
+			break;
+		default:
+			snprintf(line, sizeof(line), "%-24s #%u", getTypeName((Type)command.type), a[0]);
+			break;
+		}
+
+		listing += line;
+		listing += "\n";
+	}
+
+	return listing;
+}
+
+int CommandBuffer::getCommandCount()
+{
+	return (int)m_commands.size();
+}
+
+int CommandBuffer::getCommandCount(Type type)
+{
+	int count = 0;
+	for (int i = 0; i < (int)m_commands.size(); i++)
+		count += (m_commands[i].type == type) ? 1 : 0;
+
+	return count;
+}
+
+size_t CommandBuffer::getPayloadBytes()
+{
+	return m_payload.size();
+}
+
+const char* CommandBuffer::getTypeName(Type type)
+{
+	static const char* names[TypeCount] = {
+		"IASetInputLayout",
+		"IASetVertexBuffers",
+		"IASetIndexBuffer",
+		"IASetPrimitiveTopology",
+		"VSSetShader",
+		"VSSetConstantBuffers",
+		"VSSetConstantBuffers1",
+		"PSSetShader",
+		"PSSetConstantBuffers",
+		"PSSetConstantBuffers1",
+		"PSSetShaderResources",
+		"PSSetSamplers",
+		"RSSetState",
+		"RSSetViewports",
+		"OMSetBlendState",
+		"OMSetDepthStencilState",
+		"OMSetRenderTargets",
+		"Map",
+		"ClearRenderTargetView",
+		"ClearDepthStencilView",
+		"CopyResource",
+		"DrawIndexed",
+		"DrawIndexedInstanced",
+		"DrawString",
+	};
+
+	return (type < TypeCount) ? names[type] : "Unknown";
+}
+
+void CommandBuffer::IASetInputLayout(ID3D11InputLayout* layout)
+{
+	record(InputLayout, handle(layout));
+	m_target->IASetInputLayout(layout);
+}
+
+void CommandBuffer::IASetVertexBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets)
+{
+	unsigned int at = appendHandles((const void* const*)buffers, count);
+	append(strides, count*sizeof(unsigned int));
+	append(offsets, count*sizeof(unsigned int));
+	record(VertexBuffers, slot, count, at);
+
+	m_target->IASetVertexBuffers(slot, count, buffers, strides, offsets);
+}
+
+void CommandBuffer::IASetIndexBuffer(ID3D11Buffer* buffer, int format, unsigned int offset)
+{
+	record(IndexBuffer, handle(buffer), (unsigned int)format, offset);
+	m_target->IASetIndexBuffer(buffer, format, offset);
+}
+
+void CommandBuffer::IASetPrimitiveTopology(int topology)
+{
+	record(PrimitiveTopology, (unsigned int)topology);
+	m_target->IASetPrimitiveTopology(topology);
+}
+
+void CommandBuffer::VSSetShader(ID3D11VertexShader* shader)
+{
+	record(VertexShader, handle(shader));
+	m_target->VSSetShader(shader);
+}
+
+void CommandBuffer::VSSetConstantBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers)
+{
+	record(VertexConstantBuffers, slot, count, appendHandles((const void* const*)buffers, count));
+	m_target->VSSetConstantBuffers(slot, count, buffers);
+}
+
+void CommandBuffer::VSSetConstantBuffers1(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* constantCounts)
+{
+	unsigned int at = appendHandles((const void* const*)buffers, count);
+	append(firstConstants, count*sizeof(unsigned int));
+	append(constantCounts, count*sizeof(unsigned int));
+	record(VertexConstantBuffers1, slot, count, at);
+
+	m_target->VSSetConstantBuffers1(slot, count, buffers, firstConstants, constantCounts);
+}
+
+void CommandBuffer::PSSetShader(ID3D11PixelShader* shader)
+{
+	record(PixelShader, handle(shader));
+	m_target->PSSetShader(shader);
+}
+
+void CommandBuffer::PSSetConstantBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers)
+{
+	record(PixelConstantBuffers, slot, count, appendHandles((const void* const*)buffers, count));
+	m_target->PSSetConstantBuffers(slot, count, buffers);
+}
+
+void CommandBuffer::PSSetConstantBuffers1(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* constantCounts)
+{
+	unsigned int at = appendHandles((const void* const*)buffers, count);
+	append(firstConstants, count*sizeof(unsigned int));
+	append(constantCounts, count*sizeof(unsigned int));
+	record(PixelConstantBuffers1, slot, count, at);
+
+	m_target->PSSetConstantBuffers1(slot, count, buffers, firstConstants, constantCounts);
+}
+
+void CommandBuffer::PSSetShaderResources(unsigned int slot, unsigned int count, ID3D11ShaderResourceView* const* views)
+{
+	record(ShaderResources, slot, count, appendHandles((const void* const*)views, count));
+	m_target->PSSetShaderResources(slot, count, views);
+}
+
+void CommandBuffer::PSSetSamplers(unsigned int slot, unsigned int count, ID3D11SamplerState* const* samplers)
+{
+	record(Samplers, slot, count, appendHandles((const void* const*)samplers, count));
+	m_target->PSSetSamplers(slot, count, samplers);
+}
+
+void CommandBuffer::RSSetState(ID3D11RasterizerState* state)
+{
+	record(RasterizerState, handle(state));
+	m_target->RSSetState(state);
+}
+
+void CommandBuffer::RSSetViewports(unsigned int count, const RenderViewport* viewports)
+{
+	record(Viewports, count, append(viewports, count*sizeof(RenderViewport)));
+	if (count > 0)
+		m_viewport = viewports[0];
+
+	m_target->RSSetViewports(count, viewports);
+}
+
+RenderViewport CommandBuffer::RSGetViewport()
+{
+	// NB: Not a command; it changes nothing, so is answered without being recorded
+	return (m_target) ? m_target->RSGetViewport() : m_viewport;
+}
+
+void CommandBuffer::OMSetBlendState(ID3D11BlendState* state, const float factor[4], unsigned int sampleMask)
+{
+	record(BlendState, handle(state), (factor) ? append(factor, 4*sizeof(float)) : NoPayload, sampleMask);
+	m_target->OMSetBlendState(state, factor, sampleMask);
+}
+
+void CommandBuffer::OMSetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef)
+{
+	record(DepthStencilState, handle(state), stencilRef);
+	m_target->OMSetDepthStencilState(state, stencilRef);
+}
+
+void CommandBuffer::OMSetRenderTargets(unsigned int count, ID3D11RenderTargetView* const* targets, ID3D11DepthStencilView* depthStencil)
+{
+	record(RenderTargets, count, appendHandles((const void* const*)targets, count), handle(depthStencil));
+	m_target->OMSetRenderTargets(count, targets, depthStencil);
+}
+
+void* CommandBuffer::Map(ID3D11Buffer* buffer, unsigned int offset, unsigned int bytes, bool discard)
+{
+	// The caller writes into the payload, which is copied on to the target's memory on Unmap
+	m_mapped = m_target->Map(buffer, offset, bytes, discard);
+
+	unsigned int at = (unsigned int)m_payload.size();
+	m_payload.resize(at+bytes);
+	record(Write, handle(buffer), (discard) ? 1 : 0, at, bytes, offset);
+
+	return m_payload.data()+at;
+}
+
+void CommandBuffer::Unmap(ID3D11Buffer* buffer)
+{
+	// NB: Nothing else is recorded between a Map and its Unmap, so the open map is always the last command
+	const Command& command = m_commands.back();
+	memcpy(m_mapped, m_payload.data()+command.args[2], command.args[3]);
+
+	m_target->Unmap(buffer);
+	m_mapped = nullptr;
+}
+
+void CommandBuffer::ClearRenderTargetView(ID3D11RenderTargetView* target, const float colour[4])
+{
+	record(ClearRenderTarget, handle(target), append(colour, 4*sizeof(float)));
+	m_target->ClearRenderTargetView(target, colour);
+}
+
+void CommandBuffer::ClearDepthStencilView(ID3D11DepthStencilView* depthStencil, unsigned int flags, float depth, unsigned char stencil)
+{
+	unsigned int depthBits;
+	memcpy(&depthBits, &depth, sizeof(depthBits));
+
+	record(ClearDepthStencil, handle(depthStencil), flags, depthBits, stencil);
+	m_target->ClearDepthStencilView(depthStencil, flags, depth, stencil);
+}
+
+void CommandBuffer::CopyResource(ID3D11Resource* destination, ID3D11Resource* source)
+{
+	record(Copy, handle(destination), handle(source));
+	m_target->CopyResource(destination, source);
+}
+
+void CommandBuffer::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	record(Draw, indexCount, startIndex, (unsigned int)baseVertex);
+	m_target->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void CommandBuffer::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance)
+{
+	record(DrawInstanced, indexCount, instanceCount, startIndex, (unsigned int)baseVertex, startInstance);
+	m_target->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+void CommandBuffer::DrawString(const wchar_t* text, float x, float y)
+{
+	unsigned int xBits, yBits;
+	memcpy(&xBits, &x, sizeof(xBits));
+	memcpy(&yBits, &y, sizeof(yBits));
+	record(Text, append(text, (unsigned int)((wcslen(text)+1)*sizeof(wchar_t))), xBits, yBits);
+	m_target->DrawString(text, x, y);
+}
+
+void CommandBuffer::record(Type type, unsigned int a0, unsigned int a1, unsigned int a2, unsigned int a3, unsigned int a4, unsigned int a5, unsigned int a6)
+{
+	m_commands.push_back({ (unsigned int)type, { a0, a1, a2, a3, a4, a5, a6 } });
+}
+
+unsigned int CommandBuffer::handle(const void* pointer)
+{
+	auto found = m_handleIndices.find(pointer);
+	if (found != m_handleIndices.end())
+		return found->second;
+
+	unsigned int index = (unsigned int)m_handles.size();
+	m_handles.push_back(pointer);
+	m_handleIndices[pointer] = index;
+
+	return index;
+}
+
+unsigned int CommandBuffer::append(const void* data, unsigned int bytes)
+{
+	unsigned int at = (unsigned int)m_payload.size();
+	m_payload.insert(m_payload.end(), (const unsigned char*)data, (const unsigned char*)data+bytes);
+
+	return at;
+}
+
+unsigned int CommandBuffer::appendHandles(const void* const* pointers, unsigned int count)
+{
+	unsigned int at = (unsigned int)m_payload.size();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int index = handle(pointers[i]);
+		append(&index, sizeof(index));
+	}
+
+	return at;
+}
+
+template <typename T>
+T* CommandBuffer::resolve(unsigned int index)
+{
+	return (T*)m_handles[index];
+}
+
+template <typename T>
+const T* CommandBuffer::payload(unsigned int offset)
+{
+	return (const T*)(m_payload.data()+offset);
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "RenderContext.h"
+
+// A recording of everything a render context passed on to its backend, as a flat stream of POD commands.
+// Replaying it re-issues the same commands through a context, with any registered constant patches applied, so a pass
+// that issues the same sequence every time only has to be walked once. Recordings also save to disk, to diff between builds.
+// NB: Handles are stored as indices into a table of the pointers seen while recording, in order of first use, so
+// listings stay comparable between runs. A recording loaded from disk has no real handles, so can only be replayed
+// into a context whose backend never dereferences them (i.e. NullRenderContextBackend)
+class CommandBuffer : public RenderContextBackend
+{
+public:
+	enum Type
+	{
+		InputLayout,
+		VertexBuffers,
+		IndexBuffer,
+		PrimitiveTopology,
+		VertexShader,
+		VertexConstantBuffers,
+		VertexConstantBuffers1,
+		PixelShader,
+		PixelConstantBuffers,
+		PixelConstantBuffers1,
+		ShaderResources,
+		Samplers,
+		RasterizerState,
+		Viewports,
+		BlendState,
+		DepthStencilState,
+		RenderTargets,
+		Write,			// Constants written between a Map and its Unmap are kept in the payload
+		ClearRenderTarget,
+		ClearDepthStencil,
+		Copy,
+		Draw,
+		DrawInstanced,
+		Text,			// The string is kept in the payload
+		TypeCount
+	};
+
+	// Arguments are scalars, handle indices, or offsets into the payload for anything variable-length
+	struct Command
+	{
+		unsigned int	type;
+		unsigned int	args[7];
+	};
+
+	CommandBuffer();
+
+	// Swaps the context's backend for this one, which records each call and passes it on to the original.
+	// NB: The context's shadow is invalidated first, so the recording binds everything it relies on, and the constant
+	// ring is detached while recording, since a replayed ring write would land wherever the ring has moved on to since
+	void							Begin(RenderContext* context);
+	void							End();
+	void							Reset();		// Forgets the recording and patches (e.g. once its handles are released)
+
+	bool							getRecorded();	// Whether there is a finished recording to replay
+
+	// On replay, every recorded write to buffer has bytes at offset replaced by whatever source then points to
+	void							addPatch(ID3D11Buffer* buffer, unsigned int offset, const void* source, unsigned int bytes);
+	void							Replay(RenderContext* context);
+
+	bool							save(const std::string& filename);
+	bool							load(const std::string& filename);
+
+	std::string						getListing();		// One line per command, with handles as #indices
+	int								getCommandCount();
+	int								getCommandCount(Type type);
+	size_t							getPayloadBytes();
+	static const char*				getTypeName(Type type);
+
+	// RenderContextBackend
+	void							IASetInputLayout(ID3D11InputLayout* layout) override;
+	void							IASetVertexBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets) override;
+	void							IASetIndexBuffer(ID3D11Buffer* buffer, int format, unsigned int offset) override;
+	void							IASetPrimitiveTopology(int topology) override;
+
+	void							VSSetShader(ID3D11VertexShader* shader) override;
+	void							VSSetConstantBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers) override;
+	void							VSSetConstantBuffers1(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* constantCounts) override;
+	void							PSSetShader(ID3D11PixelShader* shader) override;
+	void							PSSetConstantBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers) override;
+	void							PSSetConstantBuffers1(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* constantCounts) override;
+	void							PSSetShaderResources(unsigned int slot, unsigned int count, ID3D11ShaderResourceView* const* views) override;
+	void							PSSetSamplers(unsigned int slot, unsigned int count, ID3D11SamplerState* const* samplers) override;
+
+	void							RSSetState(ID3D11RasterizerState* state) override;
+	void							RSSetViewports(unsigned int count, const RenderViewport* viewports) override;
+	RenderViewport					RSGetViewport() override;
+
+	void							OMSetBlendState(ID3D11BlendState* state, const float factor[4], unsigned int sampleMask) override;
+	void							OMSetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef) override;
+	void							OMSetRenderTargets(unsigned int count, ID3D11RenderTargetView* const* targets, ID3D11DepthStencilView* depthStencil) override;
+
+	void*							Map(ID3D11Buffer* buffer, unsigned int offset, unsigned int bytes, bool discard) override;
+	void							Unmap(ID3D11Buffer* buffer) override;
+
+	void							ClearRenderTargetView(ID3D11RenderTargetView* target, const float colour[4]) override;
+	void							ClearDepthStencilView(ID3D11DepthStencilView* depthStencil, unsigned int flags, float depth, unsigned char stencil) override;
+	void							CopyResource(ID3D11Resource* destination, ID3D11Resource* source) override;
+	void							DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) override;
+	void							DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance) override;
+	void							DrawString(const wchar_t* text, float x, float y) override;
+
+private:
+	struct Patch
+	{
+		unsigned int	buffer;		// Handle index
+		unsigned int	offset;
+		const void*		source;
+		unsigned int	bytes;
+	};
+
+	void							record(Type type, unsigned int a0 = 0, unsigned int a1 = 0, unsigned int a2 = 0, unsigned int a3 = 0, unsigned int a4 = 0, unsigned int a5 = 0, unsigned int a6 = 0);
+	unsigned int					handle(const void* pointer);			// 0 is always nullptr
+	unsigned int					append(const void* data, unsigned int bytes);	// Returns the payload offset
+	unsigned int					appendHandles(const void* const* pointers, unsigned int count);
+
+	template <typename T>
+	T*								resolve(unsigned int index);			// Handle index back to a pointer
+	template <typename T>
+	const T*						payload(unsigned int offset);
+
+	std::vector<Command>			m_commands;
+	std::vector<unsigned char>		m_payload;
+	std::vector<const void*>		m_handles;
+	std::unordered_map<const void*, unsigned int>	m_handleIndices;
+	std::vector<Patch>				m_patches;
+
+	RenderContext*					m_context;		// While recording
+	RenderContextBackend*			m_target;		// Where recorded calls are passed on to
+	ConstantRing*					m_ring;			// Detached while recording
+	RenderViewport					m_viewport;
+	void*							m_mapped;		// The target's memory for the open Map, filled from the payload on Unmap
+	bool							m_recorded;
+};
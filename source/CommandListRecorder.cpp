@@ -0,0 +1,255 @@
+#include "pch.h"
+#include "CommandListRecorder.h"
+#include <chrono>
+
+RecordedCommandListBackend::RecordedCommandListBackend()
+{
+}
+
+void RecordedCommandListBackend::setListCount(int count)
+{
+	while ((int)m_buffers.size() < count)
+	{
+		m_buffers.push_back(std::unique_ptr<CommandBuffer>(new CommandBuffer()));
+		m_targets.push_back(std::unique_ptr<NullRenderContextBackend>(new NullRenderContextBackend()));
+	}
+}
+
+void RecordedCommandListBackend::beginList(int list, RenderContext* context)
+{
+	m_targets[list]->Reset();
+	context->Initialise(m_targets[list].get());
+	m_buffers[list]->Begin(context);
+}
+
+void RecordedCommandListBackend::endList(int list)
+{
+	m_buffers[list]->End();
+}
+
+void RecordedCommandListBackend::executeList(int list, RenderContext* immediate)
+{
+	m_buffers[list]->Replay(immediate);
+}
+
+CommandBuffer* RecordedCommandListBackend::getList(int list)
+{
+	return m_buffers[list].get();
+}
+
+CommandListRecorder::CommandListRecorder()
+{
+	m_backend = nullptr;
+	m_count = 0;
+	m_record = nullptr;
+	m_next = 0;
+
+	m_generation = 0;
+	m_working = 0;
+	m_stopping = false;
+}
+
+CommandListRecorder::~CommandListRecorder()
+{
+	StopThreads();
+}
+
+void CommandListRecorder::Initialise(CommandListBackend* backend, int threadCount)
+{
+	m_backend = backend;
+	m_count = 0;
+
+	setThreadCount(threadCount);
+}
+
+void CommandListRecorder::setThreadCount(int threadCount)
+{
+	StopThreads();
+
+	// NB: The submitting thread records too, so only the rest need threads of their own
+	for (int i = 1; i < threadCount; i++)
+		m_threads.push_back(std::thread(&CommandListRecorder::Work, this, m_generation));
+}
+
+int CommandListRecorder::getThreadCount()
+{
+	return 1+(int)m_threads.size();
+}
+
+void CommandListRecorder::Record(int count, const RecordFunction& record)
+{
+	m_backend->setListCount(count);
+	while ((int)m_contexts.size() < count)
+		m_contexts.push_back(std::unique_ptr<RenderContext>(new RenderContext()));
+
+	m_count = count;
+	m_record = &record;
+	m_next = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_working = (int)m_threads.size();
+		m_generation++;
+	}
+	m_started.notify_all();
+
+	RecordLists();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_finished.wait(lock, [this]() { return m_working == 0; });
+	m_record = nullptr;
+}
+
+void CommandListRecorder::Submit(RenderContext* immediate)
+{
+	// NB: Lists were recorded in any order, but are executed in the order they were asked for, so later lists may depend on earlier
+	for (int i = 0; i < m_count; i++)
+		m_backend->executeList(i, immediate);
+}
+
+int CommandListRecorder::getListCount()
+{
+	return m_count;
+}
+
+int CommandListRecorder::getBoundCount()
+{
+	int count = 0;
+	for (int i = 0; i < m_count; i++)
+		count += m_contexts[i]->getBoundCount();
+
+	return count;
+}
+
+int CommandListRecorder::getBoundCount(RenderContext::Call call)
+{
+	int count = 0;
+	for (int i = 0; i < m_count; i++)
+		count += m_contexts[i]->getBoundCount(call);
+
+	return count;
+}
+
+size_t CommandListRecorder::getMappedBytes()
+{
+	size_t bytes = 0;
+	for (int i = 0; i < m_count; i++)
+		bytes += m_contexts[i]->getMappedBytes();
+
+	return bytes;
+}
+
+bool CommandListRecorder::benchmark(int count, int draws, int repeats, std::string& report)
+{
+	// NB: Made-up handles stand in for real state, as in DrawQueue::compareStateChanges
+	RecordFunction record = [draws](RenderContext* context, int list) {
+		ID3D11RenderTargetView* target = (ID3D11RenderTargetView*)(size_t)(0x1000+16*list);
+		float colour[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		RenderViewport viewport = { 0.0f, 0.0f, 512.0f, 512.0f, 0.0f, 1.0f };
+
+		context->OMSetRenderTargets(1, &target, nullptr);
+		context->ClearRenderTargetView(target, colour);
+		context->RSSetViewports(1, &viewport);
+		for (int i = 0; i < draws; i++)
+		{
+			ID3D11Buffer* constants = (ID3D11Buffer*)(size_t)(0x2000+16*(i%4));
+			ID3D11ShaderResourceView* texture = (ID3D11ShaderResourceView*)(size_t)(0x3000+16*(i%8));
+
+			context->VSSetShader((ID3D11VertexShader*)(size_t)(0x4000+16*(i%4)), 0, 0);
+			context->PSSetShader((ID3D11PixelShader*)(size_t)(0x5000+16*(i%4)), 0, 0);
+			float* data = (float*)context->Map(constants, 192);
+			for (int j = 0; j < 48; j++)
+				data[j] = (float)(list*draws+i+j);
+			context->Unmap(constants);
+			context->VSSetConstants(0, { constants, 0, 0 });
+			context->PSSetShaderResources(0, 1, &texture);
+			context->DrawIndexed(2880, 0, 0);
+		}
+	};
+
+	// NB: Past the hardware's own thread count, only the cost of the extra threads shows
+	report = "Recording " + std::to_string(count) + " lists of " + std::to_string(draws) + " draws, on " + std::to_string(std::thread::hardware_concurrency()) + " hardware thread(s):\n";
+	int singleCalls = 0;
+	bool same = true;
+	for (int threads = 1; threads <= 8; threads *= 2)
+	{
+		NullRenderContextBackend immediateBackend;
+		RenderContext immediate;
+		immediate.Initialise(&immediateBackend);
+
+		RecordedCommandListBackend backend;
+		CommandListRecorder recorder;
+		recorder.Initialise(&backend, threads);
+
+		double recording = 0.0, submitting = 0.0;
+		for (int r = 0; r < repeats; r++)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			recorder.Record(count, record);
+			auto recorded = std::chrono::high_resolution_clock::now();
+			recorder.Submit(&immediate);
+			auto end = std::chrono::high_resolution_clock::now();
+
+			recording += std::chrono::duration<double, std::micro>(recorded-start).count();
+			submitting += std::chrono::duration<double, std::micro>(end-recorded).count();
+		}
+
+		// NB: However the lists were shared out, replaying them must reach the device the same
+		if (threads == 1)
+			singleCalls = immediateBackend.getCallCount();
+		same = same && immediateBackend.getCallCount() == singleCalls;
+
+		char line[128];
+		snprintf(line, sizeof(line), "  %2d thread(s): %8.1fus recording, %8.1fus submitting, %d calls replayed\n", threads, recording/repeats, submitting/repeats, immediateBackend.getCallCount());
+		report += line;
+	}
+
+	return same;
+}
+
+void CommandListRecorder::Work(int generation)
+{
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_started.wait(lock, [this, generation]() { return m_stopping || m_generation != generation; });
+			if (m_stopping)
+				return;
+
+			generation = m_generation;
+		}
+
+		RecordLists();
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (--m_working == 0)
+			m_finished.notify_all();
+	}
+}
+
+void CommandListRecorder::RecordLists()
+{
+	for (int list = m_next++; list < m_count; list = m_next++)
+	{
+		RenderContext* context = m_contexts[list].get();
+		m_backend->beginList(list, context);
+		(*m_record)(context, list);
+		m_backend->endList(list);
+	}
+}
+
+void CommandListRecorder::StopThreads()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_started.notify_all();
+
+	for (int i = 0; i < (int)m_threads.size(); i++)
+		m_threads[i].join();
+
+	m_threads.clear();
+	m_stopping = false;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "RenderContext.h"
+#include "CommandBuffer.h"
+
+// Where a recorder's lists are recorded, and how they reach the immediate context.
+// NB: beginList and endList are called on whichever thread records the list, so must touch nothing shared between lists
+class CommandListBackend
+{
+public:
+	virtual ~CommandListBackend() {}
+
+	virtual void					setListCount(int count) = 0;		// Called before recording starts, on the submitting thread
+	virtual void					beginList(int list, RenderContext* context) = 0;	// Points context at wherever list is recorded
+	virtual void					endList(int list) = 0;
+	virtual void					executeList(int list, RenderContext* immediate) = 0;
+};
+
+// Records each list into a CommandBuffer, then replays it through the immediate context, so runs anywhere (e.g. headlessly)
+class RecordedCommandListBackend : public CommandListBackend
+{
+public:
+	RecordedCommandListBackend();
+
+	void							setListCount(int count) override;
+	void							beginList(int list, RenderContext* context) override;
+	void							endList(int list) override;
+	void							executeList(int list, RenderContext* immediate) override;
+
+	CommandBuffer*					getList(int list);
+
+private:
+	std::vector<std::unique_ptr<CommandBuffer>>				m_buffers;
+	std::vector<std::unique_ptr<NullRenderContextBackend>>	m_targets;	// Recording passes everything on to nothing
+};
+
+// Records independent lists of commands in parallel, each on its own render context, then submits them in list order.
+// NB: Each list starts from a blank shadow and no constant ring, so must bind everything it relies on itself
+class CommandListRecorder
+{
+public:
+	typedef std::function<void(RenderContext*, int)> RecordFunction;	// Records one list, given its index
+
+	CommandListRecorder();
+	~CommandListRecorder();
+
+	void							Initialise(CommandListBackend* backend, int threadCount);	// The submitting thread counts as one
+	void							setThreadCount(int threadCount);
+	int								getThreadCount();
+
+	void							Record(int count, const RecordFunction& record);	// Returns once every list is recorded
+	void							Submit(RenderContext* immediate);					// Executes the lists recorded last, in order
+
+	int								getListCount();
+	int								getBoundCount();		// Calls the lists' contexts passed on while recording
+	int								getBoundCount(RenderContext::Call call);
+	size_t							getMappedBytes();
+
+	// Microseconds to record and then submit count lists of draws each, against the recorded backend, for 1 to 8 threads.
+	// False if any thread count replayed a different number of calls than one thread did
+	static bool						benchmark(int count, int draws, int repeats, std::string& report);
+
+private:
+	void							Work(int generation);	// Worker thread loop, from the batch it was started after
+	void							RecordLists();		// Claims and records lists until none are left
+	void							StopThreads();
+
+	CommandListBackend*				m_backend;
+	std::vector<std::unique_ptr<RenderContext>>	m_contexts;
+	int								m_count;
+	const RecordFunction*			m_record;
+	std::atomic<int>				m_next;
+
+	std::vector<std::thread>		m_threads;
+	std::mutex						m_mutex;
+	std::condition_variable			m_started;
+	std::condition_variable			m_finished;
+	int								m_generation;	// Bumped to set the workers off on a new batch
+	int								m_working;		// Workers yet to finish the current batch
+	bool							m_stopping;
+};
@@ -0,0 +1,138 @@
+#include "pch.h"
+#include "ConstantRing.h"
+#include <cstring>
+
+ConstantRing::ConstantRing()
+{
+	m_device = nullptr;
+	m_buffer = nullptr;
+	m_size = 0;
+	m_offset = 0;
+
+	newFrame();
+}
+
+ConstantRing::~ConstantRing()
+{
+	Shutdown();
+}
+
+bool ConstantRing::Initialise(RenderDevice* device, unsigned int bytes)
+{
+	Shutdown();
+
+	// STEP 1: Offset binding, and mapping a constant buffer without discarding it, are both optional in 11.1
+	if (!device->getConstantOffsetting())
+		return false;
+
+	// STEP 2: Create the ring itself
+	RenderBufferDesc ringDesc;
+	ringDesc.bytes = (bytes+Alignment-1)/Alignment*Alignment;
+	ringDesc.bind = RenderBindConstantBuffer;
+	ringDesc.dynamic = true;
+
+	m_device = device;
+	m_buffer = m_device->CreateBuffer(ringDesc);
+	if (!m_buffer)
+		return false;
+
+	// NB: Starting full means the first write discards, so nothing is ever written over the GPU's feet
+	m_size = ringDesc.bytes;
+	m_offset = m_size;
+
+	return true;
+}
+
+void ConstantRing::Shutdown()
+{
+	if (m_device)
+		m_device->Release(m_buffer);
+
+	m_buffer = nullptr;
+	m_size = 0;
+	m_offset = 0;
+	m_allocations.clear();
+}
+
+void ConstantRing::newFrame()
+{
+	for (int i = 0; i < TierCount; i++)
+	{
+		m_writeCount[i] = 0;
+		m_reuseCount[i] = 0;
+	}
+}
+
+ConstantBinding ConstantRing::write(RenderContext* context, Tier tier, const void* key, const void* data, unsigned int bytes)
+{
+	// STEP 1: Reuse the last allocation for this tier and key if nothing has changed
+	Allocation* allocation = nullptr;
+	for (int i = 0; i < (int)m_allocations.size(); i++)
+	{
+		if (m_allocations[i].tier == tier && m_allocations[i].key == key)
+		{
+			allocation = &m_allocations[i];
+			break;
+		}
+	}
+
+	if (allocation && allocation->data.size() == bytes && memcmp(allocation->data.data(), data, bytes) == 0)
+	{
+		m_reuseCount[tier]++;
+		return allocation->binding;
+	}
+
+	// STEP 2: Reserve a window, wrapping (and discarding) once the ring is full
+	unsigned int reserved = (bytes+Alignment-1)/Alignment*Alignment;
+	bool discard = (m_offset+reserved > m_size);
+	if (discard)
+	{
+		// NB: Everything written before the wrap is gone, so none of it can be reused
+		m_offset = 0;
+		m_allocations.clear();
+		allocation = nullptr;
+	}
+
+	void* window = context->Map(m_buffer, bytes, discard, m_offset);
+	memcpy(window, data, bytes);
+	context->Unmap(m_buffer);
+
+	ConstantBinding binding = { m_buffer, m_offset/16, reserved/16 };
+	m_offset += reserved;
+	m_writeCount[tier]++;
+
+	// STEP 3: Remember it for next time
+	if (!allocation)
+	{
+		m_allocations.push_back(Allocation());
+		allocation = &m_allocations.back();
+		allocation->tier = tier;
+		allocation->key = key;
+	}
+	allocation->binding = binding;
+	allocation->data.assign((const char*)data, (const char*)data+bytes);
+
+	return binding;
+}
+
+int ConstantRing::getWriteCount(Tier tier)
+{
+	return m_writeCount[tier];
+}
+
+int ConstantRing::getReuseCount(Tier tier)
+{
+	return m_reuseCount[tier];
+}
+
+const char* ConstantRing::getTierName(Tier tier)
+{
+	static const char* names[TierCount] = {
+		"Frame",
+		"View",
+		"Object",
+		"Material",
+	};
+
+	return names[tier];
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "RenderContext.h"
+#include "RenderDevice.h"
+
+// One large dynamic constant buffer that every shader sub-allocates from, bound a 256-byte window at a time (Direct3D 11.1).
+// Constants are split by how often they change, and a write that matches what its tier last wrote reuses that allocation instead
+class ConstantRing
+{
+public:
+	enum Tier
+	{
+		Frame,		// Time
+		View,		// Camera and projection, shared by a whole pass or capture face
+		Object,		// World matrix
+		Material,	// Each shader's own parameters
+		TierCount
+	};
+
+	ConstantRing();
+	~ConstantRing();
+
+	bool							Initialise(RenderDevice* device, unsigned int bytes);	// False where the device cannot bind windows of a buffer
+	void							Shutdown();
+
+	void							newFrame();		// Resets the counts
+
+	// Copies bytes of data into the ring, unless (tier, key) last wrote the same bytes, and returns the window to bind it with
+	ConstantBinding					write(RenderContext* context, Tier tier, const void* key, const void* data, unsigned int bytes);
+
+	// Since the last newFrame
+	int								getWriteCount(Tier tier);
+	int								getReuseCount(Tier tier);
+	static const char*				getTierName(Tier tier);
+
+	static const unsigned int		Alignment = 256;	// Windows must start on, and span, a multiple of 16 constants
+
+private:
+	struct Allocation
+	{
+		Tier				tier;
+		const void*			key;
+		ConstantBinding		binding;
+		std::vector<char>	data;
+	};
+
+	RenderDevice*					m_device;
+	ID3D11Buffer*					m_buffer;
+	unsigned int					m_size;
+	unsigned int					m_offset;
+
+	std::vector<Allocation>			m_allocations;	// The latest write for each (tier, key), while it is still in the ring
+
+	int								m_writeCount[TierCount];
+	int								m_reuseCount[TierCount];
+};
@@ -0,0 +1,63 @@
+#include "pch.h"
+#include "DeviceCommandListBackend.h"
+
+DeviceCommandListBackend::DeviceCommandListBackend()
+{
+	m_device = nullptr;
+	m_immediate = nullptr;
+}
+
+bool DeviceCommandListBackend::Initialise(ID3D11Device* device, ID3D11DeviceContext* immediate)
+{
+	m_device = device;
+	m_immediate = immediate;
+
+	m_deferred.clear();
+	m_backends.clear();
+	m_lists.clear();
+
+	// NB: Single-threaded devices refuse deferred contexts outright
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> deferred;
+	if (FAILED(m_device->CreateDeferredContext(0, &deferred)))
+		return false;
+
+	m_deferred.push_back(deferred);
+	m_backends.push_back(std::unique_ptr<DeviceRenderContextBackend>(new DeviceRenderContextBackend()));
+	m_lists.push_back(nullptr);
+
+	return true;
+}
+
+void DeviceCommandListBackend::setListCount(int count)
+{
+	while (m_deferred.size() < count)
+	{
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> deferred;
+		DX::ThrowIfFailed(m_device->CreateDeferredContext(0, &deferred));
+
+		m_deferred.push_back(deferred);
+		m_backends.push_back(std::unique_ptr<DeviceRenderContextBackend>(new DeviceRenderContextBackend()));
+		m_lists.push_back(nullptr);
+	}
+}
+
+void DeviceCommandListBackend::beginList(int list, RenderContext* context)
+{
+	// NB: No ID3D11DeviceContext1, as recorded lists never bind windowed constants
+	m_backends[list]->Initialise(m_deferred[list].Get(), nullptr);
+	context->Initialise(m_backends[list].get());
+}
+
+void DeviceCommandListBackend::endList(int list)
+{
+	m_lists[list].Reset();
+	DX::ThrowIfFailed(m_deferred[list]->FinishCommandList(FALSE, &m_lists[list]));
+}
+
+void DeviceCommandListBackend::executeList(int list, RenderContext* immediate)
+{
+	m_immediate->ExecuteCommandList(m_lists[list].Get(), FALSE);
+	m_lists[list].Reset();
+
+	immediate->Invalidate();
+}
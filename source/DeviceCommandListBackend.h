@@ -0,0 +1,24 @@
+#pragma once
+#include "CommandListRecorder.h"
+#include "DeviceRenderContextBackend.h"
+
+// Records each list on a deferred context of its own, then executes the finished command lists on the immediate context
+class DeviceCommandListBackend : public CommandListBackend
+{
+public:
+	DeviceCommandListBackend();
+
+	bool							Initialise(ID3D11Device* device, ID3D11DeviceContext* immediate);	// False if the device cannot create deferred contexts
+
+	void							setListCount(int count) override;
+	void							beginList(int list, RenderContext* context) override;
+	void							endList(int list) override;
+	void							executeList(int list, RenderContext* immediate) override;	// Invalidates immediate, as executing leaves the device in its default state
+
+private:
+	ID3D11Device*					m_device;
+	ID3D11DeviceContext*			m_immediate;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11DeviceContext>>	m_deferred;
+	std::vector<std::unique_ptr<DeviceRenderContextBackend>>	m_backends;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11CommandList>>		m_lists;
+};
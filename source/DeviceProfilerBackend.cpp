@@ -0,0 +1,127 @@
+#include "pch.h"
+#include "DeviceProfilerBackend.h"
+
+DeviceProfilerBackend::DeviceProfilerBackend()
+{
+	m_deviceResources = nullptr;
+	m_oldest = 0;
+	m_pending = 0;
+	m_timing = false;
+}
+
+void DeviceProfilerBackend::Initialise(DX::DeviceResources* deviceResources)
+{
+	m_deviceResources = deviceResources;
+	m_oldest = 0;
+	m_pending = 0;
+	m_timing = false;
+
+	D3D11_QUERY_DESC disjointDesc = { D3D11_QUERY_TIMESTAMP_DISJOINT, 0 };
+	for (int i = 0; i < FrameLatency; i++)
+	{
+		m_sets[i].disjoint.Reset();
+		m_sets[i].timestamps.clear();
+		m_sets[i].count = 0;
+		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateQuery(&disjointDesc, &m_sets[i].disjoint));
+	}
+}
+
+bool DeviceProfilerBackend::beginFrame()
+{
+	m_timing = (m_pending < FrameLatency);
+	if (!m_timing)
+		return false;
+
+	// NB: The frame's first timestamp is what everything else in it is measured from
+	QuerySet& set = m_sets[(m_oldest+m_pending)%FrameLatency];
+	set.count = 0;
+	m_deviceResources->GetD3DDeviceContext()->Begin(set.disjoint.Get());
+	timestamp();
+
+	return true;
+}
+
+void DeviceProfilerBackend::endFrame()
+{
+	if (!m_timing)
+		return;
+
+	QuerySet& set = m_sets[(m_oldest+m_pending)%FrameLatency];
+	m_deviceResources->GetD3DDeviceContext()->End(set.disjoint.Get());
+
+	m_pending++;
+	m_timing = false;
+}
+
+int DeviceProfilerBackend::beginEvent(const char* name)
+{
+	// NB: Scope names are plain ASCII
+	std::string narrowName(name);
+	std::wstring wideName(narrowName.begin(), narrowName.end());
+	m_deviceResources->PIXBeginEvent(wideName.c_str());
+
+	return timestamp();
+}
+
+int DeviceProfilerBackend::endEvent()
+{
+	int index = timestamp();
+	m_deviceResources->PIXEndEvent();
+
+	return index;
+}
+
+bool DeviceProfilerBackend::collect(std::vector<double>& timestamps)
+{
+	if (m_pending == 0)
+		return false;
+
+	// NB: Never flushes, so a frame still on the GPU just waits for a later call
+	auto context = m_deviceResources->GetD3DDeviceContext();
+	QuerySet& set = m_sets[m_oldest];
+
+	D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+	if (context->GetData(set.disjoint.Get(), &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+		return false;
+
+	timestamps.clear();
+	if (!disjoint.Disjoint)
+	{
+		UINT64 first = 0;
+		for (int i = 0; i < set.count; i++)
+		{
+			UINT64 ticks;
+			if (context->GetData(set.timestamps[i].Get(), &ticks, sizeof(ticks), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+				return false;
+
+			first = (i == 0) ? ticks : first;
+			timestamps.push_back((double)(ticks-first)*1000000.0/(double)disjoint.Frequency);
+		}
+	}
+
+	m_oldest = (m_oldest+1)%FrameLatency;
+	m_pending--;
+
+	return true;
+}
+
+int DeviceProfilerBackend::timestamp()
+{
+	if (!m_timing)
+		return -1;
+
+	QuerySet& set = m_sets[(m_oldest+m_pending)%FrameLatency];
+	if (set.count == set.timestamps.size())
+	{
+		if (set.count == MaxTimestamps)
+			return -1;
+
+		D3D11_QUERY_DESC timestampDesc = { D3D11_QUERY_TIMESTAMP, 0 };
+		Microsoft::WRL::ComPtr<ID3D11Query> query;
+		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateQuery(&timestampDesc, &query));
+		set.timestamps.push_back(query);
+	}
+
+	m_deviceResources->GetD3DDeviceContext()->End(set.timestamps[set.count].Get());
+	return set.count++;
+}
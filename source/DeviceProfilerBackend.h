@@ -0,0 +1,40 @@
+#pragma once
+#include "DeviceResources.h"
+#include "Profiler.h"
+
+// Times scopes with timestamp queries on the immediate context, and brackets them in PIX events.
+// NB: Results come back a few frames late; a frame is simply not timed if every query set is still in flight
+class DeviceProfilerBackend : public ProfilerBackend
+{
+public:
+	DeviceProfilerBackend();
+
+	void							Initialise(DX::DeviceResources* deviceResources);
+
+	bool							beginFrame() override;
+	void							endFrame() override;
+
+	int								beginEvent(const char* name) override;
+	int								endEvent() override;
+
+	bool							collect(std::vector<double>& timestamps) override;
+
+	static const int				FrameLatency = 4;		// Frames in flight before their query sets are reused
+	static const int				MaxTimestamps = 512;	// Per frame; scopes beyond this go untimed
+
+private:
+	struct QuerySet
+	{
+		Microsoft::WRL::ComPtr<ID3D11Query>					disjoint;
+		std::vector<Microsoft::WRL::ComPtr<ID3D11Query>>	timestamps;		// Created as first needed
+		int													count;
+	};
+
+	int								timestamp();
+
+	DX::DeviceResources*			m_deviceResources;
+	QuerySet						m_sets[FrameLatency];
+	int								m_oldest;		// First set awaiting its results
+	int								m_pending;		// Sets awaiting their results
+	bool							m_timing;
+};
@@ -0,0 +1,164 @@
+#include "pch.h"
+#include "DeviceRenderContextBackend.h"
+
+static_assert(sizeof(RenderViewport) == sizeof(D3D11_VIEWPORT), "RenderViewport must match D3D11_VIEWPORT");
+
+DeviceRenderContextBackend::DeviceRenderContextBackend()
+{
+	m_context = nullptr;
+	m_context1 = nullptr;
+}
+
+void DeviceRenderContextBackend::Initialise(ID3D11DeviceContext* context, ID3D11DeviceContext1* context1)
+{
+	m_context = context;
+	m_context1 = context1;
+}
+
+void DeviceRenderContextBackend::setFont(ID3D11Device* device, const wchar_t* filename)
+{
+	m_sprites = std::make_unique<DirectX::SpriteBatch>(m_context);
+	m_font = std::make_unique<DirectX::SpriteFont>(device, filename);
+}
+
+void DeviceRenderContextBackend::IASetInputLayout(ID3D11InputLayout* layout)
+{
+	m_context->IASetInputLayout(layout);
+}
+
+void DeviceRenderContextBackend::IASetVertexBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets)
+{
+	m_context->IASetVertexBuffers(slot, count, buffers, strides, offsets);
+}
+
+void DeviceRenderContextBackend::IASetIndexBuffer(ID3D11Buffer* buffer, int format, unsigned int offset)
+{
+	m_context->IASetIndexBuffer(buffer, (DXGI_FORMAT)format, offset);
+}
+
+void DeviceRenderContextBackend::IASetPrimitiveTopology(int topology)
+{
+	m_context->IASetPrimitiveTopology((D3D11_PRIMITIVE_TOPOLOGY)topology);
+}
+
+void DeviceRenderContextBackend::VSSetShader(ID3D11VertexShader* shader)
+{
+	m_context->VSSetShader(shader, nullptr, 0);
+}
+
+void DeviceRenderContextBackend::VSSetConstantBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers)
+{
+	m_context->VSSetConstantBuffers(slot, count, buffers);
+}
+
+void DeviceRenderContextBackend::VSSetConstantBuffers1(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* constantCounts)
+{
+	m_context1->VSSetConstantBuffers1(slot, count, buffers, firstConstants, constantCounts);
+}
+
+void DeviceRenderContextBackend::PSSetShader(ID3D11PixelShader* shader)
+{
+	m_context->PSSetShader(shader, nullptr, 0);
+}
+
+void DeviceRenderContextBackend::PSSetConstantBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers)
+{
+	m_context->PSSetConstantBuffers(slot, count, buffers);
+}
+
+void DeviceRenderContextBackend::PSSetConstantBuffers1(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* constantCounts)
+{
+	m_context1->PSSetConstantBuffers1(slot, count, buffers, firstConstants, constantCounts);
+}
+
+void DeviceRenderContextBackend::PSSetShaderResources(unsigned int slot, unsigned int count, ID3D11ShaderResourceView* const* views)
+{
+	m_context->PSSetShaderResources(slot, count, views);
+}
+
+void DeviceRenderContextBackend::PSSetSamplers(unsigned int slot, unsigned int count, ID3D11SamplerState* const* samplers)
+{
+	m_context->PSSetSamplers(slot, count, samplers);
+}
+
+void DeviceRenderContextBackend::RSSetState(ID3D11RasterizerState* state)
+{
+	m_context->RSSetState(state);
+}
+
+void DeviceRenderContextBackend::RSSetViewports(unsigned int count, const RenderViewport* viewports)
+{
+	m_context->RSSetViewports(count, reinterpret_cast<const D3D11_VIEWPORT*>(viewports));
+}
+
+RenderViewport DeviceRenderContextBackend::RSGetViewport()
+{
+	UINT viewportCount = 1;
+	D3D11_VIEWPORT viewport = {};
+	m_context->RSGetViewports(&viewportCount, &viewport);
+
+	return *reinterpret_cast<RenderViewport*>(&viewport);
+}
+
+void DeviceRenderContextBackend::OMSetBlendState(ID3D11BlendState* state, const float factor[4], unsigned int sampleMask)
+{
+	m_context->OMSetBlendState(state, factor, sampleMask);
+}
+
+void DeviceRenderContextBackend::OMSetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef)
+{
+	m_context->OMSetDepthStencilState(state, stencilRef);
+}
+
+void DeviceRenderContextBackend::OMSetRenderTargets(unsigned int count, ID3D11RenderTargetView* const* targets, ID3D11DepthStencilView* depthStencil)
+{
+	m_context->OMSetRenderTargets(count, targets, depthStencil);
+}
+
+void* DeviceRenderContextBackend::Map(ID3D11Buffer* buffer, unsigned int offset, unsigned int bytes, bool discard)
+{
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	m_context->Map(buffer, 0, (discard) ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mappedResource);
+
+	return (char*)mappedResource.pData+offset;
+}
+
+void DeviceRenderContextBackend::Unmap(ID3D11Buffer* buffer)
+{
+	m_context->Unmap(buffer, 0);
+}
+
+void DeviceRenderContextBackend::ClearRenderTargetView(ID3D11RenderTargetView* target, const float colour[4])
+{
+	m_context->ClearRenderTargetView(target, colour);
+}
+
+void DeviceRenderContextBackend::ClearDepthStencilView(ID3D11DepthStencilView* depthStencil, unsigned int flags, float depth, unsigned char stencil)
+{
+	m_context->ClearDepthStencilView(depthStencil, flags, depth, stencil);
+}
+
+void DeviceRenderContextBackend::CopyResource(ID3D11Resource* destination, ID3D11Resource* source)
+{
+	m_context->CopyResource(destination, source);
+}
+
+void DeviceRenderContextBackend::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	m_context->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void DeviceRenderContextBackend::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance)
+{
+	m_context->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+void DeviceRenderContextBackend::DrawString(const wchar_t* text, float x, float y)
+{
+	if (!m_font)
+		return;
+
+	m_sprites->Begin();
+	m_font->DrawString(m_sprites.get(), text, DirectX::XMFLOAT2(x, y), DirectX::Colors::White);
+	m_sprites->End();
+}
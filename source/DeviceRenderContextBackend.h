@@ -0,0 +1,50 @@
+#pragma once
+#include "RenderContext.h"
+
+// Passes a render context's calls on to a real device context
+class DeviceRenderContextBackend : public RenderContextBackend
+{
+public:
+	DeviceRenderContextBackend();
+
+	void							Initialise(ID3D11DeviceContext* context, ID3D11DeviceContext1* context1);	// context1 may be null, in which case windowed constants are unavailable
+	void							setFont(ID3D11Device* device, const wchar_t* filename);		// A SpriteFont, for DrawString; without one, text is dropped
+
+	void							IASetInputLayout(ID3D11InputLayout* layout) override;
+	void							IASetVertexBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets) override;
+	void							IASetIndexBuffer(ID3D11Buffer* buffer, int format, unsigned int offset) override;
+	void							IASetPrimitiveTopology(int topology) override;
+
+	void							VSSetShader(ID3D11VertexShader* shader) override;
+	void							VSSetConstantBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers) override;
+	void							VSSetConstantBuffers1(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* constantCounts) override;
+	void							PSSetShader(ID3D11PixelShader* shader) override;
+	void							PSSetConstantBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers) override;
+	void							PSSetConstantBuffers1(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* constantCounts) override;
+	void							PSSetShaderResources(unsigned int slot, unsigned int count, ID3D11ShaderResourceView* const* views) override;
+	void							PSSetSamplers(unsigned int slot, unsigned int count, ID3D11SamplerState* const* samplers) override;
+
+	void							RSSetState(ID3D11RasterizerState* state) override;
+	void							RSSetViewports(unsigned int count, const RenderViewport* viewports) override;
+	RenderViewport					RSGetViewport() override;
+
+	void							OMSetBlendState(ID3D11BlendState* state, const float factor[4], unsigned int sampleMask) override;
+	void							OMSetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef) override;
+	void							OMSetRenderTargets(unsigned int count, ID3D11RenderTargetView* const* targets, ID3D11DepthStencilView* depthStencil) override;
+
+	void*							Map(ID3D11Buffer* buffer, unsigned int offset, unsigned int bytes, bool discard) override;
+	void							Unmap(ID3D11Buffer* buffer) override;
+
+	void							ClearRenderTargetView(ID3D11RenderTargetView* target, const float colour[4]) override;
+	void							ClearDepthStencilView(ID3D11DepthStencilView* depthStencil, unsigned int flags, float depth, unsigned char stencil) override;
+	void							CopyResource(ID3D11Resource* destination, ID3D11Resource* source) override;
+	void							DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) override;
+	void							DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance) override;
+	void							DrawString(const wchar_t* text, float x, float y) override;
+
+private:
+	ID3D11DeviceContext*			m_context;
+	ID3D11DeviceContext1*			m_context1;
+	std::unique_ptr<DirectX::SpriteBatch>	m_sprites;
+	std::unique_ptr<DirectX::SpriteFont>	m_font;
+};
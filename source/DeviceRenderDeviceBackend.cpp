@@ -0,0 +1,286 @@
+#include "pch.h"
+#include "DeviceRenderDeviceBackend.h"
+#include <vector>
+
+DeviceRenderDeviceBackend::DeviceRenderDeviceBackend()
+{
+	m_device = nullptr;
+	m_context = nullptr;
+	m_context1 = nullptr;
+}
+
+void DeviceRenderDeviceBackend::Initialise(ID3D11Device* device, ID3D11DeviceContext* context, ID3D11DeviceContext1* context1)
+{
+	m_device = device;
+	m_context = context;
+	m_context1 = context1;
+}
+
+ID3D11Buffer* DeviceRenderDeviceBackend::CreateBuffer(const RenderBufferDesc& desc, const void* data)
+{
+	D3D11_BUFFER_DESC bufferDesc;
+	bufferDesc.Usage = (desc.dynamic) ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_DEFAULT;
+	bufferDesc.ByteWidth = desc.bytes;
+	bufferDesc.BindFlags = desc.bind;
+	bufferDesc.CPUAccessFlags = (desc.dynamic) ? D3D11_CPU_ACCESS_WRITE : 0;
+	bufferDesc.MiscFlags = 0;
+	bufferDesc.StructureByteStride = 0;
+
+	D3D11_SUBRESOURCE_DATA initialData;
+	initialData.pSysMem = data;
+	initialData.SysMemPitch = 0;
+	initialData.SysMemSlicePitch = 0;
+
+	ID3D11Buffer* buffer = nullptr;
+	if (FAILED(m_device->CreateBuffer(&bufferDesc, (data) ? &initialData : nullptr, &buffer)))
+		return nullptr;
+
+	return buffer;
+}
+
+ID3D11Texture2D* DeviceRenderDeviceBackend::CreateTexture2D(const RenderTextureDesc& desc, const void* data)
+{
+	D3D11_TEXTURE2D_DESC textureDesc;
+	ZeroMemory(&textureDesc, sizeof(textureDesc));
+	textureDesc.Width = desc.width;
+	textureDesc.Height = desc.height;
+	textureDesc.MipLevels = 1;
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = (DXGI_FORMAT)desc.format;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.SampleDesc.Quality = 0;
+	textureDesc.Usage = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags = desc.bind;
+	textureDesc.CPUAccessFlags = 0;
+	textureDesc.MiscFlags = 0;
+
+	D3D11_SUBRESOURCE_DATA initialData;
+	initialData.pSysMem = data;
+	initialData.SysMemPitch = desc.width*(unsigned int)RenderDevice::getFormatBytes(desc.format);
+	initialData.SysMemSlicePitch = 0;
+
+	ID3D11Texture2D* texture = nullptr;
+	if (FAILED(m_device->CreateTexture2D(&textureDesc, (data) ? &initialData : nullptr, &texture)))
+		return nullptr;
+
+	return texture;
+}
+
+ID3D11RenderTargetView* DeviceRenderDeviceBackend::CreateRenderTargetView(ID3D11Texture2D* texture)
+{
+	// NB: A null description views the whole of the first mip in the texture's own format
+	ID3D11RenderTargetView* view = nullptr;
+	if (!texture || FAILED(m_device->CreateRenderTargetView(texture, nullptr, &view)))
+		return nullptr;
+
+	return view;
+}
+
+ID3D11ShaderResourceView* DeviceRenderDeviceBackend::CreateShaderResourceView(ID3D11Texture2D* texture)
+{
+	ID3D11ShaderResourceView* view = nullptr;
+	if (!texture || FAILED(m_device->CreateShaderResourceView(texture, nullptr, &view)))
+		return nullptr;
+
+	return view;
+}
+
+ID3D11DepthStencilView* DeviceRenderDeviceBackend::CreateDepthStencilView(ID3D11Texture2D* texture)
+{
+	ID3D11DepthStencilView* view = nullptr;
+	if (!texture || FAILED(m_device->CreateDepthStencilView(texture, nullptr, &view)))
+		return nullptr;
+
+	return view;
+}
+
+ID3D11VertexShader* DeviceRenderDeviceBackend::CreateVertexShader(const void* bytecode, size_t bytes)
+{
+	ID3D11VertexShader* shader = nullptr;
+	if (FAILED(m_device->CreateVertexShader(bytecode, bytes, nullptr, &shader)))
+		return nullptr;
+
+	return shader;
+}
+
+ID3D11PixelShader* DeviceRenderDeviceBackend::CreatePixelShader(const void* bytecode, size_t bytes)
+{
+	ID3D11PixelShader* shader = nullptr;
+	if (FAILED(m_device->CreatePixelShader(bytecode, bytes, nullptr, &shader)))
+		return nullptr;
+
+	return shader;
+}
+
+ID3D11InputLayout* DeviceRenderDeviceBackend::CreateInputLayout(const RenderInputElement* elements, unsigned int count, const void* bytecode, size_t bytes)
+{
+	std::vector<D3D11_INPUT_ELEMENT_DESC> layout(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		// NB: The first element in each slot starts it; the rest follow on
+		bool first = true;
+		for (unsigned int j = 0; j < i; j++)
+			first = first && elements[j].slot != elements[i].slot;
+
+		layout[i].SemanticName = elements[i].semantic;
+		layout[i].SemanticIndex = elements[i].index;
+		layout[i].Format = (DXGI_FORMAT)elements[i].format;
+		layout[i].InputSlot = elements[i].slot;
+		layout[i].AlignedByteOffset = (first) ? 0 : D3D11_APPEND_ALIGNED_ELEMENT;
+		layout[i].InputSlotClass = (elements[i].instanced) ? D3D11_INPUT_PER_INSTANCE_DATA : D3D11_INPUT_PER_VERTEX_DATA;
+		layout[i].InstanceDataStepRate = (elements[i].instanced) ? 1 : 0;
+	}
+
+	ID3D11InputLayout* inputLayout = nullptr;
+	if (FAILED(m_device->CreateInputLayout(layout.data(), count, bytecode, bytes, &inputLayout)))
+		return nullptr;
+
+	return inputLayout;
+}
+
+ID3D11SamplerState* DeviceRenderDeviceBackend::CreateSamplerState(const RenderSamplerDesc& desc)
+{
+	D3D11_TEXTURE_ADDRESS_MODE address = (desc.clamp) ? D3D11_TEXTURE_ADDRESS_CLAMP : D3D11_TEXTURE_ADDRESS_WRAP;
+
+	D3D11_SAMPLER_DESC samplerDesc;
+	ZeroMemory(&samplerDesc, sizeof(samplerDesc));
+	samplerDesc.Filter = (desc.point) ? D3D11_FILTER_MIN_MAG_MIP_POINT : D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	samplerDesc.AddressU = address;
+	samplerDesc.AddressV = address;
+	samplerDesc.AddressW = address;
+	samplerDesc.MipLODBias = 0.0f;
+	samplerDesc.MaxAnisotropy = 1;
+	samplerDesc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
+	samplerDesc.MinLOD = 0;
+	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+
+	ID3D11SamplerState* sampler = nullptr;
+	if (FAILED(m_device->CreateSamplerState(&samplerDesc, &sampler)))
+		return nullptr;
+
+	return sampler;
+}
+
+ID3D11RasterizerState* DeviceRenderDeviceBackend::CreateRasterizerState(const RenderRasterizerDesc& desc)
+{
+	// NB: As CommonStates makes them
+	D3D11_RASTERIZER_DESC rasterizerDesc;
+	ZeroMemory(&rasterizerDesc, sizeof(rasterizerDesc));
+	rasterizerDesc.FillMode = D3D11_FILL_SOLID;
+	rasterizerDesc.CullMode = (D3D11_CULL_MODE)desc.cull;
+	rasterizerDesc.FrontCounterClockwise = FALSE;
+	rasterizerDesc.DepthBias = D3D11_DEFAULT_DEPTH_BIAS;
+	rasterizerDesc.DepthBiasClamp = D3D11_DEFAULT_DEPTH_BIAS_CLAMP;
+	rasterizerDesc.SlopeScaledDepthBias = D3D11_DEFAULT_SLOPE_SCALED_DEPTH_BIAS;
+	rasterizerDesc.DepthClipEnable = TRUE;
+	rasterizerDesc.ScissorEnable = FALSE;
+	rasterizerDesc.MultisampleEnable = TRUE;
+	rasterizerDesc.AntialiasedLineEnable = FALSE;
+
+	ID3D11RasterizerState* state = nullptr;
+	if (FAILED(m_device->CreateRasterizerState(&rasterizerDesc, &state)))
+		return nullptr;
+
+	return state;
+}
+
+ID3D11DepthStencilState* DeviceRenderDeviceBackend::CreateDepthStencilState(const RenderDepthStencilDesc& desc)
+{
+	D3D11_DEPTH_STENCIL_DESC depthStencilDesc;
+	ZeroMemory(&depthStencilDesc, sizeof(depthStencilDesc));
+	depthStencilDesc.DepthEnable = (desc.test) ? TRUE : FALSE;
+	depthStencilDesc.DepthWriteMask = (desc.write) ? D3D11_DEPTH_WRITE_MASK_ALL : D3D11_DEPTH_WRITE_MASK_ZERO;
+	depthStencilDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
+	depthStencilDesc.StencilEnable = FALSE;
+	depthStencilDesc.StencilReadMask = D3D11_DEFAULT_STENCIL_READ_MASK;
+	depthStencilDesc.StencilWriteMask = D3D11_DEFAULT_STENCIL_WRITE_MASK;
+	depthStencilDesc.FrontFace.StencilFunc = D3D11_COMPARISON_ALWAYS;
+	depthStencilDesc.FrontFace.StencilPassOp = D3D11_STENCIL_OP_KEEP;
+	depthStencilDesc.FrontFace.StencilFailOp = D3D11_STENCIL_OP_KEEP;
+	depthStencilDesc.FrontFace.StencilDepthFailOp = D3D11_STENCIL_OP_KEEP;
+	depthStencilDesc.BackFace = depthStencilDesc.FrontFace;
+
+	ID3D11DepthStencilState* state = nullptr;
+	if (FAILED(m_device->CreateDepthStencilState(&depthStencilDesc, &state)))
+		return nullptr;
+
+	return state;
+}
+
+ID3D11BlendState* DeviceRenderDeviceBackend::CreateBlendState(const RenderBlendDesc& desc)
+{
+	D3D11_BLEND_DESC blendDesc;
+	ZeroMemory(&blendDesc, sizeof(blendDesc));
+	blendDesc.RenderTarget[0].BlendEnable = (desc.alpha) ? TRUE : FALSE;
+	blendDesc.RenderTarget[0].SrcBlend = blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+	blendDesc.RenderTarget[0].DestBlend = blendDesc.RenderTarget[0].DestBlendAlpha = (desc.alpha) ? D3D11_BLEND_INV_SRC_ALPHA : D3D11_BLEND_ZERO;
+	blendDesc.RenderTarget[0].BlendOp = blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+	blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+
+	ID3D11BlendState* state = nullptr;
+	if (FAILED(m_device->CreateBlendState(&blendDesc, &state)))
+		return nullptr;
+
+	return state;
+}
+
+ID3D11ShaderResourceView* DeviceRenderDeviceBackend::CreateTextureFromFile(const wchar_t* filename)
+{
+	ID3D11ShaderResourceView* view = nullptr;
+	if (FAILED(DirectX::CreateDDSTextureFromFile(m_device, filename, nullptr, &view)))
+		return nullptr;
+
+	return view;
+}
+
+void DeviceRenderDeviceBackend::Release(void* resource)
+{
+	// NB: Every resource is a COM object, with IUnknown first
+	static_cast<IUnknown*>(resource)->Release();
+}
+
+bool DeviceRenderDeviceBackend::ReadTexture(ID3D11ShaderResourceView* view, RenderTexels& texels)
+{
+	Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> source, staging;
+	view->GetResource(resource.GetAddressOf());
+	if (FAILED(resource.As(&source)))
+		return false;
+
+	D3D11_TEXTURE2D_DESC desc;
+	source->GetDesc(&desc);
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Usage = D3D11_USAGE_STAGING;
+	desc.BindFlags = 0;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	desc.MiscFlags = 0;
+	if (FAILED(m_device->CreateTexture2D(&desc, nullptr, staging.GetAddressOf())))
+		return false;
+
+	m_context->CopySubresourceRegion(staging.Get(), 0, 0, 0, 0, source.Get(), 0, nullptr);
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(m_context->Map(staging.Get(), 0, D3D11_MAP_READ, 0, &mapped)))
+		return false;
+
+	// NB: Block-compressed rows hold four lines of texels each
+	unsigned int rows = (desc.Format >= DXGI_FORMAT_BC1_TYPELESS && desc.Format <= DXGI_FORMAT_BC5_SNORM) ? (desc.Height+3)/4 : desc.Height;
+	texels.format = desc.Format;
+	texels.width = desc.Width;
+	texels.height = desc.Height;
+	texels.rowPitch = mapped.RowPitch;
+	texels.data.assign((const unsigned char*)mapped.pData, (const unsigned char*)mapped.pData+(size_t)rows*mapped.RowPitch);
+	m_context->Unmap(staging.Get(), 0);
+
+	return true;
+}
+
+bool DeviceRenderDeviceBackend::getConstantOffsetting()
+{
+	// NB: Offset binding, and mapping a constant buffer without discarding it, are both optional in 11.1
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	if (!m_context1 || FAILED(m_device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))))
+		return false;
+
+	return options.ConstantBufferOffsetting && options.MapNoOverwriteOnDynamicConstantBuffer;
+}
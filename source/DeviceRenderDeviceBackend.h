@@ -0,0 +1,34 @@
+#pragma once
+#include "RenderDevice.h"
+
+// Creates a render device's resources on a real device
+class DeviceRenderDeviceBackend : public RenderDeviceBackend
+{
+public:
+	DeviceRenderDeviceBackend();
+
+	void								Initialise(ID3D11Device* device, ID3D11DeviceContext* context, ID3D11DeviceContext1* context1);	// context1 may be null, as before Direct3D 11.1
+
+	ID3D11Buffer*						CreateBuffer(const RenderBufferDesc& desc, const void* data) override;
+	ID3D11Texture2D*					CreateTexture2D(const RenderTextureDesc& desc, const void* data) override;
+	ID3D11RenderTargetView*				CreateRenderTargetView(ID3D11Texture2D* texture) override;
+	ID3D11ShaderResourceView*			CreateShaderResourceView(ID3D11Texture2D* texture) override;
+	ID3D11DepthStencilView*				CreateDepthStencilView(ID3D11Texture2D* texture) override;
+	ID3D11VertexShader*					CreateVertexShader(const void* bytecode, size_t bytes) override;
+	ID3D11PixelShader*					CreatePixelShader(const void* bytecode, size_t bytes) override;
+	ID3D11InputLayout*					CreateInputLayout(const RenderInputElement* elements, unsigned int count, const void* bytecode, size_t bytes) override;
+	ID3D11SamplerState*					CreateSamplerState(const RenderSamplerDesc& desc) override;
+	ID3D11RasterizerState*				CreateRasterizerState(const RenderRasterizerDesc& desc) override;
+	ID3D11DepthStencilState*			CreateDepthStencilState(const RenderDepthStencilDesc& desc) override;
+	ID3D11BlendState*					CreateBlendState(const RenderBlendDesc& desc) override;
+	ID3D11ShaderResourceView*			CreateTextureFromFile(const wchar_t* filename) override;
+	void								Release(void* resource) override;
+
+	bool								ReadTexture(ID3D11ShaderResourceView* view, RenderTexels& texels) override;	// Through the immediate context, which copying and mapping leave bound as it was
+	bool								getConstantOffsetting() override;
+
+private:
+	ID3D11Device*						m_device;
+	ID3D11DeviceContext*				m_context;
+	ID3D11DeviceContext1*				m_context1;
+};
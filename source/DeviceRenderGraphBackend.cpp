@@ -0,0 +1,46 @@
+#include "pch.h"
+#include "DeviceRenderGraphBackend.h"
+
+DeviceRenderGraphBackend::DeviceRenderGraphBackend()
+{
+	m_profiler = nullptr;
+	m_pool = nullptr;
+	m_passCount = 0;
+}
+
+void DeviceRenderGraphBackend::Initialise(Profiler* profiler, RenderTexturePool* pool)
+{
+	m_profiler = profiler;
+	m_pool = pool;
+}
+
+RenderTexture* DeviceRenderGraphBackend::acquire(int width, int height)
+{
+	return m_pool->acquire(width, height);
+}
+
+void DeviceRenderGraphBackend::release(RenderTexture* texture)
+{
+	m_pool->release(texture);
+}
+
+void DeviceRenderGraphBackend::beginPass(const std::string& name)
+{
+	m_profiler->begin(name.c_str());
+	m_passCount++;
+}
+
+void DeviceRenderGraphBackend::endPass()
+{
+	m_profiler->end();
+}
+
+bool DeviceRenderGraphBackend::getExecutes()
+{
+	return true;
+}
+
+int DeviceRenderGraphBackend::getPassCount()
+{
+	return m_passCount;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "Profiler.h"
+#include "RenderGraph.h"
+#include "RenderTexturePool.h"
+
+// Runs a render graph on the device, drawing its transient textures from a pool
+class DeviceRenderGraphBackend : public RenderGraphBackend
+{
+public:
+	DeviceRenderGraphBackend();
+
+	void							Initialise(Profiler* profiler, RenderTexturePool* pool);
+
+	RenderTexture*					acquire(int width, int height) override;
+	void							release(RenderTexture* texture) override;
+
+	void							beginPass(const std::string& name) override;	// Brackets each pass in a profiler scope (and so a PIX event)
+	void							endPass() override;
+
+	bool							getExecutes() override;
+
+	int								getPassCount();		// Begun since constructed
+
+private:
+	Profiler*						m_profiler;
+	RenderTexturePool*				m_pool;
+	int								m_passCount;
+};
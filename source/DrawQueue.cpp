@@ -0,0 +1,185 @@
+#include "pch.h"
+#include "DrawQueue.h"
+#include <chrono>
+#include <random>
+
+DrawQueue::DrawQueue()
+{
+}
+
+unsigned long long DrawQueue::makeKey(unsigned int layer, unsigned int shader, unsigned int material, float depth)
+{
+	// NB: Depth is clamped to [0, 1]; callers map their own range (e.g. distance over the far plane) onto it
+	depth = (depth < 0.0f) ? 0.0f : (depth > 1.0f) ? 1.0f : depth;
+	unsigned long long quantised = (unsigned long long)(depth*0xFFFFFF);
+
+	return ((unsigned long long)(layer & 0xFF) << 56) | ((unsigned long long)(shader & 0xFFF) << 44) | ((unsigned long long)(material & 0xFFFFF) << 24) | quantised;
+}
+
+unsigned int DrawQueue::getShaderId(const void* shader)
+{
+	for (unsigned int i = 0; i < m_shaders.size(); i++)
+	{
+		if (m_shaders[i] == shader)
+			return i;
+	}
+
+	m_shaders.push_back(shader);
+	return (unsigned int)m_shaders.size()-1;
+}
+
+unsigned int DrawQueue::getMaterialId(const void* texture, const void* normalTexture)
+{
+	for (unsigned int i = 0; i < m_materials.size(); i++)
+	{
+		if (m_materials[i].first == texture && m_materials[i].second == normalTexture)
+			return i;
+	}
+
+	m_materials.push_back(std::make_pair(texture, normalTexture));
+	return (unsigned int)m_materials.size()-1;
+}
+
+void DrawQueue::push(unsigned long long key, DrawFunction draw)
+{
+	m_packets.push_back({ key, (unsigned int)m_draws.size() });
+	m_draws.push_back(draw);
+}
+
+void DrawQueue::Submit(RenderContext* context)
+{
+	RadixSort(m_packets, m_scratch);
+
+	for (int i = 0; i < (int)m_packets.size(); i++)
+		m_draws[m_packets[i].draw](context);
+
+	m_packets.clear();
+	m_draws.clear();
+}
+
+int DrawQueue::getSize()
+{
+	return (int)m_packets.size();
+}
+
+void DrawQueue::RadixSort(std::vector<Packet>& packets, std::vector<Packet>& scratch)
+{
+	// Least significant byte first; each pass is stable, so equal keys keep their push order
+	size_t count = packets.size();
+	if (count < 2)
+		return;
+
+	scratch.resize(count);
+
+	// STEP 1: Histogram every byte in one sweep
+	unsigned int histograms[8][256] = {};
+	for (size_t i = 0; i < count; i++)
+	{
+		for (int b = 0; b < 8; b++)
+			histograms[b][(packets[i].key >> (8*b)) & 0xFF]++;
+	}
+
+	std::vector<Packet>* source = &packets;
+	std::vector<Packet>* destination = &scratch;
+	for (int b = 0; b < 8; b++)
+	{
+		// STEP 2: Skip any byte that is the same in every key, as it would not reorder anything (e.g. unused layers)
+		unsigned int* histogram = histograms[b];
+		if (histogram[((*source)[0].key >> (8*b)) & 0xFF] == count)
+			continue;
+
+		unsigned int offsets[256];
+		unsigned int offset = 0;
+		for (int i = 0; i < 256; i++)
+		{
+			offsets[i] = offset;
+			offset += histogram[i];
+		}
+
+		// STEP 3: Scatter
+		for (size_t i = 0; i < count; i++)
+		{
+			const Packet& packet = (*source)[i];
+			(*destination)[offsets[(packet.key >> (8*b)) & 0xFF]++] = packet;
+		}
+		std::swap(source, destination);
+	}
+
+	if (source != &packets)
+		packets.swap(scratch);
+}
+
+bool DrawQueue::benchmarkSort(int count, int repeats, std::string& report)
+{
+	std::mt19937_64 random(502);
+	std::vector<Packet> packets(count), scratch;
+
+	double total = 0.0;
+	int misordered = 0;
+	for (int r = 0; r < repeats; r++)
+	{
+		// Realistic keys: few layers and shaders, many materials and depths
+		for (int i = 0; i < count; i++)
+			packets[i] = { makeKey(random() % 4, random() % 16, random() % 1024, (random() % 1000)/1000.0f), (unsigned int)i };
+
+		auto start = std::chrono::high_resolution_clock::now();
+		RadixSort(packets, scratch);
+		auto end = std::chrono::high_resolution_clock::now();
+
+		total += std::chrono::duration<double, std::micro>(end-start).count();
+
+		// NB: Draws were pushed in index order, so ties must keep it
+		for (int i = 1; i < count; i++)
+			misordered += (packets[i].key < packets[i-1].key || (packets[i].key == packets[i-1].key && packets[i].draw < packets[i-1].draw));
+	}
+
+	char line[128];
+	snprintf(line, sizeof(line), "Draw queue: %.1fus to sort %d draws, %d out of order\n", total/repeats, count, misordered);
+	report = line;
+
+	return misordered == 0;
+}
+
+bool DrawQueue::compareStateChanges(int count, int shaderCount, int materialCount, std::string& report)
+{
+	// NB: The null backend never dereferences what it is given, so made-up handles stand in for real state
+	std::mt19937 random(502);
+	std::vector<int> shaders(count), materials(count);
+	for (int i = 0; i < count; i++)
+	{
+		shaders[i] = random() % shaderCount;
+		materials[i] = random() % materialCount;
+	}
+
+	int callCounts[2];
+	report.clear();
+	for (int sorted = 0; sorted < 2; sorted++)
+	{
+		NullRenderContextBackend backend;
+		RenderContext context;
+		context.Initialise(&backend);
+
+		DrawQueue queue;
+		for (int i = 0; i < count; i++)
+		{
+			ID3D11VertexShader* vertexShader = (ID3D11VertexShader*)(size_t)(0x1000+16*shaders[i]);
+			ID3D11PixelShader* pixelShader = (ID3D11PixelShader*)(size_t)(0x2000+16*shaders[i]);
+			ID3D11ShaderResourceView* texture = (ID3D11ShaderResourceView*)(size_t)(0x3000+16*materials[i]);
+
+			unsigned long long key = (sorted) ? makeKey(0, queue.getShaderId(vertexShader), queue.getMaterialId(texture), 0.0f) : 0;
+			queue.push(key, [=](RenderContext* context) {
+				context->VSSetShader(vertexShader, 0, 0);
+				context->PSSetShader(pixelShader, 0, 0);
+				context->PSSetShaderResources(0, 1, &texture);
+				context->DrawIndexed(3, 0, 0);
+			});
+		}
+		queue.Submit(&context);
+
+		callCounts[sorted] = backend.getCallCount();
+		report += std::string((sorted) ? "Sorted" : "In push order") + ": " + std::to_string(backend.getCallCount()) + " calls reached the backend\n";
+		report += context.getReport();
+	}
+
+	return callCounts[1] < callCounts[0];
+}
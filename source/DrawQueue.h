@@ -0,0 +1,49 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+#include "RenderContext.h"
+
+// Draws pushed during a pass, each tagged with a 64-bit sort key, then radix-sorted so that draws sharing a shader
+// and textures are issued back to back. Keys sort by layer first, so anything order-dependent (e.g. the skybox,
+// which must be drawn before anything it could overwrite) keeps its place by sitting in an earlier layer.
+class DrawQueue
+{
+public:
+	typedef std::function<void(RenderContext*)>	DrawFunction;	// Binds whatever the draw needs, and draws it
+
+	DrawQueue();
+
+	// Key layout, most significant first: layer (8 bits), shader (12), material (20), depth (24)
+	static unsigned long long		makeKey(unsigned int layer, unsigned int shader, unsigned int material, float depth);
+
+	// Dense ids for sort keys, in order of first appearance. Ids are kept between frames, so keys stay comparable
+	unsigned int					getShaderId(const void* shader);
+	unsigned int					getMaterialId(const void* texture, const void* normalTexture = nullptr);
+
+	void							push(unsigned long long key, DrawFunction draw);
+	void							Submit(RenderContext* context);		// Sorts, issues, and empties the queue
+
+	int								getSize();
+
+	// Radix sorts count random keys repeats times, reporting the average; false if any came out of order, or equal keys out of push order
+	static bool						benchmarkSort(int count, int repeats, std::string& report);
+	// Submits the same synthetic draws in push order and sorted through a null backend, and reports the state changes of each; false if sorting saved none
+	static bool						compareStateChanges(int count, int shaderCount, int materialCount, std::string& report);
+
+private:
+	struct Packet
+	{
+		unsigned long long	key;
+		unsigned int		draw;	// Index into m_draws
+	};
+
+	static void						RadixSort(std::vector<Packet>& packets, std::vector<Packet>& scratch);
+
+	std::vector<Packet>				m_packets;
+	std::vector<Packet>				m_scratch;
+	std::vector<DrawFunction>		m_draws;
+
+	std::vector<const void*>		m_shaders;
+	std::vector<std::pair<const void*, const void*>>	m_materials;
+};
@@ -0,0 +1,679 @@
+#include "pch.h"
+#include "EnvironmentBaker.h"
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <thread>
+
+namespace
+{
+	const float PI = 3.14159265f;
+	const float Epsilon = 1e-4f;		// How far past a surface a path restarts, so it doesn't hit it again
+	const float MinWeight = 1.0f/256.0f;	// Below which a reflection can't change its texel, so isn't traced
+	const int FileVersion = 1;
+
+	float Dot(const float a[3], const float b[3])
+	{
+		return a[0]*b[0]+a[1]*b[1]+a[2]*b[2];
+	}
+
+	void Normalize(float v[3])
+	{
+		float inverseLength = 1.0f/sqrtf(Dot(v, v));
+		for (int j = 0; j < 3; j++)
+			v[j] *= inverseLength;
+	}
+
+	float Saturate(float x)
+	{
+		return std::min(std::max(x, 0.0f), 1.0f);
+	}
+
+	// Runs work(0..count-1) on threadCount threads, each taking the next index as it finishes the last
+	void ParallelFor(int count, int threadCount, const std::function<void(int)>& work)
+	{
+		std::atomic<int> next(0);
+		auto run = [&]() {
+			for (int i = next++; i < count; i = next++)
+				work(i);
+		};
+
+		std::vector<std::thread> threads;
+		for (int i = 1; i < std::min(threadCount, count); i++)
+			threads.push_back(std::thread(run));
+		run();
+		for (int i = 0; i < (int)threads.size(); i++)
+			threads[i].join();
+	}
+
+	// Distance along a normalised direction to where it leaves a sphere (from inside) or enters it (from outside); FLT_MAX if it doesn't
+	float HitSphere(const float centre[3], float radius, const float origin[3], const float direction[3], bool inside)
+	{
+		float offset[3] = { origin[0]-centre[0], origin[1]-centre[1], origin[2]-centre[2] };
+		float b = Dot(offset, direction);
+		float discriminant = b*b-(Dot(offset, offset)-radius*radius);
+		if (discriminant < 0.0f)
+			return FLT_MAX;
+
+		float t = (inside) ? -b+sqrtf(discriminant) : -b-sqrtf(discriminant);
+		return (t > Epsilon) ? t : FLT_MAX;
+	}
+
+	// Inverse of find_environment_st: the direction through (s, t) on a face
+	void FindFaceDirection(int face, float s, float t, float direction[3])
+	{
+		float a = 2.0f*s-1.0f, b = 2.0f*t-1.0f;
+		const float directions[6][3] = { { -1.0f, -b, -a }, { -a, -b, 1.0f }, { 1.0f, -b, a }, { a, -b, -1.0f }, { -a, 1.0f, -b }, { -a, -1.0f, b } };
+		std::copy(directions[face], directions[face]+3, direction);
+		Normalize(direction);
+	}
+
+	void MakeWorld(float scale, float x, float y, float z, float world[16])
+	{
+		for (int i = 0; i < 16; i++)
+			world[i] = (i%5 == 0) ? scale : 0.0f;
+		world[12] = x;
+		world[13] = y;
+		world[14] = z;
+		world[15] = 1.0f;
+	}
+}
+
+EnvironmentBaker::EnvironmentBaker()
+{
+	m_threadCount = 1;
+	for (int i = 0; i < 6; i++)
+		m_sky[i] = nullptr;
+	m_lighting = {};
+	for (int j = 0; j < 3; j++)
+		m_lightPosition[j] = 0.0f;
+	m_capturing = -1;
+}
+
+void EnvironmentBaker::setThreadCount(int threadCount)
+{
+	m_threadCount = std::max(1, threadCount);
+}
+
+void EnvironmentBaker::setSky(const Texture* const faces[6])
+{
+	for (int i = 0; i < 6; i++)
+		m_sky[i] = faces[i];
+}
+
+void EnvironmentBaker::setLighting(const Lighting& lighting)
+{
+	m_lighting = lighting;
+}
+
+int EnvironmentBaker::addMesh(const std::vector<float>& vertices)
+{
+	m_meshes.push_back(vertices);
+	return (int)m_meshes.size()-1;
+}
+
+void EnvironmentBaker::addBasic(const Basic& basic)
+{
+	m_basics.push_back(basic);
+}
+
+void EnvironmentBaker::addGlass(const Glass& glass)
+{
+	m_glasses.push_back(glass);
+}
+
+void EnvironmentBaker::Build()
+{
+	// Basics are traced together, in world space
+	std::vector<float> triangles;
+	m_basicOwners.clear();
+	m_basicFaces.clear();
+	for (int i = 0; i < (int)m_basics.size(); i++)
+	{
+		const std::vector<float>& vertices = m_meshes[m_basics[i].mesh];
+		const float* world = m_basics[i].world;
+		int vertexCount = (int)vertices.size()/SoftwareRenderer::VertexFloats;
+		for (int v = 0; v+2 < vertexCount; v += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				const float* in = &vertices[SoftwareRenderer::VertexFloats*(v+k)];
+				for (int j = 0; j < 3; j++)
+					triangles.push_back(in[0]*world[j]+in[1]*world[4+j]+in[2]*world[8+j]+world[12+j]);
+			}
+			m_basicOwners.push_back(i);
+			m_basicFaces.push_back(v/3);
+		}
+	}
+	m_basicBvh.Build(triangles.data(), (int)m_basicOwners.size(), m_threadCount);
+
+	// Glass and liquid are spheres; specimens are meshes of their own, only ever reached from inside their glass
+	auto makeSphere = [](const float world[16], Sphere& sphere) {
+		std::copy(world+12, world+15, sphere.centre);
+		sphere.radius = sqrtf(Dot(world, world));
+		for (int row = 0; row < 3; row++)
+			for (int j = 0; j < 3; j++)
+				sphere.axes[3*row+j] = world[4*row+j]/sphere.radius;
+	};
+
+	m_glassSpheres.resize(m_glasses.size());
+	m_liquidSpheres.resize(m_glasses.size());
+	m_specimenBvhs.assign(m_glasses.size(), TriangleBvh());
+	for (int i = 0; i < (int)m_glasses.size(); i++)
+	{
+		const Glass& glass = m_glasses[i];
+		makeSphere(glass.world, m_glassSpheres[i]);
+		makeSphere(glass.liquidWorld, m_liquidSpheres[i]);
+		if (glass.specimen < 0)
+			continue;
+
+		const std::vector<float>& vertices = m_meshes[glass.specimen];
+		int vertexCount = (int)vertices.size()/SoftwareRenderer::VertexFloats;
+		triangles.clear();
+		for (int v = 0; v < vertexCount-vertexCount%3; v++)
+		{
+			const float* in = &vertices[SoftwareRenderer::VertexFloats*v];
+			for (int j = 0; j < 3; j++)
+				triangles.push_back(in[0]*glass.specimenWorld[j]+in[1]*glass.specimenWorld[4+j]+in[2]*glass.specimenWorld[8+j]+glass.specimenWorld[12+j]);
+		}
+		m_specimenBvhs[i].Build(triangles.data(), vertexCount/3, m_threadCount);
+	}
+}
+
+void EnvironmentBaker::Bake(int glass, int size, Capture& capture)
+{
+	// NB: As the static passes light each capture, from where it is taken
+	m_capturing = glass;
+	std::copy(m_glassSpheres[glass].centre, m_glassSpheres[glass].centre+3, m_lightPosition);
+
+	const float clear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int face = 0; face < 6; face++)
+	{
+		SoftwareRenderer::makeTexture(size, size, clear, capture.background[face]);
+		SoftwareRenderer::makeTexture(size, size, clear, capture.reflection[face]);
+	}
+
+	// Every face's tiles, shared out together, so threads beyond six still have work
+	int tiles = (size+TileSize-1)/TileSize;
+	ParallelFor(6*tiles*tiles, m_threadCount, [&](int i) { bakeTile(glass, size, i/(tiles*tiles), i%(tiles*tiles), capture); });
+
+	m_capturing = -1;
+}
+
+size_t EnvironmentBaker::getBytes(const Capture& capture)
+{
+	size_t bytes = 0;
+	for (int face = 0; face < 6; face++)
+		bytes += (capture.background[face].texels.size()+capture.reflection[face].texels.size())*sizeof(float);
+
+	return bytes;
+}
+
+bool EnvironmentBaker::save(const std::string& filename, const Capture& capture)
+{
+	FILE* file = fopen(filename.c_str(), "wb");
+	if (!file)
+		return false;
+
+	// A header, then every face's RGBA floats row by row: the background's six, then the reflection's
+	int size = capture.background[0].width;
+	int header[3] = { 0x42564E45, FileVersion, size };	// "ENVB"
+	bool written = fwrite(header, sizeof(header), 1, file) == 1;
+	for (int face = 0; written && face < 12; face++)
+	{
+		const Texture& texture = (face < 6) ? capture.background[face] : capture.reflection[face-6];
+		written = texture.width == size && texture.height == size && fwrite(texture.texels.data(), sizeof(float), texture.texels.size(), file) == texture.texels.size();
+	}
+	fclose(file);
+
+	return written;
+}
+
+bool EnvironmentBaker::load(const std::string& filename, Capture& capture)
+{
+	FILE* file = fopen(filename.c_str(), "rb");
+	if (!file)
+		return false;
+
+	int header[3];
+	if (fread(header, sizeof(header), 1, file) != 1 || header[0] != 0x42564E45 || header[1] != FileVersion || header[2] <= 0 || header[2] > 16384)
+	{
+		fclose(file);
+		return false;
+	}
+
+	Capture loaded;
+	const float clear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	bool read = true;
+	for (int face = 0; read && face < 12; face++)
+	{
+		Texture& texture = (face < 6) ? loaded.background[face] : loaded.reflection[face-6];
+		SoftwareRenderer::makeTexture(header[2], header[2], clear, texture);
+		read = fread(texture.texels.data(), sizeof(float), texture.texels.size(), file) == texture.texels.size();
+	}
+	fclose(file);
+	if (!read)
+		return false;
+
+	for (int face = 0; face < 6; face++)
+	{
+		capture.background[face].width = capture.reflection[face].width = header[2];
+		capture.background[face].height = capture.reflection[face].height = header[2];
+		capture.background[face].texels.swap(loaded.background[face].texels);
+		capture.reflection[face].texels.swap(loaded.reflection[face].texels);
+	}
+
+	return true;
+}
+
+bool EnvironmentBaker::benchmark(const std::vector<float>& sphere, const std::vector<float>& cube, int size, int threadCount, std::string& report)
+{
+	if (sphere.empty() || cube.empty())
+	{
+		report = "Environment baking: no meshes to bake\n";
+		return false;
+	}
+
+	// Textures: a checked base, flat normals, tinted glass and brine, and a skybox that is a different colour each way
+	const float flat[4] = { 0.5f, 0.5f, 1.0f, 1.0f }, glassColour[4] = { 0.8f, 0.9f, 1.0f, 1.0f }, brineColour[4] = { 0.6f, 0.7f, 0.4f, 1.0f }, clear[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	Texture checker, normals, glassTexture, brine, sky[6];
+	SoftwareRenderer::makeTexture(64, 64, flat, checker);
+	for (int y = 0; y < 64; y++)
+	{
+		for (int x = 0; x < 64; x++)
+		{
+			float shade = (((x/8)+(y/8))%2) ? 0.9f : 0.3f;
+			float colour[4] = { shade, 0.6f*shade, 0.4f*shade, 1.0f };
+			std::copy(colour, colour+4, &checker.texels[4*(64*y+x)]);
+		}
+	}
+	SoftwareRenderer::makeTexture(1, 1, flat, normals);
+	SoftwareRenderer::makeTexture(1, 1, glassColour, glassTexture);
+	SoftwareRenderer::makeTexture(1, 1, brineColour, brine);
+	const Texture* skyFaces[6];
+	for (int f = 0; f < 6; f++)
+	{
+		SoftwareRenderer::makeTexture(32, 32, clear, sky[f]);
+		for (int y = 0; y < 32; y++)
+		{
+			for (int x = 0; x < 32; x++)
+			{
+				float colour[4] = { 0.2f+0.1f*f, 0.4f+0.5f*y/32.0f, 0.9f-0.1f*f, 1.0f };
+				std::copy(colour, colour+4, &sky[f].texels[4*(32*y+x)]);
+			}
+		}
+		skyFaces[f] = &sky[f];
+	}
+
+	// A ring of lit spheres around three jars, as scene.txt has them, the largest holding a specimen
+	EnvironmentBaker baker;
+	baker.setSky(skyFaces);
+	baker.setLighting({ { 0.2f, 0.2f, 0.2f, 1.0f }, { 0.93f, 1.0f, 0.98f, 1.0f }, { 0.0f, 0.0f, 0.0f }, 10.0f });
+	int sphereMesh = baker.addMesh(sphere), cubeMesh = baker.addMesh(cube);
+	for (int i = 0; i < 8; i++)
+	{
+		Basic basic = { sphereMesh, {}, &checker, &normals };
+		MakeWorld(0.5f, 4.0f*cosf(0.25f*PI*i), 0.3f*sinf(0.5f*PI*i), 4.0f*sinf(0.25f*PI*i), basic.world);
+		baker.addBasic(basic);
+	}
+	const float jars[3][5] = { { 0.0f, 0.5f, 0.0f, 2.0f, 1.33f }, { -0.8550504f, -0.75f, 2.349232f, 0.75f, 1.33f }, { -1.2734f, 0.25f, 1.998838f, 0.37f, 1.5f } };
+	for (int i = 0; i < 3; i++)
+	{
+		Glass glass = {};
+		MakeWorld(jars[i][3], jars[i][0], jars[i][1], jars[i][2], glass.world);
+		glass.refractiveIndex = jars[i][4];
+		glass.opacity = 0.01f;
+		glass.texture = &glassTexture;
+		MakeWorld(0.8f*jars[i][3], jars[i][0], jars[i][1], jars[i][2], glass.liquidWorld);
+		glass.liquidRefractiveIndex = 1.34f;
+		glass.liquidOpacity = 0.35f;
+		glass.liquidTexture = &brine;
+		glass.specimen = (i == 0) ? cubeMesh : -1;
+		MakeWorld(0.6f*jars[i][3], jars[i][0], jars[i][1], jars[i][2], glass.specimenWorld);
+		glass.specimenTexture = &checker;
+		glass.specimenNormalMap = &normals;
+		baker.addGlass(glass);
+	}
+	baker.Build();
+
+	char line[256];
+	report = "Environment baking, six " + std::to_string(size) + "x" + std::to_string(size) + " faces (" + std::to_string(Samples*Samples) + " rays a texel) for each of the background and reflection, on " + std::to_string(std::thread::hardware_concurrency()) + " hardware thread(s):\n";
+	bool passed = true;
+	for (int i = 0; i < 3; i++)
+	{
+		Capture captures[2];
+		double times[2];
+		int threadCounts[2] = { 1, threadCount };
+		for (int c = 0; c < 2; c++)
+		{
+			baker.setThreadCount(threadCounts[c]);
+			auto start = std::chrono::high_resolution_clock::now();
+			baker.Bake(i, size, captures[c]);
+			auto end = std::chrono::high_resolution_clock::now();
+			times[c] = std::chrono::duration<double, std::milli>(end-start).count();
+		}
+
+		double psnr = INFINITY;
+		for (int face = 0; face < 6; face++)
+			psnr = std::min(psnr, std::min(SoftwareRenderer::comparePsnr(captures[0].background[face], captures[1].background[face]), SoftwareRenderer::comparePsnr(captures[0].reflection[face], captures[1].reflection[face])));
+
+		// NB: Bakes are written and read as they are, so one back from its file must match to the bit
+		Capture loaded;
+		bool kept = save("bake_benchmark.bin", captures[1]) && load("bake_benchmark.bin", loaded);
+		for (int face = 0; kept && face < 6; face++)
+			kept = loaded.background[face].texels == captures[1].background[face].texels && loaded.reflection[face].texels == captures[1].reflection[face].texels;
+		remove("bake_benchmark.bin");
+		passed = passed && psnr == INFINITY && kept;
+
+		snprintf(line, sizeof(line), "  Glass object %d: %8.1fms on 1 thread, %8.1fms on %d (%.2fx), %.1fMB; PSNR between them %.1f dB%s\n",
+			i, times[0], times[1], threadCount, times[0]/times[1], getBytes(captures[1])/(1024.0*1024.0), psnr, (kept) ? "" : " (NOT KEPT BY ITS FILE!)");
+		report += line;
+	}
+
+	return passed;
+}
+
+void EnvironmentBaker::bakeTile(int glass, int size, int face, int tile, Capture& capture)
+{
+	int tiles = (size+TileSize-1)/TileSize;
+	int minX = TileSize*(tile%tiles), minY = TileSize*(tile/tiles);
+	const float* centre = m_glassSpheres[glass].centre;
+	const float weight = 1.0f/(Samples*Samples);
+	static_assert(Samples*Samples == 4, "A texel's rays are traced as one packet of four");
+
+	for (int y = minY; y < std::min(minY+TileSize, size); y++)
+	{
+		for (int x = minX; x < std::min(minX+TileSize, size); x++)
+		{
+			TriangleBvh::Ray rays[4];
+			TriangleBvh::Hit hits[4];
+			for (int k = 0; k < 4; k++)
+			{
+				float s = (x+(k%Samples+0.5f)/Samples)/size, t = (y+(k/Samples+0.5f)/Samples)/size;
+				std::copy(centre, centre+3, rays[k].origin);
+				FindFaceDirection(face, s, t, rays[k].direction);
+				rays[k].maxDistance = FLT_MAX;
+			}
+			m_basicBvh.Intersect4(rays, hits);
+
+			float* background = &capture.background[face].texels[4*(size*y+x)];
+			float* reflection = &capture.reflection[face].texels[4*(size*y+x)];
+			for (int k = 0; k < 4; k++)
+			{
+				float colour[4];
+				if (hits[k].triangle >= 0)
+				{
+					float point[3];
+					for (int j = 0; j < 3; j++)
+						point[j] = rays[k].origin[j]+hits[k].distance*rays[k].direction[j];
+					int basic = m_basicOwners[hits[k].triangle];
+					shadeMesh(m_meshes[m_basics[basic].mesh], m_basics[basic].world, m_basicFaces[hits[k].triangle], hits[k].u, hits[k].v, m_basics[basic].texture, m_basics[basic].normalMap, point, colour);
+				}
+				else
+				{
+					sampleSky(rays[k].direction, colour);
+				}
+				for (int c = 0; c < 4; c++)
+					background[c] += weight*colour[c];
+
+				// The reflection only differs where another glass object is in front
+				bool glassInFront = false;
+				for (int g = 0; g < (int)m_glasses.size(); g++)
+					glassInFront = glassInFront || (g != glass && HitSphere(m_glassSpheres[g].centre, m_glassSpheres[g].radius, rays[k].origin, rays[k].direction, false) < hits[k].distance);
+				if (glassInFront)
+				{
+					Path path = { {}, {}, Air, -1, 0, weight };
+					std::copy(rays[k].origin, rays[k].origin+3, path.origin);
+					std::copy(rays[k].direction, rays[k].direction+3, path.direction);
+					trace(path, true, colour);
+				}
+				for (int c = 0; c < 4; c++)
+					reflection[c] += weight*colour[c];
+			}
+		}
+	}
+}
+
+void EnvironmentBaker::trace(const Path& path, bool withGlass, float colour[4])
+{
+	if (path.bounces > MaxBounces)
+	{
+		sampleSky(path.direction, colour);
+		return;
+	}
+
+	TriangleBvh::Ray ray;
+	std::copy(path.origin, path.origin+3, ray.origin);
+	std::copy(path.direction, path.direction+3, ray.direction);
+	ray.maxDistance = FLT_MAX;
+	TriangleBvh::Hit hit;
+	auto pointAt = [&](float distance, float point[3]) {
+		for (int j = 0; j < 3; j++)
+			point[j] = path.origin[j]+distance*path.direction[j];
+	};
+	auto normalAt = [&](const Sphere& sphere, const float point[3], float normal[3]) {
+		for (int j = 0; j < 3; j++)
+			normal[j] = (point[j]-sphere.centre[j])/sphere.radius;
+	};
+
+	// As the unit sphere's mesh wraps its texture: around y, from +x towards -z, and from the bottom up
+	auto sampleSphere = [&](const Sphere& sphere, const Texture* texture, const float normal[3], float result[4]) {
+		if (!texture)
+		{
+			result[0] = result[1] = result[2] = result[3] = 1.0f;
+			return;
+		}
+		float model[3] = { Dot(normal, &sphere.axes[0]), Dot(normal, &sphere.axes[3]), Dot(normal, &sphere.axes[6]) };
+		float s = -atan2f(model[2], model[0])/(2.0f*PI), t = 1.0f-acosf(std::min(std::max(model[1], -1.0f), 1.0f))/PI;
+		SoftwareRenderer::Sample(*texture, s, t, result);
+	};
+
+	if (path.medium == Air)
+	{
+		// Nearest of the basics and any glass object but the one capturing
+		m_basicBvh.Intersect(ray, hit);
+		int glass = -1;
+		float nearest = hit.distance;
+		for (int g = 0; withGlass && g < (int)m_glasses.size(); g++)
+		{
+			float distance = (g == m_capturing) ? FLT_MAX : HitSphere(m_glassSpheres[g].centre, m_glassSpheres[g].radius, path.origin, path.direction, false);
+			if (distance < nearest)
+			{
+				nearest = distance;
+				glass = g;
+			}
+		}
+
+		float point[3];
+		pointAt(nearest, point);
+		if (glass >= 0)
+		{
+			// As glass_ps: its own texture over what the surface refracts and reflects, all lit
+			const Glass& object = m_glasses[glass];
+			float normal[3], through[4], texture[4], lightColour[4];
+			normalAt(m_glassSpheres[glass], point, normal);
+			Path entering = path;
+			entering.glass = glass;
+			traceBoundary(entering, point, normal, object.refractiveIndex, 1.0f, InGlass, Air, through);
+			sampleSphere(m_glassSpheres[glass], object.texture, normal, texture);
+			light(point, normal, lightColour);
+			for (int k = 0; k < 4; k++)
+				colour[k] = lightColour[k]*(object.opacity*texture[k]+(1.0f-object.opacity)*through[k]);
+		}
+		else if (hit.triangle >= 0)
+		{
+			int basic = m_basicOwners[hit.triangle];
+			shadeMesh(m_meshes[m_basics[basic].mesh], m_basics[basic].world, m_basicFaces[hit.triangle], hit.u, hit.v, m_basics[basic].texture, m_basics[basic].normalMap, point, colour);
+		}
+		else
+		{
+			sampleSky(path.direction, colour);
+		}
+		return;
+	}
+
+	// Inside a glass object, the nearest of its specimen, its liquid's surface and (from the glass) its own
+	const Glass& object = m_glasses[path.glass];
+	const Sphere& glassSphere = m_glassSpheres[path.glass];
+	const Sphere& liquidSphere = m_liquidSpheres[path.glass];
+	m_specimenBvhs[path.glass].Intersect(ray, hit);
+	float liquidDistance = HitSphere(liquidSphere.centre, liquidSphere.radius, path.origin, path.direction, path.medium == InLiquid);
+	float glassDistance = (path.medium == InGlass) ? HitSphere(glassSphere.centre, glassSphere.radius, path.origin, path.direction, true) : FLT_MAX;
+
+	float point[3], normal[3];
+	if (hit.triangle >= 0 && hit.distance < std::min(liquidDistance, glassDistance))
+	{
+		pointAt(hit.distance, point);
+		shadeMesh(m_meshes[object.specimen], object.specimenWorld, hit.triangle, hit.u, hit.v, object.specimenTexture, object.specimenNormalMap, point, colour);
+	}
+	else if (liquidDistance < glassDistance)
+	{
+		// As specimen_ps, but only on the way in: the brine over whatever is behind it, lit
+		pointAt(liquidDistance, point);
+		normalAt(liquidSphere, point, normal);
+		float through[4];
+		traceBoundary(path, point, normal, object.liquidRefractiveIndex, object.refractiveIndex, InLiquid, InGlass, through);
+		if (path.medium == InLiquid)
+		{
+			std::copy(through, through+4, colour);
+			return;
+		}
+
+		float texture[4], lightColour[4];
+		sampleSphere(liquidSphere, object.liquidTexture, normal, texture);
+		light(point, normal, lightColour);
+		for (int k = 0; k < 4; k++)
+			colour[k] = lightColour[k]*(object.liquidOpacity*texture[k]+(1.0f-object.liquidOpacity)*through[k]);
+	}
+	else if (glassDistance < FLT_MAX)
+	{
+		pointAt(glassDistance, point);
+		normalAt(glassSphere, point, normal);
+		traceBoundary(path, point, normal, object.refractiveIndex, 1.0f, InGlass, Air, colour);
+	}
+	else
+	{
+		// NB: Only when a path grazes a surface it starts on
+		sampleSky(path.direction, colour);
+	}
+}
+
+void EnvironmentBaker::traceBoundary(const Path& path, const float point[3], const float normal[3], float insideIndex, float outsideIndex, Medium inside, Medium outside, float colour[4])
+{
+	// Which way the path crosses decides the indices, and which side each continuation is on
+	float cosine = -Dot(path.direction, normal);
+	bool entering = cosine > 0.0f;
+	float facing[3];
+	for (int j = 0; j < 3; j++)
+		facing[j] = (entering) ? normal[j] : -normal[j];
+	cosine = fabsf(cosine);
+	float from = (entering) ? outsideIndex : insideIndex, to = (entering) ? insideIndex : outsideIndex;
+
+	// Fresnel, for unpolarised light
+	float eta = from/to;
+	float sine2 = eta*eta*(1.0f-cosine*cosine);
+	float reflectance = 1.0f, transmittedCosine = 0.0f;
+	if (sine2 < 1.0f)
+	{
+		transmittedCosine = sqrtf(1.0f-sine2);
+		float rs = (from*cosine-to*transmittedCosine)/(from*cosine+to*transmittedCosine);
+		float rp = (to*cosine-from*transmittedCosine)/(to*cosine+from*transmittedCosine);
+		reflectance = 0.5f*(rs*rs+rp*rp);
+	}
+
+	for (int k = 0; k < 4; k++)
+		colour[k] = 0.0f;
+
+	Path next = path;
+	next.bounces = path.bounces+1;
+	if (reflectance < 1.0f)
+	{
+		next.medium = (entering) ? inside : outside;
+		next.weight = path.weight*(1.0f-reflectance);
+		for (int j = 0; j < 3; j++)
+		{
+			next.direction[j] = eta*path.direction[j]+(eta*cosine-transmittedCosine)*facing[j];
+			next.origin[j] = point[j]+Epsilon*next.direction[j];
+		}
+		Normalize(next.direction);
+
+		float refracted[4];
+		trace(next, true, refracted);
+		for (int k = 0; k < 4; k++)
+			colour[k] += (1.0f-reflectance)*refracted[k];
+	}
+
+	// NB: Total internal reflection always continues; partial reflections only while they can still show
+	if (reflectance >= 1.0f || path.weight*reflectance > MinWeight)
+	{
+		next.medium = (entering) ? outside : inside;
+		next.weight = path.weight*reflectance;
+		for (int j = 0; j < 3; j++)
+		{
+			next.direction[j] = path.direction[j]+2.0f*cosine*facing[j];
+			next.origin[j] = point[j]+Epsilon*next.direction[j];
+		}
+
+		float reflected[4];
+		trace(next, true, reflected);
+		for (int k = 0; k < 4; k++)
+			colour[k] += reflectance*reflected[k];
+	}
+}
+
+void EnvironmentBaker::sampleSky(const float direction[3], float colour[4])
+{
+	SoftwareRenderer::SampleSkybox(m_sky, direction, colour);
+}
+
+void EnvironmentBaker::shadeMesh(const std::vector<float>& vertices, const float world[16], int triangle, float u, float v, const Texture* texture, const Texture* normalMap, const float point[3], float colour[4])
+{
+	// Interpolated as the rasteriser would, then transformed as the vertex shaders do
+	const float* corners[3];
+	for (int k = 0; k < 3; k++)
+		corners[k] = &vertices[SoftwareRenderer::VertexFloats*(3*triangle+k)];
+	const float weights[3] = { 1.0f-u-v, u, v };
+	float model[11];
+	for (int i = 0; i < 11; i++)
+		model[i] = weights[0]*corners[0][3+i]+weights[1]*corners[1][3+i]+weights[2]*corners[2][3+i];
+
+	float frame[3][3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const float* in = &model[2+3*axis];
+		for (int j = 0; j < 3; j++)
+			frame[axis][j] = in[0]*world[j]+in[1]*world[4+j]+in[2]*world[8+j];
+		Normalize(frame[axis]);
+	}
+
+	const float flat[4] = { 0.5f, 0.5f, 1.0f, 1.0f };
+	float textureColour[4] = { 1.0f, 1.0f, 1.0f, 1.0f }, normalColour[4];
+	std::copy(flat, flat+4, normalColour);
+	if (texture)
+		SoftwareRenderer::Sample(*texture, model[0], model[1], textureColour);
+	if (normalMap)
+		SoftwareRenderer::Sample(*normalMap, model[0], model[1], normalColour);
+
+	// NB: Frame rows are normal, tangent and binormal, as the vertices hold them
+	float normal[3];
+	for (int j = 0; j < 3; j++)
+		normal[j] = (2.0f*normalColour[0]-1.0f)*frame[1][j]+(2.0f*normalColour[1]-1.0f)*frame[2][j]+(2.0f*normalColour[2]-1.0f)*frame[0][j];
+	Normalize(normal);
+
+	float lightColour[4];
+	light(point, normal, lightColour);
+	for (int k = 0; k < 4; k++)
+		colour[k] = lightColour[k]*textureColour[k];
+}
+
+void EnvironmentBaker::light(const float point[3], const float normal[3], float colour[4])
+{
+	float direction[3] = { point[0]-m_lightPosition[0], point[1]-m_lightPosition[1], point[2]-m_lightPosition[2] };
+	float distance = std::max(sqrtf(Dot(direction, direction)), sqrtf(m_lighting.strength));
+	Normalize(direction);
+	float intensity = m_lighting.strength*Saturate(-Dot(normal, direction))/(distance*distance);
+	for (int k = 0; k < 4; k++)
+		colour[k] = Saturate(m_lighting.ambient[k]+m_lighting.diffuse[k]*intensity);
+}
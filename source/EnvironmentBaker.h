@@ -0,0 +1,125 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "SoftwareRenderer.h"
+#include "TriangleBvh.h"
+
+// Ray traces each glass object's static captures on the CPU, to bake them offline rather than rasterise them at startup.
+// Basic models are meshes, traced through one TriangleBvh over them all; every other glass object is an analytic sphere of glass around a sphere of liquid
+// (and maybe a specimen), bent at each boundary by the indices either side of it, rather than composited over the background as the overlay passes do.
+// Faces are laid out as find_environment_st reads them, and shaded as light_ps, specimen_ps and glass_ps would, from a light at the capture's centre
+class EnvironmentBaker
+{
+public:
+	typedef SoftwareRenderer::Texture	Texture;
+	typedef SoftwareRenderer::Lighting	Lighting;
+
+	static const int				TileSize = 16;		// Texels along each side of a tile, the unit faces are shared out between threads in
+	static const int				Samples = 2;		// Rays along each side of a texel, traced together as a packet
+	static const int				MaxBounces = 8;		// Boundaries a path crosses before it is given the sky behind it
+
+	struct Basic
+	{
+		int				mesh;			// As addMesh returned it
+		float			world[16];
+		const Texture*	texture;
+		const Texture*	normalMap;
+	};
+
+	// NB: Spheres are the unit sphere through their world matrices, which should scale uniformly
+	struct Glass
+	{
+		float			world[16];
+		float			refractiveIndex;
+		float			opacity;
+		const Texture*	texture;
+
+		float			liquidWorld[16];
+		float			liquidRefractiveIndex;
+		float			liquidOpacity;
+		const Texture*	liquidTexture;
+
+		int				specimen;		// Mesh, or -1 if none
+		float			specimenWorld[16];
+		const Texture*	specimenTexture;
+		const Texture*	specimenNormalMap;
+	};
+
+	// What each glass object keeps: the background around it, and the same with the other glass objects in front
+	struct Capture
+	{
+		Texture			background[6];
+		Texture			reflection[6];
+	};
+
+	EnvironmentBaker();
+
+	void							setThreadCount(int threadCount);
+	void							setSky(const Texture* const faces[6]);		// As skybox_ps samples them
+	void							setLighting(const Lighting& lighting);		// The position is ignored; each capture is lit from its own centre
+
+	int								addMesh(const std::vector<float>& vertices);	// Fourteen floats a vertex, as ModelClass::GetVertices gives them; returns its index
+	void							addBasic(const Basic& basic);
+	void							addGlass(const Glass& glass);
+	void							Build();		// After adding everything, before baking
+
+	void							Bake(int glass, int size, Capture& capture);	// Square faces of size texels, from the glass object's centre
+
+	static size_t					getBytes(const Capture& capture);
+	static bool						save(const std::string& filename, const Capture& capture);
+	static bool						load(const std::string& filename, Capture& capture);	// False, leaving the capture as it was, if missing or malformed
+
+	// Bakes a made-up scene (a ring of spheres around three jars) on 1 and threadCount threads, reporting the time and memory of each capture.
+	// False if the meshes are empty, the two bakes differ, or a capture does not come back from its file as it went in
+	static bool						benchmark(const std::vector<float>& sphere, const std::vector<float>& cube, int size, int threadCount, std::string& report);
+
+private:
+	// Where a path is: in the air, in a glass object's glass, or in its liquid
+	enum Medium
+	{
+		Air,
+		InGlass,
+		InLiquid,
+	};
+
+	struct Sphere
+	{
+		float	centre[3];
+		float	radius;
+		float	axes[9];		// Rows of the world matrix's rotation, to find texture coordinates in model space
+	};
+
+	struct Path
+	{
+		float	origin[3];
+		float	direction[3];	// Normalised
+		Medium	medium;
+		int		glass;			// Whose glass or liquid the path is in
+		int		bounces;
+		float	weight;			// What the path contributes to its texel
+	};
+
+	void							trace(const Path& path, bool withGlass, float colour[4]);
+	void							traceBoundary(const Path& path, const float point[3], const float normal[3], float insideIndex, float outsideIndex, Medium inside, Medium outside, float colour[4]);	// Normal facing outside
+	void							sampleSky(const float direction[3], float colour[4]);
+	void							shadeMesh(const std::vector<float>& vertices, const float world[16], int triangle, float u, float v, const Texture* texture, const Texture* normalMap, const float point[3], float colour[4]);
+	void							light(const float point[3], const float normal[3], float colour[4]);	// As the lit pixel shaders find the light's colour
+	void							bakeTile(int glass, int size, int face, int tile, Capture& capture);
+
+	int								m_threadCount;
+	const Texture*					m_sky[6];
+	Lighting						m_lighting;
+	float							m_lightPosition[3];
+	int								m_capturing;		// Glass object being baked, left out of its own captures
+
+	std::vector<std::vector<float>>	m_meshes;
+	std::vector<Basic>				m_basics;
+	std::vector<Glass>				m_glasses;
+	std::vector<Sphere>				m_glassSpheres;
+	std::vector<Sphere>				m_liquidSpheres;
+
+	TriangleBvh						m_basicBvh;
+	std::vector<int>				m_basicOwners;		// Indices: triangle in m_basicBvh; values: basic
+	std::vector<int>				m_basicFaces;		// ...and its triangle in that basic's mesh
+	std::vector<TriangleBvh>		m_specimenBvhs;		// Indices: glass object; empty if it has no specimen
+};
@@ -0,0 +1,164 @@
+#include "pch.h"
+#include "EnvironmentDetail.h"
+
+namespace
+{
+	// Tier 0 matches the original, full-resolution captures
+	const int	s_tierWidths[] = { 1280, 640, 320 };
+	const int	s_tierHeights[] = { 720, 360, 180 };
+	const int	s_tierIntervals[] = { 1, 2, 4 };
+	const float	s_tierCoverages[] = { 0.05f, 0.01f };	// Minimum fraction of the screen covered to hold each tier (the last tier has no minimum)
+	const int	s_tierCount = 3;
+
+	const float	s_hysteresis = 0.25f;					// Coverage must clear a threshold by this proportion before the tier changes
+	const int	s_holdFrames = 30;						// Minimum frames between tier changes
+	const float	s_farDistance = 15.0f;					// Beyond this distance, refresh half as often again
+}
+
+EnvironmentDetail::EnvironmentDetail()
+{
+	m_tier = 0;
+	m_refreshInterval = 1;
+	m_phase = 0;
+	m_framesHeld = 0;
+	m_coverage = 1.0f;
+	m_resized = false;
+	m_due = true;
+	m_stale = false;
+	m_initialised = false;
+}
+
+EnvironmentDetail::~EnvironmentDetail()
+{
+}
+
+void EnvironmentDetail::Initialise(int phase)
+{
+	m_tier = 0;
+	m_refreshInterval = 1;
+	m_phase = phase;
+	m_framesHeld = 0;
+	m_resized = false;
+	m_due = true;
+	m_stale = false;
+	m_initialised = false;
+}
+
+void EnvironmentDetail::Update(Camera* camera, DirectX::SimpleMath::Vector3 position, float radius, uint64_t frame)
+{
+	m_coverage = findCoverage(camera, position, radius);
+
+	// STEP 1: Pick a tier, only moving once coverage clears the threshold by a margin (avoids popping)
+	int tier = m_tier;
+	if (!m_initialised)
+	{
+		tier = s_tierCount-1;
+		while (tier > 0 && m_coverage >= s_tierCoverages[tier-1])
+			tier--;
+	}
+	else if (m_framesHeld >= s_holdFrames)
+	{
+		while (tier > 0 && m_coverage > s_tierCoverages[tier-1]*(1.0f+s_hysteresis))
+			tier--;
+		while (tier < s_tierCount-1 && m_coverage < s_tierCoverages[tier]*(1.0f-s_hysteresis))
+			tier++;
+	}
+
+	m_resized = (tier != m_tier) || !m_initialised;
+	m_framesHeld = (m_resized) ? 0 : m_framesHeld+1;
+	m_tier = tier;
+
+	// STEP 2: Pick a refresh rate from the tier and distance to the camera
+	m_refreshInterval = s_tierIntervals[m_tier];
+	if ((position-camera->getPosition()).Length()-radius > s_farDistance)
+		m_refreshInterval *= 2;
+
+	// STEP 3: Stagger refreshes between objects, but always refresh freshly (re)allocated or stale maps
+	m_due = m_resized || m_stale || ((frame+m_phase) % m_refreshInterval == 0);
+	m_stale = false;
+	m_initialised = true;
+}
+
+void EnvironmentDetail::invalidate()
+{
+	m_stale = true;
+}
+
+float EnvironmentDetail::findCoverage(Camera* camera, DirectX::SimpleMath::Vector3 position, float radius)
+{
+	DirectX::SimpleMath::Matrix projection = camera->getPerspective();
+	DirectX::SimpleMath::Vector3 viewPosition = DirectX::SimpleMath::Vector3::Transform(position, camera->getCameraMatrix());
+
+	// NB: View space is right-handed, so the camera looks down negative z
+	float depth = -viewPosition.z;
+	if (depth+radius <= 0.0f)
+		return 0.0f;
+	depth = std::max(depth, radius);
+
+	// Project the bounding sphere's centre and extent into normalised device coordinates
+	float centreX = viewPosition.x*projection._11/depth;
+	float centreY = viewPosition.y*projection._22/depth;
+	float radiusX = radius*projection._11/depth;
+	float radiusY = radius*projection._22/depth;
+
+	if (std::abs(centreX)-radiusX > 1.0f || std::abs(centreY)-radiusY > 1.0f)
+		return 0.0f;
+
+	// Ellipse area as a fraction of the 2x2 NDC square
+	return std::min(1.0f, DirectX::XM_PI*radiusX*radiusY/4.0f);
+}
+
+int EnvironmentDetail::getTier()
+{
+	return m_tier;
+}
+
+int EnvironmentDetail::getWidth()
+{
+	return s_tierWidths[m_tier];
+}
+
+int EnvironmentDetail::getHeight()
+{
+	return s_tierHeights[m_tier];
+}
+
+int EnvironmentDetail::getRefreshInterval()
+{
+	return m_refreshInterval;
+}
+
+float EnvironmentDetail::getCoverage()
+{
+	return m_coverage;
+}
+
+bool EnvironmentDetail::getResized()
+{
+	return m_resized;
+}
+
+bool EnvironmentDetail::getDue()
+{
+	return m_due;
+}
+
+int EnvironmentDetail::getTierCount()
+{
+	return s_tierCount;
+}
+
+int EnvironmentDetail::getHoldFrames()
+{
+	return s_holdFrames;
+}
+
+int EnvironmentDetail::getTierWidth(int tier)
+{
+	return s_tierWidths[tier];
+}
+
+int EnvironmentDetail::getTierHeight(int tier)
+{
+	return s_tierHeights[tier];
+}
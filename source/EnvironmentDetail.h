@@ -0,0 +1,40 @@
+#pragma once
+#include "Camera.h"
+
+// Chooses the resolution and refresh rate of a glass object's environment maps from its projected screen coverage
+class EnvironmentDetail
+{
+public:
+	EnvironmentDetail();
+	~EnvironmentDetail();
+
+	void							Initialise(int phase);
+	void							Update(Camera* camera, DirectX::SimpleMath::Vector3 position, float radius, uint64_t frame);
+	void							invalidate();		// Maps were skipped while unseen, so refresh them on the next update
+
+	int								getTier();
+	int								getWidth();
+	int								getHeight();
+	int								getRefreshInterval();
+	float							getCoverage();
+	bool							getResized();		// Tier changed this frame, so the object's maps need reallocating
+	bool							getDue();			// Object's dynamic maps should be re-rendered this frame
+
+	static int						getTierCount();
+	static int						getTierWidth(int tier);
+	static int						getTierHeight(int tier);
+	static int						getHoldFrames();	// Minimum frames between tier changes
+
+private:
+	float							findCoverage(Camera* camera, DirectX::SimpleMath::Vector3 position, float radius);
+
+	int								m_tier;
+	int								m_refreshInterval;
+	int								m_phase;
+	int								m_framesHeld;
+	float							m_coverage;
+	bool							m_resized;
+	bool							m_due;
+	bool							m_stale;
+	bool							m_initialised;
+};
@@ -0,0 +1,398 @@
+#include "pch.h"
+#include "EnvironmentProjection.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <emmintrin.h>
+#include <limits>
+
+using namespace DirectX::SimpleMath;
+
+namespace
+{
+	inline __m128 absolute(__m128 v)
+	{
+		return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+	}
+
+	inline __m128 select(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	inline __m128 signOf(__m128 v)
+	{
+		// NB: Matches HLSL's sign() closely enough here, as only the folded (non-zero) lanes use it
+		return _mm_or_ps(_mm_set1_ps(1.0f), _mm_and_ps(_mm_set1_ps(-0.0f), v));
+	}
+}
+
+Vector3 EnvironmentProjection::encodeCube(Vector3 v)
+{
+	// NB: Same face order and tie-breaking as find_environment_st
+	float extremity = std::max(std::abs(v.x), std::max(std::abs(v.y), std::abs(v.z)));
+	float extremities[6] = { -v.x, v.z, v.x, -v.z, v.y, -v.y };
+	Vector2 sts[6] = { Vector2(-v.z, -v.y), Vector2(-v.x, -v.y), Vector2(v.z, -v.y), Vector2(v.x, -v.y), Vector2(-v.x, -v.z), Vector2(-v.x, v.z) };
+
+	for (int i = 0; i < 6; i++)
+	{
+		if (extremity > 0.0f && extremity == extremities[i])
+		{
+			Vector2 st = sts[i]/extremity;
+			st = 0.5f*(st+Vector2(1.0f, 1.0f));
+			return Vector3(st.x, st.y, (float)i);
+		}
+	}
+
+	return Vector3(0.5f, 0.5f, 0.0f);
+}
+
+Vector3 EnvironmentProjection::decodeCube(Vector2 st, int face)
+{
+	float a = 2.0f*st.x-1.0f;
+	float b = 2.0f*st.y-1.0f;
+
+	Vector3 v;
+	switch (face)
+	{
+	case 0: v = Vector3(-1.0f, -b, -a); break;
+	case 1: v = Vector3(-a, -b, 1.0f); break;
+	case 2: v = Vector3(1.0f, -b, a); break;
+	case 3: v = Vector3(a, -b, -1.0f); break;
+	case 4: v = Vector3(-a, 1.0f, -b); break;
+	default: v = Vector3(-a, -1.0f, b); break;
+	}
+	v.Normalize();
+
+	return v;
+}
+
+Vector2 EnvironmentProjection::encodeOctahedral(Vector3 v)
+{
+	// Project onto the octahedron |x|+|y|+|z| = 1, then fold the -z half over the +z half's corners
+	float l1 = std::abs(v.x)+std::abs(v.y)+std::abs(v.z);
+	if (l1 <= 0.0f)
+		return Vector2(0.5f, 0.5f);
+
+	Vector2 p = Vector2(v.x, v.y)/l1;
+	if (v.z < 0.0f)
+	{
+		Vector2 folded = Vector2((1.0f-std::abs(p.y))*((p.x >= 0.0f) ? 1.0f : -1.0f), (1.0f-std::abs(p.x))*((p.y >= 0.0f) ? 1.0f : -1.0f));
+		p = folded;
+	}
+
+	return 0.5f*(p+Vector2(1.0f, 1.0f));
+}
+
+Vector3 EnvironmentProjection::decodeOctahedral(Vector2 st)
+{
+	Vector2 p = 2.0f*st-Vector2(1.0f, 1.0f);
+	Vector3 v = Vector3(p.x, p.y, 1.0f-std::abs(p.x)-std::abs(p.y));
+	if (v.z < 0.0f)
+	{
+		float x = (1.0f-std::abs(p.y))*((p.x >= 0.0f) ? 1.0f : -1.0f);
+		float y = (1.0f-std::abs(p.x))*((p.y >= 0.0f) ? 1.0f : -1.0f);
+		v.x = x;
+		v.y = y;
+	}
+	v.Normalize();
+
+	return v;
+}
+
+Vector2 EnvironmentProjection::encodeParaboloid(Vector3 v)
+{
+	v.Normalize();
+
+	// +z hemisphere on the left half, -z on the right
+	bool back = (v.z < 0.0f);
+	float d = 1.0f+std::abs(v.z);
+	Vector2 p = Vector2(v.x, v.y)/d;
+	Vector2 st = 0.5f*(p+Vector2(1.0f, 1.0f));
+
+	return Vector2(0.5f*st.x+((back) ? 0.5f : 0.0f), st.y);
+}
+
+Vector3 EnvironmentProjection::decodeParaboloid(Vector2 st)
+{
+	bool back = (st.x >= 0.5f);
+	float s = (back) ? 2.0f*st.x-1.0f : 2.0f*st.x;
+
+	Vector2 p = Vector2(2.0f*s-1.0f, 2.0f*st.y-1.0f);
+	float r2 = p.LengthSquared();
+	Vector3 v = Vector3(2.0f*p.x, 2.0f*p.y, 1.0f-r2)/(1.0f+r2);
+	if (back)
+		v.z = -v.z;
+
+	return v;
+}
+
+Vector2 EnvironmentProjection::encode(Mode mode, Vector3 v)
+{
+	switch (mode)
+	{
+	case Octahedral: return encodeOctahedral(v);
+	case DualParaboloid: return encodeParaboloid(v);
+	default:
+		{
+			Vector3 st = encodeCube(v);
+			return Vector2(st.x, st.y);
+		}
+	}
+}
+
+Vector3 EnvironmentProjection::decode(Mode mode, Vector2 st)
+{
+	switch (mode)
+	{
+	case Octahedral: return decodeOctahedral(st);
+	case DualParaboloid: return decodeParaboloid(st);
+	default: return decodeCube(st, 0);
+	}
+}
+
+int EnvironmentProjection::getTargetWidth(Mode mode, int height)
+{
+	return (mode == DualParaboloid) ? 2*height : height;
+}
+
+Vector4 EnvironmentProjection::sampleBilinear(const Vector4* texels, int width, int height, float s, float t, int minX, int maxX)
+{
+	// NB: Clamped addressing, with minX/maxX keeping each paraboloid's samples within its own half
+	float x = s*width-0.5f;
+	float y = t*height-0.5f;
+
+	int x0 = (int)std::floor(x);
+	int y0 = (int)std::floor(y);
+	float fx = x-x0;
+	float fy = y-y0;
+
+	int x1 = std::min(std::max(x0+1, minX), maxX);
+	int y1 = std::min(std::max(y0+1, 0), height-1);
+	x0 = std::min(std::max(x0, minX), maxX);
+	y0 = std::min(std::max(y0, 0), height-1);
+
+	Vector4 top = texels[y0*width+x0]*(1.0f-fx)+texels[y0*width+x1]*fx;
+	Vector4 bottom = texels[y1*width+x0]*(1.0f-fx)+texels[y1*width+x1]*fx;
+
+	return top*(1.0f-fy)+bottom*fy;
+}
+
+Vector4 EnvironmentProjection::sampleCube(const Vector4* faces[6], int faceWidth, int faceHeight, Vector3 v)
+{
+	Vector3 st = encodeCube(v);
+
+	return sampleBilinear(faces[(int)st.z], faceWidth, faceHeight, st.x, st.y, 0, faceWidth-1);
+}
+
+Vector4 EnvironmentProjection::sampleTarget(Mode mode, const Vector4* target, int width, int height, Vector3 v)
+{
+	Vector2 st = encode(mode, v);
+
+	if (mode == DualParaboloid)
+	{
+		bool back = (st.x >= 0.5f);
+		return sampleBilinear(target, width, height, st.x, st.y, (back) ? width/2 : 0, (back) ? width-1 : width/2-1);
+	}
+
+	return sampleBilinear(target, width, height, st.x, st.y, 0, width-1);
+}
+
+void EnvironmentProjection::ConvertReference(Mode mode, const Vector4* faces[6], int faceWidth, int faceHeight, Vector4* target, int width, int height)
+{
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			Vector2 st = Vector2((x+0.5f)/width, (y+0.5f)/height);
+			target[y*width+x] = sampleCube(faces, faceWidth, faceHeight, decode(mode, st));
+		}
+	}
+}
+
+void EnvironmentProjection::Convert(Mode mode, const Vector4* faces[6], int faceWidth, int faceHeight, Vector4* target, int width, int height)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 lanes = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+
+	for (int y = 0; y < height; y++)
+	{
+		__m128 t = _mm_set1_ps((y+0.5f)/height);
+		__m128 py = _mm_sub_ps(_mm_mul_ps(two, t), one);
+
+		int x = 0;
+		for (; x+4 <= width; x += 4)
+		{
+			__m128 s = _mm_div_ps(_mm_add_ps(_mm_set1_ps((float)x), lanes), _mm_set1_ps((float)width));
+
+			// STEP 1: Decode four texels' directions
+			__m128 vx, vy, vz;
+			if (mode == DualParaboloid)
+			{
+				__m128 back = _mm_cmpge_ps(s, half);
+				__m128 local = _mm_sub_ps(_mm_mul_ps(two, s), _mm_and_ps(back, one));
+				__m128 px = _mm_sub_ps(_mm_mul_ps(two, local), one);
+				__m128 r2 = _mm_add_ps(_mm_mul_ps(px, px), _mm_mul_ps(py, py));
+				__m128 d = _mm_div_ps(one, _mm_add_ps(one, r2));
+
+				vx = _mm_mul_ps(_mm_mul_ps(two, px), d);
+				vy = _mm_mul_ps(_mm_mul_ps(two, py), d);
+				vz = _mm_mul_ps(_mm_sub_ps(one, r2), d);
+				vz = select(back, _mm_sub_ps(zero, vz), vz);
+			}
+			else
+			{
+				__m128 px = _mm_sub_ps(_mm_mul_ps(two, s), one);
+				vz = _mm_sub_ps(_mm_sub_ps(one, absolute(px)), absolute(py));
+
+				__m128 folded = _mm_cmplt_ps(vz, zero);
+				vx = select(folded, _mm_mul_ps(_mm_sub_ps(one, absolute(py)), signOf(px)), px);
+				vy = select(folded, _mm_mul_ps(_mm_sub_ps(one, absolute(px)), signOf(py)), py);
+			}
+
+			// STEP 2: Pick each direction's cube face (earliest match wins, as in find_environment_st) and its coordinates
+			__m128 extremity = _mm_max_ps(absolute(vx), _mm_max_ps(absolute(vy), absolute(vz)));
+			__m128 extremities[6] = { _mm_sub_ps(zero, vx), vz, vx, _mm_sub_ps(zero, vz), vy, _mm_sub_ps(zero, vy) };
+			__m128 ss[6] = { _mm_sub_ps(zero, vz), _mm_sub_ps(zero, vx), vz, vx, _mm_sub_ps(zero, vx), _mm_sub_ps(zero, vx) };
+			__m128 ts[6] = { _mm_sub_ps(zero, vy), _mm_sub_ps(zero, vy), _mm_sub_ps(zero, vy), _mm_sub_ps(zero, vy), _mm_sub_ps(zero, vz), vz };
+
+			__m128 face = zero, faceS = zero, faceT = zero;
+			for (int i = 5; i >= 0; i--)
+			{
+				__m128 match = _mm_cmpeq_ps(extremities[i], extremity);
+				face = select(match, _mm_set1_ps((float)i), face);
+				faceS = select(match, ss[i], faceS);
+				faceT = select(match, ts[i], faceT);
+			}
+
+			__m128 inverse = _mm_div_ps(half, extremity);
+			faceS = _mm_add_ps(_mm_mul_ps(faceS, inverse), half);
+			faceT = _mm_add_ps(_mm_mul_ps(faceT, inverse), half);
+
+			// STEP 3: Fetch (scalar, as the faces differ per lane)
+			alignas(16) float faceLanes[4], sLanes[4], tLanes[4];
+			_mm_store_ps(faceLanes, face);
+			_mm_store_ps(sLanes, faceS);
+			_mm_store_ps(tLanes, faceT);
+
+			for (int i = 0; i < 4; i++)
+				target[y*width+x+i] = sampleBilinear(faces[(int)faceLanes[i]], faceWidth, faceHeight, sLanes[i], tLanes[i], 0, faceWidth-1);
+		}
+
+		// Whatever doesn't fill a group of four
+		for (; x < width; x++)
+		{
+			Vector2 st = Vector2((x+0.5f)/width, (y+0.5f)/height);
+			target[y*width+x] = sampleCube(faces, faceWidth, faceHeight, decode(mode, st));
+		}
+	}
+}
+
+float EnvironmentProjection::findPSNR(Mode mode, const Vector4* faces[6], int faceWidth, int faceHeight, const Vector4* target, int width, int height, int samples)
+{
+	// Fibonacci sphere, so every direction is weighted equally
+	const float goldenAngle = DirectX::XM_PI*(3.0f-std::sqrt(5.0f));
+
+	double error = 0.0;
+	for (int i = 0; i < samples; i++)
+	{
+		float y = 1.0f-2.0f*(i+0.5f)/samples;
+		float r = std::sqrt(std::max(0.0f, 1.0f-y*y));
+		Vector3 v = Vector3(r*std::cos(goldenAngle*i), y, r*std::sin(goldenAngle*i));
+
+		Vector4 expected = sampleCube(faces, faceWidth, faceHeight, v);
+		Vector4 actual = sampleTarget(mode, target, width, height, v);
+
+		float difference[3] = { expected.x-actual.x, expected.y-actual.y, expected.z-actual.z };
+		for (int j = 0; j < 3; j++)
+			error += difference[j]*difference[j];
+	}
+
+	double mse = error/(3.0*samples);
+	if (mse <= 0.0)
+		return std::numeric_limits<float>::infinity();
+
+	return (float)(10.0*std::log10(1.0/mse));
+}
+
+bool EnvironmentProjection::benchmark(int faceWidth, int faceHeight, const std::vector<int>& heights, int samples, std::string& report)
+{
+	// STEP 1: Every layout's directions round-trip, over evenly spread directions
+	const float goldenAngle = DirectX::XM_PI*(3.0f-std::sqrt(5.0f));
+	float worst[3] = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < samples; i++)
+	{
+		float y = 1.0f-2.0f*(i+0.5f)/samples;
+		float r = std::sqrt(std::max(0.0f, 1.0f-y*y));
+		Vector3 v = Vector3(r*std::cos(goldenAngle*i), y, r*std::sin(goldenAngle*i));
+
+		Vector3 st = encodeCube(v);
+		worst[0] = std::max(worst[0], (decodeCube(Vector2(st.x, st.y), (int)st.z)-v).Length());
+		worst[1] = std::max(worst[1], (decodeOctahedral(encodeOctahedral(v))-v).Length());
+		worst[2] = std::max(worst[2], (decodeParaboloid(encodeParaboloid(v))-v).Length());
+	}
+
+	char line[256];
+	snprintf(line, sizeof(line), "  Round trips: worst %.2g (cube), %.2g (octahedral), %.2g (paraboloid)\n", worst[0], worst[1], worst[2]);
+	report += line;
+	bool passed = worst[0] < 1e-5f && worst[1] < 1e-5f && worst[2] < 1e-5f;
+
+	// STEP 2: Faces of a pattern with sharp edges, so resampling loses something
+	std::vector<Vector4> texels[6];
+	const Vector4* faces[6];
+	for (int j = 0; j < 6; j++)
+	{
+		texels[j].resize(faceWidth*faceHeight);
+		for (int y = 0; y < faceHeight; y++)
+		{
+			for (int x = 0; x < faceWidth; x++)
+			{
+				Vector3 v = decodeCube(Vector2((x+0.5f)/faceWidth, (y+0.5f)/faceHeight), j);
+				v.Normalize();
+				float k = 0.5f+0.5f*std::tanh(8.0f*std::sin(24.0f*v.x)*std::sin(24.0f*v.y)*std::sin(24.0f*v.z));
+				texels[j][y*faceWidth+x] = Vector4(k, 0.5f+0.5f*v.y, 1.0f-k, 1.0f);
+			}
+		}
+		faces[j] = texels[j].data();
+	}
+
+	// STEP 3: Each layout at each height, the SIMD conversion against the scalar one
+	for (int m = Octahedral; m <= DualParaboloid; m++)
+	{
+		Mode mode = (Mode)m;
+		for (int i = 0; i < (int)heights.size(); i++)
+		{
+			int height = heights[i];
+			int width = getTargetWidth(mode, height);
+			std::vector<Vector4> reference(width*height), converted(width*height);
+
+			auto start = std::chrono::high_resolution_clock::now();
+			ConvertReference(mode, faces, faceWidth, faceHeight, reference.data(), width, height);
+			auto referenceEnd = std::chrono::high_resolution_clock::now();
+			Convert(mode, faces, faceWidth, faceHeight, converted.data(), width, height);
+			auto convertEnd = std::chrono::high_resolution_clock::now();
+
+			float difference = 0.0f;
+			for (int j = 0; j < width*height; j++)
+				difference = std::max(difference, std::abs(converted[j].x-reference[j].x)+std::abs(converted[j].y-reference[j].y)+std::abs(converted[j].z-reference[j].z));
+
+			float referencePsnr = findPSNR(mode, faces, faceWidth, faceHeight, reference.data(), width, height, samples);
+			float psnr = findPSNR(mode, faces, faceWidth, faceHeight, converted.data(), width, height, samples);
+
+			snprintf(line, sizeof(line), "  %-10s %4dx%-4d %7.1fms scalar, %7.1fms SIMD, %.1fdB (scalar %.1fdB), differing by at most %.2g\n", (mode == Octahedral) ? "Octahedral" : "Paraboloid", width, height,
+				std::chrono::duration<double, std::milli>(referenceEnd-start).count(), std::chrono::duration<double, std::milli>(convertEnd-referenceEnd).count(), psnr, referencePsnr, difference);
+			report += line;
+
+			// NB: Faces are picked by exact comparison, so a texel on an edge may sample the neighbouring face instead
+			passed = passed && difference < 0.01f && std::abs(psnr-referencePsnr) < 0.1f;
+			if (i+1 == (int)heights.size())
+				passed = passed && psnr >= 40.0f;
+		}
+	}
+
+	return passed;
+}
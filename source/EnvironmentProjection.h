@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Maps between directions and the texture coordinates of each environment layout.
+// Cube matches find_environment_st in the shaders: six faces, ordered -x, +z, +x, -z, +y, -y.
+// Octahedral folds the sphere into one square target; dual paraboloid puts the +z and -z hemispheres side by side in a 2:1 target.
+class EnvironmentProjection
+{
+public:
+	enum Mode
+	{
+		Cube = 0,
+		Octahedral = 1,
+		DualParaboloid = 2,
+	};
+
+	static DirectX::SimpleMath::Vector3	encodeCube(DirectX::SimpleMath::Vector3 v);				// (s, t, face)
+	static DirectX::SimpleMath::Vector3	decodeCube(DirectX::SimpleMath::Vector2 st, int face);
+
+	static DirectX::SimpleMath::Vector2	encodeOctahedral(DirectX::SimpleMath::Vector3 v);
+	static DirectX::SimpleMath::Vector3	decodeOctahedral(DirectX::SimpleMath::Vector2 st);
+
+	static DirectX::SimpleMath::Vector2	encodeParaboloid(DirectX::SimpleMath::Vector3 v);
+	static DirectX::SimpleMath::Vector3	decodeParaboloid(DirectX::SimpleMath::Vector2 st);
+
+	static DirectX::SimpleMath::Vector2	encode(Mode mode, DirectX::SimpleMath::Vector3 v);
+	static DirectX::SimpleMath::Vector3	decode(Mode mode, DirectX::SimpleMath::Vector2 st);
+
+	static int							getTargetWidth(Mode mode, int height);					// Single target holding a whole environment
+
+	// Resamples six captured faces (RGBA float, row-major) into one target, four texels at a time
+	static void							Convert(Mode mode, const DirectX::SimpleMath::Vector4* faces[6], int faceWidth, int faceHeight, DirectX::SimpleMath::Vector4* target, int width, int height);
+	static void							ConvertReference(Mode mode, const DirectX::SimpleMath::Vector4* faces[6], int faceWidth, int faceHeight, DirectX::SimpleMath::Vector4* target, int width, int height);
+
+	static DirectX::SimpleMath::Vector4	sampleCube(const DirectX::SimpleMath::Vector4* faces[6], int faceWidth, int faceHeight, DirectX::SimpleMath::Vector3 v);
+	static DirectX::SimpleMath::Vector4	sampleTarget(Mode mode, const DirectX::SimpleMath::Vector4* target, int width, int height, DirectX::SimpleMath::Vector3 v);
+
+	// Peak signal-to-noise ratio (dB, colours in [0, 1]) of a converted target against the six faces, over evenly spread directions
+	static float						findPSNR(Mode mode, const DirectX::SimpleMath::Vector4* faces[6], int faceWidth, int faceHeight, const DirectX::SimpleMath::Vector4* target, int width, int height, int samples);
+
+	// Converts six faces of a sharp-edged pattern into each single-target layout at each height, both ways, timing them and finding their PSNR.
+	// False if any direction fails to round-trip, Convert strays from ConvertReference, or the tallest targets fall below 40dB
+	static bool							benchmark(int faceWidth, int faceHeight, const std::vector<int>& heights, int samples, std::string& report);
+
+private:
+	static DirectX::SimpleMath::Vector4	sampleBilinear(const DirectX::SimpleMath::Vector4* texels, int width, int height, float s, float t, int minX, int maxX);
+};
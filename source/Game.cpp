@@ -7,6 +7,7 @@
 
 
 //toreorganise
+#include <chrono>
 #include <fstream>
 
 extern void ExitGame();
@@ -16,14 +17,64 @@ using namespace DirectX::SimpleMath;
 
 using Microsoft::WRL::ComPtr;
 
+namespace
+{
+	const unsigned char StaticFacesDone = 0x3F;			// Every face of a glass object's static maps...
+	const unsigned char StaticProjectionDone = 0x40;	// ...and their projection, in single-target modes
+}
+
 Game::Game() noexcept(false)
 {
     m_deviceResources = std::make_unique<DX::DeviceResources>();
     m_deviceResources->RegisterDeviceNotify(this);
+	m_Headless = false;
+	m_BackBufferView = nullptr;
+	m_BackBufferDepthView = nullptr;
+	m_HeadlessBackBuffer[0] = m_HeadlessBackBuffer[1] = nullptr;
+	m_ScreenViewport = {};
+	GetDefaultSize(m_OutputWidth, m_OutputHeight);
+
+	m_texture1 = m_texture2 = m_normalTexture1 = m_brineTexture = m_glassTexture = nullptr;
+
+	m_RenderGraphPassCount = -1;
+	m_SkippedFaceCount = 0;
+	m_SkippedFaceCountReported = -1;
+	m_ProjectionCount = 0;
+	m_RenderContextBoundCount = -1;
+	m_ParallelRecording = true;
+	m_DeferredRecording = false;
+	m_Benchmarking = false;
+	m_Baking = false;
+	m_BakeSize = 0;
+	m_Referencing = false;
+	m_StaticBytes = 0;
+	m_StaticCached = false;
+	m_StaticCache.setThreadCount(std::max(1, (int)std::thread::hardware_concurrency()));
+	m_StartupStart = std::chrono::high_resolution_clock::now();
+	m_FirstFrameReported = false;
+	m_StartupReported = false;
+	m_Progressive = false;
+	m_RecordingPath = false;
+	m_RecordingStart = 0.0;
+
+	// NB: Octahedral/DualParaboloid (see SetProjection) resample each map into one target after capture, so the glass shaders read it with one sample
+	m_EnvironmentMode = EnvironmentProjection::Cube;
+
+	m_FaceVisibleStale = true;
+	m_OcclusionCulling = true;
+
+	// The default scene, unless SetScene is given another
+	m_Scene.load("scene.txt");
 }
 
 Game::~Game()
 {
+#ifdef _DEBUG
+	// The latest frames' scopes, for chrome://tracing or Perfetto
+	if (!m_Headless)
+		m_Profiler.saveChromeTrace("profile.json");
+#endif
+
 #ifdef DXTK_AUDIO
     if (m_audEngine)
     {
@@ -45,20 +96,7 @@ void Game::Initialize(HWND window, int width, int height)
     m_deviceResources->CreateWindowSizeDependentResources();
     CreateWindowSizeDependentResources();
 
-	//setup light
-	m_Ambience = Vector4(0.1f, 0.1f, 0.1f, 1.0f);
-	//m_Ambience = Vector4(1.0f, 1.0f, 1.0f, 1.0f);
-	m_Light.setAmbientColour(m_Ambience.x, m_Ambience.y, m_Ambience.z, m_Ambience.w);
-	m_Light.setDiffuseColour(0.93f, 1.0f, 0.98f, 1.0f);
-	m_Light.setPosition(-1.0f, -1.0f, -1.0f);
-	m_Light.setDirection(1.0f, 1.0f, 0.0f);
-	m_Light.setStrength(10.0);
-
-	//setup camera
-	//m_Camera.setPosition(Vector3(2.4f+0.75*cos(atan(-1.8/2.4)), 0.0f, 1.8f+0.75*sin(atan(-1.8/2.4))));
-	//m_Camera.setRotation(Vector3(-90.0f, -180+(180.0/3.14159265)*atan(2.4/1.8), 0.0f));	//orientation is -90 becuase zero will be looking up at the sky straight up.
-	m_Camera.setPosition(Vector3(0.0, 0.0f, 10.0));
-	m_Camera.setRotation(Vector3(-90.0f, -180, 0.0f));
+	SetupLightAndCamera();
 	
 #ifdef DXTK_AUDIO
     // Create DirectXTK for Audio objects
@@ -84,26 +122,74 @@ void Game::Initialize(HWND window, int width, int height)
 #endif
 }
 
+void Game::InitializeHeadless(int width, int height)
+{
+	// NB: A fixed step every frame, as benchmarks take, so each run sees the same frames however fast it goes
+	m_Headless = true;
+	m_OutputWidth = std::max(width, 1);
+	m_OutputHeight = std::max(height, 1);
+	m_timer.SetFixedTimeStep(true);
+	m_timer.SetTargetElapsedSeconds(1.0/60.0);
+
+	CreateDeviceDependentResources();
+	CreateWindowSizeDependentResources();
+
+	SetupLightAndCamera();
+}
+
+void Game::SetupLightAndCamera()
+{
+	//setup light
+	m_Ambience = Vector4(0.1f, 0.1f, 0.1f, 1.0f);
+	//m_Ambience = Vector4(1.0f, 1.0f, 1.0f, 1.0f);
+	m_Light.setAmbientColour(m_Ambience.x, m_Ambience.y, m_Ambience.z, m_Ambience.w);
+	m_Light.setDiffuseColour(0.93f, 1.0f, 0.98f, 1.0f);
+	m_Light.setPosition(-1.0f, -1.0f, -1.0f);
+	m_Light.setDirection(1.0f, 1.0f, 0.0f);
+	m_Light.setStrength(10.0);
+
+	//setup camera
+	//m_Camera.setPosition(Vector3(2.4f+0.75*cos(atan(-1.8/2.4)), 0.0f, 1.8f+0.75*sin(atan(-1.8/2.4))));
+	//m_Camera.setRotation(Vector3(-90.0f, -180+(180.0/3.14159265)*atan(2.4/1.8), 0.0f));	//orientation is -90 becuase zero will be looking up at the sky straight up.
+	m_Camera.setPosition(Vector3(0.0, 0.0f, 10.0));
+	m_Camera.setRotation(Vector3(-90.0f, -180, 0.0f));
+}
+
 #pragma region Frame Update
 // Executes the basic game loop.
 void Game::Tick()
 {
+	// NB: Everything timed from here on is counted towards this frame
+	if (m_Benchmarking)
+		m_Benchmark.beginFrame();
+	m_Profiler.beginFrame();
+
 	//take in input
 	m_input.Update();								//update the hardware
 	m_gameInputCommands = m_input.getGameInput();	//retrieve the input for our game
+	if (m_Benchmarking)
+		m_gameInputCommands = InputCommands();		// NB: Benchmarks ignore the controls, so run the same whoever holds the mouse
+	m_Hud.setVisible(m_gameInputCommands.hud);
 	
 	//Update all game objects
-    m_timer.Tick([&]()
-    {
-        Update(m_timer);
-    });
+	// NB: Benchmarks (and headless runs) step a fixed time every frame, so each run sees the same frames however fast it goes
+	auto update = [&]()
+	{
+		Profiler::Scope scope(&m_Profiler, "Update");
+		Update(m_timer);
+	};
+	if (m_Benchmarking || m_Headless)
+		m_timer.Step(update);
+	else
+		m_timer.Tick(update);
 
 	//Render all game content. 
     Render();
+	m_Hud.endFrame(m_timer.GetElapsedSeconds());
 
 #ifdef DXTK_AUDIO
     // Only update audio engine once per frame
-    if (!m_audEngine->IsCriticalError() && m_audEngine->Update())
+    if (m_audEngine && !m_audEngine->IsCriticalError() && m_audEngine->Update())
     {
         // Setup a retry in 1 second
         m_audioTimerAcc = 1.f;
@@ -111,7 +197,14 @@ void Game::Tick()
     }
 #endif
 
-	
+	m_Profiler.endFrame();
+
+	if (m_Benchmarking)
+	{
+		m_Benchmark.endFrame();
+		if (m_Benchmark.getFinished())
+			FinishBenchmark();
+	}
 }
 
 // Updates the world.
@@ -122,6 +215,14 @@ void Game::Update(DX::StepTimer const& timer)
 	//note that currently.  Delta-time is not considered in the game object movement. 
 	Vector3 inputPosition = Vector3(0.0f, 0.0f, 0.0f);
 
+	// Benchmarks fly the camera along their path instead
+	if (m_Benchmarking)
+	{
+		CameraPath::Key key = m_CameraPath.sample(m_time);
+		m_Camera.setPosition(Vector3(key.position[0], key.position[1], key.position[2]));
+		m_Camera.setRotation(Vector3(key.rotation[0], key.rotation[1], key.rotation[2]));
+	}
+
 	// STEP 1: Read camera translation inputs (from keyboard)
 	if (m_gameInputCommands.forward)
 		inputPosition.z += 1.0f;
@@ -167,6 +268,24 @@ void Game::Update(DX::StepTimer const& timer)
 
 	// STEP 3: Process inputs
 	m_Camera.Update();
+	if (!m_Benchmarking && m_gameInputCommands.record != m_RecordingPath)
+	{
+		// NB: A recording ends as soon as it is toggled off, and its path replaces any earlier one
+		m_RecordingPath = m_gameInputCommands.record;
+		if (m_RecordingPath)
+		{
+			m_CameraPath.clear();
+			m_RecordingStart = m_time;
+		}
+		else
+			m_CameraPath.save("camera_path.txt");
+	}
+	if (m_RecordingPath)
+	{
+		Vector3 position = m_Camera.getPosition(), rotation = m_Camera.getRotation();
+		m_CameraPath.add({ m_time-m_RecordingStart, { position.x, position.y, position.z }, { rotation.x, rotation.y, rotation.z } });
+	}
+
 	m_Light.setPosition(m_Camera.getPosition().x, m_Camera.getPosition().y, m_Camera.getPosition().z);
 	UpdateModels(m_time);
 
@@ -208,7 +327,83 @@ void Game::Update(DX::StepTimer const& timer)
 
 void Game::UpdateModels(float time)
 {
+	// NB: Only what moved since the last frame is rebuilt
+	SceneTransforms& transforms = m_Scene.getTransforms();
+	m_MovedObjects.clear();
+	for (int i = 0; i < m_BasicCount; i++)
+		if (transforms.getDirty(m_Scene.getBasicTransform(i)))
+			m_MovedObjects.push_back(i);
+	for (int i = 0; i < m_GlassCount; i++)
+		if (transforms.getDirty(m_Scene.getGlassTransform(i)))
+			m_MovedObjects.push_back(m_BasicCount+i);
+	transforms.Update();
+
+	// Specimens and liquids move with time alone, so are placed once a frame rather than once a draw
+	m_Animations.Update(time);
+
+	// Moving objects keep their place in the BVH, and just stretch its boxes
+	for (int k = 0; k < (int)m_MovedObjects.size(); k++)
+	{
+		int object = m_MovedObjects[k];
+		if (object < m_BasicCount)
+			SetObjectBounds(object, m_BasicModels[object], *GetBasicTransform(object));
+		else
+			SetObjectBounds(object, m_GlassModels[object-m_BasicCount], *GetGlassTransform(object-m_BasicCount));
+	}
+	for (int i = 0; i < m_GlassCount; i++)
+		SetObjectBounds(m_BasicCount+m_GlassCount+i, &m_Cube, m_Animations.get(m_SpecimenAnimations[i]));
+
+	m_Bvh.Refit();
+	m_FaceVisibleStale = true;
+}
+
+Matrix Game::AnimateSpecimen(int i, float time)
+{
+	float theta = XM_PIDIV2 * time;
+	Vector3 axis = SimpleMath::Vector3(sin(XM_PI / 32) * sin(0.009 * theta), cos(XM_PI / 32), sin(XM_PI / 16) * cos(0.009 * theta));
+	Matrix spin = SimpleMath::Matrix::CreateRotationY(XM_PIDIV2) * SimpleMath::Matrix::CreateFromAxisAngle(axis, 0.018f * theta);
+	Vector3 translation = Vector3(0.03 * sin(0.07 * time), 0.0, 0.03 * cos(0.07 * time)) + Vector3(0.0, 0.1 * sin(0.5 * time), 0.0);
+
+	return Matrix::CreateTranslation(translation) * spin * Matrix::CreateScale(0.6f) * (*GetGlassTransform(i));
+}
+
+Matrix Game::AnimateLiquid(int i, float time)
+{
+	float theta = XM_PIDIV2 * time;
+	Vector3 axis = SimpleMath::Vector3(sin(XM_PI / 16) * sin(0.009 * theta), cos(XM_PI / 16), sin(XM_PI / 16) * cos(0.009 * theta));
+	Matrix spin = SimpleMath::Matrix::CreateRotationY(XM_PIDIV2) * SimpleMath::Matrix::CreateFromAxisAngle(axis, 0.018f * theta);
+
+	return spin * Matrix::CreateScale(0.8f) * (*GetGlassTransform(i));
+}
+
+Matrix* Game::GetBasicTransform(int i)
+{
+	static_assert(sizeof(Matrix) == 16*sizeof(float), "Scene world matrices are read as SimpleMath ones");
+	return reinterpret_cast<Matrix*>(m_Scene.getTransforms().getWorld(m_Scene.getBasicTransform(i)));
+}
+
+Matrix* Game::GetGlassTransform(int i)
+{
+	return reinterpret_cast<Matrix*>(m_Scene.getTransforms().getWorld(m_Scene.getGlassTransform(i)));
+}
+
+Vector3 Game::GetBasicPosition(int i)
+{
+	SceneTransforms& transforms = m_Scene.getTransforms();
+	int t = m_Scene.getBasicTransform(i);
+	return Vector3(transforms.getPositionX()[t], transforms.getPositionY()[t], transforms.getPositionZ()[t]);
+}
+
+Vector3 Game::GetGlassPosition(int i)
+{
+	SceneTransforms& transforms = m_Scene.getTransforms();
+	int t = m_Scene.getGlassTransform(i);
+	return Vector3(transforms.getPositionX()[t], transforms.getPositionY()[t], transforms.getPositionZ()[t]);
+}
 
+float Game::GetGlassScale(int i)
+{
+	return m_Scene.getTransforms().getScale()[m_Scene.getGlassTransform(i)];
 }
 #pragma endregion
 
@@ -222,66 +417,306 @@ void Game::Render()
         return;
     }
 
-    Clear();
+	Profiler::Scope scope(&m_Profiler, "Render");
 
-    m_deviceResources->PIXBeginEvent(L"Render");
-    auto context = m_deviceResources->GetD3DDeviceContext();
-	auto renderTargetView = m_deviceResources->GetRenderTargetView();
-	auto depthTargetView = m_deviceResources->GetDepthStencilView();
+	// NB: Present and anything else outside the render context leave the device in an unknown state
+	m_RenderContext.newFrame();
+	m_ConstantRing.newFrame();
+
+    Clear();
 
-    // Draw Text to the screen
-    m_sprites->Begin();
-		m_font->DrawString(m_sprites.get(), L"", XMFLOAT2(10, 10), Colors::White);
-    m_sprites->End();
+    auto context = &m_RenderContext;
+	auto renderTargetView = m_BackBufferView;
+	auto depthTargetView = m_BackBufferDepthView;
 
 	//Set Rendering states. 
-	context->OMSetBlendState(m_states->Opaque(), nullptr, 0xFFFFFFFF);
-	context->OMSetDepthStencilState(m_states->DepthDefault(), 0);
-	context->RSSetState(m_states->CullClockwise());
+	BindFrameState(context);
 //	context->RSSetState(m_states->Wireframe());
 
-	// If m_time == 0.0, then render all static textures (once only!)
-	if (!m_preRendered)
+	// Pick each glass object's environment resolution/refresh rate before anything samples them
+	UpdateEnvironmentDetail();
+
+	// Declare the frame, then let the graph order it, cull anything unseen and share transient targets
+	{
+		Profiler::Scope scope(&m_Profiler, "Build render graph");
+		BuildRenderGraph();
+		m_RenderGraph.Compile();
+	}
+
+	// NB: Unseen objects' maps were culled, so must be refreshed as soon as they come back into view
+	for (int i = 0; i < m_GlassCount; i++)
+		if (m_GlassModelPasses[i] != -1 && m_RenderGraph.getCulled(m_GlassModelPasses[i]))
+			m_GlassModelDetails[i].invalidate();
+
+#ifdef _DEBUG
+	if (m_RenderGraph.getScheduledPassCount() != m_RenderGraphPassCount)
 	{
-		RenderStaticTextures();
+		OutputDebugStringA(m_RenderGraph.getSchedule().c_str());
+		m_RenderGraphPassCount = m_RenderGraph.getScheduledPassCount();
+	}
+#endif
 
-		RenderStaticSpecimenEnvironments();
-		RenderStaticLiquidEnvironments();
+	// NB: Every viewpoint draws the same basic models, so their instances are uploaded once for all of them
+	UpdateBasicInstances();
 
-		RenderStaticEnvironments(); // FIXME: Add depth mapping!
-		RenderStaticReflectionEnvironments();
+	// NB: The graph's backend brackets every pass in a profiler scope of its own
+	m_SharedCapture.newFrame();
+	m_SkippedFaceCount = 0;
+	m_ProjectionCount = 0;
+	m_RenderGraph.Execute(&m_RenderGraphBackend);
+	m_preRendered = true;
 
-		m_preRendered = true;
+	// NB: Once the first frame has drawn every texture the static passes read
+	if (m_Baking)
+	{
+		BakeEnvironments();
+		return;
+	}
+	if (m_Referencing)
+	{
+		CompareReference();
+		return;
 	}
 
-	// STEP 1: Run render to textures...
-	// First render pass: Rendering any textures (including normal maps, etc...)
-	RenderDynamicTextures();
+	// Draw Text to the screen, over everything else
+	CountFrame();
+	if (m_Hud.getVisible())
+	{
+		Profiler::Scope scope(&m_Profiler, "Performance HUD");
+		BindFrameState(context);
+		context->DrawString(m_Hud.getText().c_str(), 10, 10);
+	}
 
-	// Second render pass: Rendering...
-	RenderDynamicSpecimenEnvironments();
-	RenderDynamicLiquidEnvironments();
+#ifdef _DEBUG
+	if (m_SkippedFaceCount != m_SkippedFaceCountReported)
+	{
+		OutputDebugStringA(("Environment faces skipped as empty: " + std::to_string(m_SkippedFaceCount) + "\n").c_str());
+		m_SkippedFaceCountReported = m_SkippedFaceCount;
+	}
 
-	RenderDynamicEnvironment(); // FIXME: Add depth mapping!
-	RenderDynamicExternalEnvironments();
-	RenderDynamicAirToGlassEnvironments();
-	RenderDynamicInternalEnvironments();
+	if (m_RenderContext.getBoundCount() != m_RenderContextBoundCount)
+	{
+		OutputDebugStringA(m_RenderContext.getReport().c_str());
+		for (int i = 0; m_RenderContext.getConstantRing() && i < ConstantRing::TierCount; i++)
+		{
+			ConstantRing::Tier tier = (ConstantRing::Tier)i;
+			OutputDebugStringA(("  " + std::string(ConstantRing::getTierName(tier)) + " constants: " + std::to_string(m_ConstantRing.getWriteCount(tier)) + " written, " + std::to_string(m_ConstantRing.getReuseCount(tier)) + " reused\n").c_str());
+		}
+		m_RenderContextBoundCount = m_RenderContext.getBoundCount();
+	}
+#endif
 
+	// NB: Headlessly there is nothing to show, nor a startup worth timing
+	if (m_Headless)
+		return;
 
-	// STEP 2: Render 'real' scene...
-	// Draw Skybox
-	RenderSkyboxOnto(&m_Camera);
+    // Show the new frame.
+	Profiler::Scope presentScope(&m_Profiler, "Present");
+    m_deviceResources->Present();
 
-	// Draw Basic Models
-	for (int i = 0; i < m_BasicCount; i++)
-		RenderBasicsOnto(&m_Camera, &m_Light, i);
+	// NB: Once each frame is shown, so startup is timed without writing the cache
+	if (!m_StartupReported)
+		ReportStartup();
+}
+
+void Game::BuildRenderGraph()
+{
+	m_RenderGraph.Reset();
+
+	size_t fullBytes = RenderTexturePool::getTextureBytes(1280, 720);
+
+	// STEP 1: Declare the targets every frame shares...
+	int backBuffer = m_RenderGraph.importTexture("Back buffer", m_OutputWidth, m_OutputHeight, 1, 0, nullptr);
+	m_RenderGraph.markOutput(backBuffer);
+
+	int staticTextures = m_RenderGraph.importTexture("Static textures", 1280, 720, 8, fullBytes, nullptr);
+	int dynamicTextures = m_RenderGraph.importTexture("Dynamic textures", 1280, 720, 4, fullBytes, nullptr);
+
+	int staticSpecimens = m_RenderGraph.importTexture("Static specimen environments", 1280, 720, 2*6*m_GlassCount*m_GlassCount, fullBytes, nullptr);
+	int staticLiquids = m_RenderGraph.importTexture("Static liquid environments", 1280, 720, 2*6*m_GlassCount*m_GlassCount, fullBytes, nullptr);
+	int staticEnvironments = m_RenderGraph.importTexture("Static environments", 1280, 720, 6*m_GlassCount, fullBytes, nullptr);
+	int staticReflections = m_RenderGraph.importTexture("Static reflection environments", 1280, 720, 6*m_GlassCount, fullBytes, nullptr);
+
+	// NB: Static targets are sampled on later frames, so must never be culled
+	m_RenderGraph.markOutput(staticTextures);
+	m_RenderGraph.markOutput(staticSpecimens);
+	m_RenderGraph.markOutput(staticLiquids);
+	m_RenderGraph.markOutput(staticEnvironments);
+	m_RenderGraph.markOutput(staticReflections);
+
+	int environment = m_RenderGraph.importTexture("Dynamic environment", 1280, 720, 6, fullBytes, m_DynamicEnvironment);
+
+	// ...and each glass object's. Specimens and air-to-glass refractions never outlive the frame, so are transient
+	std::vector<int> specimens(m_GlassCount), specimenAlphas(m_GlassCount), liquids(m_GlassCount), liquidAlphas(m_GlassCount), externals(m_GlassCount), airToGlasses(m_GlassCount), internals(m_GlassCount);
+	for (int i = 0; i < m_GlassCount; i++)
+	{
+		std::string index = std::to_string(i);
+		int width = m_GlassModelDetails[i].getWidth();
+		int height = m_GlassModelDetails[i].getHeight();
+		size_t bytes = RenderTexturePool::getTextureBytes(width, height);
+
+		specimens[i] = m_RenderGraph.createTexture("Dynamic specimen environment " + index, width, height, 6, bytes);
+		specimenAlphas[i] = m_RenderGraph.createTexture("Dynamic specimen alpha environment " + index, width, height, 6, bytes);
+		liquids[i] = m_RenderGraph.importTexture("Dynamic liquid environment " + index, width, height, 6, bytes, m_DynamicLiquidEnvironments[i].data());
+		liquidAlphas[i] = m_RenderGraph.importTexture("Dynamic liquid alpha environment " + index, width, height, 6, bytes, m_DynamicLiquidAlphaEnvironments[i].data());
+		externals[i] = m_RenderGraph.importTexture("Dynamic external environment " + index, width, height, 6, bytes, m_DynamicExternalEnvironments[i].data());
+		airToGlasses[i] = m_RenderGraph.createTexture("Dynamic air-to-glass environment " + index, width, height, 6, bytes);
+		internals[i] = m_RenderGraph.importTexture("Dynamic internal environment " + index, width, height, 6, bytes, m_DynamicInternalEnvironments[i].data());
+	}
+
+	// STEP 2: Static passes, first frame only, unless the environments are left for later frames
+	if (!m_preRendered)
+	{
+		int pass = m_RenderGraph.addPass("Static textures", [this]() { RenderStaticTextures(); });
+		m_RenderGraph.write(pass, staticTextures);
+	}
+
+	if (!m_preRendered && m_StaticQueue.getCount() == 0)
+	{
+		int pass = m_RenderGraph.addPass("Static specimen environments", [this]() { RenderStaticSpecimenEnvironments(); });
+		m_RenderGraph.read(pass, staticTextures);
+		m_RenderGraph.read(pass, dynamicTextures);
+		m_RenderGraph.write(pass, staticSpecimens);
+
+		pass = m_RenderGraph.addPass("Static liquid environments", [this]() { RenderStaticLiquidEnvironments(); });
+		m_RenderGraph.read(pass, staticTextures);
+		m_RenderGraph.read(pass, staticSpecimens);
+		m_RenderGraph.write(pass, staticLiquids);
+
+		pass = m_RenderGraph.addPass("Static environments", [this]() { RenderStaticEnvironments(); }); // FIXME: Add depth mapping!
+		m_RenderGraph.read(pass, staticTextures);
+		m_RenderGraph.read(pass, dynamicTextures);
+		m_RenderGraph.write(pass, staticEnvironments);
+
+		pass = m_RenderGraph.addPass("Static reflection environments", [this]() { RenderStaticReflectionEnvironments(); });
+		m_RenderGraph.read(pass, staticEnvironments);
+		m_RenderGraph.read(pass, staticLiquids);
+		m_RenderGraph.write(pass, staticReflections);
+	}
+	else if (m_preRendered && !m_StaticQueue.getComplete())
+	{
+		int pass = m_RenderGraph.addPass("Progressive static environments", [this]() { RenderStaticItems(); });
+		m_RenderGraph.read(pass, staticTextures);
+		m_RenderGraph.read(pass, dynamicTextures);
+		m_RenderGraph.write(pass, staticSpecimens);
+		m_RenderGraph.write(pass, staticLiquids);
+		m_RenderGraph.write(pass, staticEnvironments);
+		m_RenderGraph.write(pass, staticReflections);
+	}
+
+	// STEP 3: Dynamic passes, for the glass objects due a refresh
+	int pass = m_RenderGraph.addPass("Dynamic textures", [this]() { RenderDynamicTextures(); });
+	m_RenderGraph.write(pass, dynamicTextures);
+
+	pass = m_RenderGraph.addPass("Dynamic environment", [this]() { RenderDynamicEnvironment(); }); // FIXME: Add depth mapping!
+	m_RenderGraph.read(pass, staticTextures);
+	m_RenderGraph.read(pass, dynamicTextures);
+	m_RenderGraph.write(pass, environment);
+
+	for (int i = 0; i < m_GlassCount; i++)
+	{
+		m_GlassModelPasses[i] = -1;
+		if (!m_GlassModelDetails[i].getDue())
+			continue;
+
+		std::string index = std::to_string(i);
+		int specimen = specimens[i], specimenAlpha = specimenAlphas[i], airToGlass = airToGlasses[i];
+
+		pass = m_RenderGraph.addPass("Dynamic specimen environment " + index, [this, i, specimen, specimenAlpha]() { RenderDynamicSpecimenEnvironments(i, specimen, specimenAlpha); });
+		m_RenderGraph.read(pass, staticTextures);
+		m_RenderGraph.read(pass, dynamicTextures);
+		m_RenderGraph.write(pass, specimen);
+		m_RenderGraph.write(pass, specimenAlpha);
+
+		pass = m_RenderGraph.addPass("Dynamic liquid environment " + index, [this, i, specimen, specimenAlpha]() { RenderDynamicLiquidEnvironments(i, specimen, specimenAlpha); });
+		m_RenderGraph.read(pass, specimen);
+		m_RenderGraph.read(pass, specimenAlpha);
+		m_RenderGraph.write(pass, liquids[i]);
+		m_RenderGraph.write(pass, liquidAlphas[i]);
+
+		pass = m_RenderGraph.addPass("Dynamic external environment " + index, [this, i]() { RenderDynamicExternalEnvironments(i); });
+		m_RenderGraph.read(pass, environment);
+		for (int k = 0; k < m_GlassCount; k++)
+		{
+			if (i == k)
+				continue;
+
+			m_RenderGraph.read(pass, liquids[k]);
+			m_RenderGraph.read(pass, liquidAlphas[k]);
+		}
+		m_RenderGraph.write(pass, externals[i]);
+
+		pass = m_RenderGraph.addPass("Dynamic air-to-glass environment " + index, [this, i, airToGlass]() { RenderDynamicAirToGlassEnvironments(i, airToGlass); });
+		m_RenderGraph.read(pass, staticTextures);
+		m_RenderGraph.read(pass, externals[i]);
+		m_RenderGraph.write(pass, airToGlass);
+
+		pass = m_RenderGraph.addPass("Dynamic internal environment " + index, [this, i, airToGlass]() { RenderDynamicInternalEnvironments(i, airToGlass); });
+		m_RenderGraph.read(pass, airToGlass);
+		m_RenderGraph.read(pass, liquids[i]);
+		m_RenderGraph.read(pass, liquidAlphas[i]);
+		m_RenderGraph.write(pass, internals[i]);
+
+		m_GlassModelPasses[i] = pass;
+	}
+
+	// STEP 4: Render 'real' scene...
+	pass = m_RenderGraph.addPass("Scene", [this]() { RenderScene(); });
+	m_RenderGraph.read(pass, staticTextures);
+	m_RenderGraph.read(pass, dynamicTextures);
+	m_RenderGraph.read(pass, staticReflections);
+	for (int i = 0; i < m_GlassCount; i++)
+	{
+		// NB: Only objects on screen need their internal maps, so the rest are culled (along with whatever only fed them)
+		if (m_GlassModelDetails[i].getCoverage() > 0.0f)
+			m_RenderGraph.read(pass, internals[i]);
+
+		// ...and their external maps, while those stand in for static maps still to come
+		if (m_GlassModelDetails[i].getCoverage() > 0.0f && m_StaticFaces[i] != (StaticFacesDone | StaticProjectionDone))
+			m_RenderGraph.read(pass, externals[i]);
+	}
+	m_RenderGraph.write(pass, backBuffer);
+}
+
+void Game::RenderScene()
+{
+	CullObjects(&m_Camera, m_MainVisible);
+	OccludeObjects(&m_Camera, m_MainVisible, 320, 180);
+
+	// Draw Skybox and Basic Models
+	QueueBackgroundOnto(&m_Camera, &m_Light, m_MainVisible);
 
 	// Draw Glass Models
+	// NB: A layer of their own, so they are still drawn after everything they refract
+	unsigned int shader = m_DrawQueue.getShaderId(&m_GlassShaderPair);
 	for (int i = 0; i < m_GlassCount; i++)
-		RenderGlassOnto(&m_Camera, &m_Light, i);
+	{
+		if (!m_MainVisible[m_BasicCount+i])
+			continue;
 
-    // Show the new frame.
-    m_deviceResources->Present();
+		float depth = Vector3::Distance(m_Camera.getPosition(), GetGlassPosition(i))/100.0f;
+		m_DrawQueue.push(DrawQueue::makeKey(2, shader, 0, depth), [=](RenderContext* context) { RenderGlassOnto(context, &m_Camera, &m_Light, i); });
+	}
+
+	m_DrawQueue.Submit(&m_RenderContext);
+}
+
+void Game::UpdateEnvironmentDetail()
+{
+	Profiler::Scope scope(&m_Profiler, "Update environment detail");
+
+	// NB: Smaller/further glass objects get cheaper, less frequently refreshed environment maps
+	m_RenderTexturePool.newFrame();
+	for (int i = 0; i < m_GlassCount; i++)
+	{
+		m_GlassModelDetails[i].Update(&m_Camera, GetGlassPosition(i), GetGlassScale(i), m_timer.GetFrameCount());
+
+		if (m_GlassModelDetails[i].getResized())
+			CreateGlassEnvironments(i, m_GlassModelDetails[i].getWidth(), m_GlassModelDetails[i].getHeight());
+	}
+
+	// Maps left behind by a tier change are only kept for as long as an object must hold its new tier, in case it comes straight back
+	m_RenderTexturePool.trim(EnvironmentDetail::getHoldFrames());
 }
 
 
@@ -289,143 +724,154 @@ void Game::Render()
 
 
 // Rendering Models
-void Game::RenderBasicsOnto(Camera* camera, Light* light, int i)
+void Game::RenderBasicsOnto(RenderContext* context, Camera* camera, Light* light, int i)
 {
-	auto context = m_deviceResources->GetD3DDeviceContext();
-	auto renderTargetView = m_deviceResources->GetRenderTargetView();
-	auto depthTargetView = m_deviceResources->GetDepthStencilView();
+	auto renderTargetView = m_BackBufferView;
+	auto depthTargetView = m_BackBufferDepthView;
+
+	int material = m_Scene.getBasicMaterial(i);
 
 	m_LightShaderPair.EnableShader(context);
-	m_LightShaderPair.SetLightShaderParameters(context, &m_BasicModelTransforms[i], &camera->getCameraMatrix(), &camera->getPerspective(), m_time, light, (*m_BasicModelTextures[i])->getShaderResourceView(), (*m_BasicModelNMTextures[i])->getShaderResourceView());
+	m_LightShaderPair.SetLightShaderParameters(context, GetBasicTransform(i), &camera->getCameraMatrix(), &camera->getPerspective(), m_time, light, (*m_MaterialTextures[material])->getShaderResourceView(), (*m_MaterialNMTextures[material])->getShaderResourceView());
 	(*m_BasicModels[i]).Render(context);
 }
 
-void Game::RenderSpecimensOnto(Camera* camera, Light* light, int i)
+void Game::RenderBasicsInstancedOnto(RenderContext* context, Camera* camera, Light* light, int group)
+{
+	// NB: Groups are numbered by scene material, and the world matrix is unused, as every instance brings its own
+	int material = m_BasicInstances.getGroupMaterial(group);
+	Matrix world = Matrix::Identity;
+
+	m_LightInstancedShaderPair.EnableShader(context);
+	m_LightInstancedShaderPair.SetLightShaderParameters(context, &world, &camera->getCameraMatrix(), &camera->getPerspective(), m_time, light, (*m_MaterialTextures[material])->getShaderResourceView(), (*m_MaterialNMTextures[material])->getShaderResourceView());
+	m_BasicInstances.Bind(context);
+	m_Sphere.RenderInstanced(context, m_BasicInstances.getGroupSize(group), m_BasicInstances.getGroupFirst(group));
+}
+
+void Game::UpdateBasicInstances()
+{
+	Profiler::Scope scope(&m_Profiler, "Update basic instances");
+
+	// Spheres of one material are drawn together
+	m_BasicInstances.clear();
+	for (int i = 0; i < m_BasicCount; i++)
+		if (m_BasicModels[i] == &m_Sphere)
+			m_BasicInstances.add(*GetBasicTransform(i), m_Scene.getBasicMaterial(i));
+
+	m_BasicInstances.Upload(&m_RenderContext);
+}
+
+void Game::RenderSpecimensOnto(RenderContext* context, Camera* camera, Light* light, int i)
 {
-	if (i > 0)
+	if (!HasSpecimen(i))
 		return;
 
-	auto context = m_deviceResources->GetD3DDeviceContext();
-	auto renderTargetView = m_deviceResources->GetRenderTargetView();
-	auto depthTargetView = m_deviceResources->GetDepthStencilView();
+	auto renderTargetView = m_BackBufferView;
+	auto depthTargetView = m_BackBufferDepthView;
+	Matrix world = m_Animations.get(m_SpecimenAnimations[i]);
 
-	float theta = XM_PIDIV2 * m_time;
-	Vector3 axis = SimpleMath::Vector3(sin(XM_PI / 32) * sin(0.009 * theta), cos(XM_PI / 32), sin(XM_PI / 16) * cos(0.009 * theta));
-	Matrix spin = SimpleMath::Matrix::CreateRotationY(XM_PIDIV2) * SimpleMath::Matrix::CreateFromAxisAngle(axis, 0.018f * theta);
-	Vector3 translation = Vector3(0.03* sin(0.07 * m_time), 0.0, 0.03 * cos(0.07 * m_time))+Vector3(0.0, 0.1*sin(0.5 * m_time), 0.0);
 
 	m_LightShaderPair.EnableShader(context);
-	m_LightShaderPair.SetLightShaderParameters(context, &(Matrix::CreateTranslation(translation) * spin * Matrix::CreateScale(0.6f)* m_GlassModelTransforms[i]), &camera->getCameraMatrix(), &camera->getPerspective(), m_time, light, m_DemoRenderPass->getShaderResourceView(), m_DemoNMRenderPass->getShaderResourceView());
+	m_LightShaderPair.SetLightShaderParameters(context, &world, &camera->getCameraMatrix(), &camera->getPerspective(), m_time, light, m_DemoRenderPass->getShaderResourceView(), m_DemoNMRenderPass->getShaderResourceView());
 	m_Cube.Render(context);
 }
 
-void Game::RenderLiquidsOnto(Camera* camera, Light* light, int i, ID3D11ShaderResourceView* specimen)
+void Game::RenderLiquidsOnto(RenderContext* context, Camera* camera, Light* light, int i, ID3D11ShaderResourceView* specimen)
 {
-	auto context = m_deviceResources->GetD3DDeviceContext();
-	auto renderTargetView = m_deviceResources->GetRenderTargetView();
-	auto depthTargetView = m_deviceResources->GetDepthStencilView();
+	auto renderTargetView = m_BackBufferView;
+	auto depthTargetView = m_BackBufferDepthView;
+	Matrix world = m_Animations.get(m_LiquidAnimations[i]);
 
-	float theta = XM_PIDIV2 * m_time;
-	Vector3 axis = SimpleMath::Vector3(sin(XM_PI / 16) * sin(0.009 * theta), cos(XM_PI / 16), sin(XM_PI / 16) * cos(0.009 * theta));
-	Matrix spin = SimpleMath::Matrix::CreateRotationY(XM_PIDIV2) * SimpleMath::Matrix::CreateFromAxisAngle(axis, 0.018f * theta);
 
 	m_SpecimenShaderPair.EnableShader(context);
-	m_SpecimenShaderPair.SetSpecimenShaderParameters(context, &(spin*Matrix::CreateScale(0.8f)*m_GlassModelTransforms[i]), &camera->getCameraMatrix(), &camera->getPerspective(), m_time, light, m_LiquidOpacity[i], m_brineTexture.Get(), m_NeutralNMRenderPass->getShaderResourceView(), specimen);
+	m_SpecimenShaderPair.SetSpecimenShaderParameters(context, &world, &camera->getCameraMatrix(), &camera->getPerspective(), m_time, light, m_Scene.getLiquidOpacity(i), m_brineTexture, m_NeutralNMRenderPass->getShaderResourceView(), specimen);
 	m_Sphere.Render(context);
 }
 
 
 
-void Game::RenderSpecimenAlphasOnto(Camera* camera, int i, ID3D11ShaderResourceView* alpha)
+void Game::RenderSpecimenAlphasOnto(RenderContext* context, Camera* camera, int i, ID3D11ShaderResourceView* alpha)
 {
-	if (i > 0)
+	if (!HasSpecimen(i))
 		return;
 
-	auto context = m_deviceResources->GetD3DDeviceContext();
-	auto renderTargetView = m_deviceResources->GetRenderTargetView();
-	auto depthTargetView = m_deviceResources->GetDepthStencilView();
+	auto renderTargetView = m_BackBufferView;
+	auto depthTargetView = m_BackBufferDepthView;
+	Matrix world = m_Animations.get(m_SpecimenAnimations[i]);
 
-	float theta = XM_PIDIV2 * m_time;
-	Vector3 axis = SimpleMath::Vector3(sin(XM_PI / 32) * sin(0.009 * theta), cos(XM_PI / 32), sin(XM_PI / 16) * cos(0.009 * theta));
-	Matrix spin = SimpleMath::Matrix::CreateRotationY(XM_PIDIV2) * SimpleMath::Matrix::CreateFromAxisAngle(axis, 0.018f * theta);
-	Vector3 translation = Vector3(0.03 * sin(0.07 * m_time), 0.0, 0.03 * cos(0.07 * m_time)) + Vector3(0.0, 0.1 * sin(0.5 * m_time), 0.0);
 
 	m_AlphaShaderPair.EnableShader(context);
-	m_AlphaShaderPair.SetAlphaShaderParameters(context, &(Matrix::CreateTranslation(translation) * spin * Matrix::CreateScale(0.6f) * m_GlassModelTransforms[i]), &camera->getCameraMatrix(), &camera->getPerspective(), m_time, 1.0, alpha);
+	m_AlphaShaderPair.SetAlphaShaderParameters(context, &world, &camera->getCameraMatrix(), &camera->getPerspective(), m_time, 1.0, alpha);
 	m_Cube.Render(context);
 }
 
-void Game::RenderLiquidAlphasOnto(Camera* camera, int i, ID3D11ShaderResourceView* alpha)
+void Game::RenderLiquidAlphasOnto(RenderContext* context, Camera* camera, int i, ID3D11ShaderResourceView* alpha)
 {
-	auto context = m_deviceResources->GetD3DDeviceContext();
-	auto renderTargetView = m_deviceResources->GetRenderTargetView();
-	auto depthTargetView = m_deviceResources->GetDepthStencilView();
+	auto renderTargetView = m_BackBufferView;
+	auto depthTargetView = m_BackBufferDepthView;
+	Matrix world = m_Animations.get(m_LiquidAnimations[i]);
 
-	float theta = XM_PIDIV2 * m_time;
-	Vector3 axis = SimpleMath::Vector3(sin(XM_PI / 16) * sin(0.009 * theta), cos(XM_PI / 16), sin(XM_PI / 16) * cos(0.009 * theta));
-	Matrix spin = SimpleMath::Matrix::CreateRotationY(XM_PIDIV2) * SimpleMath::Matrix::CreateFromAxisAngle(axis, 0.018f * theta);
 
 	m_AlphaShaderPair.EnableShader(context);
-	m_AlphaShaderPair.SetAlphaShaderParameters(context, &(spin*Matrix::CreateScale(0.8f)*m_GlassModelTransforms[i]), &camera->getCameraMatrix(), &camera->getPerspective(), m_time, m_LiquidOpacity[i], alpha);
+	m_AlphaShaderPair.SetAlphaShaderParameters(context, &world, &camera->getCameraMatrix(), &camera->getPerspective(), m_time, m_Scene.getLiquidOpacity(i), alpha);
 	m_Sphere.Render(context);
 }
 
 
 
-void Game::RenderRefractionOnto(Camera* camera, Light* light, int i)
+void Game::RenderRefractionOnto(RenderContext* context, Camera* camera, Light* light, int i)
 {
-	auto context = m_deviceResources->GetD3DDeviceContext();
-	auto renderTargetView = m_deviceResources->GetRenderTargetView();
-	auto depthTargetView = m_deviceResources->GetDepthStencilView();
+	auto renderTargetView = m_BackBufferView;
+	auto depthTargetView = m_BackBufferDepthView;
 
 	ID3D11ShaderResourceView* environmentMap[6];
-	for (int j = 0; j < 6; j++)
-		environmentMap[j] = m_DynamicExternalEnvironments[i][j]->getShaderResourceView();
+	FillEnvironmentMap(m_DynamicExternalEnvironments[i].data(), m_DynamicExternalProjections[i], environmentMap);
 
 	context->RSSetState(m_states->CullCounterClockwise());
 	m_RefractionShaderPair.EnableShader(context);
-	m_RefractionShaderPair.SetRefractionShaderParameters(context, &m_GlassModelTransforms[i], &camera->getCameraMatrix(), &camera->getPerspective(), m_time, light, m_GlassModelOpacity[i], m_GlassModelRefractiveIndex[i], false, camera, m_glassTexture.Get(), m_NeutralNMRenderPass->getShaderResourceView(), environmentMap);
+	m_RefractionShaderPair.SetRefractionShaderParameters(context, GetGlassTransform(i), &camera->getCameraMatrix(), &camera->getPerspective(), m_time, light, m_Scene.getGlassOpacity(i), m_Scene.getGlassRefractiveIndex(i), false, camera, m_glassTexture, m_NeutralNMRenderPass->getShaderResourceView(), environmentMap);
 	(*m_GlassModels[i]).Render(context);
 
 	context->RSSetState(m_states->CullClockwise());
 }
 
-void Game::RenderGlassOverlayOnto(Camera* camera, int i, ID3D11ShaderResourceView* texture, ID3D11ShaderResourceView* overlay, ID3D11ShaderResourceView* alpha)
+void Game::RenderGlassOverlayOnto(RenderContext* context, Camera* camera, int i, ID3D11ShaderResourceView* texture, ID3D11ShaderResourceView* overlay, ID3D11ShaderResourceView* alpha)
 {
-	auto context = m_deviceResources->GetD3DDeviceContext();
-	auto renderTargetView = m_deviceResources->GetRenderTargetView();
-	auto depthTargetView = m_deviceResources->GetDepthStencilView();
+	auto renderTargetView = m_BackBufferView;
+	auto depthTargetView = m_BackBufferDepthView;
 
 	// FIXME: Add depth mapping!
 	m_OverlayShaderPair.EnableShader(context);
-	m_OverlayShaderPair.SetOverlayShaderParameters(context, &m_GlassModelTransforms[i], &camera->getCameraMatrix(), &camera->getPerspective(), m_time, texture, overlay, alpha); // alpha will slot in here!
+	m_OverlayShaderPair.SetOverlayShaderParameters(context, GetGlassTransform(i), &camera->getCameraMatrix(), &camera->getPerspective(), m_time, texture, overlay, alpha); // alpha will slot in here!
 	m_Sphere.Render(context);
 }
 
-void Game::RenderGlassOnto(Camera* camera, Light* light, int i)
+void Game::RenderGlassOnto(RenderContext* context, Camera* camera, Light* light, int i)
 {
-	auto context = m_deviceResources->GetD3DDeviceContext();
-	auto renderTargetView = m_deviceResources->GetRenderTargetView();
-	auto depthTargetView = m_deviceResources->GetDepthStencilView();
+	auto renderTargetView = m_BackBufferView;
+	auto depthTargetView = m_BackBufferDepthView;
 
 	ID3D11ShaderResourceView* refractionMap[6];
+	FillEnvironmentMap(m_DynamicInternalEnvironments[i].data(), m_DynamicInternalProjections[i], refractionMap);
+
+	// NB: Static faces still to come are stood in for by the dynamic external ones, which see much the same from nearby
+	RenderTexture* reflections[6];
 	for (int j = 0; j < 6; j++)
-		refractionMap[j] = m_DynamicInternalEnvironments[i][j]->getShaderResourceView();
+		reflections[j] = (m_StaticFaces[i] & (1 << j)) ? m_StaticReflectionEnvironments[i][j] : m_DynamicExternalEnvironments[i][j];
+	RenderTexture* reflectionProjection = (m_StaticFaces[i] & StaticProjectionDone) ? m_StaticReflectionProjections[i] : m_DynamicExternalProjections[i];
 
 	ID3D11ShaderResourceView* reflectionMap[6];
-	for (int j = 0; j < 6; j++)
-		reflectionMap[j] = m_StaticReflectionEnvironments[i][j]->getShaderResourceView();
+	FillEnvironmentMap(reflections, reflectionProjection, reflectionMap);
 
 	m_GlassShaderPair.EnableShader(context);
-	m_GlassShaderPair.SetGlassShaderParameters(context, &m_GlassModelTransforms[i], &camera->getCameraMatrix(), &camera->getPerspective(), m_time, light, m_GlassModelOpacity[i], 1.00/m_GlassModelRefractiveIndex[i], true, camera, m_glassTexture.Get(), m_NeutralNMRenderPass->getShaderResourceView(), refractionMap, reflectionMap);
+	m_GlassShaderPair.SetGlassShaderParameters(context, GetGlassTransform(i), &camera->getCameraMatrix(), &camera->getPerspective(), m_time, light, m_Scene.getGlassOpacity(i), 1.00/m_Scene.getGlassRefractiveIndex(i), true, camera, m_glassTexture, m_NeutralNMRenderPass->getShaderResourceView(), refractionMap, reflectionMap);
 	(*m_GlassModels[i]).Render(context);
 }
 
-void Game::RenderSkyboxOnto(Camera* camera)
+void Game::RenderSkyboxOnto(RenderContext* context, Camera* camera)
 {
-	auto context = m_deviceResources->GetD3DDeviceContext();
-	auto renderTargetView = m_deviceResources->GetRenderTargetView();
-	auto depthTargetView = m_deviceResources->GetDepthStencilView();
+	auto renderTargetView = m_BackBufferView;
+	auto depthTargetView = m_BackBufferDepthView;
 
 	ID3D11ShaderResourceView* environmentMap[6];
 	for (int j = 0; j < 6; j++)
@@ -454,6 +900,52 @@ void Game::RenderSkyboxOnto(Camera* camera)
 	context->RSSetState(m_states->CullClockwise());
 }
 
+int Game::RenderBackgroundOnto(RenderContext* context, Camera* camera, Light* light, const std::vector<unsigned char>& visible)
+{
+	// Everything common to a viewpoint's captures, before any glass is composited
+	QueueBackgroundOnto(camera, light, visible);
+	int draws = m_DrawQueue.getSize();
+	m_DrawQueue.Submit(context);
+
+	return draws;
+}
+
+void Game::QueueBackgroundOnto(Camera* camera, Light* light, const std::vector<unsigned char>& visible)
+{
+	// NB: The skybox ignores depth, so it has the first layer to itself rather than overwriting anything
+	m_DrawQueue.push(DrawQueue::makeKey(0, m_DrawQueue.getShaderId(&m_SkyboxShaderPair), 0, 0.0f), [=](RenderContext* context) { RenderSkyboxOnto(context, camera); });
+
+	// Spheres are instanced, one draw per material, so a material's draw is only skipped if none of its spheres are visible
+	std::vector<unsigned char> materialsVisible(m_Scene.getMaterialCount(), 0);
+	for (int i = 0; i < m_BasicCount; i++)
+		if (m_BasicModels[i] == &m_Sphere && visible[i])
+			materialsVisible[m_Scene.getBasicMaterial(i)] = 1;
+
+	unsigned int instancedShader = m_DrawQueue.getShaderId(&m_LightInstancedShaderPair);
+	for (int g = 0; g < m_BasicInstances.getGroupCount(); g++)
+	{
+		int i = m_BasicInstances.getGroupMaterial(g);
+		if (!materialsVisible[i])
+			continue;
+
+		unsigned int material = m_DrawQueue.getMaterialId((*m_MaterialTextures[i])->getShaderResourceView(), (*m_MaterialNMTextures[i])->getShaderResourceView());
+		m_DrawQueue.push(DrawQueue::makeKey(1, instancedShader, material, 0.0f), [=](RenderContext* context) { RenderBasicsInstancedOnto(context, camera, light, g); });
+	}
+
+	// Anything else is grouped by textures, then front to back (over the cameras' far plane) so nearer models reject what they hide
+	unsigned int shader = m_DrawQueue.getShaderId(&m_LightShaderPair);
+	for (int i = 0; i < m_BasicCount; i++)
+	{
+		if (m_BasicModels[i] == &m_Sphere || !visible[i])
+			continue;
+
+		int j = m_Scene.getBasicMaterial(i);
+		unsigned int material = m_DrawQueue.getMaterialId((*m_MaterialTextures[j])->getShaderResourceView(), (*m_MaterialNMTextures[j])->getShaderResourceView());
+		float depth = Vector3::Distance(camera->getPosition(), GetBasicPosition(i))/100.0f;
+		m_DrawQueue.push(DrawQueue::makeKey(1, shader, material, depth), [=](RenderContext* context) { RenderBasicsOnto(context, camera, light, i); });
+	}
+}
+
 
 
 
@@ -466,13 +958,19 @@ void Game::RenderStaticTextures()
 
 	for (int i = 0; i < 6; i++)
 		RenderShaderTexture(m_SkyboxRenderPass[i], m_SkyboxRendering[i]);
-
-	//Rendered as a failsafe!
-	RenderDynamicTextures();
 }
 
 void Game::RenderDynamicTextures()
 {
+	// NB: Only the time changes from frame to frame, so the pass is recorded once and replayed with the time patched in
+	if (m_DynamicTextureCommands.getRecorded())
+	{
+		m_DynamicTextureCommands.Replay(&m_RenderContext);
+		return;
+	}
+
+	m_DynamicTextureCommands.Begin(&m_RenderContext);
+
 	//RenderShaderTexture(m_NeutralRenderPass, m_NeutralRendering);
 	//RenderShaderTexture(m_NeutralNMRenderPass, m_NeutralNMRendering);
 
@@ -480,13 +978,25 @@ void Game::RenderDynamicTextures()
 	RenderShaderTexture(m_DemoNMRenderPass, m_DemoNMRendering);
 	RenderShaderTexture(m_SphericalPoresRenderPass, m_SphericalPoresRendering);
 	RenderShaderTexture(m_SphericalPoresNMRenderPass, m_SphericalPoresNMRendering);
+
+	m_DynamicTextureCommands.End();
+
+	Shader* renderings[] = { &m_DemoRendering, &m_DemoNMRendering, &m_SphericalPoresRendering, &m_SphericalPoresNMRendering };
+	for (int i = 0; i < 4; i++)
+		m_DynamicTextureCommands.addPatch(renderings[i]->getTimeBuffer(), 0, &m_time, sizeof(m_time));
+
+#ifdef _DEBUG
+	// Saved for diffing between builds
+	m_DynamicTextureCommands.save("dynamic_textures.cmdb");
+	OutputDebugStringA(("Dynamic textures recorded: " + std::to_string(m_DynamicTextureCommands.getCommandCount()) + " commands, " + std::to_string(m_DynamicTextureCommands.getPayloadBytes()) + " bytes of payload\n").c_str());
+#endif
 }
 
 void Game::RenderShaderTexture(RenderTexture* renderPass, Shader rendering)
 {
-	auto context = m_deviceResources->GetD3DDeviceContext();
-	auto renderTargetView = m_deviceResources->GetRenderTargetView();
-	auto depthTargetView = m_deviceResources->GetDepthStencilView();
+	auto context = &m_RenderContext;
+	auto renderTargetView = m_BackBufferView;
+	auto depthTargetView = m_BackBufferDepthView;
 
 	renderPass->setRenderTarget(context);
 	renderPass->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
@@ -501,400 +1011,1317 @@ void Game::RenderShaderTexture(RenderTexture* renderPass, Shader rendering)
 	context->OMSetRenderTargets(1, &renderTargetView, depthTargetView);
 }
 
+void Game::RenderProjection(RenderTexture* faces[6], RenderTexture* target)
+{
+	auto context = &m_RenderContext;
+	auto renderTargetView = m_BackBufferView;
+	auto depthTargetView = m_BackBufferDepthView;
+
+	ID3D11ShaderResourceView* environmentMap[6];
+	for (int j = 0; j < 6; j++)
+		environmentMap[j] = faces[j]->getShaderResourceView();
+
+	// NB: Drawn like the shader textures, with every texel finding its own direction from its screen position
+	target->setRenderTarget(context);
+	target->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
+	m_ProjectionShaderPair.EnableShader(context);
+	m_ProjectionCount++;
+	m_ProjectionShaderPair.SetProjectionShaderParameters(
+		context,
+		&SimpleMath::Matrix::CreateScale(2.0f),
+		&(Matrix)Matrix::Identity,
+		&(Matrix)Matrix::Identity,
+		m_time,
+		m_EnvironmentMode,
+		environmentMap);
+	m_Cube.Render(context);
+	context->OMSetRenderTargets(1, &renderTargetView, depthTargetView);
+}
+
+void Game::FillEnvironmentMap(RenderTexture* faces[6], RenderTexture* projection, ID3D11ShaderResourceView* environmentMap[6])
+{
+	// Single-target modes only read the first slot
+	for (int j = 0; j < 6; j++)
+	{
+		if (projection)
+			environmentMap[j] = (j == 0) ? projection->getShaderResourceView() : nullptr;
+		else
+			environmentMap[j] = faces[j]->getShaderResourceView();
+	}
+}
+
 
 
 void Game::RenderStaticSpecimenEnvironments()
 {
-	auto context = m_deviceResources->GetD3DDeviceContext();
-	auto renderTargetView = m_deviceResources->GetRenderTargetView();
-	auto depthTargetView = m_deviceResources->GetDepthStencilView();
-
 	// Render specimens from each glass model's perspective, using each of our six environment cameras
 	for (int i = 0; i < m_GlassCount; i++)
 	{
-		m_environmentCamera.setPosition(m_GlassModelPositions[i]);
-		m_environmentCamera.Update();
+		if (m_StaticBaked[i])
+			continue;
+
+		Profiler::Scope objectScope(&m_Profiler, ("Glass object " + std::to_string(i)).c_str());
+
+		Vector3 position = GetGlassPosition(i);
+		PlaceEnvironmentCamera(position);
 
 		// Not a great fix, but better than replicating dynamic lighting!
-		m_Light.setPosition(m_GlassModelPositions[i].x, m_GlassModelPositions[i].y, m_GlassModelPositions[i].z);
+		m_Light.setPosition(position.x, position.y, position.z);
 
 		for (int j = 0; j < 6; j++)
 		{
-			for (int k = 0; k < m_GlassCount; k++)
-			{
-				if (i == k)
-					continue;
+			Profiler::Scope faceScope(&m_Profiler, ("Face " + std::to_string(j)).c_str());
+			RenderStaticSpecimenFace(i, j);
+		}
+	}
+	m_Light.setPosition(m_Camera.getPosition().x, m_Camera.getPosition().y, m_Camera.getPosition().z);
+}
 
-				if (m_environmentCamera.getCamera(j)->getReflection())
-					context->RSSetState(m_states->CullCounterClockwise());
+void Game::RenderStaticSpecimenFace(int i, int j)
+{
+	auto context = &m_RenderContext;
+	auto renderTargetView = m_BackBufferView;
+	auto depthTargetView = m_BackBufferDepthView;
 
-				m_StaticSpecimenEnvironments[i][j][k]->setRenderTarget(context);
-				m_StaticSpecimenEnvironments[i][j][k]->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
-				RenderSpecimensOnto(m_environmentCamera.getCamera(j), &m_Light, k);
+	for (int k = 0; k < m_GlassCount; k++)
+	{
+		if (i == k)
+			continue;
 
-				m_StaticSpecimenAlphaEnvironments[i][j][k]->setRenderTarget(context);
-				m_StaticSpecimenAlphaEnvironments[i][j][k]->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
-				RenderSpecimenAlphasOnto(m_environmentCamera.getCamera(j), k, m_StaticSpecimenAlphaEnvironments[i][j][k]->getShaderResourceView());
+		if (!HasSpecimen(k) || !GetSpecimenVisible(j, k))
+		{
+			SkipEmptyFace(m_StaticSpecimenEnvironments[i][j][k]);
+			SkipEmptyFace(m_StaticSpecimenAlphaEnvironments[i][j][k]);
+			continue;
+		}
 
-				context->OMSetRenderTargets(1, &renderTargetView, depthTargetView);
-				if (m_environmentCamera.getCamera(j)->getReflection())
-					context->RSSetState(m_states->CullClockwise());
-			}
+		if (m_environmentCamera.getCamera(j)->getReflection())
+			context->RSSetState(m_states->CullCounterClockwise());
+
+		m_StaticSpecimenEnvironments[i][j][k]->setRenderTarget(context);
+		m_StaticSpecimenEnvironments[i][j][k]->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
+		RenderSpecimensOnto(context, m_environmentCamera.getCamera(j), &m_Light, k);
+
+		m_StaticSpecimenAlphaEnvironments[i][j][k]->setRenderTarget(context);
+		m_StaticSpecimenAlphaEnvironments[i][j][k]->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
+		RenderSpecimenAlphasOnto(context, m_environmentCamera.getCamera(j), k, m_StaticSpecimenAlphaEnvironments[i][j][k]->getShaderResourceView());
+
+		context->OMSetRenderTargets(1, &renderTargetView, depthTargetView);
+		if (m_environmentCamera.getCamera(j)->getReflection())
+			context->RSSetState(m_states->CullClockwise());
+	}
+}
+
+void Game::RenderStaticLiquidEnvironments()
+{
+	// Render specimens from each glass model's perspective, using each of our six environment cameras
+	for (int i = 0; i < m_GlassCount; i++)
+	{
+		if (m_StaticBaked[i])
+			continue;
+
+		Profiler::Scope objectScope(&m_Profiler, ("Glass object " + std::to_string(i)).c_str());
+
+		Vector3 position = GetGlassPosition(i);
+		PlaceEnvironmentCamera(position);
+
+		// Not a great fix, but better than replicating dynamic lighting!
+		m_Light.setPosition(position.x, position.y, position.z);
+
+		for (int j = 0; j < 6; j++)
+		{
+			Profiler::Scope faceScope(&m_Profiler, ("Face " + std::to_string(j)).c_str());
+			RenderStaticLiquidFace(i, j);
 		}
 	}
 	m_Light.setPosition(m_Camera.getPosition().x, m_Camera.getPosition().y, m_Camera.getPosition().z);
+}
+
+void Game::RenderStaticLiquidFace(int i, int j)
+{
+	auto context = &m_RenderContext;
+	auto renderTargetView = m_BackBufferView;
+	auto depthTargetView = m_BackBufferDepthView;
+
+	for (int k = 0; k < m_GlassCount; k++)
+	{
+		if (i == k)
+			continue;
+
+		if (!GetGlassVisible(j, k))
+		{
+			SkipEmptyFace(m_StaticLiquidEnvironments[i][j][k]);
+			SkipEmptyFace(m_StaticLiquidAlphaEnvironments[i][j][k]);
+			continue;
+		}
+
+		if (m_environmentCamera.getCamera(j)->getReflection())
+			context->RSSetState(m_states->CullCounterClockwise());
+
+		m_StaticLiquidEnvironments[i][j][k]->setRenderTarget(context);
+		m_StaticLiquidEnvironments[i][j][k]->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
+		RenderLiquidsOnto(context, m_environmentCamera.getCamera(j), &m_Light, k, m_StaticSpecimenEnvironments[i][j][k]->getShaderResourceView());
 
-	RenderDynamicSpecimenEnvironments();
+		m_StaticLiquidAlphaEnvironments[i][j][k]->setRenderTarget(context);
+		m_StaticLiquidAlphaEnvironments[i][j][k]->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
+		RenderLiquidAlphasOnto(context, m_environmentCamera.getCamera(j), k, m_StaticSpecimenAlphaEnvironments[i][j][k]->getShaderResourceView());
+
+		context->OMSetRenderTargets(1, &renderTargetView, depthTargetView);
+		if (m_environmentCamera.getCamera(j)->getReflection())
+			context->RSSetState(m_states->CullClockwise());
+	}
 }
 
-void Game::RenderStaticLiquidEnvironments()
+
+
+void Game::RenderStaticEnvironments()
+{
+	// Render specimens from each glass model's perspective, using each of our six environment cameras
+	for (int i = 0; i < m_GlassCount; i++)
+	{
+		if (m_StaticBaked[i])
+			continue;
+
+		Profiler::Scope objectScope(&m_Profiler, ("Glass object " + std::to_string(i)).c_str());
+
+		Vector3 position = GetGlassPosition(i);
+		PlaceEnvironmentCamera(position);
+
+		// Not a great fix, but better than replicating dynamic lighting!
+		m_Light.setPosition(position.x, position.y, position.z);
+
+		for (int j = 0; j < 6; j++)
+		{
+			Profiler::Scope faceScope(&m_Profiler, ("Face " + std::to_string(j)).c_str());
+			RenderStaticEnvironmentFace(i, j);
+		}
+	}
+	m_Light.setPosition(m_Camera.getPosition().x, m_Camera.getPosition().y, m_Camera.getPosition().z);
+}
+
+void Game::RenderStaticEnvironmentFace(int i, int j)
 {
-	auto context = m_deviceResources->GetD3DDeviceContext();
-	auto renderTargetView = m_deviceResources->GetRenderTargetView();
-	auto depthTargetView = m_deviceResources->GetDepthStencilView();
+	auto context = &m_RenderContext;
+	auto renderTargetView = m_BackBufferView;
+	auto depthTargetView = m_BackBufferDepthView;
+
+	if (m_environmentCamera.getCamera(j)->getReflection())
+		context->RSSetState(m_states->CullCounterClockwise());
+
+	m_StaticEnvironments[i][j]->setRenderTarget(context);
+	m_StaticEnvironments[i][j]->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
+
+	RenderBackgroundOnto(context, m_environmentCamera.getCamera(j), &m_Light, m_FaceVisible[j]);
 
+	context->OMSetRenderTargets(1, &renderTargetView, depthTargetView);
+	if (m_environmentCamera.getCamera(j)->getReflection())
+		context->RSSetState(m_states->CullClockwise());
+}
+
+void Game::RenderStaticReflectionEnvironments()
+{
 	// Render specimens from each glass model's perspective, using each of our six environment cameras
 	for (int i = 0; i < m_GlassCount; i++)
 	{
-		m_environmentCamera.setPosition(m_GlassModelPositions[i]);
-		m_environmentCamera.Update();
+		// NB: Baked faces only need projecting, if that wasn't done as they were loaded
+		if (m_StaticBaked[i])
+		{
+			if (m_StaticReflectionProjections[i] && !m_StaticProjected[i])
+				RenderProjection(m_StaticReflectionEnvironments[i].data(), m_StaticReflectionProjections[i]);
+			continue;
+		}
+
+		Profiler::Scope objectScope(&m_Profiler, ("Glass object " + std::to_string(i)).c_str());
+
+		Vector3 position = GetGlassPosition(i);
+		PlaceEnvironmentCamera(position);
 
 		// Not a great fix, but better than replicating dynamic lighting!
-		m_Light.setPosition(m_GlassModelPositions[i].x, m_GlassModelPositions[i].y, m_GlassModelPositions[i].z);
+		m_Light.setPosition(position.x, position.y, position.z);
 
 		for (int j = 0; j < 6; j++)
 		{
-			for (int k = 0; k < m_GlassCount; k++)
-			{
-				if (i == k)
-					continue;
+			Profiler::Scope faceScope(&m_Profiler, ("Face " + std::to_string(j)).c_str());
+			RenderStaticReflectionFace(i, j);
+		}
+
+		if (m_StaticReflectionProjections[i])
+			RenderProjection(m_StaticReflectionEnvironments[i].data(), m_StaticReflectionProjections[i]);
+	}
+	m_Light.setPosition(m_Camera.getPosition().x, m_Camera.getPosition().y, m_Camera.getPosition().z);
+}
+
+void Game::RenderStaticReflectionFace(int i, int j)
+{
+	auto context = &m_RenderContext;
+	auto renderTargetView = m_BackBufferView;
+	auto depthTargetView = m_BackBufferDepthView;
+
+	if (m_environmentCamera.getCamera(j)->getReflection())
+		context->RSSetState(m_states->CullCounterClockwise());
+
+	// NB: Same viewpoint as m_StaticEnvironments, so copy its background instead of re-rendering it
+	m_StaticReflectionEnvironments[i][j]->copyFrom(context, m_StaticEnvironments[i][j]);
+	m_StaticReflectionEnvironments[i][j]->setRenderTarget(context);
+
+	// Draw PseudoGlass Models
+	for (int k = 0; k < m_GlassCount; k++)
+	{
+		if (i == k || !GetGlassVisible(j, k))
+			continue;
+
+		RenderGlassOverlayOnto(context, m_environmentCamera.getCamera(j), k, m_StaticEnvironments[i][j]->getShaderResourceView(), m_StaticLiquidEnvironments[i][j][k]->getShaderResourceView(), m_StaticLiquidAlphaEnvironments[i][j][k]->getShaderResourceView());
+	}
+
+	context->OMSetRenderTargets(1, &renderTargetView, depthTargetView);
+	if (m_environmentCamera.getCamera(j)->getReflection())
+		context->RSSetState(m_states->CullClockwise());
+}
+
+void Game::QueueStaticItems()
+{
+	// NB: Objects off screen have no coverage, so wait until everything on screen is done
+	for (int item = 0; item < (int)m_StaticItems.size(); item++)
+	{
+		int i = m_StaticItems[item].first, j = m_StaticItems[item].second;
+		float coverage = m_GlassModelDetails[i].getCoverage();
+		if (j == 6)
+		{
+			// A lone projection is cheap, and finishes its object
+			m_StaticQueue.setPriority(item, 3.0f*coverage);
+			continue;
+		}
+
+		// Reflections mostly show what is behind the camera, as seen from the object, so faces looking that way come first
+		Vector3 toCamera = m_Camera.getPosition()-GetGlassPosition(i);
+		toCamera.Normalize();
+		m_StaticQueue.setPriority(item, coverage*(2.0f+toCamera.Dot(m_environmentCamera.getCamera(j)->getForward())));
+	}
+}
+
+void Game::RenderStaticItems()
+{
+	QueueStaticItems();
+
+	m_StaticQueue.beginFrame();
+	for (int item = m_StaticQueue.next(); item != -1; item = m_StaticQueue.next())
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		RenderStaticItem(item);
+		m_StaticQueue.finish(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now()-start).count());
+	}
+}
+
+void Game::RenderStaticItem(int item)
+{
+	int i = m_StaticItems[item].first, j = m_StaticItems[item].second;
+	Profiler::Scope objectScope(&m_Profiler, ("Glass object " + std::to_string(i)).c_str());
+
+	if (j < 6)
+	{
+		Profiler::Scope faceScope(&m_Profiler, ("Face " + std::to_string(j)).c_str());
+
+		Vector3 position = GetGlassPosition(i);
+		PlaceEnvironmentCamera(position);
+
+		// Not a great fix, but better than replicating dynamic lighting!
+		m_Light.setPosition(position.x, position.y, position.z);
+
+		RenderStaticSpecimenFace(i, j);
+		RenderStaticLiquidFace(i, j);
+		RenderStaticEnvironmentFace(i, j);
+		RenderStaticReflectionFace(i, j);
+		m_StaticFaces[i] |= 1 << j;
+
+		m_Light.setPosition(m_Camera.getPosition().x, m_Camera.getPosition().y, m_Camera.getPosition().z);
+	}
+
+	// NB: Only objects with a projection are missing one
+	if ((m_StaticFaces[i] & StaticFacesDone) == StaticFacesDone && !(m_StaticFaces[i] & StaticProjectionDone))
+	{
+		RenderProjection(m_StaticReflectionEnvironments[i].data(), m_StaticReflectionProjections[i]);
+		m_StaticFaces[i] |= StaticProjectionDone;
+	}
+}
+
+bool Game::GetStaticComplete()
+{
+	// NB: Everything is done in the first frame unless progressive
+	return m_preRendered && m_StaticQueue.getComplete();
+}
 
-				if (m_environmentCamera.getCamera(j)->getReflection())
-					context->RSSetState(m_states->CullCounterClockwise());
 
-				m_StaticLiquidEnvironments[i][j][k]->setRenderTarget(context);
-				m_StaticLiquidEnvironments[i][j][k]->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
-				RenderLiquidsOnto(m_environmentCamera.getCamera(j), &m_Light, k, m_StaticSpecimenEnvironments[i][j][k]->getShaderResourceView());
+void Game::RenderDynamicSpecimenEnvironments(int i, int specimen, int specimenAlpha)
+{
+	PlaceEnvironmentCamera(m_Camera.getPosition());
+ 
+	// NB: Dynamic, due to player movement
+	std::vector<int> faces;
+	for (int j = 0; j < 6; j++)
+	{
+		if (!HasSpecimen(i) || !GetSpecimenVisible(j, i))
+		{
+			SkipEmptyFace(m_RenderGraph.getTexture(specimen, j));
+			SkipEmptyFace(m_RenderGraph.getTexture(specimenAlpha, j));
+			continue;
+		}
+
+		faces.push_back(j);
+	}
+
+	RenderFaces(faces, [=](RenderContext* context, int j) {
+		auto renderTargetView = m_BackBufferView;
+		auto depthTargetView = m_BackBufferDepthView;
+
+		RenderTexture* specimenTexture = m_RenderGraph.getTexture(specimen, j);
+		RenderTexture* specimenAlphaTexture = m_RenderGraph.getTexture(specimenAlpha, j);
+
+		if (m_environmentCamera.getCamera(j)->getReflection())
+			context->RSSetState(m_states->CullCounterClockwise());
+
+		specimenTexture->setRenderTarget(context);
+		specimenTexture->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
+		RenderSpecimensOnto(context, m_environmentCamera.getCamera(j), &m_Light, i);
+
+		specimenAlphaTexture->setRenderTarget(context);
+		specimenAlphaTexture->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
+		RenderSpecimenAlphasOnto(context, m_environmentCamera.getCamera(j), i, specimenAlphaTexture->getShaderResourceView());
+
+		context->OMSetRenderTargets(1, &renderTargetView, depthTargetView);
+		if (m_environmentCamera.getCamera(j)->getReflection())
+			context->RSSetState(m_states->CullClockwise());
+	});
+}
+
+void Game::RenderDynamicLiquidEnvironments(int i, int specimen, int specimenAlpha)
+{
+	PlaceEnvironmentCamera(m_Camera.getPosition());
+
+	// NB: Dynamic, due to player movement
+	std::vector<int> faces;
+	for (int j = 0; j < 6; j++)
+	{
+		if (!GetGlassVisible(j, i))
+		{
+			SkipEmptyFace(m_DynamicLiquidEnvironments[i][j]);
+			SkipEmptyFace(m_DynamicLiquidAlphaEnvironments[i][j]);
+			continue;
+		}
+
+		faces.push_back(j);
+	}
+
+	RenderFaces(faces, [=](RenderContext* context, int j) {
+		auto renderTargetView = m_BackBufferView;
+		auto depthTargetView = m_BackBufferDepthView;
+
+		if (m_environmentCamera.getCamera(j)->getReflection())
+			context->RSSetState(m_states->CullCounterClockwise());
+
+		m_DynamicLiquidEnvironments[i][j]->setRenderTarget(context);
+		m_DynamicLiquidEnvironments[i][j]->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
+		RenderLiquidsOnto(context, m_environmentCamera.getCamera(j), &m_Light, i, m_RenderGraph.getTexture(specimen, j)->getShaderResourceView());
+
+		m_DynamicLiquidAlphaEnvironments[i][j]->setRenderTarget(context);
+		m_DynamicLiquidAlphaEnvironments[i][j]->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
+		RenderLiquidAlphasOnto(context, m_environmentCamera.getCamera(j), i, m_RenderGraph.getTexture(specimenAlpha, j)->getShaderResourceView());
+
+		context->OMSetRenderTargets(1, &renderTargetView, depthTargetView);
+		if (m_environmentCamera.getCamera(j)->getReflection())
+			context->RSSetState(m_states->CullClockwise());
+	});
+}
+
+
+void Game::RenderDynamicEnvironment()
+{
+	auto context = &m_RenderContext;
+	auto renderTargetView = m_BackBufferView;
+	auto depthTargetView = m_BackBufferDepthView;
 
-				m_StaticLiquidAlphaEnvironments[i][j][k]->setRenderTarget(context);
-				m_StaticLiquidAlphaEnvironments[i][j][k]->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
-				RenderLiquidAlphasOnto(m_environmentCamera.getCamera(j), k, m_StaticSpecimenAlphaEnvironments[i][j][k]->getShaderResourceView());
+	PlaceEnvironmentCamera(m_Camera.getPosition());
+
+	for (int i = 0; i < 6; i++)
+	{
+		Profiler::Scope faceScope(&m_Profiler, ("Face " + std::to_string(i)).c_str());
+
+		if (m_environmentCamera.getCamera(i)->getReflection())
+			context->RSSetState(m_states->CullCounterClockwise());
+
+		m_DynamicEnvironment[i]->setRenderTarget(context);
+		m_DynamicEnvironment[i]->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
+
+		// NB: These double as this frame's full-resolution shared backgrounds
+		int draws = RenderBackgroundOnto(context, m_environmentCamera.getCamera(i), &m_Light, m_FaceVisible[i]);
+		m_SharedCapture.store(i, m_DynamicEnvironment[i], draws);
+
+		context->OMSetRenderTargets(1, &renderTargetView, depthTargetView);
+		if (m_environmentCamera.getCamera(i)->getReflection())
+			context->RSSetState(m_states->CullClockwise());
+	}
+}
+
+void Game::RenderDynamicExternalEnvironments(int i)
+{
+	auto immediate = &m_RenderContext;
+	auto renderTargetView = m_BackBufferView;
+	auto depthTargetView = m_BackBufferDepthView;
+
+	PlaceEnvironmentCamera(m_Camera.getPosition());
+
+	// Start from each face's shared background, rather than re-rendering the skybox and basic models
+	// NB: Found up front, as the first glass object to need one renders it for everyone else
+	RenderTexture* backgrounds[6];
+	std::vector<int> faces;
+	for (int j = 0; j < 6; j++)
+	{
+		if (m_environmentCamera.getCamera(j)->getReflection())
+			immediate->RSSetState(m_states->CullCounterClockwise());
+
+		backgrounds[j] = FindSharedBackground(j, m_GlassModelDetails[i].getWidth(), m_GlassModelDetails[i].getHeight());
+		faces.push_back(j);
+
+		if (m_environmentCamera.getCamera(j)->getReflection())
+			immediate->RSSetState(m_states->CullClockwise());
+	}
+	immediate->OMSetRenderTargets(1, &renderTargetView, depthTargetView);
+
+	RenderFaces(faces, [=](RenderContext* context, int j) {
+		if (m_environmentCamera.getCamera(j)->getReflection())
+			context->RSSetState(m_states->CullCounterClockwise());
+
+		m_DynamicExternalEnvironments[i][j]->copyFrom(context, backgrounds[j]);
+		m_DynamicExternalEnvironments[i][j]->setRenderTarget(context);
+
+		// Draw PseudoGlass Models
+		for (int k = 0; k < m_GlassCount; k++)
+		{
+			if (i == k || !GetGlassVisible(j, k))
+				continue;
+
+			RenderGlassOverlayOnto(context, m_environmentCamera.getCamera(j), k, m_DynamicEnvironment[j]->getShaderResourceView(), m_DynamicLiquidEnvironments[k][j]->getShaderResourceView(), m_DynamicLiquidAlphaEnvironments[k][j]->getShaderResourceView());
+		}
+
+		context->OMSetRenderTargets(1, &renderTargetView, depthTargetView);
+		if (m_environmentCamera.getCamera(j)->getReflection())
+			context->RSSetState(m_states->CullClockwise());
+	});
+
+	if (m_DynamicExternalProjections[i])
+		RenderProjection(m_DynamicExternalEnvironments[i].data(), m_DynamicExternalProjections[i]);
+}
+
+RenderTexture* Game::FindSharedBackground(int face, int width, int height)
+{
+	RenderTexture* background = m_SharedCapture.find(face, width, height);
+	if (background)
+	{
+		m_SharedCapture.recordReuse(background);
+		return background;
+	}
+
+	// First capture at this resolution this frame, so render it once for everyone else
+	auto context = &m_RenderContext;
+
+	background = m_SharedCapture.create(face, width, height);
+	background->setRenderTarget(context);
+	background->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
+	m_SharedCapture.setDraws(background, RenderBackgroundOnto(context, m_environmentCamera.getCamera(face), &m_Light, m_FaceVisible[face]));
+
+	return background;
+}
+
+void Game::RenderFaces(const std::vector<int>& faces, const std::function<void(RenderContext*, int)>& renderFace)
+{
+	if (!m_ParallelRecording)
+	{
+		for (int k = 0; k < (int)faces.size(); k++)
+		{
+			Profiler::Scope scope(&m_Profiler, ("Face " + std::to_string(faces[k])).c_str());
+			renderFace(&m_RenderContext, faces[k]);
+		}
+
+		return;
+	}
+
+	// NB: Each list starts from nothing, so is first given the state a face drawn in sequence would have inherited
+	{
+		Profiler::Scope scope(&m_Profiler, "Record faces");
+		m_CommandListRecorder.Record((int)faces.size(), [&](RenderContext* context, int list) {
+			Profiler::Scope scope(&m_Profiler, ("Face " + std::to_string(faces[list])).c_str(), false);
+			BindFrameState(context);
+			renderFace(context, faces[list]);
+		});
+	}
+
+	Profiler::Scope scope(&m_Profiler, "Submit faces");
+	m_CommandListRecorder.Submit(&m_RenderContext);
+	BindFrameState(&m_RenderContext);
+
+	// NB: Deferred lists never pass through the immediate context, so are counted as recorded
+	if (m_DeferredRecording)
+	{
+		int states = 0;
+		for (int i = RenderContext::InputLayout; i <= RenderContext::RenderTargets; i++)
+			states += m_CommandListRecorder.getBoundCount((RenderContext::Call)i);
+
+		m_Hud.add(PerformanceHud::DrawCalls, m_CommandListRecorder.getBoundCount(RenderContext::Draws));
+		m_Hud.add(PerformanceHud::StateChanges, states);
+		m_Hud.add(PerformanceHud::TargetSwitches, m_CommandListRecorder.getBoundCount(RenderContext::RenderTargets));
+		m_Hud.add(PerformanceHud::ConstantBytes, m_CommandListRecorder.getMappedBytes());
+	}
+}
+
+void Game::BindFrameState(RenderContext* context)
+{
+	auto renderTargetView = m_BackBufferView;
+	auto depthTargetView = m_BackBufferDepthView;
+
+	context->OMSetBlendState(m_states->Opaque(), nullptr, 0xFFFFFFFF);
+	context->OMSetDepthStencilState(m_states->DepthDefault(), 0);
+	context->RSSetState(m_states->CullClockwise());
+	context->OMSetRenderTargets(1, &renderTargetView, depthTargetView);
+	context->RSSetViewports(1, &m_ScreenViewport);
+}
+
+void Game::FinishBenchmark()
+{
+	m_Benchmark.saveFrames(m_BenchmarkOutput + "_frames.csv");
+	m_Benchmark.saveSummary(m_BenchmarkOutput + ".json");
+	OutputDebugStringA(m_Benchmark.getSummary().c_str());
+
+	m_Benchmarking = false;
+	ExitGame();
+}
+
+bool Game::verifyHeadless(int frames, std::string& report)
+{
+	// NB: On the heap, as a game holds a great deal
+	auto game = std::make_unique<Game>();
+	game->InitializeHeadless(1280, 720);
+
+	RenderDevice& device = game->m_RenderDevice;
+	bool passed = frames >= 4;
+	int firstScheduled = 0;
+	int created[RenderDevice::ResourceCount] = {};
+	size_t allocated = 0;
+	char line[256];
+	for (int frame = 0; frame < frames; frame++)
+	{
+		int begun = game->m_RenderGraphBackend.getPassCount();
+		game->m_NullRenderContextBackend.Reset();
+		game->Tick();
+
+		// Every pass the graph scheduled was run, and every draw submitted went through the render context
+		int scheduled = game->m_RenderGraph.getScheduledPassCount();
+		int ran = game->m_RenderGraphBackend.getPassCount()-begun;
+		int draws = game->m_NullRenderContextBackend.getDrawCount();
+		int counted = game->m_RenderContext.getBoundCount(RenderContext::Draws);
+		passed = passed && ran == scheduled && draws > 0 && draws == counted;
+
+		// The static passes run on the first frame alone
+		if (frame == 0)
+			firstScheduled = scheduled;
+		else if (frame == 1)
+			passed = passed && scheduled < firstScheduled;
+
+		// Nothing is created from halfway on, as the pool and the shared captures have settled by then
+		bool settled = true;
+		for (int i = 0; i < RenderDevice::ResourceCount; i++)
+		{
+			settled = settled && device.getCreatedCount((RenderDevice::Resource)i) == created[i];
+			created[i] = device.getCreatedCount((RenderDevice::Resource)i);
+		}
+		settled = settled && device.getAllocatedBytes() == allocated;
+		allocated = device.getAllocatedBytes();
+		if (frame > frames/2)
+			passed = passed && settled;
+
+		snprintf(line, sizeof(line), "  Frame %d: %d of %d scheduled passes run, %d draws submitted (%d counted), %.1fMB allocated%s\n", frame, ran, scheduled, draws, counted, allocated/(1024.0*1024.0), (settled) ? "" : ", some of it new");
+		report += line;
+	}
+
+	return passed;
+}
+
+bool Game::compareShadowing(int frames, std::string& report)
+{
+	// NB: Identical runs but for the shadow, so any difference in what reaches the backend is what it eliminated.
+	// That is every call it skipped, and more besides: viewport queries it answered, and constant slots it narrowed a range past
+	std::vector<int> calls[2], draws[2], skipped[2];
+	for (int run = 0; run < 2; run++)
+	{
+		auto game = std::make_unique<Game>();
+		game->InitializeHeadless(1280, 720);
+		game->m_RenderContext.setShadowing(run == 0);
+		game->m_NullRenderContextBackend.setLogging(true);
+		for (int frame = 0; frame < frames; frame++)
+		{
+			game->m_NullRenderContextBackend.Reset();
+			game->Tick();
+			calls[run].push_back((int)game->m_NullRenderContextBackend.getLog().size());
+			draws[run].push_back(game->m_NullRenderContextBackend.getDrawCount());
+			skipped[run].push_back(game->m_RenderContext.getSkippedCount());
+		}
+	}
+
+	bool passed = frames > 0;
+	char line[256];
+	for (int frame = 0; frame < frames; frame++)
+	{
+		int eliminated = calls[1][frame]-calls[0][frame];
+		passed = passed && draws[0][frame] == draws[1][frame] && skipped[1][frame] == 0 && skipped[0][frame] > 0 && eliminated >= skipped[0][frame];
+
+		snprintf(line, sizeof(line), "  Frame %d: %d calls reach the backend unshadowed, %d shadowed (%d eliminated, %.1f%%; %d reported skipped), %d draws\n", frame, calls[1][frame], calls[0][frame], eliminated, 100.0*eliminated/std::max(calls[1][frame], 1), skipped[0][frame], draws[0][frame]);
+		report += line;
+	}
+
+	return passed;
+}
+
+bool Game::compareProjections(int frames, std::string& report)
+{
+	// NB: Identical runs but for the layout, so any difference in draws is what resampling into one target costs
+	const char* modes[3] = { "cube", "octahedral", "paraboloid" };
+	std::vector<int> draws[3], projections[3];
+	for (int mode = 0; mode < 3; mode++)
+	{
+		auto game = std::make_unique<Game>();
+		game->SetProjection(modes[mode]);
+		game->InitializeHeadless(1280, 720);
+		for (int frame = 0; frame < frames; frame++)
+		{
+			game->m_NullRenderContextBackend.Reset();
+			game->Tick();
+			draws[mode].push_back(game->m_NullRenderContextBackend.getDrawCount());
+			projections[mode].push_back(game->m_ProjectionCount);
+		}
+	}
+
+	bool passed = frames > 0;
+	char line[256];
+	for (int frame = 0; frame < frames; frame++)
+	{
+		snprintf(line, sizeof(line), "  Frame %d: %d draws as cubes, %d octahedral (%d projecting), %d paraboloid (%d projecting)\n", frame, draws[0][frame], draws[1][frame], projections[1][frame], draws[2][frame], projections[2][frame]);
+		report += line;
+
+		passed = passed && projections[0][frame] == 0;
+		for (int mode = 1; mode < 3; mode++)
+			passed = passed && draws[mode][frame] == draws[0][frame]+projections[mode][frame] && (frame > 0 || projections[mode][frame] > 0);
+	}
+
+	return passed;
+}
+
+void Game::BakeEnvironments()
+{
+	// Everything the static passes sample, as the first frame left it
+	SoftwareRenderer::Texture sky[6], specimen, specimenNM, brine, glass;
+	std::vector<SoftwareRenderer::Texture> materials(m_Scene.getMaterialCount()), materialNMs(m_Scene.getMaterialCount());
+	const SoftwareRenderer::Texture* skyFaces[6];
+	bool read = ReadTexture(m_DemoRenderPass->getShaderResourceView(), specimen) && ReadTexture(m_DemoNMRenderPass->getShaderResourceView(), specimenNM);
+	read = read && ReadTexture(m_brineTexture, brine) && ReadTexture(m_glassTexture, glass);
+	for (int j = 0; j < 6; j++)
+	{
+		read = read && ReadTexture(m_SkyboxRenderPass[j]->getShaderResourceView(), sky[j]);
+		skyFaces[j] = &sky[j];
+	}
+	for (int i = 0; i < m_Scene.getMaterialCount(); i++)
+		read = read && ReadTexture((*m_MaterialTextures[i])->getShaderResourceView(), materials[i]) && ReadTexture((*m_MaterialNMTextures[i])->getShaderResourceView(), materialNMs[i]);
+
+	m_Baking = false;
+	if (!read)
+	{
+		OutputDebugStringA("Baking failed: the scene's textures couldn't be read back\n");
+		ExitGame();
+		return;
+	}
+
+	EnvironmentBaker baker;
+	baker.setThreadCount(std::max(1, (int)std::thread::hardware_concurrency()));
+	baker.setSky(skyFaces);
+	Vector4 ambient = m_Light.getAmbientColour(), diffuse = m_Light.getDiffuseColour();
+	baker.setLighting({ { ambient.x, ambient.y, ambient.z, ambient.w }, { diffuse.x, diffuse.y, diffuse.z, diffuse.w }, { 0.0f, 0.0f, 0.0f }, m_Light.getStrength() });
+
+	// Each model's mesh is added once, however many objects share it
+	std::vector<ModelClass*> models;
+	auto findMesh = [&](ModelClass* model) {
+		int mesh = (int)(std::find(models.begin(), models.end(), model)-models.begin());
+		if (mesh == models.size())
+		{
+			std::vector<float> vertices;
+			model->GetVertices(vertices);
+			models.push_back(model);
+			baker.addMesh(vertices);
+		}
+		return mesh;
+	};
+
+	for (int i = 0; i < m_BasicCount; i++)
+	{
+		int material = m_Scene.getBasicMaterial(i);
+		EnvironmentBaker::Basic basic = { findMesh(m_BasicModels[i]), {}, &materials[material], &materialNMs[material] };
+		std::copy(&GetBasicTransform(i)->_11, &GetBasicTransform(i)->_11+16, basic.world);
+		baker.addBasic(basic);
+	}
+
+	// NB: Glass is traced as the sphere its transform makes of the unit sphere, as scene.txt's jars are
+	for (int i = 0; i < m_GlassCount; i++)
+	{
+		Matrix liquidWorld = m_Animations.get(m_LiquidAnimations[i]), specimenWorld = m_Animations.get(m_SpecimenAnimations[i]);
+		EnvironmentBaker::Glass object = {};
+		std::copy(&GetGlassTransform(i)->_11, &GetGlassTransform(i)->_11+16, object.world);
+		object.refractiveIndex = m_Scene.getGlassRefractiveIndex(i);
+		object.opacity = m_Scene.getGlassOpacity(i);
+		object.texture = &glass;
+		std::copy(&liquidWorld._11, &liquidWorld._11+16, object.liquidWorld);
+		object.liquidRefractiveIndex = 1.34f;	// Brine; scenes only give the glass's
+		object.liquidOpacity = m_Scene.getLiquidOpacity(i);
+		object.liquidTexture = &brine;
+		object.specimen = (HasSpecimen(i)) ? findMesh(&m_Cube) : -1;
+		std::copy(&specimenWorld._11, &specimenWorld._11+16, object.specimenWorld);
+		object.specimenTexture = &specimen;
+		object.specimenNormalMap = &specimenNM;
+		baker.addGlass(object);
+	}
+	baker.Build();
+
+	char line[256];
+	std::string report = "Static environments baked, six " + std::to_string(m_BakeSize) + "x" + std::to_string(m_BakeSize) + " faces for each of the background and reflection, on " + std::to_string(std::thread::hardware_concurrency()) + " hardware thread(s):\n";
+	size_t totalBytes = 0;
+	for (int i = 0; i < m_GlassCount; i++)
+	{
+		EnvironmentBaker::Capture capture;
+		auto start = std::chrono::high_resolution_clock::now();
+		baker.Bake(i, m_BakeSize, capture);
+		auto end = std::chrono::high_resolution_clock::now();
+
+		std::string filename = GetBakeFilename(i);
+		bool saved = EnvironmentBaker::save(filename, capture);
+		totalBytes += EnvironmentBaker::getBytes(capture);
+		snprintf(line, sizeof(line), "  Glass object %d: %8.1fms, %6.1fMB, %s %s\n", i, std::chrono::duration<double, std::milli>(end-start).count(), EnvironmentBaker::getBytes(capture)/(1024.0*1024.0), (saved) ? "written to" : "couldn't be written to", filename.c_str());
+		report += line;
+	}
+	snprintf(line, sizeof(line), "  In all %.1fMB, against %.1fMB rendering them takes\n", totalBytes/(1024.0*1024.0), m_StaticBytes/(1024.0*1024.0));
+	report += line;
+
+	OutputDebugStringA(report.c_str());
+	FILE* file = fopen("baked_environments.txt", "w");
+	if (file)
+	{
+		fputs(report.c_str(), file);
+		fclose(file);
+	}
+
+	ExitGame();
+}
+
+void Game::CompareReference()
+{
+	// NB: Nothing was loaded in place of the static passes (see SetReference), so the first glass object's background faces are the GPU's own
+	m_Referencing = false;
+	SoftwareRenderer::Texture sky[6];
+	std::vector<SoftwareRenderer::Texture> materials(m_Scene.getMaterialCount()), materialNMs(m_Scene.getMaterialCount());
+	bool read = m_GlassCount > 0;
+	for (int j = 0; j < 6; j++)
+		read = read && ReadTexture(m_SkyboxRenderPass[j]->getShaderResourceView(), sky[j]);
+	for (int i = 0; i < m_Scene.getMaterialCount(); i++)
+		read = read && ReadTexture((*m_MaterialTextures[i])->getShaderResourceView(), materials[i]) && ReadTexture((*m_MaterialNMTextures[i])->getShaderResourceView(), materialNMs[i]);
+	if (!read)
+	{
+		OutputDebugStringA("Reference comparison failed: the scene's textures couldn't be read back\n");
+		ExitGame();
+		return;
+	}
+
+	// Drawn as RenderStaticEnvironmentFace draws them: the skybox, then every basic model, lit from the capture's centre
+	Vector3 position = GetGlassPosition(0);
+	PlaceEnvironmentCamera(position);
+	Vector4 ambient = m_Light.getAmbientColour(), diffuse = m_Light.getDiffuseColour();
+	SoftwareRenderer::Lighting lighting = { { ambient.x, ambient.y, ambient.z, ambient.w }, { diffuse.x, diffuse.y, diffuse.z, diffuse.w }, { position.x, position.y, position.z }, m_Light.getStrength() };
+
+	std::vector<std::vector<float>> meshes(m_BasicCount);
+	for (int i = 0; i < m_BasicCount; i++)
+		m_BasicModels[i]->GetVertices(meshes[i]);
+	std::vector<float> cube;
+	m_Cube.GetVertices(cube);
+
+	SoftwareRenderer renderer;
+	renderer.setThreadCount(std::max(1, (int)std::thread::hardware_concurrency()));
+	const float clear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	char line[256];
+	std::string report = "Glass object 0's static background, the GPU's faces against the software renderer's:\n";
+	for (int j = 0; j < 6; j++)
+	{
+		Camera* camera = m_environmentCamera.getCamera(j);
+		SoftwareRenderer::Texture gpu, software;
+		if (!ReadTexture(m_StaticEnvironments[0][j]->getShaderResourceView(), gpu))
+		{
+			report += "  Face " + std::to_string(j) + " couldn't be read back\n";
+			continue;
+		}
+
+		// NB: Reflected faces come out mirrored, so cull the other way
+		bool reflection = camera->getReflection();
+		SoftwareRenderer::Material skybox = {}, lit = {};
+		skybox.shading = SoftwareRenderer::Skybox;
+		skybox.cull = (reflection) ? SoftwareRenderer::CullClockwise : SoftwareRenderer::CullCounterClockwise;
+		for (int k = 0; k < 6; k++)
+			skybox.textures[k] = &sky[k];
+		lit.shading = SoftwareRenderer::Light;
+		lit.cull = (reflection) ? SoftwareRenderer::CullCounterClockwise : SoftwareRenderer::CullClockwise;
+		lit.depthTest = true;
+
+		Matrix view = camera->getCameraMatrix(), projection = camera->getPerspective(), skyboxWorld = Matrix::CreateTranslation(camera->getPosition());
+		Vector3 eye = camera->getPosition();
+		float cameraPosition[3] = { eye.x, eye.y, eye.z };
+		SoftwareRenderer::makeTexture(gpu.width, gpu.height, clear, software);
+		renderer.BeginPass(&software, &view._11, &projection._11, cameraPosition, clear);
+		renderer.Draw(cube.data(), (int)cube.size()/SoftwareRenderer::VertexFloats, &skyboxWorld._11, skybox, lighting);
+		for (int i = 0; i < m_BasicCount; i++)
+		{
+			int material = m_Scene.getBasicMaterial(i);
+			lit.textures[0] = &materials[material];
+			lit.textures[1] = &materialNMs[material];
+			renderer.Draw(meshes[i].data(), (int)meshes[i].size()/SoftwareRenderer::VertexFloats, &GetBasicTransform(i)->_11, lit, lighting);
+		}
+		renderer.EndPass();
+
+		std::string gpuFilename = "reference_gpu_" + std::to_string(j) + ".ppm", softwareFilename = "reference_software_" + std::to_string(j) + ".ppm";
+		bool saved = SoftwareRenderer::savePpm(gpu, gpuFilename) && SoftwareRenderer::savePpm(software, softwareFilename);
+		snprintf(line, sizeof(line), "  Face %d: %dx%d, PSNR %.1f dB, %s %s and %s\n", j, gpu.width, gpu.height, SoftwareRenderer::comparePsnr(gpu, software),
+			(saved) ? "written to" : "couldn't be written to", gpuFilename.c_str(), softwareFilename.c_str());
+		report += line;
+	}
+	m_Light.setPosition(m_Camera.getPosition().x, m_Camera.getPosition().y, m_Camera.getPosition().z);
+
+	OutputDebugStringA(report.c_str());
+	FILE* file = fopen("reference_comparison.txt", "w");
+	if (file)
+	{
+		fputs(report.c_str(), file);
+		fclose(file);
+	}
+
+	ExitGame();
+}
+
+bool Game::ReadTexture(ID3D11ShaderResourceView* view, SoftwareRenderer::Texture& texture)
+{
+	// NB: Copying and mapping bind nothing, so the render context's shadow stays true
+	RenderTexels texels;
+	return m_RenderDevice.ReadTexture(view, texels) && SoftwareRenderer::readTexels(texels.format, texels.data.data(), texels.rowPitch, texels.width, texels.height, texture);
+}
+
+std::string Game::GetBakeFilename(int i)
+{
+	return "baked_environment_" + std::to_string(i) + ".env";
+}
 
-				context->OMSetRenderTargets(1, &renderTargetView, depthTargetView);
-				if (m_environmentCamera.getCamera(j)->getReflection())
-					context->RSSetState(m_states->CullClockwise());
-			}
-		}
+uint64_t Game::GetStaticCacheKey()
+{
+	// The resolutions everything static is rendered at
+	int resolutions[4] = { 1280, 720, (int)m_EnvironmentMode, EnvironmentProjection::getTargetWidth(m_EnvironmentMode, 720) };
+	uint64_t key = StaticCache::hash(resolutions, sizeof(resolutions));
+
+	// The scene: what is drawn, with what, and where
+	for (int i = 0; i < m_Scene.getModelCount(); i++)
+		key = StaticCache::hashString(m_Scene.getModelName(i), key);
+	for (int i = 0; i < m_Scene.getMaterialCount(); i++)
+	{
+		const Scene::Material& material = m_Scene.getMaterial(i);
+		key = StaticCache::hashString(material.name+"|"+material.texture+"|"+material.normalMap, key);
 	}
-	m_Light.setPosition(m_Camera.getPosition().x, m_Camera.getPosition().y, m_Camera.getPosition().z);
+	for (int i = 0; i < m_Scene.getBasicCount(); i++)
+	{
+		int basic[3] = { m_Scene.getBasicTransform(i), m_Scene.getBasicModel(i), m_Scene.getBasicMaterial(i) };
+		key = StaticCache::hash(basic, sizeof(basic), key);
+	}
+	for (int i = 0; i < m_Scene.getGlassCount(); i++)
+	{
+		int glass[3] = { m_Scene.getGlassTransform(i), m_Scene.getGlassModel(i), m_Scene.getSpecimen(i) };
+		float materials[3] = { m_Scene.getGlassRefractiveIndex(i), m_Scene.getGlassOpacity(i), m_Scene.getLiquidOpacity(i) };
+		key = StaticCache::hash(materials, sizeof(materials), StaticCache::hash(glass, sizeof(glass), key));
+	}
+
+	SceneTransforms& transforms = m_Scene.getTransforms();
+	const float* components[8] = { transforms.getPositionX(), transforms.getPositionY(), transforms.getPositionZ(), transforms.getScale(), transforms.getRotationX(), transforms.getRotationY(), transforms.getRotationZ(), transforms.getRotationW() };
+	for (int i = 0; i < 8; i++)
+		key = StaticCache::hash(components[i], transforms.getCount()*sizeof(float), key);
+
+	// Every shader binary and texture the static passes read, and any captures baked offline
+	// NB: Lighting is set in code, so delete the cache after changing it
+	const char* files[] = {
+		"light_vs.cso", "light_instanced_vs.cso", "light_ps.cso", "skybox_vs.cso", "skybox_ps.cso", "specimen_vs.cso", "specimen_ps.cso",
+		"refraction_vs.cso", "refraction_ps.cso", "glass_vs.cso", "glass_ps.cso", "alpha_vs.cso", "alpha_ps.cso", "overlay_vs.cso", "overlay_ps.cso",
+		"projection_ps.cso", "colour_vs.cso", "skybox_pores.cso", "neutral.cso", "neutral_nm.cso", "pores.cso", "pores_nm.cso",
+		"spherical_pores.cso", "spherical_pores_nm.cso",
+		"Stylized_Stone_Floor_005_basecolor.dds", "EvilDrone_Diff.dds", "Stylized_Stone_Floor_005_normal.dds", "brine_texture.dds", "glass_texture.dds",
+	};
+	for (const char* file : files)
+		key = StaticCache::hashFile(file, key);
+	for (int i = 0; i < m_GlassCount; i++)
+		key = StaticCache::hashFile(GetBakeFilename(i), key);
 
-	RenderDynamicLiquidEnvironments();
+	return key;
 }
 
+RenderTexture* Game::CreateCachedTexture(int width, int height, const float* texels)
+{
+	RenderTexture* texture;
+	if (m_StaticCached)
+	{
+		// NB: The texels aren't needed once they're on the device
+		StaticCache::Texture& cached = m_StaticCache.getTexture((int)m_StaticCacheTextures.size());
+		texture = new RenderTexture(&m_RenderDevice, cached.width, cached.height, 1, 2, cached.texels.data());
+		std::vector<float>().swap(cached.texels);
+	}
+	else
+		texture = new RenderTexture(&m_RenderDevice, width, height, 1, 2, texels);
 
+	m_StaticCacheTextures.push_back(texture);
+	return texture;
+}
 
-void Game::RenderStaticEnvironments()
+std::string Game::SaveStaticCache()
 {
-	auto context = m_deviceResources->GetD3DDeviceContext();
-	auto renderTargetView = m_deviceResources->GetRenderTargetView();
-	auto depthTargetView = m_deviceResources->GetDepthStencilView();
+	auto start = std::chrono::high_resolution_clock::now();
 
-	// Render specimens from each glass model's perspective, using each of our six environment cameras
-	for (int i = 0; i < m_GlassCount; i++)
+	m_StaticCache.clear();
+	bool read = true;
+	for (int i = 0; read && i < (int)m_StaticCacheTextures.size(); i++)
 	{
-		m_environmentCamera.setPosition(m_GlassModelPositions[i]);
-		m_environmentCamera.Update();
-
-		// Not a great fix, but better than replicating dynamic lighting!
-		m_Light.setPosition(m_GlassModelPositions[i].x, m_GlassModelPositions[i].y, m_GlassModelPositions[i].z);
+		m_StaticCache.add(StaticCache::Texture());
+		read = ReadTexture(m_StaticCacheTextures[i]->getShaderResourceView(), m_StaticCache.getTexture(i));
+	}
 
-		for (int j = 0; j < 6; j++)
-		{
-			if (m_environmentCamera.getCamera(j)->getReflection())
-				context->RSSetState(m_states->CullCounterClockwise());
+	bool saved = read && m_StaticCache.save(GetStaticCacheFilename(), GetStaticCacheKey());
+	auto end = std::chrono::high_resolution_clock::now();
 
-			m_StaticEnvironments[i][j]->setRenderTarget(context);
-			m_StaticEnvironments[i][j]->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
+	char line[256];
+	if (saved)
+		snprintf(line, sizeof(line), "  %d static textures cached in %.1fms, %.1fMB packed to %.1fMB\n", m_StaticCache.getTextureCount(), std::chrono::duration<double, std::milli>(end-start).count(), m_StaticCache.getBytes()/(1024.0*1024.0), m_StaticCache.getFileBytes()/(1024.0*1024.0));
+	else
+		snprintf(line, sizeof(line), "  Static textures couldn't be %s, so will be rendered again next time\n", (read) ? "written" : "read back");
 
-			RenderSkyboxOnto(m_environmentCamera.getCamera(j));
+	// NB: Only the file was wanted
+	m_StaticCache.clear();
 
-			for (int k = 0; k < m_BasicCount; k++)
-				RenderBasicsOnto(m_environmentCamera.getCamera(j), &m_Light, k);
+	return line;
+}
 
-			context->OMSetRenderTargets(1, &renderTargetView, depthTargetView);
-			if (m_environmentCamera.getCamera(j)->getReflection())
-				context->RSSetState(m_states->CullClockwise());
-		}
-	}
-	m_Light.setPosition(m_Camera.getPosition().x, m_Camera.getPosition().y, m_Camera.getPosition().z);
+std::string Game::GetStaticCacheFilename()
+{
+	return "static_cache.bin";
 }
 
-void Game::RenderStaticReflectionEnvironments()
+void Game::ReportStartup()
 {
-	auto context = m_deviceResources->GetD3DDeviceContext();
-	auto renderTargetView = m_deviceResources->GetRenderTargetView();
-	auto depthTargetView = m_deviceResources->GetDepthStencilView();
+	double startup = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now()-m_StartupStart).count();
 
-	// Render specimens from each glass model's perspective, using each of our six environment cameras
-	for (int i = 0; i < m_GlassCount; i++)
+	char line[256];
+	std::string report;
+	if (!m_FirstFrameReported)
 	{
-		m_environmentCamera.setPosition(m_GlassModelPositions[i]);
-		m_environmentCamera.Update();
-
-		// Not a great fix, but better than replicating dynamic lighting!
-		m_Light.setPosition(m_GlassModelPositions[i].x, m_GlassModelPositions[i].y, m_GlassModelPositions[i].z);
-
-		for (int j = 0; j < 6; j++)
+		snprintf(line, sizeof(line), "Startup: %.1fms to the first frame, with a %s static cache%s; %.1fMB of static maps\n", startup, (m_StaticCached) ? "warm" : "cold", (m_StaticQueue.getComplete()) ? "" : ", leaving static faces for later frames", m_StaticBytes/(1024.0*1024.0));
+		report += line;
+		if (m_StaticCached)
 		{
-			if (m_environmentCamera.getCamera(j)->getReflection())
-				context->RSSetState(m_states->CullCounterClockwise());
+			snprintf(line, sizeof(line), "  %d static textures loaded from %.1fMB\n", (int)m_StaticCacheTextures.size(), m_StaticCache.getFileBytes()/(1024.0*1024.0));
+			report += line;
+		}
+		m_FirstFrameReported = true;
+	}
 
-			m_StaticReflectionEnvironments[i][j]->setRenderTarget(context);
-			m_StaticReflectionEnvironments[i][j]->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
+	if (GetStaticComplete())
+	{
+		snprintf(line, sizeof(line), "  %.1fms to full quality, %d frame(s) in\n", startup, (int)m_timer.GetFrameCount());
+		report += line;
 
-			RenderSkyboxOnto(m_environmentCamera.getCamera(j));
+		// NB: Only once every static map is done
+		if (!m_StaticCached)
+			report += SaveStaticCache();
+		m_StartupReported = true;
+	}
 
-			for (int k = 0; k < m_BasicCount; k++)
-				RenderBasicsOnto(m_environmentCamera.getCamera(j), &m_Light, k);
+	// NB: Appended, so cold and warm launches can be compared
+	if (report.empty())
+		return;
 
-			// Draw PseudoGlass Models
-			for (int k = 0; k < m_GlassCount; k++)
-			{
-				if (i == k)
-					continue;
+	OutputDebugStringA(report.c_str());
+	FILE* file = fopen("startup.txt", "a");
+	if (file)
+	{
+		fputs(report.c_str(), file);
+		fclose(file);
+	}
+}
 
-				RenderGlassOverlayOnto(m_environmentCamera.getCamera(j), k, m_StaticEnvironments[i][j]->getShaderResourceView(), m_StaticLiquidEnvironments[i][j][k]->getShaderResourceView(), m_StaticLiquidAlphaEnvironments[i][j][k]->getShaderResourceView());
-			}
+void Game::CountFrame()
+{
+	// NB: State changes are the binds that got past the shadow, render targets included
+	int states = 0;
+	for (int i = RenderContext::InputLayout; i <= RenderContext::RenderTargets; i++)
+		states += m_RenderContext.getBoundCount((RenderContext::Call)i);
+
+	m_Hud.add(PerformanceHud::DrawCalls, m_RenderContext.getBoundCount(RenderContext::Draws));
+	m_Hud.add(PerformanceHud::StateChanges, states);
+	m_Hud.add(PerformanceHud::TargetSwitches, m_RenderContext.getBoundCount(RenderContext::RenderTargets));
+	m_Hud.add(PerformanceHud::ConstantBytes, m_RenderContext.getMappedBytes());
+
+	// Every read past the first of each animation is a matrix build the table saved
+	m_Hud.add(PerformanceHud::MatricesReused, std::max(0, m_Animations.getReadCount()-m_Animations.getBuildCount()));
+
+	// What copying the shared backgrounds saved re-rendering
+	m_Hud.add(PerformanceHud::CapturesShared, m_SharedCapture.getReuseCount());
+	m_Hud.add(PerformanceHud::DrawsShared, m_SharedCapture.getDrawsSaved());
+	m_Hud.add(PerformanceHud::PixelsShared, (size_t)m_SharedCapture.getPixelsSaved());
+
+	// Pooled dynamic maps, plus the static maps (baked or not) and the single dynamic environment
+	size_t staticBytes = m_StaticBytes+6*RenderTexturePool::getTextureBytes(1280, 720);
+	m_Hud.set(PerformanceHud::EnvironmentBytes, m_RenderTexturePool.getAllocatedBytes()+staticBytes);
+}
 
-			context->OMSetRenderTargets(1, &renderTargetView, depthTargetView);
-			if (m_environmentCamera.getCamera(j)->getReflection())
-				context->RSSetState(m_states->CullClockwise());
-		}
-	}
-	m_Light.setPosition(m_Camera.getPosition().x, m_Camera.getPosition().y, m_Camera.getPosition().z);
+bool Game::HasSpecimen(int i)
+{
+	return m_Scene.getSpecimen(i);
 }
 
+bool Game::GetGlassVisible(int face, int i)
+{
+	// NB: Liquids sit inside their glass, so share its visibility
+	return m_FaceVisible[face][m_BasicCount+i];
+}
 
-void Game::RenderDynamicSpecimenEnvironments()
+bool Game::GetSpecimenVisible(int face, int i)
 {
-	auto context = m_deviceResources->GetD3DDeviceContext();
-	auto renderTargetView = m_deviceResources->GetRenderTargetView();
-	auto depthTargetView = m_deviceResources->GetDepthStencilView();
+	return m_FaceVisible[face][m_BasicCount+m_GlassCount+i];
+}
 
-	m_environmentCamera.setPosition(m_Camera.getPosition());
-	m_environmentCamera.Update();
- 
-	// NB: Dynamic, due to player movement
+void Game::BuildBvh()
+{
+	// NB: Specimens start out filling their jars; UpdateModels fits them to where they float
+	const float none[3] = { 0.0f, 0.0f, 0.0f };
+	m_Bvh.clear();
+	for (int i = 0; i < m_BasicCount+2*m_GlassCount; i++)
+		m_Bvh.add(none, none);
+
+	for (int i = 0; i < m_BasicCount; i++)
+		SetObjectBounds(i, m_BasicModels[i], *GetBasicTransform(i));
 	for (int i = 0; i < m_GlassCount; i++)
 	{
-		for (int j = 0; j < 6; j++)
-		{
-			if (m_environmentCamera.getCamera(j)->getReflection())
-				context->RSSetState(m_states->CullCounterClockwise());
+		SetObjectBounds(m_BasicCount+i, m_GlassModels[i], *GetGlassTransform(i));
+		SetObjectBounds(m_BasicCount+m_GlassCount+i, m_GlassModels[i], *GetGlassTransform(i));
+	}
 
-			m_DynamicSpecimenEnvironments[i][j]->setRenderTarget(context);
-			m_DynamicSpecimenEnvironments[i][j]->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
-			RenderSpecimensOnto(m_environmentCamera.getCamera(j), &m_Light, i);
+	m_Bvh.Build();
+	m_FaceVisibleStale = true;
+}
 
-			m_DynamicSpecimenAlphaEnvironments[i][j]->setRenderTarget(context);
-			m_DynamicSpecimenAlphaEnvironments[i][j]->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
-			RenderSpecimenAlphasOnto(m_environmentCamera.getCamera(j), i, m_DynamicSpecimenAlphaEnvironments[i][j]->getShaderResourceView());
+void Game::SetObjectBounds(int object, ModelClass* model, const Matrix& world)
+{
+	Vector3 modelMin = model->GetBoundsMin(), modelMax = model->GetBoundsMax();
+	float min[3], max[3];
+	SceneBvh::transformBounds(&modelMin.x, &modelMax.x, &world._11, min, max);
 
-			context->OMSetRenderTargets(1, &renderTargetView, depthTargetView);
-			if (m_environmentCamera.getCamera(j)->getReflection())
-				context->RSSetState(m_states->CullClockwise());
-		}
+	// A little slack covers rasterisation at the frustum's edge
+	for (int j = 0; j < 3; j++)
+	{
+		float slack = 0.005f*(max[j]-min[j]);
+		min[j] -= slack;
+		max[j] += slack;
 	}
+
+	m_Bvh.setBounds(object, min, max);
 }
 
-void Game::RenderDynamicLiquidEnvironments()
+void Game::CullObjects(Camera* camera, std::vector<unsigned char>& visible)
 {
-	auto context = m_deviceResources->GetD3DDeviceContext();
-	auto renderTargetView = m_deviceResources->GetRenderTargetView();
-	auto depthTargetView = m_deviceResources->GetDepthStencilView();
+	Matrix viewProjection = camera->getCameraMatrix()*camera->getPerspective();
+	m_Bvh.Cull(SceneBvh::makeFrustum(&viewProjection._11), visible);
+}
 
-	m_environmentCamera.setPosition(m_Camera.getPosition());
-	m_environmentCamera.Update();
+void Game::OccludeObjects(Camera* camera, std::vector<unsigned char>& visible, int width, int height)
+{
+	if (!m_OcclusionCulling)
+		return;
 
-	// NB: Dynamic, due to player movement
-	for (int i = 0; i < m_GlassCount; i++)
+	// NB: Only opaque spheres and cubes occlude; glass is seen through, and other models have no proxy yet
+	Matrix viewProjection = camera->getCameraMatrix()*camera->getPerspective();
+	m_Occlusion.Begin(&viewProjection._11, width, height);
+	for (int i = 0; i < m_BasicCount; i++)
 	{
-		for (int j = 0; j < 6; j++)
-		{
-			if (m_environmentCamera.getCamera(j)->getReflection())
-				context->RSSetState(m_states->CullCounterClockwise());
+		if (!visible[i])
+			continue;
 
-			m_DynamicLiquidEnvironments[i][j]->setRenderTarget(context);
-			m_DynamicLiquidEnvironments[i][j]->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
-			RenderLiquidsOnto(m_environmentCamera.getCamera(j), &m_Light, i, m_DynamicSpecimenEnvironments[i][j]->getShaderResourceView());
+		if (m_BasicModels[i] == &m_Sphere)
+			m_Occlusion.RenderOccluder(m_SphereOccluder.data(), (int)m_SphereOccluder.size()/9, &GetBasicTransform(i)->_11);
+		else if (m_BasicModels[i] == &m_Cube)
+			m_Occlusion.RenderOccluder(m_BoxOccluder.data(), (int)m_BoxOccluder.size()/9, &GetBasicTransform(i)->_11);
+	}
+	m_Occlusion.End();
 
-			m_DynamicLiquidAlphaEnvironments[i][j]->setRenderTarget(context);
-			m_DynamicLiquidAlphaEnvironments[i][j]->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
-			RenderLiquidAlphasOnto(m_environmentCamera.getCamera(j), i, m_DynamicSpecimenAlphaEnvironments[i][j]->getShaderResourceView());
+	// Occluders test against themselves too, but are never hidden by their own proxies
+	int occluded = 0;
+	for (int i = 0; i < (int)visible.size(); i++)
+	{
+		if (!visible[i])
+			continue;
 
-			context->OMSetRenderTargets(1, &renderTargetView, depthTargetView);
-			if (m_environmentCamera.getCamera(j)->getReflection())
-				context->RSSetState(m_states->CullClockwise());
+		float min[3], max[3];
+		m_Bvh.getBounds(i, min, max);
+		if (!m_Occlusion.TestBox(min, max))
+		{
+			visible[i] = 0;
+			occluded++;
 		}
 	}
-}
 
+	m_Hud.add(PerformanceHud::ObjectsOccluded, occluded);
+}
 
-void Game::RenderDynamicEnvironment()
+void Game::PlaceEnvironmentCamera(Vector3 position)
 {
-	auto context = m_deviceResources->GetD3DDeviceContext();
-	auto renderTargetView = m_deviceResources->GetRenderTargetView();
-	auto depthTargetView = m_deviceResources->GetDepthStencilView();
-
-	m_environmentCamera.setPosition(m_Camera.getPosition());
+	m_environmentCamera.setPosition(position);
 	m_environmentCamera.Update();
 
-	for (int i = 0; i < 6; i++)
+	// NB: Every dynamic capture is from the player's position, so most frames cull the faces once
+	if (!m_FaceVisibleStale && position == m_FaceVisiblePosition)
+		return;
+
+	Profiler::Scope scope(&m_Profiler, "Cull faces");
+	for (int j = 0; j < 6; j++)
 	{
-		if (m_environmentCamera.getCamera(i)->getReflection())
-			context->RSSetState(m_states->CullCounterClockwise());
+		CullObjects(m_environmentCamera.getCamera(j), m_FaceVisible[j]);
+		OccludeObjects(m_environmentCamera.getCamera(j), m_FaceVisible[j], 128, 128);
+	}
 
-		m_DynamicEnvironment[i]->setRenderTarget(context);
-		m_DynamicEnvironment[i]->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
+	m_FaceVisiblePosition = position;
+	m_FaceVisibleStale = false;
+}
+
+void Game::SkipEmptyFace(RenderTexture* face)
+{
+	m_SkippedFaceCount++;
 
-		RenderSkyboxOnto(m_environmentCamera.getCamera(i));
+	// Already blank from an earlier frame, so no need to bind or clear it at all
+	if (face->getConstant())
+		return;
 
-		for (int j = 0; j < m_BasicCount; j++)
-			RenderBasicsOnto(m_environmentCamera.getCamera(i), &m_Light, j);
+	auto context = &m_RenderContext;
+	auto renderTargetView = m_BackBufferView;
+	auto depthTargetView = m_BackBufferDepthView;
 
-		context->OMSetRenderTargets(1, &renderTargetView, depthTargetView);
-		if (m_environmentCamera.getCamera(i)->getReflection())
-			context->RSSetState(m_states->CullClockwise());
-	}
+	face->setRenderTarget(context);
+	face->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
+	face->setConstant(true);
+
+	context->OMSetRenderTargets(1, &renderTargetView, depthTargetView);
 }
 
-void Game::RenderDynamicExternalEnvironments()
+void Game::RenderDynamicAirToGlassEnvironments(int i, int airToGlass)
 {
-	auto context = m_deviceResources->GetD3DDeviceContext();
-	auto renderTargetView = m_deviceResources->GetRenderTargetView();
-	auto depthTargetView = m_deviceResources->GetDepthStencilView();
-
-	m_environmentCamera.setPosition(m_Camera.getPosition());
-	m_environmentCamera.Update();
+	PlaceEnvironmentCamera(m_Camera.getPosition());
 
-	for (int i = 0; i < m_GlassCount; i++)
+	std::vector<int> faces;
+	for (int j = 0; j < 6; j++)
 	{
-		for (int j = 0; j < 6; j++)
+		if (!GetGlassVisible(j, i))
 		{
-			if (m_environmentCamera.getCamera(j)->getReflection())
-				context->RSSetState(m_states->CullCounterClockwise());
-
-			m_DynamicExternalEnvironments[i][j]->setRenderTarget(context);
-			m_DynamicExternalEnvironments[i][j]->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
-
-			RenderSkyboxOnto(m_environmentCamera.getCamera(j));
+			SkipEmptyFace(m_RenderGraph.getTexture(airToGlass, j));
+			continue;
+		}
 
-			for (int k = 0; k < m_BasicCount; k++)
-				RenderBasicsOnto(m_environmentCamera.getCamera(j), &m_Light, k);
+		faces.push_back(j);
+	}
 
-			// Draw PseudoGlass Models
-			for (int k = 0; k < m_GlassCount; k++)
-			{
-				if (i == k)
-					continue;
+	RenderFaces(faces, [=](RenderContext* context, int j) {
+		auto renderTargetView = m_BackBufferView;
+		auto depthTargetView = m_BackBufferDepthView;
 
-				RenderGlassOverlayOnto(m_environmentCamera.getCamera(j), k, m_DynamicEnvironment[j]->getShaderResourceView(), m_DynamicLiquidEnvironments[k][j]->getShaderResourceView(), m_DynamicLiquidAlphaEnvironments[k][j]->getShaderResourceView());
-			}
+		RenderTexture* airToGlassTexture = m_RenderGraph.getTexture(airToGlass, j);
 
-			context->OMSetRenderTargets(1, &renderTargetView, depthTargetView);
-			if (m_environmentCamera.getCamera(j)->getReflection())
-				context->RSSetState(m_states->CullClockwise());
-		}
-	}
-}
+		if (m_environmentCamera.getCamera(j)->getReflection())
+			context->RSSetState(m_states->CullCounterClockwise());
 
+		airToGlassTexture->setRenderTarget(context);
+		airToGlassTexture->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
 
-void Game::RenderDynamicAirToGlassEnvironments()
-{
-	auto context = m_deviceResources->GetD3DDeviceContext();
-	auto renderTargetView = m_deviceResources->GetRenderTargetView();
-	auto depthTargetView = m_deviceResources->GetDepthStencilView();
+		// NB: No need to wrry about surroundings for high density to low density
+		/*RenderSkyboxOnto(context, m_environmentCamera.getCamera(j));
 
-	m_environmentCamera.setPosition(m_Camera.getPosition());
-	m_environmentCamera.Update();
+		for (int k = 0; k < m_BasicCount; k++)
+			RenderBasicsOnto(context, m_environmentCamera.getCamera(j), &m_Light, k);
 
-	for (int i = 0; i < m_GlassCount; i++)
-	{
-		for (int j = 0; j < 6; j++)
+		// Draw PseudoGlass Models
+		for (int k = 0; k < m_GlassCount; k++)
 		{
-			if (m_environmentCamera.getCamera(j)->getReflection())
-				context->RSSetState(m_states->CullCounterClockwise());
-
-			m_DynamicAirToGlassEnvironments[i][j]->setRenderTarget(context);
-			m_DynamicAirToGlassEnvironments[i][j]->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
+			if (i == k)
+				continue;
 
-			// NB: No need to wrry about surroundings for high density to low density
-			/*RenderSkyboxOnto(m_environmentCamera.getCamera(j));
+			RenderPseudoGlassOnto(m_environmentCamera.getCamera(j), &m_Light, k, m_DynamicLiquidEnvironments[k][j]->getShaderResourceView(), m_DynamicLiquidAlphaEnvironments[k][j]->getShaderResourceView());
+		}*/
 
-			for (int k = 0; k < m_BasicCount; k++)
-				RenderBasicsOnto(m_environmentCamera.getCamera(j), &m_Light, k);
+		// Draw refraction
+		RenderRefractionOnto(context, m_environmentCamera.getCamera(j), &m_Light, i);
 
-			// Draw PseudoGlass Models
-			for (int k = 0; k < m_GlassCount; k++)
-			{
-				if (i == k)
-					continue;
-
-				RenderPseudoGlassOnto(m_environmentCamera.getCamera(j), &m_Light, k, m_DynamicLiquidEnvironments[k][j]->getShaderResourceView(), m_DynamicLiquidAlphaEnvironments[k][j]->getShaderResourceView());
-			}*/
+		context->OMSetRenderTargets(1, &renderTargetView, depthTargetView);
+		if (m_environmentCamera.getCamera(j)->getReflection())
+			context->RSSetState(m_states->CullClockwise());
+	});
+}
 
-			// Draw refraction
-			RenderRefractionOnto(m_environmentCamera.getCamera(j), &m_Light, i);
+void Game::RenderDynamicInternalEnvironments(int i, int airToGlass)
+{
+	PlaceEnvironmentCamera(m_Camera.getPosition());
 
-			context->OMSetRenderTargets(1, &renderTargetView, depthTargetView);
-			if (m_environmentCamera.getCamera(j)->getReflection())
-				context->RSSetState(m_states->CullClockwise());
+	std::vector<int> faces;
+	for (int j = 0; j < 6; j++)
+	{
+		if (!GetGlassVisible(j, i))
+		{
+			SkipEmptyFace(m_DynamicInternalEnvironments[i][j]);
+			continue;
 		}
+
+		faces.push_back(j);
 	}
-}
 
-void Game::RenderDynamicInternalEnvironments()
-{
-	auto context = m_deviceResources->GetD3DDeviceContext();
-	auto renderTargetView = m_deviceResources->GetRenderTargetView();
-	auto depthTargetView = m_deviceResources->GetDepthStencilView();
+	RenderFaces(faces, [=](RenderContext* context, int j) {
+		auto renderTargetView = m_BackBufferView;
+		auto depthTargetView = m_BackBufferDepthView;
 
-	m_environmentCamera.setPosition(m_Camera.getPosition());
-	m_environmentCamera.Update();
+		if (m_environmentCamera.getCamera(j)->getReflection())
+			context->RSSetState(m_states->CullCounterClockwise());
 
-	for (int i = 0; i < m_GlassCount; i++)
-	{
-		for (int j = 0; j < 6; j++)
-		{
-			if (m_environmentCamera.getCamera(j)->getReflection())
-				context->RSSetState(m_states->CullCounterClockwise());
+		m_DynamicInternalEnvironments[i][j]->setRenderTarget(context);
+		m_DynamicInternalEnvironments[i][j]->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
 
-			m_DynamicInternalEnvironments[i][j]->setRenderTarget(context);
-			m_DynamicInternalEnvironments[i][j]->clearRenderTarget(context, 0.0f, 0.0f, 0.0f, 0.0f);
+		// NB: No need to wrry about surroundings for high density to low density
+		/*RenderSkyboxOnto(context, m_environmentCamera.getCamera(j));
 
-			// NB: No need to wrry about surroundings for high density to low density
-			/*RenderSkyboxOnto(m_environmentCamera.getCamera(j));
+		for (int k = 0; k < m_BasicCount; k++)
+			RenderBasicsOnto(context, m_environmentCamera.getCamera(j), &m_Light, k);
 
-			for (int k = 0; k < m_BasicCount; k++)
-				RenderBasicsOnto(m_environmentCamera.getCamera(j), &m_Light, k);
+		// Draw PseudoGlass Models
+		for (int k = 0; k < m_GlassCount; k++)
+		{
+			if (i == k)
+				continue;
 
-			// Draw PseudoGlass Models
-			for (int k = 0; k < m_GlassCount; k++)
-			{
-				if (i == k)
-					continue;
+			RenderPseudoGlassOnto(m_environmentCamera.getCamera(j), &m_Light, k, m_DynamicLiquidEnvironments[k][j]->getShaderResourceView(), m_DynamicLiquidAlphaEnvironments[k][j]->getShaderResourceView());
+		}*/
 
-				RenderPseudoGlassOnto(m_environmentCamera.getCamera(j), &m_Light, k, m_DynamicLiquidEnvironments[k][j]->getShaderResourceView(), m_DynamicLiquidAlphaEnvironments[k][j]->getShaderResourceView());
-			}*/
+		// Draw refraction
+		RenderGlassOverlayOnto(context, m_environmentCamera.getCamera(j), i, m_RenderGraph.getTexture(airToGlass, j)->getShaderResourceView(), m_DynamicLiquidEnvironments[i][j]->getShaderResourceView(), m_DynamicLiquidAlphaEnvironments[i][j]->getShaderResourceView());
 
-			// Draw refraction
-			RenderGlassOverlayOnto(m_environmentCamera.getCamera(j), i, m_DynamicAirToGlassEnvironments[i][j]->getShaderResourceView(), m_DynamicLiquidEnvironments[i][j]->getShaderResourceView(), m_DynamicLiquidAlphaEnvironments[i][j]->getShaderResourceView());
+		context->OMSetRenderTargets(1, &renderTargetView, depthTargetView);
+		if (m_environmentCamera.getCamera(j)->getReflection())
+			context->RSSetState(m_states->CullClockwise());
+	});
 
-			context->OMSetRenderTargets(1, &renderTargetView, depthTargetView);
-			if (m_environmentCamera.getCamera(j)->getReflection())
-				context->RSSetState(m_states->CullClockwise());
-		}
-	}
+	if (m_DynamicInternalProjections[i])
+		RenderProjection(m_DynamicInternalEnvironments[i].data(), m_DynamicInternalProjections[i]);
 }
 
 
@@ -905,22 +2332,19 @@ void Game::RenderDynamicInternalEnvironments()
 // Helper method to clear the back buffers.
 void Game::Clear()
 {
-    m_deviceResources->PIXBeginEvent(L"Clear");
+    Profiler::Scope scope(&m_Profiler, "Clear");
 
     // Clear the views.
-    auto context = m_deviceResources->GetD3DDeviceContext();
-    auto renderTarget = m_deviceResources->GetRenderTargetView();
-    auto depthStencil = m_deviceResources->GetDepthStencilView();
+    auto context = &m_RenderContext;
+    auto renderTarget = m_BackBufferView;
+    auto depthStencil = m_BackBufferDepthView;
 
     context->ClearRenderTargetView(renderTarget, Colors::Black);
     context->ClearDepthStencilView(depthStencil, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
     context->OMSetRenderTargets(1, &renderTarget, depthStencil);
 
     // Set the viewport.
-    auto viewport = m_deviceResources->GetScreenViewport();
-    context->RSSetViewports(1, &viewport);
-
-    m_deviceResources->PIXEndEvent();
+    context->RSSetViewports(1, &m_ScreenViewport);
 }
 
 #pragma endregion
@@ -983,205 +2407,474 @@ void Game::GetDefaultSize(int& width, int& height) const
     width = 1280;
     height = 720;
 }
+
+bool Game::SetScene(const std::string& filename)
+{
+	return m_Scene.load(filename);
+}
+
+bool Game::SetBenchmark(const std::string& cameraPath, int warmupFrames, int measuredFrames, const std::string& output)
+{
+	if (!m_CameraPath.load(cameraPath))
+		return false;
+
+	m_timer.SetFixedTimeStep(true);
+	m_timer.SetTargetElapsedSeconds(1.0/60.0);
+	m_Benchmark.Initialise(&m_Profiler, warmupFrames, measuredFrames);
+	m_BenchmarkOutput = output;
+	m_Benchmarking = true;
+
+	return true;
+}
+
+bool Game::SetBake(int size)
+{
+	if (size <= 0)
+		return false;
+
+	m_BakeSize = size;
+	m_Baking = true;
+
+	return true;
+}
+
+void Game::SetReference()
+{
+	m_Referencing = true;
+}
+
+bool Game::SetProgressive(double budgetMilliseconds)
+{
+	if (budgetMilliseconds <= 0.0)
+		return false;
+
+	m_StaticQueue.setBudget(budgetMilliseconds);
+	m_Progressive = true;
+
+	return true;
+}
+
+bool Game::SetProjection(const std::string& name)
+{
+	if (name == "cube")
+		m_EnvironmentMode = EnvironmentProjection::Cube;
+	else if (name == "octahedral")
+		m_EnvironmentMode = EnvironmentProjection::Octahedral;
+	else if (name == "paraboloid")
+		m_EnvironmentMode = EnvironmentProjection::DualParaboloid;
+	else
+		return false;
+
+	return true;
+}
 #pragma endregion
 
 #pragma region Direct3D Resources
 // These are the resources that depend on the device.
 void Game::CreateDeviceDependentResources()
 {
-    auto context = m_deviceResources->GetD3DDeviceContext();
-    auto device = m_deviceResources->GetD3DDevice();
-
-    m_states = std::make_unique<CommonStates>(device);
-    m_fxFactory = std::make_unique<EffectFactory>(device);
-    m_sprites = std::make_unique<SpriteBatch>(context);
-    m_font = std::make_unique<SpriteFont>(device, L"SegoeUI_18.spritefont");
-	m_batch = std::make_unique<PrimitiveBatch<VertexPositionColor>>(context);
-
-	// Models
-	m_Cube.InitializeModel(device, "cube.obj");
-	m_Sphere.InitializeModel(device, "Unit Sphere (High Poly).obj");
-	m_SpecimenJar1.InitializeModel(device, "Specimen Jar #1.obj");
-	m_Teapot.InitializeModel(device, "cube.obj");
-	m_DeathStar.InitializeModel(device, "death_star.obj");
-
-	m_BasicCount = 3;
-	m_GlassCount = 3;
-
-	m_BasicModelPositions[0] = Vector3(-2.0f,30.0f, 0.0f);
-	m_BasicModelPositions[1] = Vector3(0.0f, 0.0f, 0.0f);
-	m_BasicModelPositions[2] = Vector3(2.0f, 0.0f, 0.0f);
-	m_BasicModelPositions[3] = Vector3(2.0f, 0.0f, -2.0f);
-	m_BasicModelPositions[4] = Vector3(2.0f, 0.0f, -4.0f);
-
-	m_BasicModelTextures[0] = &m_NeutralRenderPass;
-	m_BasicModelTextures[1] = &m_DemoRenderPass;
-	m_BasicModelTextures[2] = &m_DemoRenderPass;
-	m_BasicModelTextures[3] = &m_DemoNMRenderPass;
-	m_BasicModelTextures[4] = &m_DemoNMRenderPass;
-
-	m_BasicModelNMTextures[0] = &m_DemoNMRenderPass;
-	m_BasicModelNMTextures[1] = &m_NeutralNMRenderPass;
-	m_BasicModelNMTextures[2] = &m_DemoNMRenderPass;
-	m_BasicModelNMTextures[3] = &m_DemoNMRenderPass;
-	m_BasicModelNMTextures[4] = &m_NeutralNMRenderPass;
-
-	m_BasicModels[0] = &m_Sphere;
-	m_BasicModelScales[0] = 1.15f;
-	m_BasicModelAxes[0] = Vector3(-1.0f, 1.0f, 1.0f);
-	m_BasicModelAngles[0] = XM_PI/12;
-	m_BasicModelPositions[0] = Vector3(0.0, -0.35, 0.0) + Vector3(3.1 * cos( -3*XM_PI / 8), 0.0f, 3.1 * sin(-3*XM_PI / 8));
-	m_BasicModelTextures[0] = &m_SphericalPoresRenderPass;
-	m_BasicModelNMTextures[0] = &m_SphericalPoresNMRenderPass;
-
-	m_BasicModels[1] = &m_Sphere;
-	m_BasicModelScales[1] = 0.75f;
-	m_BasicModelAxes[1] = Vector3(-1.0f, 1.0f, 0.0f);
-	m_BasicModelAngles[1] = XM_PI / 12;
-	m_BasicModelPositions[1] = Vector3(0.0, -0.75, 0.0) + Vector3(2.5 * cos(-XM_PI / 6), 0.0f, 2.5 * sin(-XM_PI / 6));
-	m_BasicModelTextures[1] = &m_SphericalPoresRenderPass;
-	m_BasicModelNMTextures[1] = &m_SphericalPoresNMRenderPass;
-
-	m_BasicModels[2] = &m_Sphere;
-	m_BasicModelScales[2] = 1.25f;
-	m_BasicModelAxes[2] = Vector3(0.0f, 1.0f, -1.0f);
-	m_BasicModelAngles[2] = XM_PI / 24;
-	m_BasicModelPositions[2] = Vector3(0.0, -0.25, 0.0) + Vector3(3.2 * cos(5 * XM_PI / 6), 0.0f, 3.2 * sin(5 * XM_PI / 6));
-	m_BasicModelTextures[2] = &m_SphericalPoresRenderPass;
-	m_BasicModelNMTextures[2] = &m_SphericalPoresNMRenderPass;
-
-	m_GlassModels[0] = &m_Sphere;
-	m_GlassModelScales[0] = 2.0f;
-	m_GlassModelAxes[0] = Vector3(0.0f, 1.0f, 0.0f);
-	m_GlassModelAngles[0] = 0.0f;
-	m_GlassModelPositions[0] = Vector3(0.0f, 0.5f, 0.0f);
-	m_GlassModelRefractiveIndex[0] = 1.33f;
-	m_GlassModelOpacity[0] = 0.01f;
-	m_GlassModelTextures[0] = &m_NeutralRenderPass;
-	m_GlassModelNMTextures[0] = &m_NeutralNMRenderPass;
-
-	m_LiquidOpacity[0] = 0.35;
-
-	m_GlassModels[1] = &m_Sphere;
-	m_GlassModelScales[1] = 0.75f;
-	m_GlassModelAxes[1] = Vector3(0.0f, 1.0f, 0.0f);
-	m_GlassModelAngles[1] = 0.0f;
-	m_GlassModelPositions[1] = Vector3(0.0, -0.75, 0.0)+Vector3(2.5*cos(11*XM_PI/18), 0.0f, 2.5*sin(11 * XM_PI / 18));
-	m_GlassModelRefractiveIndex[1] = 1.33f;
-	m_GlassModelOpacity[1] = 0.02f;
-	m_GlassModelTextures[1] = &m_NeutralRenderPass;
-	m_GlassModelNMTextures[1] = &m_NeutralNMRenderPass;
-
-	m_LiquidOpacity[1] = 0.5;
-
-	m_GlassModels[2] = &m_Sphere;
-	m_GlassModelScales[2] = 0.37f;
-	m_GlassModelAxes[2] = Vector3(1.0f, 1.0f, 0.0f);
-	m_GlassModelAngles[2] = 0.0f;
-	m_GlassModelPositions[2] = Vector3(0.0, 0.25, 0.0) + Vector3(2.37 * cos(49 * XM_PI / 72), 0.0f, 2.37 * sin(49 * XM_PI / 72));
-	m_GlassModelRefractiveIndex[2] = 1.50f;
-	m_GlassModelOpacity[2] = 0.01f;
-	m_GlassModelTextures[2] = &m_NeutralRenderPass;
-	m_GlassModelNMTextures[2] = &m_NeutralNMRenderPass;
-
-	m_LiquidOpacity[2] = 0.0;
-
-	for (int i = 0; i < m_BasicCount; i++)
+	// NB: Everything is created through the render device, which keeps count; headlessly, on null backends throughout
+	if (m_Headless)
+	{
+		m_RenderDevice.Initialise(&m_NullRenderDeviceBackend);
+	}
+	else
 	{
-		m_BasicModelAxes[i].Normalize();
-		m_BasicModelTransforms[i] = SimpleMath::Matrix::CreateScale(m_BasicModelScales[i])*SimpleMath::Matrix::CreateFromAxisAngle(m_BasicModelAxes[i], m_BasicModelAngles[i])*SimpleMath::Matrix::CreateTranslation(m_BasicModelPositions[i]);
+		auto context = m_deviceResources->GetD3DDeviceContext();
+		auto device = m_deviceResources->GetD3DDevice();
+		m_RenderDeviceBackend.Initialise(device, context, m_deviceResources->GetD3DDeviceContext1());
+		m_RenderContextBackend.Initialise(context, m_deviceResources->GetD3DDeviceContext1());
+		m_RenderContextBackend.setFont(device, L"SegoeUI_18.spritefont");
+		m_ProfilerBackend.Initialise(m_deviceResources.get());
+		m_RenderDevice.Initialise(&m_RenderDeviceBackend);
 	}
+	m_states = std::make_unique<RenderStates>(&m_RenderDevice);
 
-	for (int i = 0; i < m_GlassCount; i++)
+	// Models
+	m_Cube.InitializeModel(&m_RenderDevice, "cube.obj");
+	m_Sphere.InitializeModel(&m_RenderDevice, "Unit Sphere (High Poly).obj");
+	m_SpecimenJar1.InitializeModel(&m_RenderDevice, "Specimen Jar #1.obj");
+	m_Teapot.InitializeModel(&m_RenderDevice, "cube.obj");
+	m_DeathStar.InitializeModel(&m_RenderDevice, "death_star.obj");
+
+	// Occluder proxies; the sphere's is shrunk a little, so its corners stay inside the model's facets
+	Vector3 sphereMin = m_Sphere.GetBoundsMin(), sphereMax = m_Sphere.GetBoundsMax(), cubeMin = m_Cube.GetBoundsMin(), cubeMax = m_Cube.GetBoundsMax();
+	Vector3 sphereCentre = 0.5f*(sphereMin+sphereMax), sphereRadius = 0.495f*(sphereMax-sphereMin);
+	OcclusionBuffer::makeSphere(6, 8, m_SphereOccluder);
+	for (int i = 0; i < (int)m_SphereOccluder.size(); i += 3)
 	{
-		m_GlassModelAxes[i].Normalize();
-		m_GlassModelTransforms[i] = SimpleMath::Matrix::CreateScale(m_GlassModelScales[i])*SimpleMath::Matrix::CreateFromAxisAngle(m_GlassModelAxes[i], m_GlassModelAngles[i])*SimpleMath::Matrix::CreateTranslation(m_GlassModelPositions[i]);
+		m_SphereOccluder[i] = sphereCentre.x+sphereRadius.x*m_SphereOccluder[i];
+		m_SphereOccluder[i+1] = sphereCentre.y+sphereRadius.y*m_SphereOccluder[i+1];
+		m_SphereOccluder[i+2] = sphereCentre.z+sphereRadius.z*m_SphereOccluder[i+2];
 	}
+	OcclusionBuffer::makeBox(&cubeMin.x, &cubeMax.x, m_BoxOccluder);
+
+	// What to draw with them, and how many of everything per glass object to make
+	ResolveScene();
 
 	// Shaders
-	m_LightShaderPair.InitLightShader(device, L"light_vs.cso", L"light_ps.cso");
-	m_SkyboxShaderPair.InitSkyboxShader(device, L"skybox_vs.cso", L"skybox_ps.cso");
-	m_SpecimenShaderPair.InitSpecimenShader(device, L"specimen_vs.cso", L"specimen_ps.cso");
-	m_RefractionShaderPair.InitRefractionShader(device, L"refraction_vs.cso", L"refraction_ps.cso");
-	m_GlassShaderPair.InitGlassShader(device, L"glass_vs.cso", L"glass_ps.cso");
-	m_AlphaShaderPair.InitAlphaShader(device, L"alpha_vs.cso", L"alpha_ps.cso");
-	m_OverlayShaderPair.InitOverlayShader(device, L"overlay_vs.cso", L"overlay_ps.cso");
+	m_LightShaderPair.InitLightShader(&m_RenderDevice, L"light_vs.cso", L"light_ps.cso");
+	m_LightInstancedShaderPair.InitLightShader(&m_RenderDevice, L"light_instanced_vs.cso", L"light_ps.cso", true);
+	m_SkyboxShaderPair.InitSkyboxShader(&m_RenderDevice, L"skybox_vs.cso", L"skybox_ps.cso");
+	m_SpecimenShaderPair.InitSpecimenShader(&m_RenderDevice, L"specimen_vs.cso", L"specimen_ps.cso");
+	m_RefractionShaderPair.InitRefractionShader(&m_RenderDevice, L"refraction_vs.cso", L"refraction_ps.cso");
+	m_GlassShaderPair.InitGlassShader(&m_RenderDevice, L"glass_vs.cso", L"glass_ps.cso");
+	m_AlphaShaderPair.InitAlphaShader(&m_RenderDevice, L"alpha_vs.cso", L"alpha_ps.cso");
+	m_OverlayShaderPair.InitOverlayShader(&m_RenderDevice, L"overlay_vs.cso", L"overlay_ps.cso");
+	m_ProjectionShaderPair.InitProjectionShader(&m_RenderDevice, L"light_vs.cso", L"projection_ps.cso");
+
+	m_RefractionShaderPair.setEnvironmentMode(m_EnvironmentMode);
+	m_GlassShaderPair.setEnvironmentMode(m_EnvironmentMode);
 
 	for (int i = 0; i < 6; i++)
-		m_SkyboxRendering[i].InitShader(device, L"colour_vs.cso", L"skybox_pores.cso");
+		m_SkyboxRendering[i].InitShader(&m_RenderDevice, L"colour_vs.cso", L"skybox_pores.cso");
 
-	m_NeutralRendering.InitShader(device, L"light_vs.cso", L"neutral.cso");
-	m_NeutralNMRendering.InitShader(device, L"light_vs.cso", L"neutral_nm.cso");
-	m_DemoRendering.InitShader(device, L"light_vs.cso", L"pores.cso");
-	m_DemoNMRendering.InitShader(device, L"light_vs.cso", L"pores_nm.cso");
+	m_NeutralRendering.InitShader(&m_RenderDevice, L"light_vs.cso", L"neutral.cso");
+	m_NeutralNMRendering.InitShader(&m_RenderDevice, L"light_vs.cso", L"neutral_nm.cso");
+	m_DemoRendering.InitShader(&m_RenderDevice, L"light_vs.cso", L"pores.cso");
+	m_DemoNMRendering.InitShader(&m_RenderDevice, L"light_vs.cso", L"pores_nm.cso");
 
-	m_SphericalPoresRendering.InitShader(device, L"light_vs.cso", L"spherical_pores.cso");
-	m_SphericalPoresNMRendering.InitShader(device, L"light_vs.cso", L"spherical_pores_nm.cso");
+	m_SphericalPoresRendering.InitShader(&m_RenderDevice, L"light_vs.cso", L"spherical_pores.cso");
+	m_SphericalPoresNMRendering.InitShader(&m_RenderDevice, L"light_vs.cso", L"spherical_pores_nm.cso");
 
 
 	//load Textures
-	CreateDDSTextureFromFile(device, L"Stylized_Stone_Floor_005_basecolor.dds",		nullptr,	m_texture1.ReleaseAndGetAddressOf());
-	CreateDDSTextureFromFile(device, L"EvilDrone_Diff.dds", nullptr,	m_texture2.ReleaseAndGetAddressOf());
-	CreateDDSTextureFromFile(device, L"Stylized_Stone_Floor_005_normal.dds", nullptr,	m_normalTexture1.ReleaseAndGetAddressOf());
-	CreateDDSTextureFromFile(device, L"brine_texture.dds", nullptr, m_brineTexture.ReleaseAndGetAddressOf());
-	CreateDDSTextureFromFile(device, L"glass_texture.dds", nullptr, m_glassTexture.ReleaseAndGetAddressOf());
+	m_texture1 = m_RenderDevice.CreateTextureFromFile(L"Stylized_Stone_Floor_005_basecolor.dds");
+	m_texture2 = m_RenderDevice.CreateTextureFromFile(L"EvilDrone_Diff.dds");
+	m_normalTexture1 = m_RenderDevice.CreateTextureFromFile(L"Stylized_Stone_Floor_005_normal.dds");
+	m_brineTexture = m_RenderDevice.CreateTextureFromFile(L"brine_texture.dds");
+	m_glassTexture = m_RenderDevice.CreateTextureFromFile(L"glass_texture.dds");
+
+	// Static results from an earlier launch, if nothing they were made from has changed since
+	// NB: Six sky faces and two neutral textures, then each object's six reflection faces (and projection, in single-target modes)
+	int cachedCount = 8+m_GlassCount*((m_EnvironmentMode == EnvironmentProjection::Cube) ? 6 : 7);
+	m_StaticCached = !m_Headless && !m_Baking && !m_Referencing && m_StaticCache.load(GetStaticCacheFilename(), GetStaticCacheKey()) && m_StaticCache.getTextureCount() == cachedCount;
+	m_StaticCacheTextures.clear();
 
 	//Initialise Render to texture
 	for (int i = 0; i < 6; i++)
 	{
-		m_SkyboxRenderPass[i] = new RenderTexture(device, 1280, 720, 1, 2);
+		m_SkyboxRenderPass[i] = CreateCachedTexture(1280, 720);
 	}
 
-	m_NeutralRenderPass = new RenderTexture(device, 1280, 720, 1, 2);
-	m_NeutralNMRenderPass = new RenderTexture(device, 1280, 720, 1, 2);
-	m_DemoRenderPass = new RenderTexture(device, 1280, 720, 1, 2);
-	m_DemoNMRenderPass = new RenderTexture(device, 1280, 720, 1, 2);
-	m_SphericalPoresRenderPass = new RenderTexture(device, 1280, 720, 1, 2);
-	m_SphericalPoresNMRenderPass = new RenderTexture(device, 1280, 720, 1, 2);
+	m_NeutralRenderPass = CreateCachedTexture(1280, 720);
+	m_NeutralNMRenderPass = CreateCachedTexture(1280, 720);
+	m_DemoRenderPass = new RenderTexture(&m_RenderDevice, 1280, 720, 1, 2);
+	m_DemoNMRenderPass = new RenderTexture(&m_RenderDevice, 1280, 720, 1, 2);
+	m_SphericalPoresRenderPass = new RenderTexture(&m_RenderDevice, 1280, 720, 1, 2);
+	m_SphericalPoresNMRenderPass = new RenderTexture(&m_RenderDevice, 1280, 720, 1, 2);
 
 	for (int i = 0; i < 6; i++)
 	{
-		m_DynamicEnvironment[i] = new RenderTexture(device, 1280, 720, 1, 2);
+		m_DynamicEnvironment[i] = new RenderTexture(&m_RenderDevice, 1280, 720, 1, 2);
 	}
 
+	// Per-object dynamic maps come from the pool, as their resolution follows the object's screen coverage
+	m_RenderTexturePool.Initialise(&m_RenderDevice);
+	m_BasicInstances.Initialise(&m_RenderDevice);
+	m_SharedCapture.Initialise(&m_RenderTexturePool);
+	m_Profiler.Initialise((m_Headless) ? (ProfilerBackend*)&m_NullProfilerBackend : &m_ProfilerBackend, 1 << 16);
+	m_Hud.Initialise(&m_Profiler, 0.25);
+	m_RenderGraphBackend.Initialise(&m_Profiler, &m_RenderTexturePool);
+	m_RenderContext.Initialise((m_Headless) ? (RenderContextBackend*)&m_NullRenderContextBackend : &m_RenderContextBackend);
+	m_DynamicTextureCommands.Reset();
+
+	// Environment faces are recorded on deferred contexts where the device allows, otherwise into command buffers replayed in order
+	// NB: No more threads than a capture has faces
+	int threads = std::min(6, std::max(1, (int)std::thread::hardware_concurrency()));
+	m_DeferredRecording = !m_Headless && m_DeviceCommandLists.Initialise(m_deviceResources->GetD3DDevice(), m_deviceResources->GetD3DDeviceContext());
+	m_CommandListRecorder.Initialise((m_DeferredRecording) ? (CommandListBackend*)&m_DeviceCommandLists : &m_RecordedCommandLists, threads);
+
+	// Constants are sub-allocated from one ring where the device can bind part of a buffer; otherwise each shader keeps its own buffers
+	bool constantRing = m_ConstantRing.Initialise(&m_RenderDevice, 1024*1024);
+	m_RenderContext.setConstantRing((constantRing) ? &m_ConstantRing : nullptr);
 	for (int i = 0; i < m_GlassCount; i++)
 	{
 		for (int j = 0; j < 6; j++)
 		{
-			for (int k = 0; k < m_GlassCount; k++)
-			{
-				m_StaticSpecimenEnvironments[i][j][k] = new RenderTexture(device, 1280, 720, 1, 2);
-				m_StaticLiquidEnvironments[i][j][k] = new RenderTexture(device, 1280, 720, 1, 2);
+			m_DynamicLiquidEnvironments[i][j] = nullptr;
+			m_DynamicLiquidAlphaEnvironments[i][j] = nullptr;
 
-				m_StaticSpecimenAlphaEnvironments[i][j][k] = new RenderTexture(device, 1280, 720, 1, 2);
-				m_StaticLiquidAlphaEnvironments[i][j][k] = new RenderTexture(device, 1280, 720, 1, 2);
+			m_DynamicExternalEnvironments[i][j] = nullptr;
+			m_DynamicInternalEnvironments[i][j] = nullptr;
+		}
+
+		m_DynamicExternalProjections[i] = nullptr;
+		m_DynamicInternalProjections[i] = nullptr;
+
+		m_GlassModelDetails[i].Initialise(i);
+		CreateGlassEnvironments(i, 1280, 720);
+	}
+
+	m_StaticBytes = 0;
+	for (int i = 0; i < m_GlassCount; i++)
+	{
+		// Cached captures are only what the glass shaders read, so need neither their backgrounds nor the intermediate maps that composited them.
+		// Captures baked offline (see SetBake) are loaded as they are, without the intermediates
+		EnvironmentBaker::Capture capture;
+		if (m_StaticCached)
+		{
+			// NB: Sized as they were cached, whatever is asked for here
+			m_StaticBaked[i] = 1;
+			for (int j = 0; j < 6; j++)
+			{
+				m_StaticReflectionEnvironments[i][j] = CreateCachedTexture(1280, 720);
+				m_StaticBytes += RenderTexturePool::getTextureBytes(m_StaticReflectionEnvironments[i][j]->getTextureWidth(), m_StaticReflectionEnvironments[i][j]->getTextureHeight());
+			}
+		}
+		else if (!m_Headless && !m_Baking && !m_Referencing && EnvironmentBaker::load(GetBakeFilename(i), capture))
+		{
+			m_StaticBaked[i] = 1;
+			for (int j = 0; j < 6; j++)
+			{
+				int size = capture.background[j].width;
+				m_StaticEnvironments[i][j] = new RenderTexture(&m_RenderDevice, size, size, 1, 2, capture.background[j].texels.data());
+				m_StaticReflectionEnvironments[i][j] = CreateCachedTexture(size, size, capture.reflection[j].texels.data());
+				m_StaticBytes += 2*RenderTexturePool::getTextureBytes(size, size);
+			}
+		}
+		else
+		{
+			m_StaticBaked[i] = 0;
+			for (int j = 0; j < 6; j++)
+			{
+				for (int k = 0; k < m_GlassCount; k++)
+				{
+					m_StaticSpecimenEnvironments[i][j][k] = new RenderTexture(&m_RenderDevice, 1280, 720, 1, 2);
+					m_StaticLiquidEnvironments[i][j][k] = new RenderTexture(&m_RenderDevice, 1280, 720, 1, 2);
+
+					m_StaticSpecimenAlphaEnvironments[i][j][k] = new RenderTexture(&m_RenderDevice, 1280, 720, 1, 2);
+					m_StaticLiquidAlphaEnvironments[i][j][k] = new RenderTexture(&m_RenderDevice, 1280, 720, 1, 2);
+				}
+
+				m_StaticEnvironments[i][j] = new RenderTexture(&m_RenderDevice, 1280, 720, 1, 2);
+				m_StaticReflectionEnvironments[i][j] = CreateCachedTexture(1280, 720);
+				m_StaticBytes += (4*m_GlassCount+2)*RenderTexturePool::getTextureBytes(1280, 720);
 			}
+		}
+
+		m_StaticReflectionProjections[i] = nullptr;
+		m_StaticProjected[i] = m_StaticCached;
+		if (m_EnvironmentMode != EnvironmentProjection::Cube && m_StaticBaked[i] && !m_StaticCached)
+		{
+			// NB: Baked faces are on hand already, so are resampled here rather than drawn on the first frame
+			int size = capture.reflection[0].height;
+			int width = EnvironmentProjection::getTargetWidth(m_EnvironmentMode, size);
+			const Vector4* faces[6];
+			for (int j = 0; j < 6; j++)
+				faces[j] = reinterpret_cast<const Vector4*>(capture.reflection[j].texels.data());
+			std::vector<Vector4> projection(width*size);
+			EnvironmentProjection::Convert(m_EnvironmentMode, faces, size, size, projection.data(), width, size);
+
+			m_StaticReflectionProjections[i] = CreateCachedTexture(width, size, &projection[0].x);
+			m_StaticProjected[i] = 1;
+			m_StaticBytes += RenderTexturePool::getTextureBytes(width, size);
+		}
+		else if (m_EnvironmentMode != EnvironmentProjection::Cube)
+		{
+			m_StaticReflectionProjections[i] = CreateCachedTexture(EnvironmentProjection::getTargetWidth(m_EnvironmentMode, 720), 720);
+			m_StaticBytes += RenderTexturePool::getTextureBytes(m_StaticReflectionProjections[i]->getTextureWidth(), m_StaticReflectionProjections[i]->getTextureHeight());
+		}
+	}
 
-			m_StaticEnvironments[i][j] = new RenderTexture(device, 1280, 720, 1, 2);
-			m_StaticReflectionEnvironments[i][j] = new RenderTexture(device, 1280, 720, 1, 2);
 
-			m_DynamicSpecimenEnvironments[i][j] = new RenderTexture(device, 1280, 720, 1, 2);
-			m_DynamicLiquidEnvironments[i][j] = new RenderTexture(device, 1280, 720, 1, 2);
 
-			m_DynamicSpecimenAlphaEnvironments[i][j] = new RenderTexture(device, 1280, 720, 1, 2);
-			m_DynamicLiquidAlphaEnvironments[i][j] = new RenderTexture(device, 1280, 720, 1, 2);
+	// Progressively, each object's faces are left for later frames, unless loaded; its projection follows once they are all in
+	m_StaticItems.clear();
+	m_StaticFaces.assign(m_GlassCount, StaticFacesDone | StaticProjectionDone);
+	for (int i = 0; i < m_GlassCount && m_Progressive && !m_Baking && !m_Referencing && !m_StaticCached; i++)
+	{
+		if (!m_StaticBaked[i])
+		{
+			m_StaticFaces[i] = 0;
+			for (int j = 0; j < 6; j++)
+				m_StaticItems.push_back(std::make_pair(i, j));
+		}
 
-			m_DynamicExternalEnvironments[i][j] = new RenderTexture(device, 1280, 720, 1, 2);
-			m_DynamicAirToGlassEnvironments[i][j] = new RenderTexture(device, 1280, 720, 1, 2);
-			m_DynamicInternalEnvironments[i][j] = new RenderTexture(device, 1280, 720, 1, 2);
+		if (m_StaticReflectionProjections[i] && !m_StaticProjected[i])
+		{
+			m_StaticFaces[i] &= ~StaticProjectionDone;
+			if (m_StaticBaked[i])
+				m_StaticItems.push_back(std::make_pair(i, 6));
 		}
 	}
+	m_StaticQueue.Reset((int)m_StaticItems.size());
+
+	// NB: A warm cache leaves the static passes nothing to do
+	m_preRendered = m_StaticCached;
+
+#ifdef _DEBUG
+	OutputDebugStringA(m_RenderDevice.getReport().c_str());
+#endif
+}
+
+void Game::CreateGlassEnvironments(int i, int width, int height)
+{
+	// NB: Release everything before acquiring, so textures of the right size are handed straight back
+	for (int j = 0; j < 6; j++)
+	{
+		m_RenderTexturePool.release(m_DynamicLiquidEnvironments[i][j]);
+		m_RenderTexturePool.release(m_DynamicLiquidAlphaEnvironments[i][j]);
+
+		m_RenderTexturePool.release(m_DynamicExternalEnvironments[i][j]);
+		m_RenderTexturePool.release(m_DynamicInternalEnvironments[i][j]);
+	}
+	m_RenderTexturePool.release(m_DynamicExternalProjections[i]);
+	m_RenderTexturePool.release(m_DynamicInternalProjections[i]);
+
+	for (int j = 0; j < 6; j++)
+	{
+		m_DynamicLiquidEnvironments[i][j] = m_RenderTexturePool.acquire(width, height);
+		m_DynamicLiquidAlphaEnvironments[i][j] = m_RenderTexturePool.acquire(width, height);
+
+		m_DynamicExternalEnvironments[i][j] = m_RenderTexturePool.acquire(width, height);
+		m_DynamicInternalEnvironments[i][j] = m_RenderTexturePool.acquire(width, height);
+	}
+
+	// Square (or 2:1) single targets, as tall as the faces
+	m_DynamicExternalProjections[i] = nullptr;
+	m_DynamicInternalProjections[i] = nullptr;
+	if (m_EnvironmentMode != EnvironmentProjection::Cube)
+	{
+		m_DynamicExternalProjections[i] = m_RenderTexturePool.acquire(EnvironmentProjection::getTargetWidth(m_EnvironmentMode, height), height);
+		m_DynamicInternalProjections[i] = m_RenderTexturePool.acquire(EnvironmentProjection::getTargetWidth(m_EnvironmentMode, height), height);
+	}
+}
+
+void Game::ResolveScene()
+{
+	// NB: Anything named that this build has not got is drawn plain, rather than not at all
+	m_MaterialTextures.resize(m_Scene.getMaterialCount());
+	m_MaterialNMTextures.resize(m_Scene.getMaterialCount());
+	for (int i = 0; i < m_Scene.getMaterialCount(); i++)
+	{
+		const Scene::Material& material = m_Scene.getMaterial(i);
+		m_MaterialTextures[i] = FindTexture(material.texture);
+		m_MaterialNMTextures[i] = FindTexture(material.normalMap);
+
+		if (!m_MaterialTextures[i] || !m_MaterialNMTextures[i])
+			OutputDebugStringA(("Scene: material " + material.name + " has textures this build cannot draw, so is neutral instead\n").c_str());
+		if (!m_MaterialTextures[i])
+			m_MaterialTextures[i] = &m_NeutralRenderPass;
+		if (!m_MaterialNMTextures[i])
+			m_MaterialNMTextures[i] = &m_NeutralNMRenderPass;
+	}
+
+	m_BasicCount = m_Scene.getBasicCount();
+	m_BasicModels.resize(m_BasicCount);
+	for (int i = 0; i < m_BasicCount; i++)
+		m_BasicModels[i] = FindModel(m_Scene.getModelName(m_Scene.getBasicModel(i)));
+
+	m_GlassCount = m_Scene.getGlassCount();
+	m_GlassModels.resize(m_GlassCount);
+	for (int i = 0; i < m_GlassCount; i++)
+		m_GlassModels[i] = FindModel(m_Scene.getModelName(m_Scene.getGlassModel(i)));
+
+	m_GlassModelDetails.assign(m_GlassCount, EnvironmentDetail());
+	m_GlassModelPasses.assign(m_GlassCount, -1);
+
+	// NB: Each reads its glass object's transform, so UpdateModels evaluates them after the scene's
+	m_Animations.clear();
+	m_SpecimenAnimations.resize(m_GlassCount);
+	m_LiquidAnimations.resize(m_GlassCount);
+	for (int i = 0; i < m_GlassCount; i++)
+	{
+		m_SpecimenAnimations[i] = m_Animations.add([this, i](float time) { return AnimateSpecimen(i, time); });
+		m_LiquidAnimations[i] = m_Animations.add([this, i](float time) { return AnimateLiquid(i, time); });
+	}
 
+	// Environments, created along with the other device resources
+	std::array<RenderTexture*, 6> faces;
+	faces.fill(nullptr);
+	std::array<std::vector<RenderTexture*>, 6> viewedFaces;
+	viewedFaces.fill(std::vector<RenderTexture*>(m_GlassCount, nullptr));
+
+	m_StaticSpecimenEnvironments.assign(m_GlassCount, viewedFaces);
+	m_StaticLiquidEnvironments.assign(m_GlassCount, viewedFaces);
+	m_StaticSpecimenAlphaEnvironments.assign(m_GlassCount, viewedFaces);
+	m_StaticLiquidAlphaEnvironments.assign(m_GlassCount, viewedFaces);
+	m_StaticEnvironments.assign(m_GlassCount, faces);
+	m_StaticReflectionEnvironments.assign(m_GlassCount, faces);
+	m_StaticBaked.assign(m_GlassCount, 0);
+	m_StaticProjected.assign(m_GlassCount, 0);
+	m_DynamicLiquidEnvironments.assign(m_GlassCount, faces);
+	m_DynamicLiquidAlphaEnvironments.assign(m_GlassCount, faces);
+	m_DynamicExternalEnvironments.assign(m_GlassCount, faces);
+	m_DynamicInternalEnvironments.assign(m_GlassCount, faces);
+	m_StaticReflectionProjections.assign(m_GlassCount, nullptr);
+	m_DynamicExternalProjections.assign(m_GlassCount, nullptr);
+	m_DynamicInternalProjections.assign(m_GlassCount, nullptr);
+
+	m_Scene.getTransforms().Update();
+	BuildBvh();
+}
 
+ModelClass* Game::FindModel(const std::string& name)
+{
+	if (name == "cube")
+		return &m_Cube;
+	if (name == "specimen_jar")
+		return &m_SpecimenJar1;
+	if (name == "teapot")
+		return &m_Teapot;
+	if (name == "death_star")
+		return &m_DeathStar;
+
+	if (name != "sphere")
+		OutputDebugStringA(("Scene: no model " + name + ", so drawing a sphere instead\n").c_str());
+	return &m_Sphere;
+}
 
-	m_preRendered = false;
+RenderTexture** Game::FindTexture(const std::string& name)
+{
+	// NB: By address, as the render passes themselves are recreated along with the device
+	if (name == "neutral")
+		return &m_NeutralRenderPass;
+	if (name == "neutral_nm")
+		return &m_NeutralNMRenderPass;
+	if (name == "demo")
+		return &m_DemoRenderPass;
+	if (name == "demo_nm")
+		return &m_DemoNMRenderPass;
+	if (name == "spherical_pores")
+		return &m_SphericalPoresRenderPass;
+	if (name == "spherical_pores_nm")
+		return &m_SphericalPoresNMRenderPass;
+
+	return nullptr;
 }
 
 // Allocate all memory resources that change on a window SizeChanged event.
 void Game::CreateWindowSizeDependentResources()
 {
-    auto size = m_deviceResources->GetOutputSize();
-    float aspectRatio = float(size.right) / float(size.bottom);
+	// Headlessly, a back buffer of its own through the render device, as nothing will show it
+	if (m_Headless)
+	{
+		m_RenderDevice.Release(m_BackBufferView);
+		m_RenderDevice.Release(m_BackBufferDepthView);
+		m_RenderDevice.Release(m_HeadlessBackBuffer[0]);
+		m_RenderDevice.Release(m_HeadlessBackBuffer[1]);
+
+		RenderTextureDesc colour = { (unsigned int)m_OutputWidth, (unsigned int)m_OutputHeight, RenderFormatRgba8, RenderBindRenderTarget };
+		RenderTextureDesc depth = { (unsigned int)m_OutputWidth, (unsigned int)m_OutputHeight, RenderFormatDepth24Stencil8, RenderBindDepthStencil };
+		m_HeadlessBackBuffer[0] = m_RenderDevice.CreateTexture2D(colour);
+		m_HeadlessBackBuffer[1] = m_RenderDevice.CreateTexture2D(depth);
+		m_BackBufferView = m_RenderDevice.CreateRenderTargetView(m_HeadlessBackBuffer[0]);
+		m_BackBufferDepthView = m_RenderDevice.CreateDepthStencilView(m_HeadlessBackBuffer[1]);
+		m_ScreenViewport = { 0.0f, 0.0f, (float)m_OutputWidth, (float)m_OutputHeight, 0.0f, 1.0f };
+	}
+	else
+	{
+		auto size = m_deviceResources->GetOutputSize();
+		auto viewport = m_deviceResources->GetScreenViewport();
+		m_BackBufferView = m_deviceResources->GetRenderTargetView();
+		m_BackBufferDepthView = m_deviceResources->GetDepthStencilView();
+		m_ScreenViewport = *reinterpret_cast<RenderViewport*>(&viewport);
+		m_OutputWidth = size.right-size.left;
+		m_OutputHeight = size.bottom-size.top;
+	}
+
+    float aspectRatio = float(m_OutputWidth) / float(m_OutputHeight);
     float fovAngleY = 50.0f * XM_PI / 180.0f;
 
     // This is a simple example of change that can be made when the app is in
@@ -1193,18 +2886,22 @@ void Game::CreateWindowSizeDependentResources()
 
     // This sample makes use of a right-handed coordinate system using row-major matrices.
 	m_Camera.setPerspective(fovAngleY, aspectRatio, 0.01f, 100.0f);
+
+	// NB: The recording ends by rebinding the back buffer, which has just been recreated
+	m_DynamicTextureCommands.Reset();
 }
 
 
 void Game::OnDeviceLost()
 {
     m_states.reset();
-    m_fxFactory.reset();
-    m_sprites.reset();
-    m_font.reset();
-	m_batch.reset();
-	m_testmodel.reset();
-    m_batchInputLayout.Reset();
+
+	m_RenderDevice.Release(m_texture1);
+	m_RenderDevice.Release(m_texture2);
+	m_RenderDevice.Release(m_normalTexture1);
+	m_RenderDevice.Release(m_brineTexture);
+	m_RenderDevice.Release(m_glassTexture);
+	m_texture1 = m_texture2 = m_normalTexture1 = m_brineTexture = m_glassTexture = nullptr;
 }
 
 void Game::OnDeviceRestored()
@@ -9,6 +9,33 @@
 #include "Light.h"
 #include "Input.h"
 #include "RenderTexture.h"
+#include "RenderTexturePool.h"
+#include "EnvironmentDetail.h"
+#include "SharedCapture.h"
+#include "RenderGraph.h"
+#include "DeviceRenderGraphBackend.h"
+#include "DeviceRenderContextBackend.h"
+#include "DeviceRenderDeviceBackend.h"
+#include "RenderStates.h"
+#include "ConstantRing.h"
+#include "DrawQueue.h"
+#include "InstanceBatch.h"
+#include "CommandBuffer.h"
+#include "DeviceCommandListBackend.h"
+#include "DeviceProfilerBackend.h"
+#include "PerformanceHud.h"
+#include "Benchmark.h"
+#include "CameraPath.h"
+#include "Scene.h"
+#include "AnimationTable.h"
+#include "SceneBvh.h"
+#include "OcclusionBuffer.h"
+#include "TriangleBvh.h"
+#include "SoftwareRenderer.h"
+#include "EnvironmentBaker.h"
+#include "StaticCache.h"
+#include "ProgressiveQueue.h"
+#include "EnvironmentProjection.h"
 
 #include "Camera.h"
 #include "EnvironmentCamera.h"
@@ -21,6 +48,10 @@
 #include "GlassShader.h"
 #include "AlphaShader.h"
 #include "OverlayShader.h"
+#include "ProjectionShader.h"
+
+#include <array>
+#include <chrono>
 
 // A basic game implementation that creates a D3D11 device and
 // provides a game loop.
@@ -33,6 +64,7 @@ public:
 
     // Initialization and management
     void Initialize(HWND window, int width, int height);
+    void InitializeHeadless(int width, int height);		// As Initialize, but on null backends, with no window or device: frames are declared, scheduled and submitted, but never drawn or shown
 
     // Basic game loop
     void Tick();
@@ -54,6 +86,36 @@ public:
 
     // Properties
     void GetDefaultSize( int& width, int& height ) const;
+
+    // Runs frames of the default scene headlessly, reporting each frame's passes, submissions and allocations.
+    // False if a frame runs other than the passes its graph scheduled, submits nothing, submits other than its render context counted, or anything is still being created by the last frames
+    static bool verifyHeadless(int frames, std::string& report);
+
+    // Runs the same frames headlessly twice, with the render context shadowing state and without, counting the calls each passes on to a recording null backend.
+    // False if the two draw differently, shadowing skips nothing, or fewer calls are eliminated than it reports as skipped
+    static bool compareShadowing(int frames, std::string& report);
+
+    // Runs the same frames headlessly in each projection mode, counting the draws each submits.
+    // False if a single-target mode draws anything more than the cube mode does besides its projections, or draws no projections on its first frame
+    static bool compareProjections(int frames, std::string& report);
+
+    // Flies the camera along a path for a fixed number of frames, then writes the timings out and quits. Call before Initialize
+    bool SetBenchmark(const std::string& cameraPath, int warmupFrames, int measuredFrames, const std::string& output);
+
+    // Draws another scene, text or binary, instead of scene.txt. Call before Initialize
+    bool SetScene(const std::string& filename);
+
+    // Ray traces every glass object's static captures after the first frame, writes them for later runs to load, and quits. Call before Initialize
+    bool SetBake(int size);
+
+    // Draws the first glass object's static background on the CPU as well once the first frame is drawn, compares the two face by face, writes both out and quits. Call before Initialize
+    void SetReference();
+
+    // Shows the first frame without the static environment maps, then renders them a few faces a frame within budgetMilliseconds. Call before Initialize
+    bool SetProgressive(double budgetMilliseconds);
+
+    // Lays each environment map out as a cube (the default), or resamples it into one "octahedral" or "paraboloid" target. Call before Initialize
+    bool SetProjection(const std::string& name);
 	
 private:
 
@@ -67,27 +129,47 @@ private:
     void Update(DX::StepTimer const& timer);
     void UpdateModels(float time);
 
+    // Scene objects' transforms, as SimpleMath sees them. NB: Only valid once the scene's transforms are updated
+    DirectX::SimpleMath::Matrix* GetBasicTransform(int i);
+    DirectX::SimpleMath::Matrix* GetGlassTransform(int i);
+    DirectX::SimpleMath::Vector3 GetBasicPosition(int i);
+    DirectX::SimpleMath::Vector3 GetGlassPosition(int i);
+    float GetGlassScale(int i);
+
+    // Each glass object's specimen and liquid, as they move at the given time
+    DirectX::SimpleMath::Matrix AnimateSpecimen(int i, float time);
+    DirectX::SimpleMath::Matrix AnimateLiquid(int i, float time);
+
     void Render();
+    void UpdateEnvironmentDetail();
+    void BuildRenderGraph();
+    void RenderScene();
 
     // Rendering models
-    void RenderBasicsOnto(Camera* camera, Light* light, int i);
+    void RenderBasicsOnto(RenderContext* context, Camera* camera, Light* light, int i);
+    void RenderBasicsInstancedOnto(RenderContext* context, Camera* camera, Light* light, int group);
+    void UpdateBasicInstances();
 
-    void RenderSpecimensOnto(Camera* camera, Light* light, int i);
-    void RenderLiquidsOnto(Camera* camera, Light* light, int i, ID3D11ShaderResourceView* specimen);
+    void RenderSpecimensOnto(RenderContext* context, Camera* camera, Light* light, int i);
+    void RenderLiquidsOnto(RenderContext* context, Camera* camera, Light* light, int i, ID3D11ShaderResourceView* specimen);
 
-    void RenderSpecimenAlphasOnto(Camera* camera, int i, ID3D11ShaderResourceView* alpha);
-    void RenderLiquidAlphasOnto(Camera* camera, int i, ID3D11ShaderResourceView* alpha);
+    void RenderSpecimenAlphasOnto(RenderContext* context, Camera* camera, int i, ID3D11ShaderResourceView* alpha);
+    void RenderLiquidAlphasOnto(RenderContext* context, Camera* camera, int i, ID3D11ShaderResourceView* alpha);
 
-    void RenderRefractionOnto(Camera* camera, Light* light, int i);
-    void RenderGlassOverlayOnto(Camera* camera, int i, ID3D11ShaderResourceView* texture, ID3D11ShaderResourceView* overlay, ID3D11ShaderResourceView* alpha);
-    void RenderGlassOnto(Camera* camera, Light* light, int index);
+    void RenderRefractionOnto(RenderContext* context, Camera* camera, Light* light, int i);
+    void RenderGlassOverlayOnto(RenderContext* context, Camera* camera, int i, ID3D11ShaderResourceView* texture, ID3D11ShaderResourceView* overlay, ID3D11ShaderResourceView* alpha);
+    void RenderGlassOnto(RenderContext* context, Camera* camera, Light* light, int index);
 
-    void RenderSkyboxOnto(Camera* camera);
+    void RenderSkyboxOnto(RenderContext* context, Camera* camera);
+    int RenderBackgroundOnto(RenderContext* context, Camera* camera, Light* light, const std::vector<unsigned char>& visible);	// Only what's flagged visible; returns the draws issued
+    void QueueBackgroundOnto(Camera* camera, Light* light, const std::vector<unsigned char>& visible);	// Pushes without submitting, so callers can add to the same queue
 
     // Render passes
     void RenderStaticTextures();
     void RenderDynamicTextures();
     void RenderShaderTexture(RenderTexture* renderPass, Shader rendering);
+    void RenderProjection(RenderTexture* faces[6], RenderTexture* target);
+    void FillEnvironmentMap(RenderTexture* faces[6], RenderTexture* projection, ID3D11ShaderResourceView* environmentMap[6]);
 
     void RenderStaticSpecimenEnvironments();
     void RenderStaticLiquidEnvironments();
@@ -95,13 +177,60 @@ private:
     void RenderStaticEnvironments();
     void RenderStaticReflectionEnvironments();
 
-    void RenderDynamicSpecimenEnvironments();
-    void RenderDynamicLiquidEnvironments();
+    // NB: One face of one glass object's static maps; each reads only the same face of the stage before
+    void RenderStaticSpecimenFace(int i, int j);
+    void RenderStaticLiquidFace(int i, int j);
+    void RenderStaticEnvironmentFace(int i, int j);
+    void RenderStaticReflectionFace(int i, int j);
+
+    // Static faces rendered a few a frame after the first (see SetProgressive), each object's dynamic external maps standing in until its own are done
+    void QueueStaticItems();		// Reprioritises what is left by screen coverage, then by which way each face looks
+    void RenderStaticItems();		// As many as the frame's budget allows
+    void RenderStaticItem(int item);
+    bool GetStaticComplete();
+
+    // NB: Per glass object; transient targets are passed as render graph resources
+    void RenderDynamicSpecimenEnvironments(int i, int specimen, int specimenAlpha);
+    void RenderDynamicLiquidEnvironments(int i, int specimen, int specimenAlpha);
 
     void RenderDynamicEnvironment();
-    void RenderDynamicExternalEnvironments();
-    void RenderDynamicAirToGlassEnvironments();
-    void RenderDynamicInternalEnvironments();
+    void RenderDynamicExternalEnvironments(int i);
+    void RenderDynamicAirToGlassEnvironments(int i, int airToGlass);
+    void RenderDynamicInternalEnvironments(int i, int airToGlass);
+
+    RenderTexture* FindSharedBackground(int face, int width, int height);
+
+    // Faces of one capture are independent, so may be recorded in parallel, then submitted in order
+    void RenderFaces(const std::vector<int>& faces, const std::function<void(RenderContext*, int)>& renderFace);
+    void BindFrameState(RenderContext* context);	// Opaque, depth-tested and culling clockwise, drawing to the back buffer
+    void CountFrame();		// Hands the frame's counts to the HUD
+    void FinishBenchmark();
+
+    // Static captures baked offline, in place of the static passes
+    void BakeEnvironments();
+    bool ReadTexture(ID3D11ShaderResourceView* view, SoftwareRenderer::Texture& texture);	// Copies the top level back from the device
+    std::string GetBakeFilename(int i);
+    void CompareReference();	// The software renderer's static background against the GPU's
+
+    // Static results cached on disk from one launch to the next, in place of the static passes
+    uint64_t GetStaticCacheKey();	// Hashes the scene, the shaders and files the static passes read, and the resolutions they render at
+    RenderTexture* CreateCachedTexture(int width, int height, const float* texels = nullptr);	// The cache's next texture if it was loaded, otherwise a new one
+    std::string SaveStaticCache();	// Reads every cached texture back from the device; returns a line for the startup report
+    std::string GetStaticCacheFilename();
+    void ReportStartup();		// After each frame is shown, until the static maps are all in
+
+    // Culling, against a BVH over basics, then glass objects, then their specimens
+    void BuildBvh();
+    void SetObjectBounds(int object, ModelClass* model, const DirectX::SimpleMath::Matrix& world);
+    void CullObjects(Camera* camera, std::vector<unsigned char>& visible);
+    void OccludeObjects(Camera* camera, std::vector<unsigned char>& visible, int width, int height);	// Clears what visible basics hide, after CullObjects
+    void PlaceEnvironmentCamera(DirectX::SimpleMath::Vector3 position);	// Culls each face, unless nothing has moved since it was last placed there
+
+    // Per-face culling of environment captures, wherever the environment camera was last placed
+    bool HasSpecimen(int i);
+    bool GetGlassVisible(int face, int i);
+    bool GetSpecimenVisible(int face, int i);
+    void SkipEmptyFace(RenderTexture* face);
 
     //void RenderStaticSpecimenTextures();
     //void RenderDynamicSpecimenTextures();
@@ -114,11 +243,23 @@ private:
     //void RenderDynamicGlassFirstExternals();
 
     void Clear();
+    void SetupLightAndCamera();
     void CreateDeviceDependentResources();
     void CreateWindowSizeDependentResources();
+    void CreateGlassEnvironments(int i, int width, int height);
+    void ResolveScene();	// Looks up the scene's models and materials, and sizes everything kept per glass object
+    ModelClass* FindModel(const std::string& name);
+    RenderTexture** FindTexture(const std::string& name);
 
     // Device resources.
     std::unique_ptr<DX::DeviceResources>    m_deviceResources;
+    bool                                    m_Headless;                 // No device: everything is created and submitted on the null backends
+    ID3D11RenderTargetView*                 m_BackBufferView;           // The swap chain's, or headlessly one made through the render device
+    ID3D11DepthStencilView*                 m_BackBufferDepthView;
+    ID3D11Texture2D*                        m_HeadlessBackBuffer[2];    // Colour and depth, headlessly
+    RenderViewport                          m_ScreenViewport;
+    int                                     m_OutputWidth;
+    int                                     m_OutputHeight;
 
     // Rendering loop timer.
     DX::StepTimer                           m_timer;
@@ -129,17 +270,8 @@ private:
 	Input									m_input;
 	InputCommands							m_gameInputCommands;
 
-    // DirectXTK objects.
-    std::unique_ptr<DirectX::CommonStates>                                  m_states;
-    std::unique_ptr<DirectX::BasicEffect>                                   m_batchEffect;	
-    std::unique_ptr<DirectX::EffectFactory>                                 m_fxFactory;
-    std::unique_ptr<DirectX::SpriteBatch>                                   m_sprites;
-    std::unique_ptr<DirectX::SpriteFont>                                    m_font;
-
-	// Scene Objects
-	std::unique_ptr<DirectX::PrimitiveBatch<DirectX::VertexPositionColor>>  m_batch;
-	Microsoft::WRL::ComPtr<ID3D11InputLayout>                               m_batchInputLayout;
-	std::unique_ptr<DirectX::GeometricPrimitive>                            m_testmodel;
+    // Fixed-function states
+    std::unique_ptr<RenderStates>                                           m_states;
 
 	//lights
 	Light																	m_Light;
@@ -150,22 +282,24 @@ private:
     EnvironmentCamera                                                       m_environmentCamera;
 
 	//textures 
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texture1;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texture2;
+	ID3D11ShaderResourceView*                                               m_texture1;
+	ID3D11ShaderResourceView*                                               m_texture2;
 
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_normalTexture1;
+    ID3D11ShaderResourceView*                                               m_normalTexture1;
 
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_brineTexture;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_glassTexture;
+    ID3D11ShaderResourceView*                                               m_brineTexture;
+    ID3D11ShaderResourceView*                                               m_glassTexture;
 
 	//Shaders
 	LightShader																m_LightShaderPair;
+    LightShader                                                             m_LightInstancedShaderPair;
     SkyboxShader                                                            m_SkyboxShaderPair;
     SpecimenShader                                                          m_SpecimenShaderPair;
     RefractionShader                                                        m_RefractionShaderPair;
     GlassShader                                                             m_GlassShaderPair;
     AlphaShader                                                             m_AlphaShaderPair;
     OverlayShader                                                           m_OverlayShaderPair;
+    ProjectionShader                                                        m_ProjectionShaderPair;
 
     //GlassShader                                                             m_GlassFrontShaderPair;
     //GlassShader                                                             m_GlassBackShaderPair;
@@ -183,35 +317,70 @@ private:
     //RenderTexture**                                                         m_BasicModelTextures[5];
     //RenderTexture**                                                         m_BasicModelNMTextures[5];
 
+    Scene                                                                   m_Scene;                                    // What is drawn, loaded (from scene.txt, unless told otherwise) before any resources are sized to it
     int                                                                     m_BasicCount;
-    ModelClass*                                                             m_BasicModels[15];
-    float                                                                   m_BasicModelScales[15];
-    DirectX::SimpleMath::Vector3                                            m_BasicModelAxes[15];
-    float                                                                   m_BasicModelAngles[15];
-    DirectX::SimpleMath::Vector3                                            m_BasicModelPositions[15];
-    DirectX::SimpleMath::Matrix                                             m_BasicModelTransforms[15];
-    RenderTexture**                                                         m_BasicModelTextures[15];
-    RenderTexture**                                                         m_BasicModelNMTextures[15];
-
+    std::vector<ModelClass*>                                                m_BasicModels;                              // Resolved from the scene's model names
     int                                                                     m_GlassCount;
-    ModelClass*                                                             m_GlassModels[4];
-    float                                                                   m_GlassModelScales[4];
-    DirectX::SimpleMath::Vector3                                            m_GlassModelAxes[4];
-    float                                                                   m_GlassModelAngles[4];
-    DirectX::SimpleMath::Vector3                                            m_GlassModelPositions[4];
-    DirectX::SimpleMath::Matrix                                             m_GlassModelTransforms[4];
-    RenderTexture**                                                         m_GlassModelTextures[4];
-    RenderTexture**                                                         m_GlassModelNMTextures[4];
-    float                                                                   m_GlassModelRefractiveIndex[4];
-    float                                                                   m_GlassModelOpacity[4];
-    float                                                                   m_GlassModelSheen[4];
-
-    float                                                                   m_LiquidOpacity[3];
+    std::vector<ModelClass*>                                                m_GlassModels;
+    std::vector<EnvironmentDetail>                                          m_GlassModelDetails;
+    std::vector<int>                                                        m_GlassModelPasses;                         // Render graph pass refreshing each object's internal maps this frame, or -1
+    AnimationTable                                                          m_Animations;                               // Evaluated once a frame, before anything is drawn
+    std::vector<int>                                                        m_SpecimenAnimations;                       // Indices: glass object; values: slot in m_Animations
+    std::vector<int>                                                        m_LiquidAnimations;                         // Indices: glass object; values: slot in m_Animations
+    SceneBvh                                                                m_Bvh;                                      // Refitted every frame, as specimens always move
+    std::vector<int>                                                        m_MovedObjects;                             // This frame's, besides specimens; indices into m_Bvh
+    std::vector<unsigned char>                                              m_MainVisible;                              // Indices: object in m_Bvh; culled against m_Camera this frame
+    std::array<std::vector<unsigned char>, 6>                               m_FaceVisible;                              // Indices: face, then object in m_Bvh
+    DirectX::SimpleMath::Vector3                                            m_FaceVisiblePosition;                      // Where m_environmentCamera was when its faces were culled
+    bool                                                                    m_FaceVisibleStale;                         // Whether the BVH has changed since
+    OcclusionBuffer                                                         m_Occlusion;                                // Redrawn for every view that is culled
+    std::vector<float>                                                      m_SphereOccluder;                           // Triangles standing in for m_Sphere, inside it
+    std::vector<float>                                                      m_BoxOccluder;                              // Triangles standing in for m_Cube
+    bool                                                                    m_OcclusionCulling;
+    std::vector<RenderTexture**>                                            m_MaterialTextures;                         // Indices: scene material
+    std::vector<RenderTexture**>                                            m_MaterialNMTextures;                       // Indices: scene material
 
     //int                                                                     m_Specimens[2];
     //ModelClass*                                                             m_SpecimenModels[2][3];
 
 	// Generated Textures
+    DeviceRenderDeviceBackend                                               m_RenderDeviceBackend;
+    NullRenderDeviceBackend                                                 m_NullRenderDeviceBackend;                  // Headlessly
+    RenderDevice                                                            m_RenderDevice;                             // NB: Before anything holding resources created through it, so outlives them
+    RenderTexturePool                                                       m_RenderTexturePool;
+    SharedCapture                                                           m_SharedCapture;
+    RenderGraph                                                             m_RenderGraph;
+    DeviceRenderGraphBackend                                                m_RenderGraphBackend;
+    int                                                                     m_RenderGraphPassCount;                     // Scheduled passes when last dumped (debug builds)
+
+    int                                                                     m_SkippedFaceCount;                         // Environment faces left blank this frame, as provably empty
+    int                                                                     m_SkippedFaceCountReported;                 // ...and when last reported (debug builds)
+    int                                                                     m_ProjectionCount;                          // Draws resampling faces into a single target this frame
+
+    RenderContext                                                           m_RenderContext;
+    DeviceRenderContextBackend                                              m_RenderContextBackend;
+    NullRenderContextBackend                                                m_NullRenderContextBackend;                 // Headlessly
+    int                                                                     m_RenderContextBoundCount;                  // Calls bound when last reported (debug builds)
+    ConstantRing                                                            m_ConstantRing;
+    DrawQueue                                                               m_DrawQueue;
+    InstanceBatch                                                           m_BasicInstances;                           // Basic spheres, grouped by material
+    CommandBuffer                                                           m_DynamicTextureCommands;                   // Recorded on the first frame, replayed with the time patched after
+    CommandListRecorder                                                     m_CommandListRecorder;
+    DeviceCommandListBackend                                                m_DeviceCommandLists;                       // Deferred contexts
+    RecordedCommandListBackend                                              m_RecordedCommandLists;                     // Where deferred contexts are unavailable
+    bool                                                                    m_ParallelRecording;                        // Whether environment faces are recorded in parallel
+    bool                                                                    m_DeferredRecording;                        // ...and if so, on deferred contexts
+    Profiler                                                                m_Profiler;
+    DeviceProfilerBackend                                                   m_ProfilerBackend;
+    NullProfilerBackend                                                     m_NullProfilerBackend;                      // Headlessly
+    PerformanceHud                                                          m_Hud;
+    Benchmark                                                               m_Benchmark;
+    bool                                                                    m_Benchmarking;
+    std::string                                                             m_BenchmarkOutput;                          // Prefix of the files a benchmark writes
+    CameraPath                                                              m_CameraPath;                               // Flown by benchmarks, or being recorded
+    bool                                                                    m_RecordingPath;
+    double                                                                  m_RecordingStart;
+
     RenderTexture*                                                          m_SkyboxRenderPass[6];
     Shader                                                                  m_SkyboxRendering[6];
 
@@ -234,25 +403,44 @@ private:
     Shader                                                                  m_SphericalPoresNMRendering;
 
     // Specimen Textures
-    RenderTexture*                                                          m_StaticSpecimenEnvironments[4][6][4];      // Indices: object viewing/direction/object viewed
-    RenderTexture*                                                          m_StaticLiquidEnvironments[4][6][4];        // Indices: object viewing/direction/object viewed
+    std::vector<std::array<std::vector<RenderTexture*>, 6>>                 m_StaticSpecimenEnvironments;               // Indices: object viewing/direction/object viewed
+    std::vector<std::array<std::vector<RenderTexture*>, 6>>                 m_StaticLiquidEnvironments;                 // Indices: object viewing/direction/object viewed
 
-    RenderTexture*                                                          m_StaticSpecimenAlphaEnvironments[4][6][4]; // Indices: object viewing/direction/object viewed
-    RenderTexture*                                                          m_StaticLiquidAlphaEnvironments[4][6][4];   // Indices: object viewing/direction/object viewed
+    std::vector<std::array<std::vector<RenderTexture*>, 6>>                 m_StaticSpecimenAlphaEnvironments;          // Indices: object viewing/direction/object viewed
+    std::vector<std::array<std::vector<RenderTexture*>, 6>>                 m_StaticLiquidAlphaEnvironments;            // Indices: object viewing/direction/object viewed
 
-    RenderTexture*                                                          m_StaticEnvironments[4][6];                 // Indices: object viewing/direction
-    RenderTexture*                                                          m_StaticReflectionEnvironments[4][6];       // Indices: object viewing/direction
+    std::vector<std::array<RenderTexture*, 6>>                              m_StaticEnvironments;                       // Indices: object viewing/direction
+    std::vector<std::array<RenderTexture*, 6>>                              m_StaticReflectionEnvironments;             // Indices: object viewing/direction
 
-    RenderTexture*                                                          m_DynamicSpecimenEnvironments[4][6];        // Indices: object viewed/direction
-    RenderTexture*                                                          m_DynamicLiquidEnvironments[4][6];          // Indices: object viewed/direction
+    std::vector<std::array<RenderTexture*, 6>>                              m_DynamicLiquidEnvironments;                // Indices: object viewed/direction
 
     RenderTexture*                                                          m_DynamicEnvironment[6];                    // Indices: object viewing/direction
-    RenderTexture*                                                          m_DynamicSpecimenAlphaEnvironments[4][6];   // Indices: object viewed/direction
-    RenderTexture*                                                          m_DynamicLiquidAlphaEnvironments[4][6];     // Indices: object viewed/direction
-
-    RenderTexture*                                                          m_DynamicExternalEnvironments[4][6];        // Indices: object refracting/direction
-    RenderTexture*                                                          m_DynamicAirToGlassEnvironments[4][6];      // Indices: object refracting/direction
-    RenderTexture*                                                          m_DynamicInternalEnvironments[4][6];        // Indices: object refracting/direction
+    std::vector<std::array<RenderTexture*, 6>>                              m_DynamicLiquidAlphaEnvironments;           // Indices: object viewed/direction
+
+    std::vector<std::array<RenderTexture*, 6>>                              m_DynamicExternalEnvironments;              // Indices: object refracting/direction
+    std::vector<std::array<RenderTexture*, 6>>                              m_DynamicInternalEnvironments;              // Indices: object refracting/direction
+
+    // Single-target copies of the maps the glass shaders read (nullptr in EnvironmentProjection::Cube mode)
+    EnvironmentProjection::Mode                                             m_EnvironmentMode;
+    std::vector<RenderTexture*>                                             m_StaticReflectionProjections;              // Indices: object viewing
+    std::vector<unsigned char>                                              m_StaticBaked;                              // Indices: object viewing; whether its captures were loaded from a bake or the cache, so are never rendered
+    std::vector<unsigned char>                                              m_StaticProjected;                          // ...and whether its projection was too, or was resampled from them on the CPU, so is never drawn
+    size_t                                                                  m_StaticBytes;                              // Held by every static map
+    bool                                                                    m_Baking;
+    int                                                                     m_BakeSize;                                 // Texels along each side of a baked face
+    bool                                                                    m_Referencing;
+    StaticCache                                                             m_StaticCache;
+    std::vector<RenderTexture*>                                             m_StaticCacheTextures;                      // In the cache's order: the static textures, then each object's reflection faces (and projection)
+    bool                                                                    m_StaticCached;                             // Whether this launch loaded them, so never renders them
+    std::chrono::high_resolution_clock::time_point                          m_StartupStart;
+    bool                                                                    m_FirstFrameReported;
+    bool                                                                    m_StartupReported;
+    bool                                                                    m_Progressive;
+    ProgressiveQueue                                                        m_StaticQueue;
+    std::vector<std::pair<int, int>>                                        m_StaticItems;                              // Indices: queue item; values: object viewing and face (or 6, for its projection alone)
+    std::vector<unsigned char>                                              m_StaticFaces;                              // Indices: object viewing; bits 0-5: faces done, bit 6: projection done (or not needed)
+    std::vector<RenderTexture*>                                             m_DynamicExternalProjections;               // Indices: object refracting
+    std::vector<RenderTexture*>                                             m_DynamicInternalProjections;               // Indices: object refracting
 
 
 #ifdef DXTK_AUDIO
@@ -5,8 +5,8 @@
 class GlassShader : public RefractionShader
 {
 public:
-	bool InitGlassShader(ID3D11Device* device, WCHAR* vsFilename, WCHAR* psFilename);
-	bool SetGlassShaderParameters(ID3D11DeviceContext* context,
+	bool InitGlassShader(RenderDevice* device, WCHAR* vsFilename, WCHAR* psFilename);
+	bool SetGlassShaderParameters(RenderContext* context,
 		DirectX::SimpleMath::Matrix* world,
 		DirectX::SimpleMath::Matrix* view,
 		DirectX::SimpleMath::Matrix* projection,
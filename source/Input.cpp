@@ -4,6 +4,18 @@
 
 Input::Input()
 {
+	m_quitApp = false;
+
+	m_GameInput.forward		= false;
+	m_GameInput.back		= false;
+	m_GameInput.right		= false;
+	m_GameInput.left		= false;
+	m_GameInput.up          = false;
+	m_GameInput.down		= false;
+	m_GameInput.hud			= false;
+	m_GameInput.record		= false;
+
+	m_GameInput.rotation	= DirectX::SimpleMath::Vector2::Zero;
 }
 
 Input::~Input()
@@ -16,20 +28,14 @@ void Input::Initialise(HWND window)
 	m_mouse = std::make_unique<DirectX::Mouse>();
 	m_mouse->SetWindow(window);
 	m_mouse->SetMode(DirectX::Mouse::MODE_RELATIVE);
-	m_quitApp = false;
-
-	m_GameInput.forward		= false;
-	m_GameInput.back		= false;
-	m_GameInput.right		= false;
-	m_GameInput.left		= false;
-	m_GameInput.up          = false;
-	m_GameInput.down		= false;
-
-	m_GameInput.rotation	= DirectX::SimpleMath::Vector2::Zero;
 }
 
 void Input::Update()
 {
+	// NB: Never initialised headlessly, so nothing is ever pressed
+	if (!m_keyboard)
+		return;
+
 	auto kb = m_keyboard->GetState();	//updates the basic keyboard state
 	m_KeyboardTracker.Update(kb);		//updates the more feature filled state. Press / release etc. 
 	auto mouse = m_mouse->GetState();   //updates the basic mouse state
@@ -47,6 +53,11 @@ void Input::Update()
 	m_GameInput.up			= kb.Space;
 	m_GameInput.down		= kb.LeftShift;
 
+	if (m_KeyboardTracker.IsKeyPressed(DirectX::Keyboard::Keys::F1))
+		m_GameInput.hud		= !m_GameInput.hud;
+	if (m_KeyboardTracker.IsKeyPressed(DirectX::Keyboard::Keys::F2))
+		m_GameInput.record	= !m_GameInput.record;
+
 	m_GameInput.rotation	= DirectX::SimpleMath::Vector2(mouse.x, mouse.y);
 }
 
@@ -12,6 +12,8 @@ struct InputCommands
 	bool left;
 	bool up;
 	bool down;
+	bool hud;		// Toggled by each press of F1
+	bool record;	// Toggled by each press of F2
 
 	DirectX::SimpleMath::Vector2 rotation;
 };
@@ -0,0 +1,150 @@
+#include "pch.h"
+#include "InstanceBatch.h"
+
+InstanceBatch::InstanceBatch()
+{
+	m_device = nullptr;
+	m_worldBuffer = nullptr;
+	m_materialBuffer = nullptr;
+	m_capacity = 0;
+}
+
+InstanceBatch::~InstanceBatch()
+{
+	Shutdown();
+}
+
+void InstanceBatch::Initialise(RenderDevice* device)
+{
+	Shutdown();
+
+	m_device = device;
+}
+
+void InstanceBatch::Shutdown()
+{
+	if (m_device)
+	{
+		m_device->Release(m_worldBuffer);
+		m_device->Release(m_materialBuffer);
+	}
+
+	m_worldBuffer = nullptr;
+	m_materialBuffer = nullptr;
+	m_capacity = 0;
+}
+
+void InstanceBatch::clear()
+{
+	m_worlds.clear();
+	m_materials.clear();
+	m_groups.clear();
+}
+
+void InstanceBatch::add(const DirectX::SimpleMath::Matrix& world, unsigned int material)
+{
+	m_worlds.push_back(world);
+	m_materials.push_back(material);
+}
+
+void InstanceBatch::Upload(RenderContext* context)
+{
+	int count = (int)m_worlds.size();
+	m_groups.clear();
+	if (count == 0 || !Reserve(count))
+		return;
+
+	// STEP 1: Counting sort by material, which keeps each material's instances in the order they were added
+	unsigned int materialCount = 0;
+	for (int i = 0; i < count; i++)
+		materialCount = (m_materials[i]+1 > materialCount) ? m_materials[i]+1 : materialCount;
+
+	std::vector<int> offsets(materialCount+1, 0);
+	for (int i = 0; i < count; i++)
+		offsets[m_materials[i]+1]++;
+	for (unsigned int m = 0; m < materialCount; m++)
+	{
+		if (offsets[m+1] > 0)
+			m_groups.push_back({ m, offsets[m], offsets[m+1] });
+		offsets[m+1] += offsets[m];
+	}
+
+	m_groupedWorlds.resize(count);
+	m_groupedMaterials.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		int j = offsets[m_materials[i]]++;
+		m_groupedWorlds[j] = m_worlds[i];
+		m_groupedMaterials[j] = m_materials[i];
+	}
+
+	// STEP 2: Each array is already laid out as its stream, so uploading is a straight copy
+	// NB: Streamed rows are read as-is, so unlike constant buffers the matrices are not transposed
+	void* worlds = context->Map(m_worldBuffer, count*sizeof(DirectX::XMFLOAT4X4));
+	memcpy(worlds, m_groupedWorlds.data(), count*sizeof(DirectX::XMFLOAT4X4));
+	context->Unmap(m_worldBuffer);
+
+	void* materials = context->Map(m_materialBuffer, count*sizeof(unsigned int));
+	memcpy(materials, m_groupedMaterials.data(), count*sizeof(unsigned int));
+	context->Unmap(m_materialBuffer);
+}
+
+void InstanceBatch::Bind(RenderContext* context)
+{
+	ID3D11Buffer* buffers[2] = { m_worldBuffer, m_materialBuffer };
+	unsigned int strides[2] = { sizeof(DirectX::XMFLOAT4X4), sizeof(unsigned int) };
+	unsigned int offsets[2] = { 0, 0 };
+	context->IASetVertexBuffers(1, 2, buffers, strides, offsets);
+}
+
+bool InstanceBatch::Reserve(int count)
+{
+	if (count <= m_capacity)
+		return true;
+
+	// Grow geometrically, so a batch filling up one instance at a time does not reallocate every frame
+	int capacity = (m_capacity*2 > count) ? m_capacity*2 : count;
+	capacity = (capacity < 64) ? 64 : capacity;
+	Shutdown();
+
+	RenderBufferDesc instanceBufferDesc;
+	instanceBufferDesc.bytes = capacity*sizeof(DirectX::XMFLOAT4X4);
+	instanceBufferDesc.bind = RenderBindVertexBuffer;
+	instanceBufferDesc.dynamic = true;
+	m_worldBuffer = m_device->CreateBuffer(instanceBufferDesc);
+	if (!m_worldBuffer)
+		return false;
+
+	instanceBufferDesc.bytes = capacity*sizeof(unsigned int);
+	m_materialBuffer = m_device->CreateBuffer(instanceBufferDesc);
+	if (!m_materialBuffer)
+		return false;
+
+	m_capacity = capacity;
+	return true;
+}
+
+int InstanceBatch::getCount()
+{
+	return (int)m_worlds.size();
+}
+
+int InstanceBatch::getGroupCount()
+{
+	return (int)m_groups.size();
+}
+
+unsigned int InstanceBatch::getGroupMaterial(int group)
+{
+	return m_groups[group].material;
+}
+
+int InstanceBatch::getGroupFirst(int group)
+{
+	return m_groups[group].first;
+}
+
+int InstanceBatch::getGroupSize(int group)
+{
+	return m_groups[group].size;
+}
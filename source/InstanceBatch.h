@@ -0,0 +1,52 @@
+#pragma once
+#include "RenderContext.h"
+#include "RenderDevice.h"
+
+// Instances of one mesh, kept as structure-of-arrays so each attribute uploads straight into its own vertex stream.
+// Uploading groups them by material, so each material's instances are one contiguous range, drawn with a single call
+class InstanceBatch
+{
+public:
+	InstanceBatch();
+	~InstanceBatch();
+
+	void							Initialise(RenderDevice* device);
+	void							Shutdown();
+
+	void							clear();
+	void							add(const DirectX::SimpleMath::Matrix& world, unsigned int material);
+
+	void							Upload(RenderContext* context);		// Groups by material and fills the instance buffers, growing them as needed
+	void							Bind(RenderContext* context);		// Vertex stream slots 1 (world) and 2 (material)
+
+	int								getCount();
+	// Valid after Upload
+	int								getGroupCount();
+	unsigned int					getGroupMaterial(int group);
+	int								getGroupFirst(int group);
+	int								getGroupSize(int group);
+
+private:
+	struct Group
+	{
+		unsigned int	material;
+		int				first;
+		int				size;
+	};
+
+	bool							Reserve(int count);
+
+	RenderDevice*					m_device;
+	ID3D11Buffer*					m_worldBuffer;
+	ID3D11Buffer*					m_materialBuffer;
+	int								m_capacity;
+
+	// As added
+	std::vector<DirectX::XMFLOAT4X4>	m_worlds;
+	std::vector<unsigned int>		m_materials;
+
+	// As uploaded, grouped by material
+	std::vector<DirectX::XMFLOAT4X4>	m_groupedWorlds;
+	std::vector<unsigned int>		m_groupedMaterials;
+	std::vector<Group>				m_groups;
+};
@@ -8,8 +8,11 @@ public:
 	using Shader::SetShaderParameters;
 	using Shader::EnableShader;
 
-	bool InitLightShader(ID3D11Device* device, WCHAR* vsFilename, WCHAR* psFilename);
-	bool SetLightShaderParameters(ID3D11DeviceContext* context,
+	LightShader();
+
+	bool InitLightShader(RenderDevice* device, WCHAR* vsFilename, WCHAR* psFilename, bool instanced = false);
+	void Shutdown() override;
+	bool SetLightShaderParameters(RenderContext* context,
 		DirectX::SimpleMath::Matrix* world,
 		DirectX::SimpleMath::Matrix* view,
 		DirectX::SimpleMath::Matrix* projection,
@@ -19,6 +22,9 @@ public:
 		ID3D11ShaderResourceView* normalTexture);
 
 protected:
+	using Shader::WriteConstants;	// NB: Shader is inherited privately, so what derives from this needs it passed on
+	using Shader::m_device;
+
 	//buffer for information of a single light
 	struct LightBufferType
 	{
@@ -1,6 +1,8 @@
 
 #include "pch.h"
 #include "Game.h"
+#include "SelfTest.h"
+#include <shellapi.h>
 
 #ifdef DXTK_AUDIO
 #include <Dbt.h>
@@ -39,12 +41,142 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
     if (!XMVerifyCPUSupport())
         return 1;
 
+	// NB: Arguments are taken to be plain ASCII, like the file names they hold
+	std::vector<std::string> arguments;
+	int argumentCount = 0;
+	LPWSTR* wideArguments = CommandLineToArgvW(GetCommandLineW(), &argumentCount);
+	for (int i = 1; wideArguments && i < argumentCount; i++)
+	{
+		std::wstring argument = wideArguments[i];
+		arguments.push_back(std::string(argument.begin(), argument.end()));
+	}
+	LocalFree(wideArguments);
+
+	// Options may come in any order; those taking values skip past them
+	// -compare <baseline.json> <current.json> [-threshold 0.1] checks one benchmark's summary against another's, and quits.
+	// Exits with 2 if anything regressed, and writes what did to benchmark_comparison.txt
+	// -selftest runs every module's synthetic benchmark, checking what each computes; exits with 2 if any check failed, and writes the report to selftest.txt
+	// -convert <scene> <output> rewrites a scene as binary (or as text, if output ends in .txt), and quits
+	// -benchmark <camera path> [-warmup 120] [-frames 600] [-output benchmark] flies the path, writes the timings out and quits
+	// -bake [-size 720] ray traces each glass object's static captures once the first frame is drawn, writes them for later runs to load, and quits
+	// -reference draws the first glass object's static background on the CPU too once the first frame is drawn, writes both out with their PSNR to reference_comparison.txt, and quits
+	// -scene <file> draws another scene, in either format, instead of scene.txt
+	// -projection cube|octahedral|paraboloid lays the environment maps out as six faces, or resamples them into one target
+	// -progressive [-budget 4] shows the first frame straight away, then renders the static environments a few faces a frame within the budget (in milliseconds)
+	std::string compareBaseline, compareCurrent, convertScene, convertOutput, benchmarkPath, scenePath, projection;
+	std::string output = "benchmark";
+	int warmupFrames = 120, measuredFrames = 600, bakeSize = 720;
+	double threshold = 0.1, budget = 4.0;
+	bool selfTest = false, bake = false, reference = false, progressive = false;
+	for (int i = 0; i < (int)arguments.size(); i++)
+	{
+		const std::string& argument = arguments[i];
+		int values = (int)arguments.size()-1-i;
+
+		if (argument == "-compare" && values >= 2)
+		{
+			compareBaseline = arguments[++i];
+			compareCurrent = arguments[++i];
+		}
+		else if (argument == "-selftest")
+			selfTest = true;
+		else if (argument == "-convert" && values >= 2)
+		{
+			convertScene = arguments[++i];
+			convertOutput = arguments[++i];
+		}
+		else if (argument == "-threshold" && values >= 1)
+			threshold = atof(arguments[++i].c_str());
+		else if (argument == "-benchmark" && values >= 1)
+			benchmarkPath = arguments[++i];
+		else if (argument == "-warmup" && values >= 1)
+			warmupFrames = atoi(arguments[++i].c_str());
+		else if (argument == "-frames" && values >= 1)
+			measuredFrames = atoi(arguments[++i].c_str());
+		else if (argument == "-output" && values >= 1)
+			output = arguments[++i];
+		else if (argument == "-bake")
+			bake = true;
+		else if (argument == "-reference")
+			reference = true;
+		else if (argument == "-size" && values >= 1)
+			bakeSize = atoi(arguments[++i].c_str());
+		else if (argument == "-scene" && values >= 1)
+			scenePath = arguments[++i];
+		else if (argument == "-projection" && values >= 1)
+			projection = arguments[++i];
+		else if (argument == "-progressive")
+			progressive = true;
+		else if (argument == "-budget" && values >= 1)
+			budget = atof(arguments[++i].c_str());
+	}
+
+	if (!compareBaseline.empty())
+	{
+		std::string report;
+		bool regressed = Benchmark::compare(compareBaseline, compareCurrent, threshold, report);
+		OutputDebugStringA(report.c_str());
+
+		FILE* file = fopen("benchmark_comparison.txt", "w");
+		if (file)
+		{
+			fputs(report.c_str(), file);
+			fclose(file);
+		}
+
+		return (regressed) ? 2 : 0;
+	}
+
+	if (selfTest)
+	{
+		SelfTest test;
+		bool passed = test.run();
+		OutputDebugStringA(test.getReport().c_str());
+
+		FILE* file = fopen("selftest.txt", "w");
+		if (file)
+		{
+			fputs(test.getReport().c_str(), file);
+			fclose(file);
+		}
+
+		return (passed) ? 0 : 2;
+	}
+
+	if (!convertScene.empty())
+	{
+		Scene scene;
+		if (!scene.load(convertScene))
+			return 1;
+
+		bool text = convertOutput.size() >= 4 && convertOutput.compare(convertOutput.size()-4, 4, ".txt") == 0;
+		return ((text) ? scene.saveText(convertOutput) : scene.saveBinary(convertOutput)) ? 0 : 1;
+	}
+
     HRESULT hr = CoInitializeEx(nullptr, COINITBASE_MULTITHREADED);
     if (FAILED(hr))
         return 1;
 
     g_game = std::make_unique<Game>();
 
+	if (!benchmarkPath.empty() && !g_game->SetBenchmark(benchmarkPath, warmupFrames, measuredFrames, output))
+		return 1;
+
+	if (bake && !g_game->SetBake(bakeSize))
+		return 1;
+
+	if (reference)
+		g_game->SetReference();
+
+	if (!scenePath.empty() && !g_game->SetScene(scenePath))
+		return 1;
+
+	if (!projection.empty() && !g_game->SetProjection(projection))
+		return 1;
+
+	if (progressive && !g_game->SetProgressive(budget))
+		return 1;
+
     // Register class and create window
     {
         // Register Windows Class information. 
@@ -0,0 +1,447 @@
+#include "pch.h"
+#include "OcclusionBuffer.h"
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <emmintrin.h>
+#include <random>
+
+namespace
+{
+	// Row-major, row vectors: a then b
+	void Multiply(const float a[16], const float b[16], float product[16])
+	{
+		for (int row = 0; row < 4; row++)
+			for (int column = 0; column < 4; column++)
+				product[4*row+column] = a[4*row]*b[column]+a[4*row+1]*b[4+column]+a[4*row+2]*b[8+column]+a[4*row+3]*b[12+column];
+	}
+
+	void Transform(const float position[3], const float m[16], float clip[4])
+	{
+		for (int j = 0; j < 4; j++)
+			clip[j] = position[0]*m[j]+position[1]*m[4+j]+position[2]*m[8+j]+m[12+j];
+	}
+
+	float HorizontalMax(__m128 value)
+	{
+		value = _mm_max_ps(value, _mm_movehl_ps(value, value));
+		value = _mm_max_ss(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 1, 1, 1)));
+		return _mm_cvtss_f32(value);
+	}
+}
+
+OcclusionBuffer::OcclusionBuffer()
+{
+	m_width = 0;
+	m_height = 0;
+	m_tilesX = 0;
+	m_tilesY = 0;
+	for (int i = 0; i < 16; i++)
+		m_viewProjection[i] = (i%5 == 0) ? 1.0f : 0.0f;
+	m_triangleCount = 0;
+}
+
+void OcclusionBuffer::Begin(const float viewProjection[16], int width, int height)
+{
+	m_tilesX = std::max(1, (width+TileSize-1)/TileSize);
+	m_tilesY = std::max(1, (height+TileSize-1)/TileSize);
+	m_width = m_tilesX*TileSize;
+	m_height = m_tilesY*TileSize;
+	for (int i = 0; i < 16; i++)
+		m_viewProjection[i] = viewProjection[i];
+
+	m_depth.assign(m_width*m_height, 1.0f);
+	m_tileDepth.assign(m_tilesX*m_tilesY, 1.0f);
+	m_triangleCount = 0;
+}
+
+void OcclusionBuffer::RenderOccluder(const float* triangles, int triangleCount, const float world[16])
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+	renderTriangles(triangles, triangleCount, world, [&](const Setup& triangle) {
+		__m128 edgeA[3] = { _mm_set1_ps(triangle.edgeA[0]), _mm_set1_ps(triangle.edgeA[1]), _mm_set1_ps(triangle.edgeA[2]) };
+		__m128 depthX = _mm_set1_ps(triangle.depthX), depthMin = _mm_set1_ps(triangle.depthMin), depthMax = _mm_set1_ps(triangle.depthMax);
+		__m128 low = _mm_set1_ps((float)triangle.minX), high = _mm_set1_ps((float)triangle.maxX+1.0f);
+
+		for (int y = triangle.minY; y <= triangle.maxY; y++)
+		{
+			float py = (float)y+0.5f;
+			__m128 rows[3];
+			for (int i = 0; i < 3; i++)
+				rows[i] = _mm_set1_ps(triangle.edgeB[i]*py+triangle.edgeC[i]);
+			__m128 depthRow = _mm_set1_ps(triangle.depthY*py+triangle.depthC);
+
+			// NB: Rows are whole tiles wide, so four pixels from a multiple of four never run off the end; lanes outside the triangle's bounds are masked off
+			float* depth = &m_depth[y*m_width];
+			for (int x = triangle.minX & ~3; x <= triangle.maxX; x += 4)
+			{
+				__m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+				__m128 inside = _mm_and_ps(_mm_cmpge_ps(px, low), _mm_cmple_ps(px, high));
+				for (int i = 0; i < 3; i++)
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[i], px), rows[i]), zero));
+				if (!_mm_movemask_ps(inside))
+					continue;
+
+				__m128 z = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(depthX, px), depthRow), depthMin), depthMax);
+				__m128 old = _mm_loadu_ps(depth+x);
+				z = _mm_or_ps(_mm_and_ps(inside, z), _mm_andnot_ps(inside, old));
+				_mm_storeu_ps(depth+x, _mm_min_ps(old, z));
+			}
+		}
+	});
+}
+
+void OcclusionBuffer::RenderOccluderReference(const float* triangles, int triangleCount, const float world[16])
+{
+	// Same sums as RenderOccluder, so either gives the same depths
+	renderTriangles(triangles, triangleCount, world, [&](const Setup& triangle) {
+		for (int y = triangle.minY; y <= triangle.maxY; y++)
+		{
+			float py = (float)y+0.5f;
+			float rows[3];
+			for (int i = 0; i < 3; i++)
+				rows[i] = triangle.edgeB[i]*py+triangle.edgeC[i];
+			float depthRow = triangle.depthY*py+triangle.depthC;
+
+			float* depth = &m_depth[y*m_width];
+			for (int x = triangle.minX; x <= triangle.maxX; x++)
+			{
+				float px = (float)x+0.5f;
+				if (triangle.edgeA[0]*px+rows[0] < 0.0f || triangle.edgeA[1]*px+rows[1] < 0.0f || triangle.edgeA[2]*px+rows[2] < 0.0f)
+					continue;
+
+				float z = std::min(std::max(triangle.depthX*px+depthRow, triangle.depthMin), triangle.depthMax);
+				depth[x] = std::min(depth[x], z);
+			}
+		}
+	});
+}
+
+void OcclusionBuffer::End()
+{
+	for (int ty = 0; ty < m_tilesY; ty++)
+	{
+		for (int tx = 0; tx < m_tilesX; tx++)
+		{
+			const float* depth = &m_depth[ty*TileSize*m_width+tx*TileSize];
+			__m128 farthest = _mm_setzero_ps();
+			for (int y = 0; y < TileSize; y++, depth += m_width)
+				for (int x = 0; x < TileSize; x += 4)
+					farthest = _mm_max_ps(farthest, _mm_loadu_ps(depth+x));
+
+			m_tileDepth[ty*m_tilesX+tx] = HorizontalMax(farthest);
+		}
+	}
+}
+
+bool OcclusionBuffer::TestBox(const float min[3], const float max[3])
+{
+	int rect[4];
+	float nearest;
+	if (!project(min, max, rect, nearest))
+		return true;
+
+	for (int ty = rect[1]/TileSize; ty <= rect[3]/TileSize; ty++)
+		for (int tx = rect[0]/TileSize; tx <= rect[2]/TileSize; tx++)
+			if (nearest <= m_tileDepth[ty*m_tilesX+tx])
+				return true;
+
+	return false;
+}
+
+bool OcclusionBuffer::TestBoxReference(const float min[3], const float max[3])
+{
+	int rect[4];
+	float nearest;
+	if (!project(min, max, rect, nearest))
+		return true;
+
+	for (int y = rect[1]; y <= rect[3]; y++)
+		for (int x = rect[0]; x <= rect[2]; x++)
+			if (nearest <= m_depth[y*m_width+x])
+				return true;
+
+	return false;
+}
+
+int OcclusionBuffer::getWidth()
+{
+	return m_width;
+}
+
+int OcclusionBuffer::getHeight()
+{
+	return m_height;
+}
+
+const float* OcclusionBuffer::getDepth()
+{
+	return m_depth.data();
+}
+
+int OcclusionBuffer::getTriangleCount()
+{
+	return m_triangleCount;
+}
+
+void OcclusionBuffer::makeSphere(int rings, int segments, std::vector<float>& triangles)
+{
+	// NB: Every vertex is on the sphere, so every face is inside it
+	auto vertex = [&](int ring, int segment) {
+		float theta = 3.14159265f*ring/rings, phi = 6.28318531f*segment/segments;
+		triangles.push_back(sinf(theta)*cosf(phi));
+		triangles.push_back(cosf(theta));
+		triangles.push_back(sinf(theta)*sinf(phi));
+	};
+
+	triangles.clear();
+	for (int ring = 0; ring < rings; ring++)
+	{
+		for (int segment = 0; segment < segments; segment++)
+		{
+			if (ring > 0)
+			{
+				vertex(ring, segment);
+				vertex(ring+1, segment);
+				vertex(ring, segment+1);
+			}
+			if (ring < rings-1)
+			{
+				vertex(ring, segment+1);
+				vertex(ring+1, segment);
+				vertex(ring+1, segment+1);
+			}
+		}
+	}
+}
+
+void OcclusionBuffer::makeBox(const float min[3], const float max[3], std::vector<float>& triangles)
+{
+	// Corners numbered by bits: x, then y, then z
+	const int faces[6][4] = { { 0, 2, 3, 1 }, { 4, 5, 7, 6 }, { 0, 1, 5, 4 }, { 2, 6, 7, 3 }, { 0, 4, 6, 2 }, { 1, 3, 7, 5 } };
+	const int corners[6] = { 0, 1, 2, 0, 2, 3 };
+
+	triangles.clear();
+	for (int f = 0; f < 6; f++)
+	{
+		for (int k = 0; k < 6; k++)
+		{
+			int corner = faces[f][corners[k]];
+			triangles.push_back((corner & 1) ? max[0] : min[0]);
+			triangles.push_back((corner & 2) ? max[1] : min[1]);
+			triangles.push_back((corner & 4) ? max[2] : min[2]);
+		}
+	}
+}
+
+bool OcclusionBuffer::benchmark(int occluders, int occludees, int repeats, std::string& report)
+{
+	std::mt19937 random(502);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	// From the origin down +z, 60 degrees high at 16:9, as a Direct3D (left-handed) projection
+	const float nearPlane = 0.1f, farPlane = 100.0f, yScale = 1.0f/tanf(0.5f*1.04719755f), xScale = yScale*9.0f/16.0f;
+	const float viewProjection[16] = {
+		xScale, 0.0f, 0.0f, 0.0f,
+		0.0f, yScale, 0.0f, 0.0f,
+		0.0f, 0.0f, farPlane/(farPlane-nearPlane), 1.0f,
+		0.0f, 0.0f, -nearPlane*farPlane/(farPlane-nearPlane), 0.0f,
+	};
+
+	// Large spheres near the camera, in front of a crowd of small boxes
+	std::vector<float> sphere;
+	makeSphere(8, 12, sphere);
+	std::vector<std::vector<float>> worlds;
+	for (int i = 0; i < occluders; i++)
+	{
+		float z = 6.0f+4.0f*unit(random), scale = 1.5f+0.5f*unit(random);
+		worlds.push_back({ scale, 0.0f, 0.0f, 0.0f, 0.0f, scale, 0.0f, 0.0f, 0.0f, 0.0f, scale, 0.0f, 0.6f*z*unit(random), 0.35f*z*unit(random), z, 1.0f });
+	}
+
+	std::vector<float> boxes;
+	for (int i = 0; i < occludees; i++)
+	{
+		float z = 25.0f+15.0f*unit(random), size = 0.4f+0.2f*unit(random);
+		float centre[3] = { 0.55f*z*unit(random), 0.3f*z*unit(random), z };
+		for (int j = 0; j < 3; j++)
+			boxes.push_back(centre[j]-size);
+		for (int j = 0; j < 3; j++)
+			boxes.push_back(centre[j]+size);
+	}
+
+	const int width = 256, height = 144;
+	OcclusionBuffer simd, reference, fine;
+
+	double simdTime = 0.0, referenceTime = 0.0;
+	for (int r = 0; r < repeats; r++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		reference.Begin(viewProjection, width, height);
+		for (int i = 0; i < occluders; i++)
+			reference.RenderOccluderReference(sphere.data(), (int)sphere.size()/9, worlds[i].data());
+		reference.End();
+		auto middle = std::chrono::high_resolution_clock::now();
+		simd.Begin(viewProjection, width, height);
+		for (int i = 0; i < occluders; i++)
+			simd.RenderOccluder(sphere.data(), (int)sphere.size()/9, worlds[i].data());
+		simd.End();
+		auto end = std::chrono::high_resolution_clock::now();
+
+		referenceTime += std::chrono::duration<double, std::micro>(middle-start).count();
+		simdTime += std::chrono::duration<double, std::micro>(end-middle).count();
+	}
+
+	int differing = 0;
+	for (int i = 0; i < width*height; i++)
+		differing += (simd.m_depth[i] != reference.m_depth[i]);
+
+	// What the boxes would hide from, were the buffer four times the resolution
+	fine.Begin(viewProjection, 4*width, 4*height);
+	for (int i = 0; i < occluders; i++)
+		fine.RenderOccluder(sphere.data(), (int)sphere.size()/9, worlds[i].data());
+	fine.End();
+
+	double tileTime = 0.0, pixelTime = 0.0;
+	int tileHidden = 0, pixelHidden = 0, fineHidden = 0, wronglyHidden = 0;
+	for (int r = 0; r < repeats; r++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		int hidden[2] = { 0, 0 };
+		for (int i = 0; i < occludees; i++)
+			hidden[0] += !simd.TestBox(&boxes[6*i], &boxes[6*i+3]);
+		auto middle = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < occludees; i++)
+			hidden[1] += !simd.TestBoxReference(&boxes[6*i], &boxes[6*i+3]);
+		auto end = std::chrono::high_resolution_clock::now();
+
+		tileTime += std::chrono::duration<double, std::micro>(middle-start).count();
+		pixelTime += std::chrono::duration<double, std::micro>(end-middle).count();
+		tileHidden = hidden[0];
+		pixelHidden = hidden[1];
+	}
+	for (int i = 0; i < occludees; i++)
+	{
+		bool visible = fine.TestBoxReference(&boxes[6*i], &boxes[6*i+3]);
+		fineHidden += !visible;
+		wronglyHidden += (visible && !simd.TestBox(&boxes[6*i], &boxes[6*i+3]));
+	}
+
+	char text[512];
+	snprintf(text, sizeof(text), "Occlusion culling %d boxes behind %d spheres (%d triangles each) at %dx%d:\n"
+		"  Rasterising: %8.1fus scalar, %8.1fus SSE (%.2fx), %d pixels differing\n"
+		"  Testing:     %8.1fus by pixel, %8.1fus by tile\n"
+		"  Hidden:      %d by tile, %d by pixel, %d by pixel at %dx%d; %d hidden by tile that are visible there\n",
+		occludees, occluders, (int)sphere.size()/9, width, height,
+		referenceTime/repeats, simdTime/repeats, (simdTime > 0.0) ? referenceTime/simdTime : 0.0, differing,
+		pixelTime/repeats, tileTime/repeats,
+		tileHidden, pixelHidden, fineHidden, 4*width, 4*height, wronglyHidden);
+	report = text;
+
+	return differing == 0 && tileHidden <= pixelHidden && wronglyHidden == 0;
+}
+
+bool OcclusionBuffer::setup(const float clip[3][4], Setup& triangle)
+{
+	// NB: Anything reaching in front of the near plane is skipped rather than clipped; an occluder missing a triangle only hides less
+	float x[3], y[3], z[3];
+	for (int v = 0; v < 3; v++)
+	{
+		if (clip[v][2] < 0.0f || clip[v][3] <= 0.0f)
+			return false;
+
+		float inverseW = 1.0f/clip[v][3];
+		x[v] = (0.5f+0.5f*clip[v][0]*inverseW)*m_width;
+		y[v] = (0.5f-0.5f*clip[v][1]*inverseW)*m_height;
+		z[v] = clip[v][2]*inverseW;
+	}
+
+	// Either winding, as depth doesn't care which way a triangle faces
+	float area = (x[1]-x[0])*(y[2]-y[0])-(x[2]-x[0])*(y[1]-y[0]);
+	if (fabsf(area) < 1e-6f)
+		return false;
+	if (area < 0.0f)
+	{
+		std::swap(x[1], x[2]);
+		std::swap(y[1], y[2]);
+		std::swap(z[1], z[2]);
+		area = -area;
+	}
+
+	triangle.minX = (int)std::max(0.0f, floorf(std::min(x[0], std::min(x[1], x[2]))));
+	triangle.maxX = (int)std::min((float)(m_width-1), floorf(std::max(x[0], std::max(x[1], x[2]))));
+	triangle.minY = (int)std::max(0.0f, floorf(std::min(y[0], std::min(y[1], y[2]))));
+	triangle.maxY = (int)std::min((float)(m_height-1), floorf(std::max(y[0], std::max(y[1], y[2]))));
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+		return false;
+
+	for (int i = 0; i < 3; i++)
+	{
+		int j = (i+1)%3;
+		triangle.edgeA[i] = y[i]-y[j];
+		triangle.edgeB[i] = x[j]-x[i];
+		triangle.edgeC[i] = -(triangle.edgeA[i]*x[i]+triangle.edgeB[i]*y[i]);
+	}
+
+	triangle.depthX = ((z[1]-z[0])*(y[2]-y[0])-(z[2]-z[0])*(y[1]-y[0]))/area;
+	triangle.depthY = ((z[2]-z[0])*(x[1]-x[0])-(z[1]-z[0])*(x[2]-x[0]))/area;
+	triangle.depthC = z[0]-triangle.depthX*x[0]-triangle.depthY*y[0];
+
+	// NB: Pixel centres near the edges are extrapolated, so are held to the triangle's own depths
+	triangle.depthMin = std::min(z[0], std::min(z[1], z[2]));
+	triangle.depthMax = std::max(z[0], std::max(z[1], z[2]));
+
+	return true;
+}
+
+template <class Rasterise>
+void OcclusionBuffer::renderTriangles(const float* triangles, int triangleCount, const float world[16], Rasterise rasterise)
+{
+	float worldViewProjection[16];
+	Multiply(world, m_viewProjection, worldViewProjection);
+
+	for (int t = 0; t < triangleCount; t++)
+	{
+		float clip[3][4];
+		for (int v = 0; v < 3; v++)
+			Transform(&triangles[9*t+3*v], worldViewProjection, clip[v]);
+
+		Setup triangle;
+		if (!setup(clip, triangle))
+			continue;
+
+		rasterise(triangle);
+		m_triangleCount++;
+	}
+}
+
+bool OcclusionBuffer::project(const float min[3], const float max[3], int rect[4], float& nearest)
+{
+	float low[2] = { FLT_MAX, FLT_MAX }, high[2] = { -FLT_MAX, -FLT_MAX };
+	nearest = FLT_MAX;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		float position[3] = { (corner & 1) ? max[0] : min[0], (corner & 2) ? max[1] : min[1], (corner & 4) ? max[2] : min[2] };
+		float clip[4];
+		Transform(position, m_viewProjection, clip);
+		if (clip[2] < 0.0f || clip[3] <= 0.0f)
+			return false;
+
+		float inverseW = 1.0f/clip[3];
+		float x = (0.5f+0.5f*clip[0]*inverseW)*m_width, y = (0.5f-0.5f*clip[1]*inverseW)*m_height;
+		low[0] = std::min(low[0], x);
+		low[1] = std::min(low[1], y);
+		high[0] = std::max(high[0], x);
+		high[1] = std::max(high[1], y);
+		nearest = std::min(nearest, clip[2]*inverseW);
+	}
+
+	// Every pixel the box touches; off screen altogether counts as unknown, leaving it to frustum culling
+	rect[0] = (int)std::max(0.0f, floorf(low[0]));
+	rect[1] = (int)std::max(0.0f, floorf(low[1]));
+	rect[2] = (int)std::min((float)(m_width-1), floorf(high[0]));
+	rect[3] = (int)std::min((float)(m_height-1), floorf(high[1]));
+
+	return rect[0] <= rect[2] && rect[1] <= rect[3];
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// A low-resolution depth buffer of a few large occluders, rasterised on the CPU, that other objects' boxes are tested against before they are drawn.
+// Depth is z/w, as Direct3D's projections leave it (0 at the near plane, 1 at the far). Each tile keeps its farthest depth, so a box is hidden if it is further than all of its tiles.
+// NB: Simpler than masked occlusion culling, which keeps a coverage mask and two depths per tile rather than every pixel's depth; at this resolution a full buffer is no burden
+class OcclusionBuffer
+{
+public:
+	static const int				TileSize = 8;		// Pixels along each side of a tile
+
+	OcclusionBuffer();
+
+	void							Begin(const float viewProjection[16], int width, int height);	// Clears to the far plane. Row-major (SimpleMath) matrix; sizes are rounded up to whole tiles
+
+	// Triangles are nine floats each (three positions) in model space; any reaching in front of the near plane are skipped.
+	// RenderOccluder does four pixels at a time with SSE; RenderOccluderReference is the scalar equivalent
+	void							RenderOccluder(const float* triangles, int triangleCount, const float world[16]);
+	void							RenderOccluderReference(const float* triangles, int triangleCount, const float world[16]);
+	void							End();		// Finds each tile's farthest depth, for TestBox
+
+	// Whether any of a world-space box might be visible. TestBox reads tiles; TestBoxReference reads every pixel the box covers
+	bool							TestBox(const float min[3], const float max[3]);
+	bool							TestBoxReference(const float min[3], const float max[3]);
+
+	int								getWidth();
+	int								getHeight();
+	const float*					getDepth();			// Row by row
+	int								getTriangleCount();	// Rasterised since Begin
+
+	// Occluders must never hide more than what they stand in for, so these are inscribed in the shape they are named after
+	static void						makeSphere(int rings, int segments, std::vector<float>& triangles);	// Unit sphere
+	static void						makeBox(const float min[3], const float max[3], std::vector<float>& triangles);
+
+	// Rasterises occluders spheres in front of occludees boxes, repeats times, both ways; reports times, and how many boxes each test hides against a buffer of four times the resolution.
+	// False if the two rasterisers disagree on any pixel, or the tile test hides anything the pixel test or the finer buffer would not
+	static bool						benchmark(int occluders, int occludees, int repeats, std::string& report);
+
+private:
+	// A triangle ready to rasterise: its pixel bounds, edge functions (inside where all three are >= 0) and depth plane
+	struct Setup
+	{
+		int		minX, minY, maxX, maxY;
+		float	edgeA[3], edgeB[3], edgeC[3];
+		float	depthX, depthY, depthC;
+		float	depthMin, depthMax;
+	};
+
+	bool							setup(const float clip[3][4], Setup& triangle);		// False if nothing to rasterise
+	template <class Rasterise>
+	void							renderTriangles(const float* triangles, int triangleCount, const float world[16], Rasterise rasterise);
+	bool							project(const float min[3], const float max[3], int rect[4], float& nearest);	// False if it reaches in front of the near plane
+
+	int								m_width;
+	int								m_height;
+	int								m_tilesX;
+	int								m_tilesY;
+	float							m_viewProjection[16];
+	std::vector<float>				m_depth;
+	std::vector<float>				m_tileDepth;	// Farthest in each tile, row by row
+	int								m_triangleCount;
+};
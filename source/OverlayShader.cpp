@@ -1,7 +1,7 @@
 #include "pch.h"
 #include "OverlayShader.h"
 
-bool OverlayShader::InitOverlayShader(ID3D11Device* device, WCHAR* vsFilename, WCHAR* psFilename)
+bool OverlayShader::InitOverlayShader(RenderDevice* device, WCHAR* vsFilename, WCHAR* psFilename)
 {
 	if (!InitShader(device, vsFilename, psFilename))
 	{
@@ -11,7 +11,7 @@ bool OverlayShader::InitOverlayShader(ID3D11Device* device, WCHAR* vsFilename, W
 	return true;
 }
 
-bool OverlayShader::SetOverlayShaderParameters(ID3D11DeviceContext* context, DirectX::SimpleMath::Matrix* world, DirectX::SimpleMath::Matrix* view, DirectX::SimpleMath::Matrix* projection, float time, ID3D11ShaderResourceView* texture, ID3D11ShaderResourceView* overlayTexture, ID3D11ShaderResourceView* overlayAlphaMap)
+bool OverlayShader::SetOverlayShaderParameters(RenderContext* context, DirectX::SimpleMath::Matrix* world, DirectX::SimpleMath::Matrix* view, DirectX::SimpleMath::Matrix* projection, float time, ID3D11ShaderResourceView* texture, ID3D11ShaderResourceView* overlayTexture, ID3D11ShaderResourceView* overlayAlphaMap)
 {
 	SetShaderParameters(context, world, view, projection, time);
 
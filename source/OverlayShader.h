@@ -5,8 +5,8 @@
 class OverlayShader : public Shader
 {
 public:
-	bool InitOverlayShader(ID3D11Device* device, WCHAR* vsFilename, WCHAR* psFilename);
-	bool SetOverlayShaderParameters(ID3D11DeviceContext* context,
+	bool InitOverlayShader(RenderDevice* device, WCHAR* vsFilename, WCHAR* psFilename);
+	bool SetOverlayShaderParameters(RenderContext* context,
 		DirectX::SimpleMath::Matrix* world,
 		DirectX::SimpleMath::Matrix* view,
 		DirectX::SimpleMath::Matrix* projection,
@@ -0,0 +1,227 @@
+#include "pch.h"
+#include "PerformanceHud.h"
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	// One named scope's time per frame, on each side
+	struct PassRow
+	{
+		const char*	name;
+		int			depth;
+		double		cpu;
+		double		gpu;
+	};
+
+	std::string FormatBytes(double bytes)
+	{
+		char text[32];
+		if (bytes >= 1024.0*1024.0)
+			snprintf(text, sizeof(text), "%.1f MB", bytes/(1024.0*1024.0));
+		else
+			snprintf(text, sizeof(text), "%.1f KB", bytes/1024.0);
+
+		return text;
+	}
+}
+
+PerformanceHud::PerformanceHud()
+{
+	m_profiler = nullptr;
+	m_refreshSeconds = 0.25;
+	m_visible = false;
+
+	for (int i = 0; i < CounterCount; i++)
+	{
+		m_counts[i] = 0;
+		m_totals[i] = 0;
+	}
+	m_frames = 0;
+	m_elapsed = 0.0;
+
+	m_nextFrameTime = 0;
+	m_rebuildCount = 0;
+}
+
+void PerformanceHud::Initialise(Profiler* profiler, double refreshSeconds)
+{
+	m_profiler = profiler;
+	m_refreshSeconds = refreshSeconds;
+
+	for (int i = 0; i < CounterCount; i++)
+	{
+		m_counts[i] = 0;
+		m_totals[i] = 0;
+	}
+	m_frames = 0;
+	m_elapsed = 0.0;
+
+	m_frameTimes.clear();
+	m_nextFrameTime = 0;
+	m_text.clear();
+	m_rebuildCount = 0;
+}
+
+void PerformanceHud::setVisible(bool visible)
+{
+	m_visible = visible;
+}
+
+bool PerformanceHud::getVisible()
+{
+	return m_visible;
+}
+
+void PerformanceHud::endFrame(double frameSeconds)
+{
+	if (m_frameTimes.size() < FrameWindow)
+		m_frameTimes.push_back(frameSeconds);
+	else
+		m_frameTimes[m_nextFrameTime] = frameSeconds;
+	m_nextFrameTime = (m_nextFrameTime+1)%FrameWindow;
+
+	for (int i = 0; i < CounterCount; i++)
+	{
+		m_totals[i] += m_counts[i];
+		m_counts[i] = 0;
+	}
+	m_frames++;
+	m_elapsed += frameSeconds;
+
+	// NB: Nothing is formatted while hidden, and the text is rebuilt as soon as the overlay is shown
+	if (!m_visible)
+		m_text.clear();
+	else if (m_elapsed >= m_refreshSeconds || m_text.empty())
+		Rebuild();
+	else
+		return;
+
+	for (int i = 0; i < CounterCount; i++)
+		m_totals[i] = 0;
+	m_frames = 0;
+	m_elapsed = 0.0;
+}
+
+const std::wstring& PerformanceHud::getText()
+{
+	return m_text;
+}
+
+int PerformanceHud::getRebuildCount()
+{
+	return m_rebuildCount;
+}
+
+const char* PerformanceHud::getCounterName(Counter counter)
+{
+	static const char* names[CounterCount] = {
+		"Draw calls",
+		"State changes",
+		"Target switches",
+		"Constant bytes",
+		"Matrices reused",
+		"Objects occluded",
+		"Captures shared",
+		"Draws shared",
+		"Pixels shared",
+		"Environment maps",
+	};
+
+	return names[counter];
+}
+
+void PerformanceHud::Rebuild()
+{
+	std::string text;
+	char line[128];
+
+	// Frame times
+	std::vector<double> times = m_frameTimes;
+	std::sort(times.begin(), times.end());
+
+	double mean = 0.0;
+	for (int i = 0; i < (int)times.size(); i++)
+		mean += times[i];
+	mean /= std::max(1, (int)times.size());
+
+	auto percentile = [&times](double p) { return (times.empty()) ? 0.0 : times[(int)(p*(times.size()-1))]; };
+	snprintf(line, sizeof(line), "%.0f fps  %.2f ms  (p50 %.2f  p95 %.2f  p99 %.2f)\n", (mean > 0.0) ? 1.0/mean : 0.0, 1000.0*mean, 1000.0*percentile(0.5), 1000.0*percentile(0.95), 1000.0*percentile(0.99));
+	text += line;
+
+	// Counters, per frame since the last rebuild
+	for (int i = 0; i < CounterCount; i++)
+	{
+		double perFrame = (double)m_totals[i]/std::max(1, m_frames);
+		if (i == ConstantBytes || i == EnvironmentBytes)
+			snprintf(line, sizeof(line), "%-18s %s\n", getCounterName((Counter)i), FormatBytes(perFrame).c_str());
+		else
+			snprintf(line, sizeof(line), "%-18s %.0f\n", getCounterName((Counter)i), perFrame);
+		text += line;
+	}
+
+	// Passes, averaged over the frames still in the profiler's latest events
+	if (m_profiler)
+	{
+		std::vector<Profiler::Event> events = m_profiler->getLatestEvents(EventWindow);
+
+		// NB: The oldest frame on each side has likely lost its start to the window, so is left out
+		unsigned int device = m_profiler->getDeviceThread();
+		unsigned int firstCpu = ~0u, lastCpu = 0, firstGpu = ~0u, lastGpu = 0;
+		for (int i = 0; i < (int)events.size(); i++)
+		{
+			if (events[i].thread == device)
+			{
+				firstCpu = std::min(firstCpu, events[i].frame);
+				lastCpu = std::max(lastCpu, events[i].frame);
+			}
+			else if (events[i].thread == Profiler::GpuThread)
+			{
+				firstGpu = std::min(firstGpu, events[i].frame);
+				lastGpu = std::max(lastGpu, events[i].frame);
+			}
+		}
+		int cpuFrames = (firstCpu < lastCpu) ? lastCpu-firstCpu : 1;
+		int gpuFrames = (firstGpu < lastGpu) ? lastGpu-firstGpu : 1;
+
+		std::vector<PassRow> rows;
+		for (int i = 0; i < (int)events.size(); i++)
+		{
+			const Profiler::Event& event = events[i];
+			bool cpu = (event.thread == device && (event.frame > firstCpu || firstCpu == lastCpu));
+			bool gpu = (event.thread == Profiler::GpuThread && (event.frame > firstGpu || firstGpu == lastGpu));
+			if ((!cpu && !gpu) || event.depth > 1)
+				continue;
+
+			int row = 0;
+			while (row < (int)rows.size() && (rows[row].depth != event.depth || strcmp(rows[row].name, event.name) != 0))
+				row++;
+			if (row == (int)rows.size())
+				rows.push_back({ event.name, event.depth, 0.0, 0.0 });
+
+			if (cpu)
+				rows[row].cpu += event.duration;
+			else
+				rows[row].gpu += event.duration;
+		}
+
+		// NB: Names point into events, so rows must be done with before it goes
+		std::sort(rows.begin(), rows.end(), [](const PassRow& a, const PassRow& b) { return a.cpu+a.gpu > b.cpu+b.gpu; });
+
+		snprintf(line, sizeof(line), "\n%-30s %8s %8s\n", "Pass", "CPU ms", "GPU ms");
+		text += line;
+		for (int i = 0; i < (int)rows.size() && i < PassRows; i++)
+		{
+			std::string name = std::string(2*rows[i].depth, ' ')+rows[i].name;
+			if (rows[i].gpu > 0.0)
+				snprintf(line, sizeof(line), "%-30.30s %8.2f %8.2f\n", name.c_str(), rows[i].cpu/(1000.0*cpuFrames), rows[i].gpu/(1000.0*gpuFrames));
+			else
+				snprintf(line, sizeof(line), "%-30.30s %8.2f %8s\n", name.c_str(), rows[i].cpu/(1000.0*cpuFrames), "-");
+			text += line;
+		}
+	}
+
+	// NB: The text is plain ASCII, as is the font's character set
+	m_text.assign(text.begin(), text.end());
+	m_rebuildCount++;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Profiler.h"
+
+// Frame timings, the profiler's per-pass times and whatever the renderer counts, as text for an on-screen overlay.
+// NB: The text is only rebuilt every so often, so counting is all a frame pays for while the overlay is up
+class PerformanceHud
+{
+public:
+	enum Counter
+	{
+		DrawCalls,
+		StateChanges,
+		TargetSwitches,
+		ConstantBytes,
+		MatricesReused,		// Animated transforms read again rather than rebuilt
+		ObjectsOccluded,	// In a view's frustum, but behind occluders
+		CapturesShared,		// Environment backgrounds copied rather than rendered again
+		DrawsShared,		// That those would have issued
+		PixelsShared,		// That those would have shaded, at least
+		EnvironmentBytes,
+		CounterCount
+	};
+
+	static const int				FrameWindow = 240;		// Frames the frame-time percentiles are taken over
+	static const int				EventWindow = 4096;		// Latest profiler events the pass times are taken from
+	static const int				PassRows = 16;
+
+	PerformanceHud();
+
+	void							Initialise(Profiler* profiler, double refreshSeconds);
+	void							setVisible(bool visible);
+	bool							getVisible();
+
+	// Accumulate over the frame; both are as cheap as an add, so may go anywhere on the thread that ends the frame
+	void							add(Counter counter, size_t amount) { m_counts[counter] += amount; }
+	void							set(Counter counter, size_t value) { m_counts[counter] = value; }	// For totals (e.g. memory) rather than work
+
+	void							endFrame(double frameSeconds);	// Rebuilds the text if it is due, then starts counting afresh
+	const std::wstring&				getText();
+	int								getRebuildCount();
+
+	static const char*				getCounterName(Counter counter);
+
+private:
+	void							Rebuild();
+
+	Profiler*						m_profiler;
+	double							m_refreshSeconds;
+	bool							m_visible;
+
+	size_t							m_counts[CounterCount];		// This frame's
+	size_t							m_totals[CounterCount];		// Since the last rebuild
+	int								m_frames;					// Since the last rebuild
+	double							m_elapsed;					// Since the last rebuild
+
+	std::vector<double>				m_frameTimes;	// Ring of the latest, in seconds
+	int								m_nextFrameTime;
+
+	std::wstring					m_text;
+	int								m_rebuildCount;
+};
@@ -0,0 +1,314 @@
+#include "pch.h"
+#include "Profiler.h"
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	// A scope begun but not yet ended on this thread
+	struct OpenScope
+	{
+		Profiler*	profiler;		// nullptr if the profiler was disabled when it began
+		char		name[Profiler::NameLength];
+		double		start;
+		bool		gpu;
+	};
+
+	std::atomic<unsigned int>			s_threadCount(0);
+	thread_local unsigned int			t_thread = s_threadCount++;
+	thread_local std::vector<OpenScope>	t_open;
+
+	void CopyName(char* destination, const char* name)
+	{
+		int i = 0;
+		for (; i < Profiler::NameLength-1 && name[i]; i++)
+			destination[i] = name[i];
+		destination[i] = '\0';
+	}
+}
+
+bool NullProfilerBackend::beginFrame()
+{
+	return false;
+}
+
+void NullProfilerBackend::endFrame()
+{
+}
+
+int NullProfilerBackend::beginEvent(const char* name)
+{
+	return -1;
+}
+
+int NullProfilerBackend::endEvent()
+{
+	return -1;
+}
+
+bool NullProfilerBackend::collect(std::vector<double>& timestamps)
+{
+	return false;
+}
+
+Profiler::Scope::Scope(Profiler* profiler, const char* name, bool gpu)
+{
+	m_profiler = profiler;
+	m_profiler->begin(name, gpu);
+}
+
+Profiler::Scope::~Scope()
+{
+	m_profiler->end();
+}
+
+Profiler::Profiler()
+{
+	m_backend = nullptr;
+	m_enabled = false;
+	m_epoch = std::chrono::high_resolution_clock::now();
+	m_frame = 0;
+
+	m_capacity = 0;
+	m_head = 0;
+
+	m_gpuThread = t_thread;
+	m_gpuTiming = false;
+}
+
+void Profiler::Initialise(ProfilerBackend* backend, int capacity)
+{
+	m_backend = backend;
+	m_enabled = true;
+	m_frame = 0;
+
+	m_slots.reset(new Slot[capacity]);
+	m_capacity = capacity;
+	m_head = 0;
+	for (int i = 0; i < capacity; i++)
+		m_slots[i].sequence = 0;
+
+	m_gpuThread = t_thread;
+	m_gpuTiming = false;
+	m_gpuFrames.clear();
+	m_gpuOpen.clear();
+}
+
+void Profiler::setEnabled(bool enabled)
+{
+	m_enabled = enabled;
+}
+
+bool Profiler::getEnabled()
+{
+	return m_enabled;
+}
+
+unsigned int Profiler::getDeviceThread()
+{
+	return m_gpuThread;
+}
+
+void Profiler::beginFrame()
+{
+	collectGpu();
+
+	m_frame++;
+	m_gpuOpen.clear();
+	m_gpuTiming = m_enabled && m_backend && m_backend->beginFrame();
+	if (m_gpuTiming)
+		m_gpuFrames.push_back({ m_frame, now(), std::vector<GpuScope>() });
+}
+
+void Profiler::endFrame()
+{
+	if (m_gpuTiming)
+		m_backend->endFrame();
+
+	m_gpuTiming = false;
+}
+
+unsigned int Profiler::getFrame()
+{
+	return m_frame;
+}
+
+void Profiler::begin(const char* name, bool gpu)
+{
+	OpenScope scope;
+	scope.profiler = (m_enabled && m_capacity > 0) ? this : nullptr;
+	scope.gpu = (gpu && m_backend && t_thread == m_gpuThread);
+	CopyName(scope.name, name);
+
+	// NB: Markers still go to the GPU (e.g. for PIX) when disabled; only the timings are skipped
+	if (scope.gpu)
+	{
+		int timestamp = m_backend->beginEvent(name);
+		if (scope.profiler && m_gpuTiming && timestamp != -1)
+		{
+			GpuScope gpuScope;
+			CopyName(gpuScope.name, name);
+			gpuScope.depth = (int)t_open.size();
+			gpuScope.begin = timestamp;
+			gpuScope.end = -1;
+
+			m_gpuOpen.push_back((int)m_gpuFrames.back().scopes.size());
+			m_gpuFrames.back().scopes.push_back(gpuScope);
+		}
+		else
+			m_gpuOpen.push_back(-1);
+	}
+
+	scope.start = now();
+	t_open.push_back(scope);
+}
+
+void Profiler::end()
+{
+	double end = now();
+	OpenScope scope = t_open.back();
+	t_open.pop_back();
+
+	if (scope.gpu)
+	{
+		int timestamp = m_backend->endEvent();
+
+		// NB: A scope left open over beginFrame is dropped from the GPU timings, as its two timestamps are in different frames
+		if (!m_gpuOpen.empty())
+		{
+			int open = m_gpuOpen.back();
+			m_gpuOpen.pop_back();
+			if (open != -1)
+				m_gpuFrames.back().scopes[open].end = timestamp;
+		}
+	}
+
+	if (!scope.profiler)
+		return;
+
+	Event event;
+	memcpy(event.name, scope.name, NameLength);
+	event.start = scope.start;
+	event.duration = end-scope.start;
+	event.thread = t_thread;
+	event.depth = (int)t_open.size();
+	event.frame = m_frame;
+	push(event);
+}
+
+std::vector<Profiler::Event> Profiler::getEvents()
+{
+	return getLatestEvents((int)m_capacity);
+}
+
+std::vector<Profiler::Event> Profiler::getLatestEvents(int count)
+{
+	std::vector<Event> events;
+
+	unsigned long long head = m_head;
+	unsigned long long latest = std::min(m_capacity, (unsigned long long)std::max(count, 0));
+	unsigned long long first = (head > latest) ? head-latest : 0;
+	for (unsigned long long i = first; i < head; i++)
+	{
+		// NB: Skips any slot still being written, or overwritten since head was read
+		Slot& slot = m_slots[i%m_capacity];
+		if (slot.sequence.load(std::memory_order_acquire) != i+1)
+			continue;
+
+		Event event = slot.event;
+		if (slot.sequence.load(std::memory_order_acquire) == i+1)
+			events.push_back(event);
+	}
+
+	return events;
+}
+
+unsigned long long Profiler::getEventCount()
+{
+	return m_head;
+}
+
+std::string Profiler::getChromeTrace()
+{
+	std::vector<Event> events = getEvents();
+
+	std::string trace = "{\"traceEvents\":[\n";
+	trace += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(GpuThread) + ",\"args\":{\"name\":\"GPU\"}}";
+	for (int i = 0; i < (int)events.size(); i++)
+	{
+		const Event& event = events[i];
+
+		// NB: Names are plain ASCII, but may still hold quotes or backslashes
+		std::string name;
+		for (const char* c = event.name; *c; c++)
+		{
+			if (*c == '"' || *c == '\\')
+				name += '\\';
+			name += *c;
+		}
+
+		char line[256];
+		snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"frame\":%u,\"depth\":%d}}",
+			name.c_str(), (event.thread == GpuThread) ? "gpu" : "cpu", event.start, event.duration, event.thread, event.frame, event.depth);
+		trace += line;
+	}
+	trace += "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+	return trace;
+}
+
+bool Profiler::saveChromeTrace(const std::string& filename)
+{
+	FILE* file = fopen(filename.c_str(), "wb");
+	if (!file)
+		return false;
+
+	std::string trace = getChromeTrace();
+	bool written = fwrite(trace.data(), 1, trace.size(), file) == trace.size();
+	fclose(file);
+
+	return written;
+}
+
+double Profiler::now()
+{
+	return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now()-m_epoch).count();
+}
+
+void Profiler::push(const Event& event)
+{
+	// Claim the next slot, then publish it once written; the oldest event is simply overwritten when the ring is full
+	unsigned long long index = m_head.fetch_add(1);
+	Slot& slot = m_slots[index%m_capacity];
+
+	slot.sequence.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.event = event;
+	slot.sequence.store(index+1, std::memory_order_release);
+}
+
+void Profiler::collectGpu()
+{
+	// NB: GPU scopes are timed relative to their frame's first timestamp, which is lined up with the CPU time the frame began
+	while (!m_gpuFrames.empty() && m_backend->collect(m_timestamps))
+	{
+		const GpuFrame& frame = m_gpuFrames.front();
+		for (int i = 0; i < (int)frame.scopes.size(); i++)
+		{
+			const GpuScope& scope = frame.scopes[i];
+			if (scope.begin < 0 || scope.end < 0 || scope.end >= (int)m_timestamps.size())
+				continue;
+
+			Event event;
+			memcpy(event.name, scope.name, NameLength);
+			event.start = frame.start+m_timestamps[scope.begin];
+			event.duration = m_timestamps[scope.end]-m_timestamps[scope.begin];
+			event.thread = GpuThread;
+			event.depth = scope.depth;
+			event.frame = frame.frame;
+			push(event);
+		}
+
+		m_gpuFrames.pop_front();
+	}
+}
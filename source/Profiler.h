@@ -0,0 +1,134 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Marks and times scopes on the GPU. Mirrors the subset of timestamp queries and PIX events the profiler uses
+class ProfilerBackend
+{
+public:
+	virtual ~ProfilerBackend() {}
+
+	virtual bool					beginFrame() = 0;		// Whether this frame's timestamps can be taken (i.e. a query set is free)
+	virtual void					endFrame() = 0;
+
+	// Bracket a scope; both return the index of the timestamp taken, or -1 if there is none
+	virtual int						beginEvent(const char* name) = 0;
+	virtual int						endEvent() = 0;
+
+	// True once the oldest timed frame is in, giving each timestamp in microseconds since the frame's first.
+	// NB: A frame whose timestamps turned out to be unreliable comes back empty
+	virtual bool					collect(std::vector<double>& timestamps) = 0;
+};
+
+// Times nothing on the GPU, so the CPU half of the profiler runs headlessly
+class NullProfilerBackend : public ProfilerBackend
+{
+public:
+	bool							beginFrame() override;
+	void							endFrame() override;
+
+	int								beginEvent(const char* name) override;
+	int								endEvent() override;
+
+	bool							collect(std::vector<double>& timestamps) override;
+};
+
+// Nested CPU (and, on the thread that owns the device, GPU) timings of named scopes, kept in a fixed-size ring of the latest
+// events. Any thread may record; the ring is lock-free, so a worker never waits on another to time itself.
+// Exports as Chrome trace JSON, which chrome://tracing and Perfetto both open.
+class Profiler
+{
+public:
+	static const int				NameLength = 48;
+
+	struct Event
+	{
+		char			name[NameLength];
+		double			start;			// Microseconds since the profiler was created
+		double			duration;
+		unsigned int	thread;			// Small per-thread number, in order of first use; GPU events use GpuThread
+		int				depth;			// Nesting on that thread
+		unsigned int	frame;
+	};
+
+	static const unsigned int		GpuThread = 0xFFFF;
+
+	// Times the enclosing block
+	class Scope
+	{
+	public:
+		Scope(Profiler* profiler, const char* name, bool gpu = true);
+		~Scope();
+
+	private:
+		Profiler*		m_profiler;
+	};
+
+	Profiler();
+
+	void							Initialise(ProfilerBackend* backend, int capacity);	// GPU timings only come from the calling thread
+	void							setEnabled(bool enabled);
+	bool							getEnabled();
+	unsigned int					getDeviceThread();	// The thread number of whichever thread called Initialise
+
+	void							beginFrame();		// Also gathers whatever GPU timings have come in since
+	void							endFrame();
+	unsigned int					getFrame();			// As stamped on events since the last beginFrame
+
+	// For scopes that are not blocks (e.g. render graph passes); every begin must be matched by an end on the same thread.
+	// NB: gpu is false for work that does not reach the immediate context (e.g. recording a command list)
+	void							begin(const char* name, bool gpu = true);
+	void							end();
+
+	std::vector<Event>				getEvents();		// Everything still in the ring, oldest first
+	std::vector<Event>				getLatestEvents(int count);	// At most the latest count, oldest first
+	unsigned long long				getEventCount();	// Events recorded since Initialise, including any the ring has since dropped
+	std::string						getChromeTrace();
+	bool							saveChromeTrace(const std::string& filename);
+
+private:
+	struct Slot
+	{
+		std::atomic<unsigned long long>	sequence;	// One past the event's index once written; 0 while being written
+		Event							event;
+	};
+
+	struct GpuScope
+	{
+		char			name[NameLength];
+		int				depth;
+		int				begin;			// Timestamp indices
+		int				end;
+	};
+
+	struct GpuFrame
+	{
+		unsigned int			frame;
+		double					start;		// CPU time the frame's first timestamp was taken, to line the two clocks up
+		std::vector<GpuScope>	scopes;
+	};
+
+	double							now();
+	void							push(const Event& event);
+	void							collectGpu();
+
+	ProfilerBackend*				m_backend;
+	bool							m_enabled;
+	std::chrono::high_resolution_clock::time_point	m_epoch;
+	std::atomic<unsigned int>		m_frame;
+
+	std::unique_ptr<Slot[]>			m_slots;
+	unsigned long long				m_capacity;
+	std::atomic<unsigned long long>	m_head;
+
+	// NB: Only touched by the thread that owns the device
+	unsigned int					m_gpuThread;
+	bool							m_gpuTiming;	// Whether the current frame's timestamps are being taken
+	std::deque<GpuFrame>			m_gpuFrames;	// Awaiting their timestamps, oldest first
+	std::vector<int>				m_gpuOpen;		// Indices into the current frame's scopes
+	std::vector<double>				m_timestamps;
+};
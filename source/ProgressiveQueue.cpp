@@ -0,0 +1,166 @@
+#include "pch.h"
+#include "ProgressiveQueue.h"
+#include <cmath>
+
+namespace
+{
+	const double EstimateWeight = 0.25;		// Of each new item's time in the running estimate
+	const double DeviationMargin = 2.0;		// How many mean deviations over the estimate an item is allowed for
+}
+
+ProgressiveQueue::ProgressiveQueue()
+{
+	m_budget = 4.0;
+	Reset(0);
+}
+
+void ProgressiveQueue::Reset(int count)
+{
+	m_estimate = 0.0;
+	m_deviation = 0.0;
+	m_spent = 0.0;
+	m_frameItems = 0;
+	m_doneCount = 0;
+	m_priorities.assign(count, 0.0f);
+	m_done.assign(count, 0);
+}
+
+void ProgressiveQueue::setBudget(double milliseconds)
+{
+	m_budget = milliseconds;
+}
+
+void ProgressiveQueue::setPriority(int item, float priority)
+{
+	m_priorities[item] = priority;
+}
+
+void ProgressiveQueue::beginFrame()
+{
+	m_spent = 0.0;
+	m_frameItems = 0;
+}
+
+int ProgressiveQueue::next()
+{
+	// NB: Before the first item finishes there is no estimate, so the first frame takes one and sees
+	if (getComplete() || (m_frameItems > 0 && m_spent+getAllowance() > m_budget))
+		return -1;
+
+	int best = -1;
+	for (int i = 0; i < (int)m_done.size(); i++)
+		if (!m_done[i] && (best == -1 || m_priorities[i] > m_priorities[best]))
+			best = i;
+
+	m_done[best] = 1;
+	m_doneCount++;
+	m_frameItems++;
+
+	return best;
+}
+
+void ProgressiveQueue::finish(double milliseconds)
+{
+	m_spent += milliseconds;
+	if (m_doneCount == 1)
+	{
+		m_estimate = milliseconds;
+		m_deviation = 0.0;
+		return;
+	}
+
+	// NB: Deviation first, against the estimate this item was judged by
+	m_deviation = (1.0-EstimateWeight)*m_deviation+EstimateWeight*fabs(milliseconds-m_estimate);
+	m_estimate = (1.0-EstimateWeight)*m_estimate+EstimateWeight*milliseconds;
+}
+
+int ProgressiveQueue::getCount()
+{
+	return (int)m_done.size();
+}
+
+int ProgressiveQueue::getDoneCount()
+{
+	return m_doneCount;
+}
+
+bool ProgressiveQueue::getComplete()
+{
+	return m_doneCount == (int)m_done.size();
+}
+
+double ProgressiveQueue::getBudget()
+{
+	return m_budget;
+}
+
+double ProgressiveQueue::getEstimate()
+{
+	return m_estimate;
+}
+
+double ProgressiveQueue::getAllowance()
+{
+	return m_estimate+DeviationMargin*m_deviation;
+}
+
+double ProgressiveQueue::getSpent()
+{
+	return m_spent;
+}
+
+bool ProgressiveQueue::simulate(int count, const std::vector<double>& budgets, std::string& report)
+{
+	// Costs between 0.5 and 3ms, the dearer ones in runs, as faces that see more of the scene tend to be next to each other
+	std::vector<double> costs(count);
+	unsigned int seed = 1;
+	for (int i = 0; i < count; i++)
+	{
+		seed = seed*1664525u+1013904223u;
+		costs[i] = 0.5+2.5*(((i/6)%2) ? 0.75 : 0.25)+0.5*((double)(seed >> 8)/(1 << 24)-0.5);
+	}
+	double dearest = (count > 0) ? *std::max_element(costs.begin(), costs.end()) : 0.0;
+
+	char heading[128];
+	snprintf(heading, sizeof(heading), "Progressive queue of %d items, the dearest %.2fms:\n", count, dearest);
+	report = heading;
+	bool passed = true;
+	for (double budget : budgets)
+	{
+		ProgressiveQueue queue;
+		queue.setBudget(budget);
+		queue.Reset(count);
+		for (int i = 0; i < count; i++)
+			queue.setPriority(i, (float)((i*7)%count));
+
+		int frames = 0, over = 0;
+		double worst = 0.0;
+		std::vector<int> handedOut(count, 0);
+		while (!queue.getComplete() && frames <= count)
+		{
+			queue.beginFrame();
+			int items = 0, last = -1;
+			for (int item = queue.next(); item != -1; item = queue.next())
+			{
+				queue.finish(costs[item]);
+				handedOut[item]++;
+				items++;
+				last = item;
+			}
+
+			// NB: Only the last item of a frame can be the one misjudged
+			passed = passed && (items <= 1 || queue.getSpent()-costs[last] <= budget);
+			over += (queue.getSpent() > budget) ? 1 : 0;
+			worst = std::max(worst, queue.getSpent());
+			frames++;
+		}
+		passed = passed && std::count(handedOut.begin(), handedOut.end(), 1) == count;
+		passed = passed && worst <= budget+dearest;
+
+		char line[256];
+		snprintf(line, sizeof(line), "  %5.1fms budget: %3d frames, %3d over budget, at most %5.2fms in one\n", budget, frames, over, worst);
+		report += line;
+	}
+
+	return passed;
+}
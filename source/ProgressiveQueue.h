@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Hands out work a few items a frame rather than all at once: highest priority first, for as long as the frame's budget allows.
+// What an item costs is estimated from what those before it took, with a margin for how much they varied, so a frame only runs over by misjudging one item; every frame gets at least one.
+// Priorities may change from frame to frame (e.g. as objects come into view)
+class ProgressiveQueue
+{
+public:
+	ProgressiveQueue();
+
+	void							Reset(int count);	// Items 0..count-1, none done
+	void							setBudget(double milliseconds);
+	void							setPriority(int item, float priority);	// Higher first; ties go to the lower index
+
+	void							beginFrame();
+	int								next();			// The next item, now counted as done, or -1 if none are left or the frame's budget is spent
+	void							finish(double milliseconds);	// What the item next gave took
+
+	int								getCount();
+	int								getDoneCount();
+	bool							getComplete();
+	double							getBudget();
+	double							getEstimate();		// Milliseconds an item is expected to take
+	double							getAllowance();		// What the next item is allowed, in case it takes longer than expected
+	double							getSpent();			// This frame, in milliseconds
+
+	// Runs count items of made-up, uneven costs through the queue at each budget, reporting how many frames each took and how far over budget any went.
+	// False if an item was handed out other than once, a frame of more than one item went over by more than its last item cost, or any frame over by more than the dearest item
+	static bool						simulate(int count, const std::vector<double>& budgets, std::string& report);
+
+private:
+	double							m_budget;
+	double							m_estimate;
+	double							m_deviation;		// Mean of how far items have been from the estimate
+	double							m_spent;
+	int								m_frameItems;		// Handed out this frame
+	int								m_doneCount;
+	std::vector<float>				m_priorities;
+	std::vector<unsigned char>		m_done;
+};
@@ -0,0 +1,46 @@
+#include "pch.h"
+#include "ProjectionShader.h"
+
+ProjectionShader::ProjectionShader()
+{
+	m_projectionBuffer = nullptr;
+}
+
+bool ProjectionShader::InitProjectionShader(RenderDevice* device, WCHAR* vsFilename, WCHAR* psFilename)
+{
+	if (!InitShader(device, vsFilename, psFilename))
+	{
+		return false;
+	}
+
+	m_projectionBuffer = device->CreateBuffer({ sizeof(ProjectionBufferType), RenderBindConstantBuffer, true });
+
+	return true;
+}
+
+void ProjectionShader::Shutdown()
+{
+	if (m_device)
+	{
+		m_device->Release(m_projectionBuffer);
+	}
+	m_projectionBuffer = nullptr;
+
+	Shader::Shutdown();
+}
+
+bool ProjectionShader::SetProjectionShaderParameters(RenderContext* context, DirectX::SimpleMath::Matrix* world, DirectX::SimpleMath::Matrix* view, DirectX::SimpleMath::Matrix* projection, float time, int mode, ID3D11ShaderResourceView* environmentMap[6])
+{
+	SetShaderParameters(context, world, view, projection, time);
+
+	ProjectionBufferType projectionData;
+	projectionData.mode = (float)mode;
+	projectionData.padding = DirectX::SimpleMath::Vector3(0.0, 0.0, 0.0);
+	context->PSSetConstants(1, WriteConstants(context, ConstantRing::Material, m_projectionBuffer, &projectionData, sizeof(projectionData)));	//note the first variable is the mapped buffer ID.  Corresponding to what you set in the PS
+
+	//pass the desired texture to the pixel shader.
+	for (int i = 0; i < 6; i++)
+		context->PSSetShaderResources(i, 1, &environmentMap[i]);
+
+	return false;
+}
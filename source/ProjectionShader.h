@@ -0,0 +1,29 @@
+#pragma once
+#include "Shader.h"
+#include "RenderTexture.h"
+
+// Resamples the six faces of an environment map into one octahedral or dual-paraboloid target
+class ProjectionShader : public Shader
+{
+public:
+	ProjectionShader();
+
+	bool InitProjectionShader(RenderDevice* device, WCHAR* vsFilename, WCHAR* psFilename);
+	void Shutdown() override;
+	bool SetProjectionShaderParameters(RenderContext* context,
+		DirectX::SimpleMath::Matrix* world,
+		DirectX::SimpleMath::Matrix* view,
+		DirectX::SimpleMath::Matrix* projection,
+		float time,
+		int mode,
+		ID3D11ShaderResourceView* environmentMap[6]);
+
+protected:
+	struct ProjectionBufferType
+	{
+		float mode;
+		DirectX::SimpleMath::Vector3 padding;
+	};
+
+	ID3D11Buffer* m_projectionBuffer;
+};
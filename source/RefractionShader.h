@@ -5,8 +5,11 @@
 class RefractionShader : public LightShader
 {
 public:
-	bool InitRefractionShader(ID3D11Device* device, WCHAR* vsFilename, WCHAR* psFilename);
-	bool SetRefractionShaderParameters(ID3D11DeviceContext* context,
+	RefractionShader();
+
+	bool InitRefractionShader(RenderDevice* device, WCHAR* vsFilename, WCHAR* psFilename);
+	void Shutdown() override;
+	bool SetRefractionShaderParameters(RenderContext* context,
 		DirectX::SimpleMath::Matrix* world,
 		DirectX::SimpleMath::Matrix* view,
 		DirectX::SimpleMath::Matrix* projection,
@@ -20,13 +23,15 @@ public:
 		ID3D11ShaderResourceView* normalTexture,
 		ID3D11ShaderResourceView* environmentMap[6]);
 
+	void setEnvironmentMode(int mode);	// EnvironmentProjection::Mode of the maps passed in; single-target modes only read environmentMap[0]
+
 protected:
 	struct RefractionBufferType
 	{
 		float opacity;
 		float refractiveIndex;
 		float culling;
-		float padding;
+		float projection;
 	};
 
 	struct CameraBufferType
@@ -37,4 +42,6 @@ protected:
 
 	ID3D11Buffer* m_refractionBuffer;
 	ID3D11Buffer* m_cameraBuffer;
+
+	int m_environmentMode;
 };
@@ -0,0 +1,707 @@
+#include "pch.h"
+#include "RenderContext.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cwchar>
+
+NullRenderContextBackend::NullRenderContextBackend()
+{
+	// NB: Direct3D 11 caps a constant buffer at 4096 float4s; anything bigger (e.g. instance streams) grows it
+	m_scratch.resize(4096*16);
+
+	m_viewport = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+	m_logging = false;
+	m_callCount = 0;
+	m_drawCount = 0;
+}
+
+void NullRenderContextBackend::IASetInputLayout(ID3D11InputLayout* layout)
+{
+	record("IASetInputLayout");
+}
+
+void NullRenderContextBackend::IASetVertexBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets)
+{
+	record("IASetVertexBuffers " + std::to_string(slot) + "+" + std::to_string(count));
+}
+
+void NullRenderContextBackend::IASetIndexBuffer(ID3D11Buffer* buffer, int format, unsigned int offset)
+{
+	record("IASetIndexBuffer");
+}
+
+void NullRenderContextBackend::IASetPrimitiveTopology(int topology)
+{
+	record("IASetPrimitiveTopology " + std::to_string(topology));
+}
+
+void NullRenderContextBackend::VSSetShader(ID3D11VertexShader* shader)
+{
+	record("VSSetShader");
+}
+
+void NullRenderContextBackend::VSSetConstantBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers)
+{
+	record("VSSetConstantBuffers " + std::to_string(slot) + "+" + std::to_string(count));
+}
+
+void NullRenderContextBackend::VSSetConstantBuffers1(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* constantCounts)
+{
+	record("VSSetConstantBuffers1 " + std::to_string(slot) + "+" + std::to_string(count) + " @" + std::to_string(firstConstants[0]));
+}
+
+void NullRenderContextBackend::PSSetShader(ID3D11PixelShader* shader)
+{
+	record("PSSetShader");
+}
+
+void NullRenderContextBackend::PSSetConstantBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers)
+{
+	record("PSSetConstantBuffers " + std::to_string(slot) + "+" + std::to_string(count));
+}
+
+void NullRenderContextBackend::PSSetConstantBuffers1(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* constantCounts)
+{
+	record("PSSetConstantBuffers1 " + std::to_string(slot) + "+" + std::to_string(count) + " @" + std::to_string(firstConstants[0]));
+}
+
+void NullRenderContextBackend::PSSetShaderResources(unsigned int slot, unsigned int count, ID3D11ShaderResourceView* const* views)
+{
+	record("PSSetShaderResources " + std::to_string(slot) + "+" + std::to_string(count));
+}
+
+void NullRenderContextBackend::PSSetSamplers(unsigned int slot, unsigned int count, ID3D11SamplerState* const* samplers)
+{
+	record("PSSetSamplers " + std::to_string(slot) + "+" + std::to_string(count));
+}
+
+void NullRenderContextBackend::RSSetState(ID3D11RasterizerState* state)
+{
+	record("RSSetState");
+}
+
+void NullRenderContextBackend::RSSetViewports(unsigned int count, const RenderViewport* viewports)
+{
+	if (count > 0)
+		m_viewport = viewports[0];
+
+	record("RSSetViewports " + std::to_string((int)m_viewport.Width) + "x" + std::to_string((int)m_viewport.Height));
+}
+
+RenderViewport NullRenderContextBackend::RSGetViewport()
+{
+	record("RSGetViewports");
+
+	return m_viewport;
+}
+
+void NullRenderContextBackend::OMSetBlendState(ID3D11BlendState* state, const float factor[4], unsigned int sampleMask)
+{
+	record("OMSetBlendState");
+}
+
+void NullRenderContextBackend::OMSetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef)
+{
+	record("OMSetDepthStencilState");
+}
+
+void NullRenderContextBackend::OMSetRenderTargets(unsigned int count, ID3D11RenderTargetView* const* targets, ID3D11DepthStencilView* depthStencil)
+{
+	record("OMSetRenderTargets " + std::to_string(count));
+}
+
+void* NullRenderContextBackend::Map(ID3D11Buffer* buffer, unsigned int offset, unsigned int bytes, bool discard)
+{
+	record(discard ? "Map" : "Map (no overwrite)");
+
+	if (m_scratch.size() < offset+bytes)
+		m_scratch.resize(offset+bytes);
+
+	return m_scratch.data()+offset;
+}
+
+void NullRenderContextBackend::Unmap(ID3D11Buffer* buffer)
+{
+	record("Unmap");
+}
+
+void NullRenderContextBackend::ClearRenderTargetView(ID3D11RenderTargetView* target, const float colour[4])
+{
+	record("ClearRenderTargetView");
+}
+
+void NullRenderContextBackend::ClearDepthStencilView(ID3D11DepthStencilView* depthStencil, unsigned int flags, float depth, unsigned char stencil)
+{
+	record("ClearDepthStencilView");
+}
+
+void NullRenderContextBackend::CopyResource(ID3D11Resource* destination, ID3D11Resource* source)
+{
+	record("CopyResource");
+}
+
+void NullRenderContextBackend::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	record("DrawIndexed " + std::to_string(indexCount));
+	m_drawCount++;
+}
+
+void NullRenderContextBackend::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance)
+{
+	record("DrawIndexedInstanced " + std::to_string(indexCount) + "x" + std::to_string(instanceCount));
+	m_drawCount++;
+}
+
+void NullRenderContextBackend::DrawString(const wchar_t* text, float x, float y)
+{
+	record("DrawString " + std::to_string(wcslen(text)));
+}
+
+void NullRenderContextBackend::Reset()
+{
+	m_log.clear();
+	m_callCount = 0;
+	m_drawCount = 0;
+}
+
+void NullRenderContextBackend::setLogging(bool logging)
+{
+	m_logging = logging;
+}
+
+const std::vector<std::string>& NullRenderContextBackend::getLog()
+{
+	return m_log;
+}
+
+int NullRenderContextBackend::getCallCount()
+{
+	return m_callCount;
+}
+
+int NullRenderContextBackend::getDrawCount()
+{
+	return m_drawCount;
+}
+
+void NullRenderContextBackend::record(const std::string& call)
+{
+	if (m_logging)
+		m_log.push_back(call);
+	m_callCount++;
+}
+
+
+
+RenderContext::RenderContext()
+{
+	m_backend = nullptr;
+	m_constantRing = nullptr;
+	m_shadowing = true;
+
+	newFrame();
+}
+
+void RenderContext::Initialise(RenderContextBackend* backend)
+{
+	m_backend = backend;
+
+	newFrame();
+}
+
+RenderContextBackend* RenderContext::getBackend()
+{
+	return m_backend;
+}
+
+void RenderContext::setBackend(RenderContextBackend* backend)
+{
+	m_backend = backend;
+}
+
+void RenderContext::newFrame()
+{
+	for (int i = 0; i < CallCount; i++)
+	{
+		m_bound[i] = 0;
+		m_skipped[i] = 0;
+	}
+	m_mappedBytes = 0;
+
+	Invalidate();
+}
+
+void RenderContext::Invalidate()
+{
+	for (int i = 0; i < CallCount; i++)
+		m_known[i] = false;
+
+	for (int i = 0; i < ConstantBufferSlots; i++)
+	{
+		m_knownVertexConstantBuffers[i] = false;
+		m_knownPixelConstantBuffers[i] = false;
+	}
+	for (int i = 0; i < ShaderResourceSlots; i++)
+		m_knownShaderResources[i] = false;
+	for (int i = 0; i < SamplerSlots; i++)
+		m_knownSamplers[i] = false;
+}
+
+void RenderContext::setShadowing(bool shadowing)
+{
+	m_shadowing = shadowing;
+
+	Invalidate();
+}
+
+template <typename T>
+bool RenderContext::shadowSlots(T* shadow, bool* known, unsigned int slots, unsigned int slot, unsigned int count, T const* values, unsigned int& first, unsigned int& last)
+{
+	first = slot+count;
+	last = slot;
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int j = slot+i;
+		if (j < slots && known[j] && shadow[j] == values[i])
+			continue;
+
+		if (j < slots)
+		{
+			shadow[j] = values[i];
+			known[j] = true;
+		}
+
+		first = (j < first) ? j : first;
+		last = j;
+	}
+
+	return first <= last;
+}
+
+void RenderContext::IASetInputLayout(ID3D11InputLayout* layout)
+{
+	if (m_known[InputLayout] && m_inputLayout == layout)
+		return skipped(InputLayout);
+
+	m_inputLayout = layout;
+	m_known[InputLayout] = true;
+
+	m_backend->IASetInputLayout(layout);
+	bound(InputLayout);
+}
+
+void RenderContext::IASetVertexBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets)
+{
+	// NB: Only a single stream in slot 0 is shadowed; anything else is passed straight through
+	if (slot != 0 || count != 1)
+	{
+		m_known[VertexBuffers] = false;
+		m_backend->IASetVertexBuffers(slot, count, buffers, strides, offsets);
+		return bound(VertexBuffers);
+	}
+
+	if (m_known[VertexBuffers] && m_vertexBuffer == buffers[0] && m_vertexStride == strides[0] && m_vertexOffset == offsets[0])
+		return skipped(VertexBuffers);
+
+	m_vertexBuffer = buffers[0];
+	m_vertexStride = strides[0];
+	m_vertexOffset = offsets[0];
+	m_known[VertexBuffers] = true;
+
+	m_backend->IASetVertexBuffers(slot, count, buffers, strides, offsets);
+	bound(VertexBuffers);
+}
+
+void RenderContext::IASetIndexBuffer(ID3D11Buffer* buffer, int format, unsigned int offset)
+{
+	if (m_known[IndexBuffer] && m_indexBuffer == buffer && m_indexFormat == format && m_indexOffset == offset)
+		return skipped(IndexBuffer);
+
+	m_indexBuffer = buffer;
+	m_indexFormat = format;
+	m_indexOffset = offset;
+	m_known[IndexBuffer] = true;
+
+	m_backend->IASetIndexBuffer(buffer, format, offset);
+	bound(IndexBuffer);
+}
+
+void RenderContext::IASetPrimitiveTopology(int topology)
+{
+	if (m_known[PrimitiveTopology] && m_topology == topology)
+		return skipped(PrimitiveTopology);
+
+	m_topology = topology;
+	m_known[PrimitiveTopology] = true;
+
+	m_backend->IASetPrimitiveTopology(topology);
+	bound(PrimitiveTopology);
+}
+
+void RenderContext::VSSetShader(ID3D11VertexShader* shader, ID3D11ClassInstance* const* instances, unsigned int instanceCount)
+{
+	if (m_known[VertexShader] && m_vertexShader == shader)
+		return skipped(VertexShader);
+
+	m_vertexShader = shader;
+	m_known[VertexShader] = true;
+
+	m_backend->VSSetShader(shader);
+	bound(VertexShader);
+}
+
+void RenderContext::VSSetConstantBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers)
+{
+	ConstantBinding bindings[ConstantBufferSlots];
+	count = (count < ConstantBufferSlots) ? count : ConstantBufferSlots;
+	for (unsigned int i = 0; i < count; i++)
+		bindings[i] = { buffers[i], 0, 0 };
+
+	setConstants(m_vertexConstantBuffers, m_knownVertexConstantBuffers, slot, count, bindings, false);
+}
+
+void RenderContext::VSSetConstants(unsigned int slot, const ConstantBinding& binding)
+{
+	setConstants(m_vertexConstantBuffers, m_knownVertexConstantBuffers, slot, 1, &binding, false);
+}
+
+void RenderContext::PSSetShader(ID3D11PixelShader* shader, ID3D11ClassInstance* const* instances, unsigned int instanceCount)
+{
+	if (m_known[PixelShader] && m_pixelShader == shader)
+		return skipped(PixelShader);
+
+	m_pixelShader = shader;
+	m_known[PixelShader] = true;
+
+	m_backend->PSSetShader(shader);
+	bound(PixelShader);
+}
+
+void RenderContext::PSSetConstantBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers)
+{
+	ConstantBinding bindings[ConstantBufferSlots];
+	count = (count < ConstantBufferSlots) ? count : ConstantBufferSlots;
+	for (unsigned int i = 0; i < count; i++)
+		bindings[i] = { buffers[i], 0, 0 };
+
+	setConstants(m_pixelConstantBuffers, m_knownPixelConstantBuffers, slot, count, bindings, true);
+}
+
+void RenderContext::PSSetConstants(unsigned int slot, const ConstantBinding& binding)
+{
+	setConstants(m_pixelConstantBuffers, m_knownPixelConstantBuffers, slot, 1, &binding, true);
+}
+
+void RenderContext::setConstants(ConstantBinding* shadow, bool* known, unsigned int slot, unsigned int count, const ConstantBinding* bindings, bool pixel)
+{
+	Call call = (pixel) ? PixelConstantBuffers : VertexConstantBuffers;
+
+	unsigned int first, last;
+	if (!shadowSlots(shadow, known, ConstantBufferSlots, slot, count, bindings, first, last))
+		return skipped(call);
+
+	bool windowed = false;
+	for (unsigned int j = first; j <= last; j++)
+		windowed |= (bindings[j-slot].count != 0);
+
+	// STEP 1: Whole buffers go through in one call, exactly as before
+	if (!windowed)
+	{
+		ID3D11Buffer* buffers[ConstantBufferSlots];
+		for (unsigned int j = first; j <= last; j++)
+			buffers[j-first] = bindings[j-slot].buffer;
+
+		if (pixel)
+			m_backend->PSSetConstantBuffers(first, last-first+1, buffers);
+		else
+			m_backend->VSSetConstantBuffers(first, last-first+1, buffers);
+
+		return bound(call);
+	}
+
+	// STEP 2: Windows are bound slot by slot, since a whole buffer has no window to pass alongside them
+	for (unsigned int j = first; j <= last; j++)
+	{
+		const ConstantBinding& binding = bindings[j-slot];
+		if (binding.count == 0)
+		{
+			if (pixel)
+				m_backend->PSSetConstantBuffers(j, 1, &binding.buffer);
+			else
+				m_backend->VSSetConstantBuffers(j, 1, &binding.buffer);
+		}
+		else
+		{
+			if (pixel)
+				m_backend->PSSetConstantBuffers1(j, 1, &binding.buffer, &binding.first, &binding.count);
+			else
+				m_backend->VSSetConstantBuffers1(j, 1, &binding.buffer, &binding.first, &binding.count);
+		}
+	}
+	bound(call);
+}
+
+void RenderContext::PSSetShaderResources(unsigned int slot, unsigned int count, ID3D11ShaderResourceView* const* views)
+{
+	unsigned int first, last;
+	if (!shadowSlots(m_shaderResources, m_knownShaderResources, ShaderResourceSlots, slot, count, views, first, last))
+		return skipped(ShaderResources);
+
+	m_backend->PSSetShaderResources(first, last-first+1, views+(first-slot));
+	bound(ShaderResources);
+}
+
+void RenderContext::PSSetSamplers(unsigned int slot, unsigned int count, ID3D11SamplerState* const* samplers)
+{
+	unsigned int first, last;
+	if (!shadowSlots(m_samplers, m_knownSamplers, SamplerSlots, slot, count, samplers, first, last))
+		return skipped(Samplers);
+
+	m_backend->PSSetSamplers(first, last-first+1, samplers+(first-slot));
+	bound(Samplers);
+}
+
+void RenderContext::RSSetState(ID3D11RasterizerState* state)
+{
+	if (m_known[RasterizerState] && m_rasterizerState == state)
+		return skipped(RasterizerState);
+
+	m_rasterizerState = state;
+	m_known[RasterizerState] = true;
+
+	m_backend->RSSetState(state);
+	bound(RasterizerState);
+}
+
+void RenderContext::RSSetViewports(unsigned int count, const RenderViewport* viewports)
+{
+	if (count == 1 && m_known[Viewports] && memcmp(&m_viewport, viewports, sizeof(RenderViewport)) == 0)
+		return skipped(Viewports);
+
+	m_known[Viewports] = count == 1;
+	if (count == 1)
+		m_viewport = viewports[0];
+
+	m_backend->RSSetViewports(count, viewports);
+	bound(Viewports);
+}
+
+RenderViewport RenderContext::RSGetViewport()
+{
+	if (!m_known[Viewports])
+	{
+		m_viewport = m_backend->RSGetViewport();
+		m_known[Viewports] = true;
+	}
+
+	return m_viewport;
+}
+
+void RenderContext::OMSetBlendState(ID3D11BlendState* state, const float factor[4], unsigned int sampleMask)
+{
+	// NB: A null factor means 1, 1, 1, 1
+	float blendFactor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	if (factor)
+		memcpy(blendFactor, factor, sizeof(blendFactor));
+
+	if (m_known[BlendState] && m_blendState == state && m_sampleMask == sampleMask && memcmp(m_blendFactor, blendFactor, sizeof(blendFactor)) == 0)
+		return skipped(BlendState);
+
+	m_blendState = state;
+	memcpy(m_blendFactor, blendFactor, sizeof(blendFactor));
+	m_sampleMask = sampleMask;
+	m_known[BlendState] = true;
+
+	m_backend->OMSetBlendState(state, factor, sampleMask);
+	bound(BlendState);
+}
+
+void RenderContext::OMSetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef)
+{
+	if (m_known[DepthStencilState] && m_depthStencilState == state && m_stencilRef == stencilRef)
+		return skipped(DepthStencilState);
+
+	m_depthStencilState = state;
+	m_stencilRef = stencilRef;
+	m_known[DepthStencilState] = true;
+
+	m_backend->OMSetDepthStencilState(state, stencilRef);
+	bound(DepthStencilState);
+}
+
+void RenderContext::OMSetRenderTargets(unsigned int count, ID3D11RenderTargetView* const* targets, ID3D11DepthStencilView* depthStencil)
+{
+	bool same = m_known[RenderTargets] && count <= RenderTargetSlots && m_renderTargetCount == count && m_depthStencil == depthStencil;
+	for (unsigned int i = 0; i < count && same; i++)
+		same = m_renderTargets[i] == targets[i];
+
+	if (same)
+		return skipped(RenderTargets);
+
+	m_known[RenderTargets] = count <= RenderTargetSlots;
+	m_renderTargetCount = count;
+	for (unsigned int i = 0; i < count && i < RenderTargetSlots; i++)
+		m_renderTargets[i] = targets[i];
+	m_depthStencil = depthStencil;
+
+	// NB: The device quietly unbinds any shader resource whose texture has just become a target, so the shadow can no longer vouch for them
+	for (int i = 0; i < ShaderResourceSlots; i++)
+		m_knownShaderResources[i] = false;
+
+	m_backend->OMSetRenderTargets(count, targets, depthStencil);
+	bound(RenderTargets);
+}
+
+void* RenderContext::Map(ID3D11Buffer* buffer, unsigned int bytes, bool discard, unsigned int offset)
+{
+	bound(Maps);
+	m_mappedBytes += bytes;
+
+	return m_backend->Map(buffer, offset, bytes, discard);
+}
+
+void RenderContext::Unmap(ID3D11Buffer* buffer)
+{
+	m_backend->Unmap(buffer);
+}
+
+void RenderContext::setConstantRing(ConstantRing* ring)
+{
+	m_constantRing = ring;
+}
+
+ConstantRing* RenderContext::getConstantRing()
+{
+	return m_constantRing;
+}
+
+void RenderContext::ClearRenderTargetView(ID3D11RenderTargetView* target, const float colour[4])
+{
+	m_backend->ClearRenderTargetView(target, colour);
+	bound(Clears);
+}
+
+void RenderContext::ClearDepthStencilView(ID3D11DepthStencilView* depthStencil, unsigned int flags, float depth, unsigned char stencil)
+{
+	m_backend->ClearDepthStencilView(depthStencil, flags, depth, stencil);
+	bound(Clears);
+}
+
+void RenderContext::CopyResource(ID3D11Resource* destination, ID3D11Resource* source)
+{
+	m_backend->CopyResource(destination, source);
+	bound(Copies);
+}
+
+void RenderContext::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	m_backend->DrawIndexed(indexCount, startIndex, baseVertex);
+	bound(Draws);
+}
+
+void RenderContext::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance)
+{
+	m_backend->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+	bound(Draws);
+}
+
+void RenderContext::DrawString(const wchar_t* text, float x, float y)
+{
+	m_backend->DrawString(text, x, y);
+	bound(Text);
+	Invalidate();
+}
+
+int RenderContext::getBoundCount(Call call)
+{
+	return m_bound[call];
+}
+
+int RenderContext::getSkippedCount(Call call)
+{
+	return m_skipped[call];
+}
+
+int RenderContext::getBoundCount()
+{
+	int count = 0;
+	for (int i = 0; i < CallCount; i++)
+		count += m_bound[i];
+
+	return count;
+}
+
+int RenderContext::getSkippedCount()
+{
+	int count = 0;
+	for (int i = 0; i < CallCount; i++)
+		count += m_skipped[i];
+
+	return count;
+}
+
+size_t RenderContext::getMappedBytes()
+{
+	return m_mappedBytes;
+}
+
+std::string RenderContext::getReport()
+{
+	std::string report = "Render context: " + std::to_string(getBoundCount()) + " calls bound, " + std::to_string(getSkippedCount()) + " skipped as redundant, " + std::to_string(m_mappedBytes) + " bytes mapped\n";
+
+	for (int i = 0; i < CallCount; i++)
+	{
+		if (m_bound[i] == 0 && m_skipped[i] == 0)
+			continue;
+
+		char line[96];
+		snprintf(line, sizeof(line), "  %-24s %8d bound %8d skipped\n", getCallName((Call)i), m_bound[i], m_skipped[i]);
+		report += line;
+	}
+
+	return report;
+}
+
+const char* RenderContext::getCallName(Call call)
+{
+	static const char* names[CallCount] = {
+		"Input layout",
+		"Vertex buffers",
+		"Index buffer",
+		"Primitive topology",
+		"Vertex shader",
+		"Vertex constant buffers",
+		"Pixel shader",
+		"Pixel constant buffers",
+		"Shader resources",
+		"Samplers",
+		"Rasterizer state",
+		"Viewports",
+		"Blend state",
+		"Depth stencil state",
+		"Render targets",
+		"Maps",
+		"Clears",
+		"Copies",
+		"Draws",
+		"Text",
+	};
+
+	return names[call];
+}
+
+void RenderContext::bound(Call call)
+{
+	m_bound[call]++;
+
+	// NB: Forgetting everything after every call leaves nothing to skip
+	if (!m_shadowing)
+		Invalidate();
+}
+
+void RenderContext::skipped(Call call)
+{
+	m_skipped[call]++;
+}
@@ -0,0 +1,280 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// NB: Only ever handled by pointer, so the context itself compiles without Direct3D
+struct ID3D11Buffer;
+struct ID3D11Resource;
+struct ID3D11InputLayout;
+struct ID3D11VertexShader;
+struct ID3D11PixelShader;
+struct ID3D11ClassInstance;
+struct ID3D11SamplerState;
+struct ID3D11ShaderResourceView;
+struct ID3D11RasterizerState;
+struct ID3D11BlendState;
+struct ID3D11DepthStencilState;
+struct ID3D11RenderTargetView;
+struct ID3D11DepthStencilView;
+
+// Same layout as D3D11_VIEWPORT
+struct RenderViewport
+{
+	float	TopLeftX;
+	float	TopLeftY;
+	float	Width;
+	float	Height;
+	float	MinDepth;
+	float	MaxDepth;
+};
+
+// A constant buffer as bound to a slot: either the whole buffer (count 0), or the window of count 16-byte constants from first onwards
+struct ConstantBinding
+{
+	ID3D11Buffer*	buffer;
+	unsigned int	first;
+	unsigned int	count;
+
+	bool operator==(const ConstantBinding& other) const { return buffer == other.buffer && first == other.first && count == other.count; }
+};
+
+class ConstantRing;
+
+// Where a render context's calls actually go. Mirrors the subset of ID3D11DeviceContext the framework uses
+class RenderContextBackend
+{
+public:
+	virtual ~RenderContextBackend() {}
+
+	virtual void					IASetInputLayout(ID3D11InputLayout* layout) = 0;
+	virtual void					IASetVertexBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets) = 0;
+	virtual void					IASetIndexBuffer(ID3D11Buffer* buffer, int format, unsigned int offset) = 0;
+	virtual void					IASetPrimitiveTopology(int topology) = 0;
+
+	virtual void					VSSetShader(ID3D11VertexShader* shader) = 0;
+	virtual void					VSSetConstantBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers) = 0;
+	virtual void					VSSetConstantBuffers1(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* constantCounts) = 0;	// Direct3D 11.1 only
+	virtual void					PSSetShader(ID3D11PixelShader* shader) = 0;
+	virtual void					PSSetConstantBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers) = 0;
+	virtual void					PSSetConstantBuffers1(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* constantCounts) = 0;
+	virtual void					PSSetShaderResources(unsigned int slot, unsigned int count, ID3D11ShaderResourceView* const* views) = 0;
+	virtual void					PSSetSamplers(unsigned int slot, unsigned int count, ID3D11SamplerState* const* samplers) = 0;
+
+	virtual void					RSSetState(ID3D11RasterizerState* state) = 0;
+	virtual void					RSSetViewports(unsigned int count, const RenderViewport* viewports) = 0;
+	virtual RenderViewport			RSGetViewport() = 0;
+
+	virtual void					OMSetBlendState(ID3D11BlendState* state, const float factor[4], unsigned int sampleMask) = 0;
+	virtual void					OMSetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef) = 0;
+	virtual void					OMSetRenderTargets(unsigned int count, ID3D11RenderTargetView* const* targets, ID3D11DepthStencilView* depthStencil) = 0;
+
+	virtual void*					Map(ID3D11Buffer* buffer, unsigned int offset, unsigned int bytes, bool discard) = 0;	// D3D11_MAP_WRITE_DISCARD, or D3D11_MAP_WRITE_NO_OVERWRITE; returns where offset lands
+	virtual void					Unmap(ID3D11Buffer* buffer) = 0;
+
+	virtual void					ClearRenderTargetView(ID3D11RenderTargetView* target, const float colour[4]) = 0;
+	virtual void					ClearDepthStencilView(ID3D11DepthStencilView* depthStencil, unsigned int flags, float depth, unsigned char stencil) = 0;
+	virtual void					CopyResource(ID3D11Resource* destination, ID3D11Resource* source) = 0;
+	virtual void					DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) = 0;
+	virtual void					DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance) = 0;
+	virtual void					DrawString(const wchar_t* text, float x, float y) = 0;	// White, in the backend's own font, from (x, y) in pixels; binds whatever it needs to
+};
+
+// Records every call that reaches it without touching a device, so a frame's submissions can be counted headlessly
+class NullRenderContextBackend : public RenderContextBackend
+{
+public:
+	NullRenderContextBackend();
+
+	void							IASetInputLayout(ID3D11InputLayout* layout) override;
+	void							IASetVertexBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets) override;
+	void							IASetIndexBuffer(ID3D11Buffer* buffer, int format, unsigned int offset) override;
+	void							IASetPrimitiveTopology(int topology) override;
+
+	void							VSSetShader(ID3D11VertexShader* shader) override;
+	void							VSSetConstantBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers) override;
+	void							VSSetConstantBuffers1(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* constantCounts) override;
+	void							PSSetShader(ID3D11PixelShader* shader) override;
+	void							PSSetConstantBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers) override;
+	void							PSSetConstantBuffers1(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* constantCounts) override;
+	void							PSSetShaderResources(unsigned int slot, unsigned int count, ID3D11ShaderResourceView* const* views) override;
+	void							PSSetSamplers(unsigned int slot, unsigned int count, ID3D11SamplerState* const* samplers) override;
+
+	void							RSSetState(ID3D11RasterizerState* state) override;
+	void							RSSetViewports(unsigned int count, const RenderViewport* viewports) override;
+	RenderViewport					RSGetViewport() override;
+
+	void							OMSetBlendState(ID3D11BlendState* state, const float factor[4], unsigned int sampleMask) override;
+	void							OMSetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef) override;
+	void							OMSetRenderTargets(unsigned int count, ID3D11RenderTargetView* const* targets, ID3D11DepthStencilView* depthStencil) override;
+
+	void*							Map(ID3D11Buffer* buffer, unsigned int offset, unsigned int bytes, bool discard) override;		// Hands out scratch memory
+	void							Unmap(ID3D11Buffer* buffer) override;
+
+	void							ClearRenderTargetView(ID3D11RenderTargetView* target, const float colour[4]) override;
+	void							ClearDepthStencilView(ID3D11DepthStencilView* depthStencil, unsigned int flags, float depth, unsigned char stencil) override;
+	void							CopyResource(ID3D11Resource* destination, ID3D11Resource* source) override;
+	void							DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) override;
+	void							DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance) override;
+	void							DrawString(const wchar_t* text, float x, float y) override;		// Counted as a call, not a draw
+
+	void							Reset();					// Forgets the log and counts
+	void							setLogging(bool logging);	// Off by default; counting alone is much cheaper
+
+	const std::vector<std::string>&	getLog();
+	int								getCallCount();
+	int								getDrawCount();
+
+private:
+	void							record(const std::string& call);
+
+	std::vector<std::string>		m_log;
+	std::vector<char>				m_scratch;
+	RenderViewport					m_viewport;
+	bool							m_logging;
+	int								m_callCount;
+	int								m_drawCount;
+};
+
+// Wraps a device context, shadowing the pipeline state bound through it so that redundant binds never reach the backend.
+// NB: Anything that draws with the raw device context behind its back (e.g. Present) must be followed by Invalidate
+class RenderContext
+{
+public:
+	enum Call
+	{
+		InputLayout,
+		VertexBuffers,
+		IndexBuffer,
+		PrimitiveTopology,
+		VertexShader,
+		VertexConstantBuffers,
+		PixelShader,
+		PixelConstantBuffers,
+		ShaderResources,
+		Samplers,
+		RasterizerState,
+		Viewports,
+		BlendState,
+		DepthStencilState,
+		RenderTargets,
+		Maps,
+		Clears,
+		Copies,
+		Draws,
+		Text,
+		CallCount
+	};
+
+	RenderContext();
+
+	void							Initialise(RenderContextBackend* backend);
+
+	// Swaps the backend without touching the shadow, for a backend that passes everything on to the last (e.g. CommandBuffer)
+	RenderContextBackend*			getBackend();
+	void							setBackend(RenderContextBackend* backend);
+
+	void							newFrame();		// Resets the counts, and forgets the shadowed state
+	void							Invalidate();	// Forgets the shadowed state, so the next bind of everything goes through
+	void							setShadowing(bool shadowing);	// On by default; off, every call goes through, as a baseline for what shadowing saves
+
+	void							IASetInputLayout(ID3D11InputLayout* layout);
+	void							IASetVertexBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets);
+	void							IASetIndexBuffer(ID3D11Buffer* buffer, int format, unsigned int offset);
+	void							IASetPrimitiveTopology(int topology);
+
+	void							VSSetShader(ID3D11VertexShader* shader, ID3D11ClassInstance* const* instances, unsigned int instanceCount);	// Class instances are unsupported, so must be 0
+	void							VSSetConstantBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers);
+	void							VSSetConstants(unsigned int slot, const ConstantBinding& binding);	// Binds a window of a buffer when binding.count is non-zero
+	void							PSSetShader(ID3D11PixelShader* shader, ID3D11ClassInstance* const* instances, unsigned int instanceCount);
+	void							PSSetConstantBuffers(unsigned int slot, unsigned int count, ID3D11Buffer* const* buffers);
+	void							PSSetConstants(unsigned int slot, const ConstantBinding& binding);
+	void							PSSetShaderResources(unsigned int slot, unsigned int count, ID3D11ShaderResourceView* const* views);
+	void							PSSetSamplers(unsigned int slot, unsigned int count, ID3D11SamplerState* const* samplers);
+
+	void							RSSetState(ID3D11RasterizerState* state);
+	void							RSSetViewports(unsigned int count, const RenderViewport* viewports);
+	RenderViewport					RSGetViewport();	// Answered from the shadow whenever possible
+
+	void							OMSetBlendState(ID3D11BlendState* state, const float factor[4], unsigned int sampleMask);
+	void							OMSetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef);
+	void							OMSetRenderTargets(unsigned int count, ID3D11RenderTargetView* const* targets, ID3D11DepthStencilView* depthStencil);
+
+	void*							Map(ID3D11Buffer* buffer, unsigned int bytes, bool discard = true, unsigned int offset = 0);	// Returns where offset lands; the caller writes bytes from there
+	void							Unmap(ID3D11Buffer* buffer);
+
+	void							setConstantRing(ConstantRing* ring);	// Where shaders sub-allocate their constants; nullptr falls back to a buffer apiece
+	ConstantRing*					getConstantRing();
+
+	void							ClearRenderTargetView(ID3D11RenderTargetView* target, const float colour[4]);
+	void							ClearDepthStencilView(ID3D11DepthStencilView* depthStencil, unsigned int flags, float depth, unsigned char stencil);
+	void							CopyResource(ID3D11Resource* destination, ID3D11Resource* source);
+	void							DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex);
+	void							DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance);	// Counted as one draw
+	void							DrawString(const wchar_t* text, float x, float y);	// Forgets the shadowed state after, as the backend binds its own
+
+	// Calls passed on to, and dropped before, the backend since the last newFrame
+	int								getBoundCount(Call call);
+	int								getSkippedCount(Call call);
+	int								getBoundCount();
+	int								getSkippedCount();
+	size_t							getMappedBytes();	// Bytes written through Map
+	std::string						getReport();		// Human-readable table of the above
+	static const char*				getCallName(Call call);
+
+	static const int				ConstantBufferSlots = 14;
+	static const int				ShaderResourceSlots = 32;	// NB: Higher slots are passed straight through
+	static const int				SamplerSlots = 16;
+	static const int				RenderTargetSlots = 8;
+
+private:
+	// Compares count incoming values against the shadow from slot onwards, updating it, and narrows [first, last] to the range that changed
+	template <typename T>
+	bool							shadowSlots(T* shadow, bool* known, unsigned int slots, unsigned int slot, unsigned int count, T const* values, unsigned int& first, unsigned int& last);
+
+	void							bound(Call call);
+	void							skipped(Call call);
+
+	// Shared by the whole-buffer and windowed binds, so the two stay in one shadow
+	void							setConstants(ConstantBinding* shadow, bool* known, unsigned int slot, unsigned int count, const ConstantBinding* bindings, bool pixel);
+
+	RenderContextBackend*			m_backend;
+
+	ID3D11InputLayout*				m_inputLayout;
+	ID3D11Buffer*					m_vertexBuffer;
+	unsigned int					m_vertexStride;
+	unsigned int					m_vertexOffset;
+	ID3D11Buffer*					m_indexBuffer;
+	int								m_indexFormat;
+	unsigned int					m_indexOffset;
+	int								m_topology;
+	ID3D11VertexShader*				m_vertexShader;
+	ConstantBinding					m_vertexConstantBuffers[ConstantBufferSlots];
+	ID3D11PixelShader*				m_pixelShader;
+	ConstantBinding					m_pixelConstantBuffers[ConstantBufferSlots];
+	ID3D11ShaderResourceView*		m_shaderResources[ShaderResourceSlots];
+	ID3D11SamplerState*				m_samplers[SamplerSlots];
+	ID3D11RasterizerState*			m_rasterizerState;
+	RenderViewport					m_viewport;
+	ID3D11BlendState*				m_blendState;
+	float							m_blendFactor[4];
+	unsigned int					m_sampleMask;
+	ID3D11DepthStencilState*		m_depthStencilState;
+	unsigned int					m_stencilRef;
+	unsigned int					m_renderTargetCount;
+	ID3D11RenderTargetView*			m_renderTargets[RenderTargetSlots];
+	ID3D11DepthStencilView*			m_depthStencil;
+
+	// Whether each piece of shadowed state is known to match the device
+	bool							m_known[CallCount];
+	bool							m_knownVertexConstantBuffers[ConstantBufferSlots];
+	bool							m_knownPixelConstantBuffers[ConstantBufferSlots];
+	bool							m_knownShaderResources[ShaderResourceSlots];
+	bool							m_knownSamplers[SamplerSlots];
+
+	int								m_bound[CallCount];
+	int								m_skipped[CallCount];
+	size_t							m_mappedBytes;
+	bool							m_shadowing;
+
+	ConstantRing*					m_constantRing;
+};
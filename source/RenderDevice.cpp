@@ -0,0 +1,390 @@
+#include "pch.h"
+#include "RenderDevice.h"
+#include <cstdio>
+
+NullRenderDeviceBackend::NullRenderDeviceBackend()
+{
+	m_next = 0x10000;
+}
+
+ID3D11Buffer* NullRenderDeviceBackend::CreateBuffer(const RenderBufferDesc& desc, const void* data)
+{
+	return (ID3D11Buffer*)handle();
+}
+
+ID3D11Texture2D* NullRenderDeviceBackend::CreateTexture2D(const RenderTextureDesc& desc, const void* data)
+{
+	return (ID3D11Texture2D*)handle();
+}
+
+ID3D11RenderTargetView* NullRenderDeviceBackend::CreateRenderTargetView(ID3D11Texture2D* texture)
+{
+	return (ID3D11RenderTargetView*)handle();
+}
+
+ID3D11ShaderResourceView* NullRenderDeviceBackend::CreateShaderResourceView(ID3D11Texture2D* texture)
+{
+	return (ID3D11ShaderResourceView*)handle();
+}
+
+ID3D11DepthStencilView* NullRenderDeviceBackend::CreateDepthStencilView(ID3D11Texture2D* texture)
+{
+	return (ID3D11DepthStencilView*)handle();
+}
+
+ID3D11VertexShader* NullRenderDeviceBackend::CreateVertexShader(const void* bytecode, size_t bytes)
+{
+	return (ID3D11VertexShader*)handle();
+}
+
+ID3D11PixelShader* NullRenderDeviceBackend::CreatePixelShader(const void* bytecode, size_t bytes)
+{
+	return (ID3D11PixelShader*)handle();
+}
+
+ID3D11InputLayout* NullRenderDeviceBackend::CreateInputLayout(const RenderInputElement* elements, unsigned int count, const void* bytecode, size_t bytes)
+{
+	return (ID3D11InputLayout*)handle();
+}
+
+ID3D11SamplerState* NullRenderDeviceBackend::CreateSamplerState(const RenderSamplerDesc& desc)
+{
+	return (ID3D11SamplerState*)handle();
+}
+
+ID3D11RasterizerState* NullRenderDeviceBackend::CreateRasterizerState(const RenderRasterizerDesc& desc)
+{
+	return (ID3D11RasterizerState*)handle();
+}
+
+ID3D11DepthStencilState* NullRenderDeviceBackend::CreateDepthStencilState(const RenderDepthStencilDesc& desc)
+{
+	return (ID3D11DepthStencilState*)handle();
+}
+
+ID3D11BlendState* NullRenderDeviceBackend::CreateBlendState(const RenderBlendDesc& desc)
+{
+	return (ID3D11BlendState*)handle();
+}
+
+ID3D11ShaderResourceView* NullRenderDeviceBackend::CreateTextureFromFile(const wchar_t* filename)
+{
+	return (ID3D11ShaderResourceView*)handle();
+}
+
+void NullRenderDeviceBackend::Release(void* resource)
+{
+}
+
+bool NullRenderDeviceBackend::ReadTexture(ID3D11ShaderResourceView* view, RenderTexels& texels)
+{
+	return false;
+}
+
+bool NullRenderDeviceBackend::getConstantOffsetting()
+{
+	return true;
+}
+
+void* NullRenderDeviceBackend::handle()
+{
+	// NB: Never reused, so a render context shadowing a released handle can never mistake a new resource for it
+	m_next += 16;
+	return (void*)m_next;
+}
+
+RenderDevice::RenderDevice()
+{
+	m_backend = nullptr;
+	for (int i = 0; i < ResourceCount; i++)
+	{
+		m_created[i] = 0;
+		m_live[i] = 0;
+	}
+	m_allocatedBytes = 0;
+	m_peakBytes = 0;
+}
+
+void RenderDevice::Initialise(RenderDeviceBackend* backend)
+{
+	// NB: The counts carry on, as resources from before (e.g. a lost device) may still be released through here
+	m_backend = backend;
+}
+
+ID3D11Buffer* RenderDevice::CreateBuffer(const RenderBufferDesc& desc, const void* data)
+{
+	ID3D11Buffer* buffer = m_backend->CreateBuffer(desc, data);
+	created(Buffers, buffer, desc.bytes);
+
+	return buffer;
+}
+
+ID3D11Texture2D* RenderDevice::CreateTexture2D(const RenderTextureDesc& desc, const void* data)
+{
+	ID3D11Texture2D* texture = m_backend->CreateTexture2D(desc, data);
+	created(Textures, texture, (size_t)desc.width*(size_t)desc.height*getFormatBytes(desc.format));
+
+	return texture;
+}
+
+ID3D11RenderTargetView* RenderDevice::CreateRenderTargetView(ID3D11Texture2D* texture)
+{
+	ID3D11RenderTargetView* view = m_backend->CreateRenderTargetView(texture);
+	created(RenderTargetViews, view, 0);
+
+	return view;
+}
+
+ID3D11ShaderResourceView* RenderDevice::CreateShaderResourceView(ID3D11Texture2D* texture)
+{
+	ID3D11ShaderResourceView* view = m_backend->CreateShaderResourceView(texture);
+	created(ShaderResourceViews, view, 0);
+
+	return view;
+}
+
+ID3D11DepthStencilView* RenderDevice::CreateDepthStencilView(ID3D11Texture2D* texture)
+{
+	ID3D11DepthStencilView* view = m_backend->CreateDepthStencilView(texture);
+	created(DepthStencilViews, view, 0);
+
+	return view;
+}
+
+ID3D11VertexShader* RenderDevice::CreateVertexShader(const void* bytecode, size_t bytes)
+{
+	ID3D11VertexShader* shader = m_backend->CreateVertexShader(bytecode, bytes);
+	created(VertexShaders, shader, 0);
+
+	return shader;
+}
+
+ID3D11PixelShader* RenderDevice::CreatePixelShader(const void* bytecode, size_t bytes)
+{
+	ID3D11PixelShader* shader = m_backend->CreatePixelShader(bytecode, bytes);
+	created(PixelShaders, shader, 0);
+
+	return shader;
+}
+
+ID3D11InputLayout* RenderDevice::CreateInputLayout(const RenderInputElement* elements, unsigned int count, const void* bytecode, size_t bytes)
+{
+	ID3D11InputLayout* layout = m_backend->CreateInputLayout(elements, count, bytecode, bytes);
+	created(InputLayouts, layout, 0);
+
+	return layout;
+}
+
+ID3D11SamplerState* RenderDevice::CreateSamplerState(const RenderSamplerDesc& desc)
+{
+	ID3D11SamplerState* sampler = m_backend->CreateSamplerState(desc);
+	created(SamplerStates, sampler, 0);
+
+	return sampler;
+}
+
+ID3D11RasterizerState* RenderDevice::CreateRasterizerState(const RenderRasterizerDesc& desc)
+{
+	ID3D11RasterizerState* state = m_backend->CreateRasterizerState(desc);
+	created(RasterizerStates, state, 0);
+
+	return state;
+}
+
+ID3D11DepthStencilState* RenderDevice::CreateDepthStencilState(const RenderDepthStencilDesc& desc)
+{
+	ID3D11DepthStencilState* state = m_backend->CreateDepthStencilState(desc);
+	created(DepthStencilStates, state, 0);
+
+	return state;
+}
+
+ID3D11BlendState* RenderDevice::CreateBlendState(const RenderBlendDesc& desc)
+{
+	ID3D11BlendState* state = m_backend->CreateBlendState(desc);
+	created(BlendStates, state, 0);
+
+	return state;
+}
+
+ID3D11ShaderResourceView* RenderDevice::CreateTextureFromFile(const wchar_t* filename)
+{
+	ID3D11ShaderResourceView* view = m_backend->CreateTextureFromFile(filename);
+	created(ShaderResourceViews, view, 0);
+
+	return view;
+}
+
+void RenderDevice::Release(ID3D11Buffer* buffer)
+{
+	released(Buffers, buffer);
+}
+
+void RenderDevice::Release(ID3D11Texture2D* texture)
+{
+	released(Textures, texture);
+}
+
+void RenderDevice::Release(ID3D11RenderTargetView* view)
+{
+	released(RenderTargetViews, view);
+}
+
+void RenderDevice::Release(ID3D11ShaderResourceView* view)
+{
+	released(ShaderResourceViews, view);
+}
+
+void RenderDevice::Release(ID3D11DepthStencilView* view)
+{
+	released(DepthStencilViews, view);
+}
+
+void RenderDevice::Release(ID3D11VertexShader* shader)
+{
+	released(VertexShaders, shader);
+}
+
+void RenderDevice::Release(ID3D11PixelShader* shader)
+{
+	released(PixelShaders, shader);
+}
+
+void RenderDevice::Release(ID3D11InputLayout* layout)
+{
+	released(InputLayouts, layout);
+}
+
+void RenderDevice::Release(ID3D11SamplerState* sampler)
+{
+	released(SamplerStates, sampler);
+}
+
+void RenderDevice::Release(ID3D11RasterizerState* state)
+{
+	released(RasterizerStates, state);
+}
+
+void RenderDevice::Release(ID3D11DepthStencilState* state)
+{
+	released(DepthStencilStates, state);
+}
+
+void RenderDevice::Release(ID3D11BlendState* state)
+{
+	released(BlendStates, state);
+}
+
+bool RenderDevice::ReadTexture(ID3D11ShaderResourceView* view, RenderTexels& texels)
+{
+	return view && m_backend->ReadTexture(view, texels);
+}
+
+bool RenderDevice::getConstantOffsetting()
+{
+	return m_backend->getConstantOffsetting();
+}
+
+int RenderDevice::getCreatedCount(Resource resource)
+{
+	return m_created[resource];
+}
+
+int RenderDevice::getLiveCount(Resource resource)
+{
+	return m_live[resource];
+}
+
+size_t RenderDevice::getAllocatedBytes()
+{
+	return m_allocatedBytes;
+}
+
+size_t RenderDevice::getPeakBytes()
+{
+	return m_peakBytes;
+}
+
+std::string RenderDevice::getReport()
+{
+	std::string report = "Render device: " + std::to_string(m_allocatedBytes/1024) + " KB allocated, " + std::to_string(m_peakBytes/1024) + " KB at peak\n";
+	for (int i = 0; i < ResourceCount; i++)
+	{
+		char line[128];
+		snprintf(line, sizeof(line), "  %-22s %6d created %6d live\n", getResourceName((Resource)i), m_created[i], m_live[i]);
+		report += line;
+	}
+
+	return report;
+}
+
+const char* RenderDevice::getResourceName(Resource resource)
+{
+	static const char* names[ResourceCount] = {
+		"Buffers",
+		"Textures",
+		"Render target views",
+		"Shader resource views",
+		"Depth stencil views",
+		"Vertex shaders",
+		"Pixel shaders",
+		"Input layouts",
+		"Sampler states",
+		"Rasterizer states",
+		"Depth stencil states",
+		"Blend states",
+	};
+
+	return names[resource];
+}
+
+size_t RenderDevice::getFormatBytes(RenderFormat format)
+{
+	switch (format)
+	{
+	case RenderFormatRgba32Float:
+		return 16;
+	case RenderFormatRgb32Float:
+		return 12;
+	case RenderFormatRg32Float:
+		return 8;
+	case RenderFormatRgba8:
+	case RenderFormatR32Float:
+	case RenderFormatR32Uint:
+	case RenderFormatDepth24Stencil8:
+		return 4;
+	}
+
+	return 0;
+}
+
+void RenderDevice::created(Resource resource, void* handle, size_t bytes)
+{
+	if (!handle)
+		return;
+
+	m_created[resource]++;
+	m_live[resource]++;
+	if (bytes == 0)
+		return;
+
+	m_bytes[handle] = bytes;
+	m_allocatedBytes += bytes;
+	m_peakBytes = std::max(m_peakBytes, m_allocatedBytes);
+}
+
+void RenderDevice::released(Resource resource, void* handle)
+{
+	if (!handle)
+		return;
+
+	m_backend->Release(handle);
+	m_live[resource]--;
+
+	auto bytes = m_bytes.find(handle);
+	if (bytes != m_bytes.end())
+	{
+		m_allocatedBytes -= bytes->second;
+		m_bytes.erase(bytes);
+	}
+}
@@ -0,0 +1,242 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// NB: Only ever handled by pointer, so the device itself compiles without Direct3D
+struct ID3D11Buffer;
+struct ID3D11Texture2D;
+struct ID3D11RenderTargetView;
+struct ID3D11ShaderResourceView;
+struct ID3D11DepthStencilView;
+struct ID3D11VertexShader;
+struct ID3D11PixelShader;
+struct ID3D11InputLayout;
+struct ID3D11SamplerState;
+struct ID3D11RasterizerState;
+struct ID3D11DepthStencilState;
+struct ID3D11BlendState;
+
+// The formats resources are created in; same values as DXGI_FORMAT
+enum RenderFormat
+{
+	RenderFormatRgba32Float = 2,
+	RenderFormatRgb32Float = 6,
+	RenderFormatRg32Float = 16,
+	RenderFormatRgba8 = 28,
+	RenderFormatR32Float = 41,
+	RenderFormatR32Uint = 42,
+	RenderFormatDepth24Stencil8 = 45,
+};
+
+// Same values as D3D11_BIND_FLAG
+enum RenderBind
+{
+	RenderBindVertexBuffer = 0x1,
+	RenderBindIndexBuffer = 0x2,
+	RenderBindConstantBuffer = 0x4,
+	RenderBindShaderResource = 0x8,
+	RenderBindRenderTarget = 0x20,
+	RenderBindDepthStencil = 0x40,
+};
+
+struct RenderBufferDesc
+{
+	unsigned int	bytes;
+	unsigned int	bind;		// RenderBind flags
+	bool			dynamic;	// Written by the CPU through Map; otherwise only ever holds its initial data
+};
+
+struct RenderTextureDesc
+{
+	unsigned int	width;
+	unsigned int	height;
+	RenderFormat	format;
+	unsigned int	bind;
+};
+
+// One element of a vertex layout, placed straight after the element before it in the same slot
+struct RenderInputElement
+{
+	const char*		semantic;
+	unsigned int	index;
+	RenderFormat	format;
+	unsigned int	slot;
+	bool			instanced;	// Steps once per instance rather than once per vertex
+};
+
+struct RenderSamplerDesc
+{
+	bool			point;		// Otherwise linear
+	bool			clamp;		// Otherwise wrapped
+};
+
+// Same values as D3D11_CULL_MODE; clockwise on screen is front-facing
+enum RenderCull
+{
+	RenderCullNone = 1,
+	RenderCullFront = 2,
+	RenderCullBack = 3,
+};
+
+struct RenderRasterizerDesc
+{
+	RenderCull		cull;
+};
+
+struct RenderDepthStencilDesc
+{
+	bool			test;		// Less-equal
+	bool			write;
+};
+
+struct RenderBlendDesc
+{
+	bool			alpha;		// Premultiplied alpha; otherwise opaque
+};
+
+// A texture's top level as read back, in its own DXGI format, rowPitch bytes from one row to the next
+struct RenderTexels
+{
+	int							format;
+	unsigned int				width;
+	unsigned int				height;
+	unsigned int				rowPitch;
+	std::vector<unsigned char>	data;
+};
+
+// Where a render device's resources are actually created. Mirrors the subset of ID3D11Device the framework uses
+class RenderDeviceBackend
+{
+public:
+	virtual ~RenderDeviceBackend() {}
+
+	// Each returns nullptr on failure
+	virtual ID3D11Buffer*				CreateBuffer(const RenderBufferDesc& desc, const void* data) = 0;
+	virtual ID3D11Texture2D*			CreateTexture2D(const RenderTextureDesc& desc, const void* data) = 0;
+	virtual ID3D11RenderTargetView*		CreateRenderTargetView(ID3D11Texture2D* texture) = 0;		// Views cover the whole texture, in its own format
+	virtual ID3D11ShaderResourceView*	CreateShaderResourceView(ID3D11Texture2D* texture) = 0;
+	virtual ID3D11DepthStencilView*		CreateDepthStencilView(ID3D11Texture2D* texture) = 0;
+	virtual ID3D11VertexShader*			CreateVertexShader(const void* bytecode, size_t bytes) = 0;
+	virtual ID3D11PixelShader*			CreatePixelShader(const void* bytecode, size_t bytes) = 0;
+	virtual ID3D11InputLayout*			CreateInputLayout(const RenderInputElement* elements, unsigned int count, const void* bytecode, size_t bytes) = 0;	// Checked against the vertex shader's bytecode
+	virtual ID3D11SamplerState*			CreateSamplerState(const RenderSamplerDesc& desc) = 0;
+	virtual ID3D11RasterizerState*		CreateRasterizerState(const RenderRasterizerDesc& desc) = 0;
+	virtual ID3D11DepthStencilState*	CreateDepthStencilState(const RenderDepthStencilDesc& desc) = 0;
+	virtual ID3D11BlendState*			CreateBlendState(const RenderBlendDesc& desc) = 0;
+	virtual ID3D11ShaderResourceView*	CreateTextureFromFile(const wchar_t* filename) = 0;		// A DDS file; the view holds the only reference to its texture
+	virtual void						Release(void* resource) = 0;
+
+	virtual bool						ReadTexture(ID3D11ShaderResourceView* view, RenderTexels& texels) = 0;	// False if it couldn't be read back
+	virtual bool						getConstantOffsetting() = 0;	// Whether windows of a constant buffer can be bound, and mapped without discarding (i.e. Direct3D 11.1)
+};
+
+// Hands out made-up handles without touching a device, so whatever creates resources can run headlessly
+class NullRenderDeviceBackend : public RenderDeviceBackend
+{
+public:
+	NullRenderDeviceBackend();
+
+	ID3D11Buffer*						CreateBuffer(const RenderBufferDesc& desc, const void* data) override;
+	ID3D11Texture2D*					CreateTexture2D(const RenderTextureDesc& desc, const void* data) override;
+	ID3D11RenderTargetView*				CreateRenderTargetView(ID3D11Texture2D* texture) override;
+	ID3D11ShaderResourceView*			CreateShaderResourceView(ID3D11Texture2D* texture) override;
+	ID3D11DepthStencilView*				CreateDepthStencilView(ID3D11Texture2D* texture) override;
+	ID3D11VertexShader*					CreateVertexShader(const void* bytecode, size_t bytes) override;
+	ID3D11PixelShader*					CreatePixelShader(const void* bytecode, size_t bytes) override;
+	ID3D11InputLayout*					CreateInputLayout(const RenderInputElement* elements, unsigned int count, const void* bytecode, size_t bytes) override;
+	ID3D11SamplerState*					CreateSamplerState(const RenderSamplerDesc& desc) override;
+	ID3D11RasterizerState*				CreateRasterizerState(const RenderRasterizerDesc& desc) override;
+	ID3D11DepthStencilState*			CreateDepthStencilState(const RenderDepthStencilDesc& desc) override;
+	ID3D11BlendState*					CreateBlendState(const RenderBlendDesc& desc) override;
+	ID3D11ShaderResourceView*			CreateTextureFromFile(const wchar_t* filename) override;
+	void								Release(void* resource) override;
+
+	bool								ReadTexture(ID3D11ShaderResourceView* view, RenderTexels& texels) override;	// Never; nothing was ever drawn
+	bool								getConstantOffsetting() override;
+
+private:
+	void*								handle();
+
+	size_t								m_next;
+};
+
+// Wraps a device, keeping count of the resources created through it and the memory they hold.
+// NB: Everything the framework creates goes through here, apart from the swap chain's own targets and the HUD's font (see DeviceRenderContextBackend)
+class RenderDevice
+{
+public:
+	enum Resource
+	{
+		Buffers,
+		Textures,
+		RenderTargetViews,
+		ShaderResourceViews,
+		DepthStencilViews,
+		VertexShaders,
+		PixelShaders,
+		InputLayouts,
+		SamplerStates,
+		RasterizerStates,
+		DepthStencilStates,
+		BlendStates,
+		ResourceCount
+	};
+
+	RenderDevice();
+
+	void								Initialise(RenderDeviceBackend* backend);
+
+	ID3D11Buffer*						CreateBuffer(const RenderBufferDesc& desc, const void* data = nullptr);	// data, if any, is desc.bytes of initial contents
+	ID3D11Texture2D*					CreateTexture2D(const RenderTextureDesc& desc, const void* data = nullptr);		// data, if any, is the texels row by row, tightly packed
+	ID3D11RenderTargetView*				CreateRenderTargetView(ID3D11Texture2D* texture);
+	ID3D11ShaderResourceView*			CreateShaderResourceView(ID3D11Texture2D* texture);
+	ID3D11DepthStencilView*				CreateDepthStencilView(ID3D11Texture2D* texture);
+	ID3D11VertexShader*					CreateVertexShader(const void* bytecode, size_t bytes);
+	ID3D11PixelShader*					CreatePixelShader(const void* bytecode, size_t bytes);
+	ID3D11InputLayout*					CreateInputLayout(const RenderInputElement* elements, unsigned int count, const void* bytecode, size_t bytes);
+	ID3D11SamplerState*					CreateSamplerState(const RenderSamplerDesc& desc);
+	ID3D11RasterizerState*				CreateRasterizerState(const RenderRasterizerDesc& desc);
+	ID3D11DepthStencilState*			CreateDepthStencilState(const RenderDepthStencilDesc& desc);
+	ID3D11BlendState*					CreateBlendState(const RenderBlendDesc& desc);
+	ID3D11ShaderResourceView*			CreateTextureFromFile(const wchar_t* filename);		// Counted as a view alone, as the texture behind it is the loader's
+
+	// Each ignores nullptr
+	void								Release(ID3D11Buffer* buffer);
+	void								Release(ID3D11Texture2D* texture);
+	void								Release(ID3D11RenderTargetView* view);
+	void								Release(ID3D11ShaderResourceView* view);
+	void								Release(ID3D11DepthStencilView* view);
+	void								Release(ID3D11VertexShader* shader);
+	void								Release(ID3D11PixelShader* shader);
+	void								Release(ID3D11InputLayout* layout);
+	void								Release(ID3D11SamplerState* sampler);
+	void								Release(ID3D11RasterizerState* state);
+	void								Release(ID3D11DepthStencilState* state);
+	void								Release(ID3D11BlendState* state);
+
+	// Copies the texture behind a view back through a staging copy of its own, which is never counted
+	bool								ReadTexture(ID3D11ShaderResourceView* view, RenderTexels& texels);
+	bool								getConstantOffsetting();
+
+	// Since the device was constructed
+	int									getCreatedCount(Resource resource);
+	int									getLiveCount(Resource resource);
+	size_t								getAllocatedBytes();	// Held by every live buffer and texture
+	size_t								getPeakBytes();
+	std::string							getReport();			// Human-readable table of the above
+	static const char*					getResourceName(Resource resource);
+
+	static size_t						getFormatBytes(RenderFormat format);	// Per texel
+
+private:
+	void								created(Resource resource, void* handle, size_t bytes);
+	void								released(Resource resource, void* handle);
+
+	RenderDeviceBackend*				m_backend;
+	int									m_created[ResourceCount];
+	int									m_live[ResourceCount];
+	std::unordered_map<void*, size_t>	m_bytes;		// Held by each live buffer and texture
+	size_t								m_allocatedBytes;
+	size_t								m_peakBytes;
+};
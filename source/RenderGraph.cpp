@@ -0,0 +1,528 @@
+#include "pch.h"
+#include "RenderGraph.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+namespace
+{
+	std::string formatMegabytes(size_t bytes)
+	{
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%.1f MB", bytes/(1024.0*1024.0));
+		return buffer;
+	}
+}
+
+NullRenderGraphBackend::NullRenderGraphBackend()
+{
+	m_acquireCount = 0;
+	m_passCount = 0;
+}
+
+RenderTexture* NullRenderGraphBackend::acquire(int width, int height)
+{
+	m_log.push_back("acquire " + std::to_string(width) + "x" + std::to_string(height));
+	m_acquireCount++;
+
+	return nullptr;
+}
+
+void NullRenderGraphBackend::release(RenderTexture* texture)
+{
+	m_log.push_back("release");
+}
+
+void NullRenderGraphBackend::beginPass(const std::string& name)
+{
+	m_log.push_back("pass " + name);
+	m_passCount++;
+}
+
+void NullRenderGraphBackend::endPass()
+{
+}
+
+bool NullRenderGraphBackend::getExecutes()
+{
+	return false;
+}
+
+const std::vector<std::string>& NullRenderGraphBackend::getLog()
+{
+	return m_log;
+}
+
+int NullRenderGraphBackend::getAcquireCount()
+{
+	return m_acquireCount;
+}
+
+int NullRenderGraphBackend::getPassCount()
+{
+	return m_passCount;
+}
+
+
+
+RenderGraph::RenderGraph()
+{
+	m_compiled = false;
+}
+
+RenderGraph::~RenderGraph()
+{
+}
+
+void RenderGraph::Reset()
+{
+	m_resources.clear();
+	m_passes.clear();
+	m_slots.clear();
+	m_schedule.clear();
+	m_compiled = false;
+}
+
+int RenderGraph::importTexture(const std::string& name, int width, int height, int count, size_t bytes, RenderTexture** textures)
+{
+	Resource resource;
+	resource.name = name;
+	resource.width = width;
+	resource.height = height;
+	resource.count = count;
+	resource.bytes = bytes;
+	resource.transient = false;
+	resource.output = false;
+	resource.firstUse = -1;
+	resource.lastUse = -1;
+	resource.slot = -1;
+	if (textures)
+		resource.textures.assign(textures, textures+count);
+	m_resources.push_back(resource);
+
+	return (int)m_resources.size()-1;
+}
+
+int RenderGraph::createTexture(const std::string& name, int width, int height, int count, size_t bytes)
+{
+	int resource = importTexture(name, width, height, count, bytes, nullptr);
+	m_resources[resource].transient = true;
+
+	return resource;
+}
+
+void RenderGraph::markOutput(int resource)
+{
+	m_resources[resource].output = true;
+}
+
+int RenderGraph::addPass(const std::string& name, PassFunction function)
+{
+	Pass pass;
+	pass.name = name;
+	pass.function = function;
+	pass.culled = false;
+	m_passes.push_back(pass);
+
+	m_compiled = false;
+
+	return (int)m_passes.size()-1;
+}
+
+void RenderGraph::read(int pass, int resource)
+{
+	m_passes[pass].reads.push_back(resource);
+}
+
+void RenderGraph::write(int pass, int resource)
+{
+	std::vector<int>& writers = m_resources[resource].writers;
+	if (std::find(writers.begin(), writers.end(), pass) != writers.end())
+		return;
+
+	// NB: Kept in the order the passes were added, whatever order their writes were declared in
+	writers.insert(std::upper_bound(writers.begin(), writers.end(), pass), pass);
+	m_passes[pass].writes.push_back(resource);
+}
+
+void RenderGraph::Compile()
+{
+	linkPasses();
+	cullPasses();
+	schedulePasses();
+	aliasTransients();
+
+	m_compiled = true;
+}
+
+void RenderGraph::linkPasses()
+{
+	for (int i = 0; i < (int)m_passes.size(); i++)
+	{
+		m_passes[i].producers.clear();
+		m_passes[i].predecessors.clear();
+	}
+
+	for (int i = 0; i < (int)m_passes.size(); i++)
+	{
+		for (int j = 0; j < (int)m_passes[i].reads.size(); j++)
+		{
+			const std::vector<int>& writers = m_resources[m_passes[i].reads[j]].writers;
+			if (writers.empty())
+				continue;
+
+			// STEP 1: Read after write; the write seen is the last added before this pass, or the first if there is none
+			int version = (int)(std::lower_bound(writers.begin(), writers.end(), i)-writers.begin())-1;
+			if (version == -1 && writers[0] == i)
+				continue;
+			version = std::max(version, 0);
+
+			if (writers[version] != i)
+			{
+				m_passes[i].producers.push_back(writers[version]);
+				m_passes[i].predecessors.push_back(writers[version]);
+			}
+
+			// STEP 2: Write after read; whatever overwrites what this reads waits for it
+			if (version+1 < (int)writers.size() && writers[version+1] != i)
+				m_passes[writers[version+1]].predecessors.push_back(i);
+		}
+	}
+
+	// STEP 3: Write after write, in the order the writers were added
+	for (int i = 0; i < (int)m_resources.size(); i++)
+		for (int j = 1; j < (int)m_resources[i].writers.size(); j++)
+			m_passes[m_resources[i].writers[j]].predecessors.push_back(m_resources[i].writers[j-1]);
+
+	for (int i = 0; i < (int)m_passes.size(); i++)
+	{
+		std::vector<int>& predecessors = m_passes[i].predecessors;
+		std::sort(predecessors.begin(), predecessors.end());
+		predecessors.erase(std::unique(predecessors.begin(), predecessors.end()), predecessors.end());
+	}
+}
+
+void RenderGraph::cullPasses()
+{
+	// STEP 1: Start from every pass that produces an output (or has no declared writes, so must be run for its side effects)
+	std::vector<int> pending;
+	for (int i = 0; i < (int)m_passes.size(); i++)
+	{
+		m_passes[i].culled = true;
+
+		bool needed = m_passes[i].writes.empty();
+		for (int j = 0; j < (int)m_passes[i].writes.size(); j++)
+			needed |= m_resources[m_passes[i].writes[j]].output;
+
+		if (needed)
+			pending.push_back(i);
+	}
+
+	// STEP 2: Keep whatever wrote what those passes read, and so on
+	while (!pending.empty())
+	{
+		int pass = pending.back();
+		pending.pop_back();
+
+		if (!m_passes[pass].culled)
+			continue;
+		m_passes[pass].culled = false;
+
+		for (int i = 0; i < (int)m_passes[pass].producers.size(); i++)
+			if (m_passes[m_passes[pass].producers[i]].culled)
+				pending.push_back(m_passes[pass].producers[i]);
+	}
+}
+
+void RenderGraph::schedulePasses()
+{
+	// Count each surviving pass's unscheduled predecessors; culled ones never run, so are not waited for
+	std::vector<int> waiting(m_passes.size(), 0);
+	for (int i = 0; i < (int)m_passes.size(); i++)
+	{
+		if (m_passes[i].culled)
+			continue;
+
+		for (int j = 0; j < (int)m_passes[i].predecessors.size(); j++)
+			if (!m_passes[m_passes[i].predecessors[j]].culled)
+				waiting[i]++;
+	}
+
+	// Repeatedly schedule the earliest-declared pass that is ready, so independent passes keep their declared order
+	m_schedule.clear();
+	std::vector<bool> scheduled(m_passes.size(), false);
+	for (;;)
+	{
+		int next = -1;
+		for (int i = 0; i < (int)m_passes.size() && next == -1; i++)
+			if (!m_passes[i].culled && !scheduled[i] && waiting[i] == 0)
+				next = i;
+
+		if (next == -1)
+			break;
+
+		scheduled[next] = true;
+		m_schedule.push_back(next);
+
+		for (int i = 0; i < (int)m_passes.size(); i++)
+		{
+			if (m_passes[i].culled || scheduled[i])
+				continue;
+
+			for (int j = 0; j < (int)m_passes[i].predecessors.size(); j++)
+				if (m_passes[i].predecessors[j] == next)
+					waiting[i]--;
+		}
+	}
+
+	for (int i = 0; i < (int)m_passes.size(); i++)
+		if (!m_passes[i].culled && !scheduled[i])
+			throw std::logic_error("RenderGraph: passes depend on each other in a cycle, including '" + m_passes[i].name + "'");
+}
+
+void RenderGraph::aliasTransients()
+{
+	// STEP 1: Find each resource's lifetime, in schedule positions
+	for (int i = 0; i < (int)m_resources.size(); i++)
+	{
+		m_resources[i].firstUse = -1;
+		m_resources[i].lastUse = -1;
+		m_resources[i].slot = -1;
+	}
+
+	for (int i = 0; i < (int)m_schedule.size(); i++)
+	{
+		Pass& pass = m_passes[m_schedule[i]];
+
+		std::vector<int> used = pass.reads;
+		used.insert(used.end(), pass.writes.begin(), pass.writes.end());
+		for (int j = 0; j < (int)used.size(); j++)
+		{
+			Resource& resource = m_resources[used[j]];
+			if (resource.firstUse == -1)
+				resource.firstUse = i;
+			resource.lastUse = i;
+		}
+	}
+
+	// STEP 2: Pack transients into slots, first come first served, reusing any slot whose previous tenant has died.
+	// NB: Direct3D 11 cannot place differently-shaped textures in the same memory, so only identical shapes share
+	m_slots.clear();
+	for (int i = 0; i < (int)m_schedule.size(); i++)
+	{
+		for (int j = 0; j < (int)m_resources.size(); j++)
+		{
+			Resource& resource = m_resources[j];
+			if (!resource.transient || resource.firstUse != i)
+				continue;
+
+			for (int k = 0; k < (int)m_slots.size() && resource.slot == -1; k++)
+			{
+				Slot& slot = m_slots[k];
+				if (slot.lastUse < i && slot.width == resource.width && slot.height == resource.height && slot.count == resource.count)
+					resource.slot = k;
+			}
+
+			if (resource.slot == -1)
+			{
+				Slot slot;
+				slot.width = resource.width;
+				slot.height = resource.height;
+				slot.count = resource.count;
+				slot.bytes = resource.bytes;
+				slot.lastUse = -1;
+				m_slots.push_back(slot);
+
+				resource.slot = (int)m_slots.size()-1;
+			}
+
+			m_slots[resource.slot].lastUse = resource.lastUse;
+		}
+	}
+}
+
+void RenderGraph::Execute(RenderGraphBackend* backend)
+{
+	if (!m_compiled)
+		Compile();
+
+	for (int i = 0; i < (int)m_schedule.size(); i++)
+	{
+		Pass& pass = m_passes[m_schedule[i]];
+
+		// Transients are acquired as late, and released as early, as the schedule allows
+		for (int j = 0; j < (int)m_slots.size(); j++)
+		{
+			if (!m_slots[j].textures.empty())
+				continue;
+
+			for (int k = 0; k < (int)m_resources.size(); k++)
+			{
+				if (m_resources[k].slot == j && m_resources[k].firstUse == i)
+				{
+					for (int l = 0; l < m_slots[j].count; l++)
+						m_slots[j].textures.push_back(backend->acquire(m_slots[j].width, m_slots[j].height));
+					break;
+				}
+			}
+		}
+
+		backend->beginPass(pass.name);
+		if (backend->getExecutes() && pass.function)
+			pass.function();
+		backend->endPass();
+
+		for (int j = 0; j < (int)m_slots.size(); j++)
+		{
+			if (m_slots[j].lastUse != i)
+				continue;
+
+			for (int k = 0; k < (int)m_slots[j].textures.size(); k++)
+				backend->release(m_slots[j].textures[k]);
+			m_slots[j].textures.clear();
+		}
+	}
+}
+
+RenderTexture* RenderGraph::getTexture(int resource, int index)
+{
+	Resource& r = m_resources[resource];
+	if (r.transient)
+		return (r.slot != -1 && index < (int)m_slots[r.slot].textures.size()) ? m_slots[r.slot].textures[index] : nullptr;
+
+	return (index < (int)r.textures.size()) ? r.textures[index] : nullptr;
+}
+
+std::string RenderGraph::getSchedule()
+{
+	if (!m_compiled)
+		Compile();
+
+	std::string dump = "Render graph: " + std::to_string(getScheduledPassCount()) + " passes scheduled, " + std::to_string(getCulledPassCount()) + " culled\n";
+
+	for (int i = 0; i < (int)m_schedule.size(); i++)
+	{
+		Pass& pass = m_passes[m_schedule[i]];
+
+		dump += "  " + std::to_string(i) + ": " + pass.name + "\n";
+		for (int j = 0; j < (int)pass.reads.size(); j++)
+			dump += "      reads  " + m_resources[pass.reads[j]].name + "\n";
+		for (int j = 0; j < (int)pass.writes.size(); j++)
+			dump += "      writes " + m_resources[pass.writes[j]].name + "\n";
+	}
+
+	for (int i = 0; i < (int)m_passes.size(); i++)
+		if (m_passes[i].culled)
+			dump += "  culled: " + m_passes[i].name + "\n";
+
+	dump += "Transients:\n";
+	for (int i = 0; i < (int)m_resources.size(); i++)
+	{
+		Resource& resource = m_resources[i];
+		if (!resource.transient)
+			continue;
+
+		dump += "  " + resource.name + " (" + std::to_string(resource.count) + " x " + std::to_string(resource.width) + "x" + std::to_string(resource.height) + ")";
+		if (resource.slot == -1)
+			dump += " unused\n";
+		else
+			dump += " slot " + std::to_string(resource.slot) + ", passes " + std::to_string(resource.firstUse) + "-" + std::to_string(resource.lastUse) + "\n";
+	}
+
+	dump += "Peak transient memory: " + formatMegabytes(getPeakTransientBytes()) + " in " + std::to_string(m_slots.size()) + " slots (" + formatMegabytes(getUnaliasedTransientBytes()) + " without aliasing)\n";
+
+	return dump;
+}
+
+int RenderGraph::getScheduledPassCount()
+{
+	return (int)m_schedule.size();
+}
+
+int RenderGraph::getCulledPassCount()
+{
+	int culled = 0;
+	for (int i = 0; i < (int)m_passes.size(); i++)
+		if (m_passes[i].culled)
+			culled++;
+
+	return culled;
+}
+
+bool RenderGraph::getCulled(int pass)
+{
+	return m_passes[pass].culled;
+}
+
+size_t RenderGraph::getPeakTransientBytes()
+{
+	size_t bytes = 0;
+	for (int i = 0; i < (int)m_slots.size(); i++)
+		bytes += m_slots[i].bytes*m_slots[i].count;
+
+	return bytes;
+}
+
+size_t RenderGraph::getUnaliasedTransientBytes()
+{
+	size_t bytes = 0;
+	for (int i = 0; i < (int)m_resources.size(); i++)
+		if (m_resources[i].transient && m_resources[i].slot != -1)
+			bytes += m_resources[i].bytes*m_resources[i].count;
+
+	return bytes;
+}
+
+bool RenderGraph::verify(std::string& report)
+{
+	const size_t bytes = 64*64*20;
+
+	RenderGraph graph;
+	int output = graph.importTexture("Output", 64, 64, 3, 0, nullptr);
+	graph.markOutput(output);
+	int a = graph.createTexture("A", 64, 64, 1, bytes);
+	int c = graph.createTexture("C", 64, 64, 1, bytes);
+	int d = graph.createTexture("D", 64, 64, 1, bytes);
+	int unused = graph.createTexture("Unused", 64, 64, 1, bytes);
+
+	// Blend waits for Draw C, added after it, so Redraw A (which overwrites what Blend reads) must wait for Blend in turn
+	int blend = graph.addPass("Blend", nullptr);
+	graph.read(blend, a);
+	graph.read(blend, c);
+	graph.write(blend, output);
+	int pass = graph.addPass("Draw A", nullptr);
+	graph.write(pass, a);
+	int unseen = graph.addPass("Unseen", nullptr);
+	graph.write(unseen, unused);
+	pass = graph.addPass("Redraw A", nullptr);
+	graph.write(pass, a);
+	pass = graph.addPass("Show A", nullptr);
+	graph.read(pass, a);
+	graph.write(pass, output);
+	pass = graph.addPass("Draw C", nullptr);
+	graph.write(pass, c);
+
+	// D only lives after C has died, so can share its slot
+	pass = graph.addPass("Draw D", nullptr);
+	graph.write(pass, d);
+	pass = graph.addPass("Show D", nullptr);
+	graph.read(pass, d);
+	graph.write(pass, output);
+
+	NullRenderGraphBackend backend;
+	graph.Execute(&backend);
+
+	std::string order, expected = "Draw A, Draw C, Blend, Redraw A, Show A, Draw D, Show D, ";
+	for (int i = 0; i < (int)backend.getLog().size(); i++)
+		if (backend.getLog()[i].compare(0, 5, "pass ") == 0)
+			order += backend.getLog()[i].substr(5) + ", ";
+
+	report = graph.getSchedule();
+	bool passed = order == expected;
+	passed = passed && graph.getCulledPassCount() == 1 && graph.getCulled(unseen) && backend.getPassCount() == graph.getScheduledPassCount();
+	passed = passed && graph.getPeakTransientBytes() == 2*bytes && graph.getUnaliasedTransientBytes() == 3*bytes;
+	if (order != expected)
+		report += "Ran " + order + "expected " + expected + "\n";
+
+	return passed;
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+// NB: Only ever handled by pointer, so the graph itself compiles without Direct3D
+class RenderTexture;
+
+// Where a compiled graph's transient textures come from, and what happens around each pass
+class RenderGraphBackend
+{
+public:
+	virtual ~RenderGraphBackend() {}
+
+	virtual RenderTexture*			acquire(int width, int height) = 0;
+	virtual void					release(RenderTexture* texture) = 0;
+
+	virtual void					beginPass(const std::string& name) = 0;
+	virtual void					endPass() = 0;
+
+	virtual bool					getExecutes() = 0;		// Whether pass functions should actually be run
+};
+
+// Records acquisitions and passes without touching a device, so a graph can be compiled and inspected headlessly
+class NullRenderGraphBackend : public RenderGraphBackend
+{
+public:
+	NullRenderGraphBackend();
+
+	RenderTexture*					acquire(int width, int height) override;
+	void							release(RenderTexture* texture) override;
+
+	void							beginPass(const std::string& name) override;
+	void							endPass() override;
+
+	bool							getExecutes() override;
+
+	const std::vector<std::string>&	getLog();
+	int								getAcquireCount();
+	int								getPassCount();
+
+private:
+	std::vector<std::string>		m_log;
+	int								m_acquireCount;
+	int								m_passCount;
+};
+
+// Frame described as passes declaring the textures they read and write.
+// Compiling orders the passes by dependency, culls any whose writes nobody reads, and packs transient textures
+// with disjoint lifetimes into shared slots.
+// A resource written by several passes is written in the order they were added, each read seeing the last write added before it
+// (or the first, if added before any). So a read waits for the write it sees, and a write waits for the write before it and for every read of what it overwrites
+class RenderGraph
+{
+public:
+	typedef std::function<void()>	PassFunction;
+
+	RenderGraph();
+	~RenderGraph();
+
+	void							Reset();		// Forgets the previous frame's declarations (call before declaring the next)
+
+	// Each resource is a family of count textures (e.g. the 6 faces of an environment map)
+	int								importTexture(const std::string& name, int width, int height, int count, size_t bytes, RenderTexture** textures);	// Persistent, owned elsewhere
+	int								createTexture(const std::string& name, int width, int height, int count, size_t bytes);	// Transient, only valid during this frame's passes
+	void							markOutput(int resource);		// Must be kept, even if no pass reads it this frame
+
+	int								addPass(const std::string& name, PassFunction function);
+	void							read(int pass, int resource);
+	void							write(int pass, int resource);
+
+	void							Compile();
+	void							Execute(RenderGraphBackend* backend);
+
+	RenderTexture*					getTexture(int resource, int index);	// Valid for transients only while Execute runs
+
+	std::string						getSchedule();					// Human-readable dump of the compiled frame
+	int								getScheduledPassCount();
+	int								getCulledPassCount();
+	bool							getCulled(int pass);
+	size_t							getPeakTransientBytes();		// With aliasing
+	size_t							getUnaliasedTransientBytes();	// If every transient had its own textures
+
+	// Compiles and runs a small graph on the null backend, with a pass to cull, a read that must wait for a later-added pass and a write that must wait for it.
+	// False if anything is culled, ordered or aliased other than it should be
+	static bool						verify(std::string& report);
+
+private:
+	struct Resource
+	{
+		std::string					name;
+		int							width;
+		int							height;
+		int							count;
+		size_t						bytes;			// Per texture
+		bool						transient;
+		bool						output;
+		std::vector<int>			writers;		// Passes that write it, in the order they were added
+		int							firstUse;		// Schedule positions bounding its lifetime
+		int							lastUse;
+		int							slot;			// Transient slot it is aliased into, or -1
+		std::vector<RenderTexture*>	textures;
+	};
+
+	struct Pass
+	{
+		std::string					name;
+		PassFunction				function;
+		std::vector<int>			reads;
+		std::vector<int>			writes;
+		std::vector<int>			producers;		// Passes whose writes this reads
+		std::vector<int>			predecessors;	// Passes that must run before this, producers included
+		bool						culled;
+	};
+
+	struct Slot
+	{
+		int							width;
+		int							height;
+		int							count;
+		size_t						bytes;
+		int							lastUse;
+		std::vector<RenderTexture*>	textures;
+	};
+
+	void							linkPasses();
+	void							cullPasses();
+	void							schedulePasses();
+	void							aliasTransients();
+
+	std::vector<Resource>			m_resources;
+	std::vector<Pass>				m_passes;
+	std::vector<Slot>				m_slots;
+	std::vector<int>				m_schedule;
+	bool							m_compiled;
+};
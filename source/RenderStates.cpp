@@ -0,0 +1,72 @@
+#include "pch.h"
+#include "RenderStates.h"
+
+RenderStates::RenderStates(RenderDevice* device)
+{
+	m_device = device;
+
+	RenderBlendDesc blend = {};
+	m_opaque = m_device->CreateBlendState(blend);
+	blend.alpha = true;
+	m_alphaBlend = m_device->CreateBlendState(blend);
+
+	RenderDepthStencilDesc depth = {};
+	m_depthNone = m_device->CreateDepthStencilState(depth);
+	depth.test = true;
+	depth.write = true;
+	m_depthDefault = m_device->CreateDepthStencilState(depth);
+
+	RenderRasterizerDesc rasterizer = {};
+	rasterizer.cull = RenderCullNone;
+	m_cullNone = m_device->CreateRasterizerState(rasterizer);
+	rasterizer.cull = RenderCullFront;
+	m_cullClockwise = m_device->CreateRasterizerState(rasterizer);
+	rasterizer.cull = RenderCullBack;
+	m_cullCounterClockwise = m_device->CreateRasterizerState(rasterizer);
+}
+
+RenderStates::~RenderStates()
+{
+	m_device->Release(m_opaque);
+	m_device->Release(m_alphaBlend);
+	m_device->Release(m_depthDefault);
+	m_device->Release(m_depthNone);
+	m_device->Release(m_cullNone);
+	m_device->Release(m_cullClockwise);
+	m_device->Release(m_cullCounterClockwise);
+}
+
+ID3D11BlendState* RenderStates::Opaque()
+{
+	return m_opaque;
+}
+
+ID3D11BlendState* RenderStates::AlphaBlend()
+{
+	return m_alphaBlend;
+}
+
+ID3D11DepthStencilState* RenderStates::DepthDefault()
+{
+	return m_depthDefault;
+}
+
+ID3D11DepthStencilState* RenderStates::DepthNone()
+{
+	return m_depthNone;
+}
+
+ID3D11RasterizerState* RenderStates::CullNone()
+{
+	return m_cullNone;
+}
+
+ID3D11RasterizerState* RenderStates::CullClockwise()
+{
+	return m_cullClockwise;
+}
+
+ID3D11RasterizerState* RenderStates::CullCounterClockwise()
+{
+	return m_cullCounterClockwise;
+}
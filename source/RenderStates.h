@@ -0,0 +1,28 @@
+#pragma once
+#include "RenderDevice.h"
+
+// The fixed-function states the framework binds, named as CommonStates names them, but made through a render device so a frame can bind them headlessly
+class RenderStates
+{
+public:
+	RenderStates(RenderDevice* device);
+	~RenderStates();
+
+	ID3D11BlendState*				Opaque();
+	ID3D11BlendState*				AlphaBlend();				// Premultiplied
+	ID3D11DepthStencilState*		DepthDefault();				// Less-equal, writing depth as it goes
+	ID3D11DepthStencilState*		DepthNone();
+	ID3D11RasterizerState*			CullNone();
+	ID3D11RasterizerState*			CullClockwise();			// Clockwise on screen is front-facing, so culls those
+	ID3D11RasterizerState*			CullCounterClockwise();
+
+private:
+	RenderDevice*					m_device;
+	ID3D11BlendState*				m_opaque;
+	ID3D11BlendState*				m_alphaBlend;
+	ID3D11DepthStencilState*		m_depthDefault;
+	ID3D11DepthStencilState*		m_depthNone;
+	ID3D11RasterizerState*			m_cullNone;
+	ID3D11RasterizerState*			m_cullClockwise;
+	ID3D11RasterizerState*			m_cullCounterClockwise;
+};
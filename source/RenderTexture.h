@@ -15,6 +15,8 @@
 
 #include <d3d11.h>
 #include <directxmath.h>
+#include "RenderContext.h"
+#include "RenderDevice.h"
 
 using namespace DirectX;
 
@@ -32,13 +34,15 @@ public:
 	}
 
 	/** \brief Initialises render textures
-	*	Required renderer device, specified width and height of texture/target, and near + far planes
+	*	Required renderer device, specified width and height of texture/target, and near + far planes.
+	*	Optionally starts from texels (RGBA floats, row by row), e.g. a capture baked offline
 	*/
-	RenderTexture(ID3D11Device* device, int textureWidth, int textureHeight, float screenNear, float screenDepth);
+	RenderTexture(RenderDevice* device, int textureWidth, int textureHeight, float screenNear, float screenDepth, const float* texels = nullptr);
 	~RenderTexture();
 
-	void setRenderTarget(ID3D11DeviceContext* deviceContext);		///< Set this render texture as the render target
-	void clearRenderTarget(ID3D11DeviceContext* deviceContext, float red, float green, float blue, float alpha);	///< Empties the render texture, provide device context and RGBA (background colour)
+	void setRenderTarget(RenderContext* deviceContext);		///< Set this render texture as the render target
+	void clearRenderTarget(RenderContext* deviceContext, float red, float green, float blue, float alpha);	///< Empties the render texture, provide device context and RGBA (background colour)
+	void copyFrom(RenderContext* deviceContext, RenderTexture* source);	///< Copies colour and depth from a render texture of identical size
 	ID3D11ShaderResourceView* getShaderResourceView();			///< Get the data from this render target as a texture resource.
 
 	XMMATRIX getProjectionMatrix();		///< Get the projection matrix related to this render target (Could be different based on dimensions or near/far plane)
@@ -47,14 +51,19 @@ public:
 	int getTextureWidth();		///< Get width of this render texture
 	int getTextureHeight();		///< Get height of this render texture
 
+	bool getConstant();				///< Whether the texture is known to hold nothing but a blank clear (cleared by binding it again)
+	void setConstant(bool lconstant);	///< Mark a texture as blank, straight after clearing it to 0, 0, 0, 0
+
 private:
+	RenderDevice* device;
 	int textureWidth, textureHeight;
+	bool constant;
 	ID3D11Texture2D* renderTargetTexture;
 	ID3D11RenderTargetView* renderTargetView;
 	ID3D11ShaderResourceView* shaderResourceView;
 	ID3D11Texture2D* depthStencilBuffer;
 	ID3D11DepthStencilView* depthStencilView;
-	D3D11_VIEWPORT viewport;
+	RenderViewport viewport;
 	XMMATRIX projectionMatrix;
 	XMMATRIX orthoMatrix;
 };
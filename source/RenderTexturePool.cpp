@@ -0,0 +1,175 @@
+#include "pch.h"
+#include "RenderTexturePool.h"
+#include <cstdio>
+
+RenderTexturePool::RenderTexturePool()
+{
+	m_device = nullptr;
+	m_allocationCount = 0;
+	m_frame = 0;
+}
+
+RenderTexturePool::~RenderTexturePool()
+{
+	Shutdown();
+}
+
+void RenderTexturePool::Initialise(RenderDevice* device)
+{
+	// NB: Textures belonging to a previous device cannot be reused
+	Shutdown();
+
+	m_device = device;
+	m_allocationCount = 0;
+}
+
+void RenderTexturePool::Shutdown()
+{
+	for (int i = 0; i < (int)m_textures.size(); i++)
+		delete m_textures[i].texture;
+
+	m_textures.clear();
+}
+
+RenderTexture* RenderTexturePool::acquire(int width, int height)
+{
+	for (int i = 0; i < (int)m_textures.size(); i++)
+	{
+		if (m_textures[i].inUse || m_textures[i].width != width || m_textures[i].height != height)
+			continue;
+
+		m_textures[i].inUse = true;
+		return m_textures[i].texture;
+	}
+
+	PooledTexture pooled;
+	pooled.texture = new RenderTexture(m_device, width, height, 1, 2);
+	pooled.width = width;
+	pooled.height = height;
+	pooled.inUse = true;
+	pooled.releasedFrame = m_frame;
+	m_textures.push_back(pooled);
+
+	m_allocationCount++;
+
+	return pooled.texture;
+}
+
+void RenderTexturePool::release(RenderTexture* texture)
+{
+	if (!texture)
+		return;
+
+	for (int i = 0; i < (int)m_textures.size(); i++)
+	{
+		if (m_textures[i].texture == texture)
+		{
+			m_textures[i].inUse = false;
+			m_textures[i].releasedFrame = m_frame;
+			return;
+		}
+	}
+}
+
+void RenderTexturePool::newFrame()
+{
+	m_frame++;
+}
+
+void RenderTexturePool::trim(int idleFrames)
+{
+	for (int i = (int)m_textures.size()-1; i >= 0; i--)
+	{
+		if (m_textures[i].inUse || m_frame-m_textures[i].releasedFrame < idleFrames)
+			continue;
+
+		delete m_textures[i].texture;
+		m_textures.erase(m_textures.begin()+i);
+	}
+}
+
+size_t RenderTexturePool::getTextureBytes(int width, int height)
+{
+	// R32G32B32A32 colour target plus D24S8 depth buffer
+	return (size_t)width*(size_t)height*(16+4);
+}
+
+size_t RenderTexturePool::getAllocatedBytes()
+{
+	size_t bytes = 0;
+	for (int i = 0; i < (int)m_textures.size(); i++)
+		bytes += getTextureBytes(m_textures[i].width, m_textures[i].height);
+
+	return bytes;
+}
+
+size_t RenderTexturePool::getIdleBytes()
+{
+	size_t bytes = 0;
+	for (int i = 0; i < (int)m_textures.size(); i++)
+		if (!m_textures[i].inUse)
+			bytes += getTextureBytes(m_textures[i].width, m_textures[i].height);
+
+	return bytes;
+}
+
+int RenderTexturePool::getAllocationCount()
+{
+	return m_allocationCount;
+}
+
+bool RenderTexturePool::simulate(const std::vector<int>& widths, const std::vector<int>& heights, int objects, int texturesPerObject, int idleFrames, int frames, std::string& report)
+{
+	report = "Render texture pool, " + std::to_string(objects) + " objects of " + std::to_string(texturesPerObject) + " textures over " + std::to_string(frames) + " frames:\n";
+	bool passed = true;
+	for (int trimmed = 0; trimmed < 2; trimmed++)
+	{
+		NullRenderDeviceBackend backend;
+		RenderDevice device;
+		device.Initialise(&backend);
+
+		size_t peak = 0, used = 0;
+		{
+			RenderTexturePool pool;
+			pool.Initialise(&device);
+
+			// Each object moves to another size at its own pace, no sooner than idleFrames apart; then everything settles for idleFrames more
+			std::vector<int> sizes(objects, -1);
+			std::vector<RenderTexture*> textures(objects*texturesPerObject, nullptr);
+			for (int frame = 0; frame < frames+idleFrames+1; frame++)
+			{
+				pool.newFrame();
+				for (int i = 0; i < objects; i++)
+				{
+					int size = (frame < frames) ? (frame/(idleFrames+7*i)+i) % (int)widths.size() : sizes[i];
+					if (size == sizes[i])
+						continue;
+
+					for (int j = 0; j < texturesPerObject; j++)
+						pool.release(textures[i*texturesPerObject+j]);
+					for (int j = 0; j < texturesPerObject; j++)
+						textures[i*texturesPerObject+j] = pool.acquire(widths[size], heights[size]);
+					sizes[i] = size;
+				}
+
+				if (trimmed)
+					pool.trim(idleFrames);
+
+				passed = passed && pool.getAllocatedBytes() == device.getAllocatedBytes();
+				peak = std::max(peak, device.getAllocatedBytes());
+			}
+
+			used = pool.getAllocatedBytes()-pool.getIdleBytes();
+			passed = passed && (!trimmed || pool.getIdleBytes() == 0);
+
+			char line[256];
+			snprintf(line, sizeof(line), "  %-9s %8.1f MB at peak, %8.1f MB at the end (%.1f MB in use)\n", (trimmed) ? "Trimmed" : "Untrimmed", peak/1048576.0, device.getAllocatedBytes()/1048576.0, used/1048576.0);
+			report += line;
+		}
+
+		// NB: The pool has gone, so everything it made should have gone with it
+		passed = passed && device.getAllocatedBytes() == 0;
+	}
+
+	return passed;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "RenderTexture.h"
+
+// Recycles render textures by size, so environment maps can change resolution without reallocating every time
+class RenderTexturePool
+{
+public:
+	RenderTexturePool();
+	~RenderTexturePool();
+
+	void							Initialise(RenderDevice* device);
+	void							Shutdown();
+
+	RenderTexture*					acquire(int width, int height);		// Reuses an idle texture of matching size, otherwise creates one
+	void							release(RenderTexture* texture);	// Returns a texture to the pool; nullptr is ignored
+	void							newFrame();
+	void							trim(int idleFrames = 0);			// Destroys every texture idle for at least idleFrames frames
+
+	static size_t					getTextureBytes(int width, int height);
+
+	size_t							getAllocatedBytes();				// Bytes held by every texture the pool has created
+	size_t							getIdleBytes();						// Bytes held by textures waiting to be reused
+	int								getAllocationCount();				// Number of textures created since initialisation
+
+	// Switches objects' textures between the sizes given, each object moving every so often, on a null device with and without trimming.
+	// Reports the bytes the device really allocated in each case. False if the pool's own count ever disagrees with the device's, or idle textures outlive idleFrames
+	static bool						simulate(const std::vector<int>& widths, const std::vector<int>& heights, int objects, int texturesPerObject, int idleFrames, int frames, std::string& report);
+
+private:
+	struct PooledTexture
+	{
+		RenderTexture*	texture;
+		int				width;
+		int				height;
+		bool			inUse;
+		int				releasedFrame;
+	};
+
+	RenderDevice*					m_device;
+	std::vector<PooledTexture>		m_textures;
+	int								m_allocationCount;
+	int								m_frame;
+};
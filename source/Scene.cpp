@@ -0,0 +1,898 @@
+#include "pch.h"
+#include "Scene.h"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <immintrin.h>
+#include <intrin.h>
+#include <random>
+
+namespace
+{
+	const char				BinaryMagic[4] = { 'T', 'R', 'Y', 'S' };
+	const unsigned int		BinaryVersion = 2;		// 2: Rotations as quaternions
+	const float				DegreesToRadians = 3.14159265f/180.0f;
+	const unsigned int		MaxBlock = 1 << 24;		// Elements; anything longer is taken to be a corrupt count, rather than allocated
+	const float				MaxUpdateDifference = 1e-4f;	// Between any element of the scalar and SIMD world matrices
+
+	template <typename T>
+	bool WriteBlock(FILE* file, const std::vector<T>& block)
+	{
+		unsigned int count = (unsigned int)block.size();
+		if (fwrite(&count, sizeof(count), 1, file) != 1)
+			return false;
+
+		return block.empty() || fwrite(block.data(), sizeof(T), block.size(), file) == block.size();
+	}
+
+	template <typename T>
+	bool ReadBlock(FILE* file, std::vector<T>& block)
+	{
+		unsigned int count;
+		if (fread(&count, sizeof(count), 1, file) != 1 || count > MaxBlock)
+			return false;
+
+		block.resize(count);
+		return block.empty() || fread(block.data(), sizeof(T), block.size(), file) == block.size();
+	}
+
+	bool WriteString(FILE* file, const std::string& string)
+	{
+		unsigned int length = (unsigned int)string.size();
+		return fwrite(&length, sizeof(length), 1, file) == 1 && fwrite(string.data(), 1, length, file) == length;
+	}
+
+	bool ReadString(FILE* file, std::string& string)
+	{
+		unsigned int length;
+		if (fread(&length, sizeof(length), 1, file) != 1 || length > 4096)
+			return false;
+
+		string.resize(length);
+		return length == 0 || fread(&string[0], 1, length, file) == length;
+	}
+
+	// Whether the CPU has AVX, and the OS saves its registers
+	bool HasAvx()
+	{
+		int info[4];
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+
+		return osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+	}
+
+	// Eight dirty flags (0 or 1 each) as one word, and how many of them are set
+	inline unsigned long long LoadDirty(const unsigned char* dirty)
+	{
+		unsigned long long flags;
+		memcpy(&flags, dirty, sizeof(flags));
+
+		return flags;
+	}
+
+	inline int CountDirty(unsigned long long flags)
+	{
+		return (int)((flags*0x0101010101010101ull) >> 56);
+	}
+
+	// 4x4 transpose within each 128-bit half, as _MM_TRANSPOSE4_PS
+	inline void Transpose(__m256& a, __m256& b, __m256& c, __m256& d)
+	{
+		__m256 ab0 = _mm256_unpacklo_ps(a, b), ab1 = _mm256_unpackhi_ps(a, b);
+		__m256 cd0 = _mm256_unpacklo_ps(c, d), cd1 = _mm256_unpackhi_ps(c, d);
+		a = _mm256_shuffle_ps(ab0, cd0, _MM_SHUFFLE(1, 0, 1, 0));
+		b = _mm256_shuffle_ps(ab0, cd0, _MM_SHUFFLE(3, 2, 3, 2));
+		c = _mm256_shuffle_ps(ab1, cd1, _MM_SHUFFLE(1, 0, 1, 0));
+		d = _mm256_shuffle_ps(ab1, cd1, _MM_SHUFFLE(3, 2, 3, 2));
+	}
+
+	bool Within(const std::vector<int>& indices, int count)
+	{
+		for (int i = 0; i < (int)indices.size(); i++)
+			if (indices[i] < 0 || indices[i] >= count)
+				return false;
+
+		return true;
+	}
+}
+
+SceneTransforms::SceneTransforms()
+{
+}
+
+void SceneTransforms::clear()
+{
+	m_positionX.clear();
+	m_positionY.clear();
+	m_positionZ.clear();
+	m_scale.clear();
+	m_rotationX.clear();
+	m_rotationY.clear();
+	m_rotationZ.clear();
+	m_rotationW.clear();
+	m_dirty.clear();
+	m_world.clear();
+}
+
+int SceneTransforms::add(const float position[3], float scale, const float axis[3], float angle)
+{
+	int i = getCount();
+	m_positionX.push_back(0.0f);
+	m_positionY.push_back(0.0f);
+	m_positionZ.push_back(0.0f);
+	m_scale.push_back(1.0f);
+	m_rotationX.push_back(0.0f);
+	m_rotationY.push_back(0.0f);
+	m_rotationZ.push_back(0.0f);
+	m_rotationW.push_back(1.0f);
+	m_dirty.push_back(1);
+	m_world.resize(m_world.size()+16, 0.0f);
+
+	setPosition(i, position[0], position[1], position[2]);
+	setScale(i, scale);
+	setRotation(i, axis, angle);
+
+	return i;
+}
+
+void SceneTransforms::setPosition(int i, float x, float y, float z)
+{
+	m_positionX[i] = x;
+	m_positionY[i] = y;
+	m_positionZ[i] = z;
+	m_dirty[i] = 1;
+}
+
+void SceneTransforms::setScale(int i, float scale)
+{
+	m_scale[i] = scale;
+	m_dirty[i] = 1;
+}
+
+void SceneTransforms::setRotation(int i, const float axis[3], float angle)
+{
+	// NB: Without an axis, there is no rotation to speak of, so any axis does
+	float length = sqrtf(axis[0]*axis[0]+axis[1]*axis[1]+axis[2]*axis[2]);
+	float s = (length > 0.0f) ? sinf(0.5f*angle)/length : 0.0f;
+	float quaternion[4] = { s*axis[0], s*axis[1], s*axis[2], (length > 0.0f) ? cosf(0.5f*angle) : 1.0f };
+
+	setRotation(i, quaternion);
+}
+
+void SceneTransforms::setRotation(int i, const float quaternion[4])
+{
+	float length = sqrtf(quaternion[0]*quaternion[0]+quaternion[1]*quaternion[1]+quaternion[2]*quaternion[2]+quaternion[3]*quaternion[3]);
+	float inverse = (length > 0.0f) ? 1.0f/length : 0.0f;
+
+	m_rotationX[i] = quaternion[0]*inverse;
+	m_rotationY[i] = quaternion[1]*inverse;
+	m_rotationZ[i] = quaternion[2]*inverse;
+	m_rotationW[i] = (length > 0.0f) ? quaternion[3]*inverse : 1.0f;
+	m_dirty[i] = 1;
+}
+
+int SceneTransforms::Update()
+{
+	static const bool avx = HasAvx();
+
+	return update(avx);
+}
+
+int SceneTransforms::update(bool avx)
+{
+	// NB: A block is rebuilt whole, straight from the components, once at least half of it is dirty; rebuilding a clean transform gives the
+	// same matrix, and is cheaper than gathering scattered ones into registers and back. Sparser blocks go one transform at a time
+	int count = getCount(), i = 0, updated = 0;
+	for (; i+8 <= count; i += 8)
+	{
+		unsigned long long flags = LoadDirty(&m_dirty[i]);
+		if (flags == 0)
+			continue;
+
+		int dirty = CountDirty(flags);
+		updated += dirty;
+		if (avx && dirty >= 4)
+		{
+			buildEight(i);
+			continue;
+		}
+
+		// NB: Flags are little-endian, so the low word is the first four
+		for (int half = 0; half < 2; half++)
+		{
+			unsigned long long halfFlags = (flags >> (32*half)) & 0xFFFFFFFFull;
+			if (CountDirty(halfFlags) >= 2)
+				buildFour(i+4*half);
+			else if (halfFlags != 0)
+				for (int j = i+4*half; j < i+4*half+4; j++)
+					if (m_dirty[j])
+						build(j);
+		}
+	}
+
+	// Whatever doesn't fill a block
+	for (; i < count; i++)
+	{
+		if (!m_dirty[i])
+			continue;
+
+		build(i);
+		updated++;
+	}
+
+	return updated;
+}
+
+int SceneTransforms::UpdateReference()
+{
+	int updated = 0;
+	for (int i = 0; i < (int)m_dirty.size(); i++)
+	{
+		if (!m_dirty[i])
+			continue;
+
+		build(i);
+		updated++;
+	}
+
+	return updated;
+}
+
+int SceneTransforms::getCount()
+{
+	return (int)m_dirty.size();
+}
+
+bool SceneTransforms::getDirty(int i)
+{
+	return m_dirty[i] != 0;
+}
+
+float* SceneTransforms::getWorld(int i)
+{
+	return &m_world[16*i];
+}
+
+void SceneTransforms::getAxisAngle(int i, float axis[3], float& angle)
+{
+	float w = std::max(-1.0f, std::min(m_rotationW[i], 1.0f));
+	float s = sqrtf(1.0f-w*w);
+
+	angle = 2.0f*acosf(w);
+	axis[0] = (s > 1e-6f) ? m_rotationX[i]/s : 0.0f;
+	axis[1] = (s > 1e-6f) ? m_rotationY[i]/s : 1.0f;
+	axis[2] = (s > 1e-6f) ? m_rotationZ[i]/s : 0.0f;
+}
+
+const float* SceneTransforms::getPositionX()
+{
+	return m_positionX.data();
+}
+
+const float* SceneTransforms::getPositionY()
+{
+	return m_positionY.data();
+}
+
+const float* SceneTransforms::getPositionZ()
+{
+	return m_positionZ.data();
+}
+
+const float* SceneTransforms::getScale()
+{
+	return m_scale.data();
+}
+
+const float* SceneTransforms::getRotationX()
+{
+	return m_rotationX.data();
+}
+
+const float* SceneTransforms::getRotationY()
+{
+	return m_rotationY.data();
+}
+
+const float* SceneTransforms::getRotationZ()
+{
+	return m_rotationZ.data();
+}
+
+const float* SceneTransforms::getRotationW()
+{
+	return m_rotationW.data();
+}
+
+bool SceneTransforms::benchmarkUpdate(const std::vector<int>& counts, int repeats, std::string& report)
+{
+	std::mt19937 random(502);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	// NB: AVX is only timed where the CPU has it; SSE always is
+	bool avx = HasAvx();
+	report = (avx) ? "Updating transforms, scalar against SSE and AVX:\n" : "Updating transforms, scalar against SSE (no AVX on this CPU):\n";
+	bool passed = true;
+	for (int c = 0; c < (int)counts.size(); c++)
+	{
+		SceneTransforms reference, sse, wide;
+		for (int i = 0; i < counts[c]; i++)
+		{
+			float position[3] = { 100.0f*unit(random), 100.0f*unit(random), 100.0f*unit(random) };
+			float axis[3] = { unit(random), unit(random), unit(random) };
+			float scale = 1.0f+unit(random), angle = 3.14159265f*unit(random);
+			reference.add(position, scale, axis, angle);
+			sse.add(position, scale, axis, angle);
+			wide.add(position, scale, axis, angle);
+		}
+
+		// NB: Dirtied the same way each repeat, so every side always has the same work
+		for (int dirtied = 0; dirtied < 2; dirtied++)
+		{
+			double referenceTime = 0.0, sseTime = 0.0, avxTime = 0.0;
+			int referenceUpdated = 0, sseUpdated = 0, avxUpdated = 0;
+			for (int r = 0; r < repeats; r++)
+			{
+				for (int i = 0; i < counts[c]; i += (dirtied == 0) ? 1 : 10)
+				{
+					reference.m_dirty[i] = 1;
+					sse.m_dirty[i] = 1;
+					wide.m_dirty[i] = 1;
+				}
+
+				auto start = std::chrono::high_resolution_clock::now();
+				referenceUpdated = reference.UpdateReference();
+				auto middle = std::chrono::high_resolution_clock::now();
+				sseUpdated = sse.update(false);
+				auto end = std::chrono::high_resolution_clock::now();
+				avxUpdated = (avx) ? wide.update(true) : referenceUpdated;
+				auto last = std::chrono::high_resolution_clock::now();
+
+				referenceTime += std::chrono::duration<double, std::micro>(middle-start).count();
+				sseTime += std::chrono::duration<double, std::micro>(end-middle).count();
+				avxTime += std::chrono::duration<double, std::micro>(last-end).count();
+			}
+
+			float difference = 0.0f;
+			for (int i = 0; i < 16*counts[c]; i++)
+			{
+				difference = std::max(difference, fabsf(reference.m_world[i]-sse.m_world[i]));
+				if (avx)
+					difference = std::max(difference, fabsf(reference.m_world[i]-wide.m_world[i]));
+			}
+
+			char line[200];
+			int length = snprintf(line, sizeof(line), "  %7d (%s dirty): %9.1fus scalar, %9.1fus SSE (%.2fx)", counts[c], (dirtied == 0) ? "all" : "10%", referenceTime/repeats, sseTime/repeats, (sseTime > 0.0) ? referenceTime/sseTime : 0.0);
+			if (avx)
+				length += snprintf(line+length, sizeof(line)-length, ", %9.1fus AVX (%.2fx)", avxTime/repeats, (avxTime > 0.0) ? referenceTime/avxTime : 0.0);
+			snprintf(line+length, sizeof(line)-length, ", differing by up to %g\n", difference);
+			report += line;
+			passed = passed && difference <= MaxUpdateDifference && sseUpdated == referenceUpdated && avxUpdated == referenceUpdated;
+		}
+	}
+
+	return passed;
+}
+
+void SceneTransforms::build(int i)
+{
+	// NB: Row vectors, as SimpleMath::Matrix::CreateFromQuaternion, so the rotation is the transpose of the usual (column vector) one
+	float x = m_rotationX[i], y = m_rotationY[i], z = m_rotationZ[i], w = m_rotationW[i];
+	float xx = 2.0f*x*x, yy = 2.0f*y*y, zz = 2.0f*z*z;
+	float xy = 2.0f*x*y, xz = 2.0f*x*z, yz = 2.0f*y*z;
+	float wx = 2.0f*w*x, wy = 2.0f*w*y, wz = 2.0f*w*z;
+	float scale = m_scale[i];
+
+	float* world = &m_world[16*i];
+	world[0] = scale*(1.0f-yy-zz);	world[1] = scale*(xy+wz);		world[2] = scale*(xz-wy);		world[3] = 0.0f;
+	world[4] = scale*(xy-wz);		world[5] = scale*(1.0f-xx-zz);	world[6] = scale*(yz+wx);		world[7] = 0.0f;
+	world[8] = scale*(xz+wy);		world[9] = scale*(yz-wx);		world[10] = scale*(1.0f-xx-yy);	world[11] = 0.0f;
+	world[12] = m_positionX[i];		world[13] = m_positionY[i];		world[14] = m_positionZ[i];		world[15] = 1.0f;
+
+	m_dirty[i] = 0;
+}
+
+void SceneTransforms::buildFour(int first)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 zero = _mm_setzero_ps();
+
+	// One component of four neighbouring transforms per register, as they are stored
+	__m128 x = _mm_loadu_ps(&m_rotationX[first]), y = _mm_loadu_ps(&m_rotationY[first]), z = _mm_loadu_ps(&m_rotationZ[first]), w = _mm_loadu_ps(&m_rotationW[first]);
+	__m128 scale = _mm_loadu_ps(&m_scale[first]);
+
+	__m128 x2 = _mm_add_ps(x, x), y2 = _mm_add_ps(y, y), z2 = _mm_add_ps(z, z);
+	__m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+	__m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+	__m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+
+	// Same sums as build, so either gives the same matrices
+	__m128 m00 = _mm_mul_ps(scale, _mm_sub_ps(_mm_sub_ps(one, yy), zz));
+	__m128 m01 = _mm_mul_ps(scale, _mm_add_ps(xy, wz));
+	__m128 m02 = _mm_mul_ps(scale, _mm_sub_ps(xz, wy));
+	__m128 m03 = zero;
+	__m128 m10 = _mm_mul_ps(scale, _mm_sub_ps(xy, wz));
+	__m128 m11 = _mm_mul_ps(scale, _mm_sub_ps(_mm_sub_ps(one, xx), zz));
+	__m128 m12 = _mm_mul_ps(scale, _mm_add_ps(yz, wx));
+	__m128 m13 = zero;
+	__m128 m20 = _mm_mul_ps(scale, _mm_add_ps(xz, wy));
+	__m128 m21 = _mm_mul_ps(scale, _mm_sub_ps(yz, wx));
+	__m128 m22 = _mm_mul_ps(scale, _mm_sub_ps(_mm_sub_ps(one, xx), yy));
+	__m128 m23 = zero;
+	__m128 m30 = _mm_loadu_ps(&m_positionX[first]);
+	__m128 m31 = _mm_loadu_ps(&m_positionY[first]);
+	__m128 m32 = _mm_loadu_ps(&m_positionZ[first]);
+	__m128 m33 = one;
+
+	// ...then one row of one transform per register, for four neighbouring matrices
+	_MM_TRANSPOSE4_PS(m00, m01, m02, m03);
+	_MM_TRANSPOSE4_PS(m10, m11, m12, m13);
+	_MM_TRANSPOSE4_PS(m20, m21, m22, m23);
+	_MM_TRANSPOSE4_PS(m30, m31, m32, m33);
+
+	float* world = &m_world[16*first];
+	_mm_storeu_ps(world, m00);		_mm_storeu_ps(world+4, m10);	_mm_storeu_ps(world+8, m20);	_mm_storeu_ps(world+12, m30);
+	_mm_storeu_ps(world+16, m01);	_mm_storeu_ps(world+20, m11);	_mm_storeu_ps(world+24, m21);	_mm_storeu_ps(world+28, m31);
+	_mm_storeu_ps(world+32, m02);	_mm_storeu_ps(world+36, m12);	_mm_storeu_ps(world+40, m22);	_mm_storeu_ps(world+44, m32);
+	_mm_storeu_ps(world+48, m03);	_mm_storeu_ps(world+52, m13);	_mm_storeu_ps(world+56, m23);	_mm_storeu_ps(world+60, m33);
+
+	memset(&m_dirty[first], 0, 4);
+}
+
+void SceneTransforms::buildEight(int first)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 zero = _mm256_setzero_ps();
+
+	// As buildFour, eight transforms wide
+	__m256 x = _mm256_loadu_ps(&m_rotationX[first]), y = _mm256_loadu_ps(&m_rotationY[first]), z = _mm256_loadu_ps(&m_rotationZ[first]), w = _mm256_loadu_ps(&m_rotationW[first]);
+	__m256 scale = _mm256_loadu_ps(&m_scale[first]);
+
+	__m256 x2 = _mm256_add_ps(x, x), y2 = _mm256_add_ps(y, y), z2 = _mm256_add_ps(z, z);
+	__m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+	__m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+	__m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+
+	__m256 m00 = _mm256_mul_ps(scale, _mm256_sub_ps(_mm256_sub_ps(one, yy), zz));
+	__m256 m01 = _mm256_mul_ps(scale, _mm256_add_ps(xy, wz));
+	__m256 m02 = _mm256_mul_ps(scale, _mm256_sub_ps(xz, wy));
+	__m256 m03 = zero;
+	__m256 m10 = _mm256_mul_ps(scale, _mm256_sub_ps(xy, wz));
+	__m256 m11 = _mm256_mul_ps(scale, _mm256_sub_ps(_mm256_sub_ps(one, xx), zz));
+	__m256 m12 = _mm256_mul_ps(scale, _mm256_add_ps(yz, wx));
+	__m256 m13 = zero;
+	__m256 m20 = _mm256_mul_ps(scale, _mm256_add_ps(xz, wy));
+	__m256 m21 = _mm256_mul_ps(scale, _mm256_sub_ps(yz, wx));
+	__m256 m22 = _mm256_mul_ps(scale, _mm256_sub_ps(_mm256_sub_ps(one, xx), yy));
+	__m256 m23 = zero;
+	__m256 m30 = _mm256_loadu_ps(&m_positionX[first]);
+	__m256 m31 = _mm256_loadu_ps(&m_positionY[first]);
+	__m256 m32 = _mm256_loadu_ps(&m_positionZ[first]);
+	__m256 m33 = one;
+
+	// NB: Each half transposes on its own, so the low halves hold rows of transforms 0-3, and the high halves rows of 4-7
+	Transpose(m00, m01, m02, m03);
+	Transpose(m10, m11, m12, m13);
+	Transpose(m20, m21, m22, m23);
+	Transpose(m30, m31, m32, m33);
+
+	// ...so pairing rows 0 and 1 (then 2 and 3) of the same half fills a register with half a matrix
+	__m256 rows[4][4] = { { m00, m10, m20, m30 }, { m01, m11, m21, m31 }, { m02, m12, m22, m32 }, { m03, m13, m23, m33 } };
+	float* world = &m_world[16*first];
+	for (int j = 0; j < 4; j++)
+	{
+		_mm256_storeu_ps(world+16*j, _mm256_permute2f128_ps(rows[j][0], rows[j][1], 0x20));
+		_mm256_storeu_ps(world+16*j+8, _mm256_permute2f128_ps(rows[j][2], rows[j][3], 0x20));
+		_mm256_storeu_ps(world+16*(j+4), _mm256_permute2f128_ps(rows[j][0], rows[j][1], 0x31));
+		_mm256_storeu_ps(world+16*(j+4)+8, _mm256_permute2f128_ps(rows[j][2], rows[j][3], 0x31));
+	}
+	_mm256_zeroupper();
+
+	memset(&m_dirty[first], 0, 8);
+}
+
+Scene::Scene()
+{
+}
+
+bool Scene::load(const std::string& filename)
+{
+	clear();
+
+	FILE* file = fopen(filename.c_str(), "rb");
+	if (!file)
+		return false;
+
+	char magic[4];
+	bool binary = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, BinaryMagic, sizeof(magic)) == 0;
+	if (!binary)
+		rewind(file);
+
+	bool loaded = (binary) ? loadBinary(file) : loadText(file);
+	fclose(file);
+
+	if (!loaded)
+		clear();
+	return loaded;
+}
+
+bool Scene::saveText(const std::string& filename)
+{
+	FILE* file = fopen(filename.c_str(), "w");
+	if (!file)
+		return false;
+
+	const float* x = m_transforms.getPositionX();
+	const float* y = m_transforms.getPositionY();
+	const float* z = m_transforms.getPositionZ();
+	const float* scale = m_transforms.getScale();
+
+	fprintf(file, "# material <name> <texture> <normal map>\n");
+	for (int i = 0; i < (int)m_materials.size(); i++)
+		fprintf(file, "material %s %s %s\n", m_materials[i].name.c_str(), m_materials[i].texture.c_str(), m_materials[i].normalMap.c_str());
+
+	fprintf(file, "\n# basic <model> <material> <x> <y> <z> <scale> <axis x> <axis y> <axis z> <angle>\n");
+	for (int i = 0; i < (int)m_basicTransforms.size(); i++)
+	{
+		int t = m_basicTransforms[i];
+		float axis[3], angle;
+		m_transforms.getAxisAngle(t, axis, angle);
+		fprintf(file, "basic %s %s %.7g %.7g %.7g %.7g %.7g %.7g %.7g %.7g\n", m_models[m_basicModels[i]].c_str(), m_materials[m_basicMaterials[i]].name.c_str(), x[t], y[t], z[t], scale[t], axis[0], axis[1], axis[2], angle/DegreesToRadians);
+	}
+
+	fprintf(file, "\n# glass <model> <x> <y> <z> <scale> <axis x> <axis y> <axis z> <angle> <refractive index> <opacity> <liquid opacity> <specimen 0/1>\n");
+	for (int i = 0; i < (int)m_glassTransforms.size(); i++)
+	{
+		int t = m_glassTransforms[i];
+		float axis[3], angle;
+		m_transforms.getAxisAngle(t, axis, angle);
+		fprintf(file, "glass %s %.7g %.7g %.7g %.7g %.7g %.7g %.7g %.7g %.7g %.7g %.7g %d\n", m_models[m_glassModels[i]].c_str(), x[t], y[t], z[t], scale[t], axis[0], axis[1], axis[2], angle/DegreesToRadians, m_glassRefractiveIndices[i], m_glassOpacities[i], m_liquidOpacities[i], (int)m_specimens[i]);
+	}
+
+	return fclose(file) == 0;
+}
+
+bool Scene::saveBinary(const std::string& filename)
+{
+	FILE* file = fopen(filename.c_str(), "wb");
+	if (!file)
+		return false;
+
+	bool written = fwrite(BinaryMagic, 1, sizeof(BinaryMagic), file) == sizeof(BinaryMagic) && fwrite(&BinaryVersion, sizeof(BinaryVersion), 1, file) == 1;
+
+	unsigned int count = (unsigned int)m_models.size();
+	written = written && fwrite(&count, sizeof(count), 1, file) == 1;
+	for (int i = 0; i < (int)m_models.size(); i++)
+		written = written && WriteString(file, m_models[i]);
+
+	count = (unsigned int)m_materials.size();
+	written = written && fwrite(&count, sizeof(count), 1, file) == 1;
+	for (int i = 0; i < (int)m_materials.size(); i++)
+		written = written && WriteString(file, m_materials[i].name) && WriteString(file, m_materials[i].texture) && WriteString(file, m_materials[i].normalMap);
+
+	// NB: World matrices are left out, being rebuilt from the components anyway
+	written = written && WriteBlock(file, m_transforms.m_positionX) && WriteBlock(file, m_transforms.m_positionY) && WriteBlock(file, m_transforms.m_positionZ);
+	written = written && WriteBlock(file, m_transforms.m_scale);
+	written = written && WriteBlock(file, m_transforms.m_rotationX) && WriteBlock(file, m_transforms.m_rotationY) && WriteBlock(file, m_transforms.m_rotationZ) && WriteBlock(file, m_transforms.m_rotationW);
+
+	written = written && WriteBlock(file, m_basicTransforms) && WriteBlock(file, m_basicModels) && WriteBlock(file, m_basicMaterials);
+
+	written = written && WriteBlock(file, m_glassTransforms) && WriteBlock(file, m_glassModels);
+	written = written && WriteBlock(file, m_glassRefractiveIndices) && WriteBlock(file, m_glassOpacities) && WriteBlock(file, m_liquidOpacities);
+	written = written && WriteBlock(file, m_specimens);
+
+	return (fclose(file) == 0) && written;
+}
+
+void Scene::clear()
+{
+	m_transforms.clear();
+	m_models.clear();
+	m_materials.clear();
+
+	m_basicTransforms.clear();
+	m_basicModels.clear();
+	m_basicMaterials.clear();
+
+	m_glassTransforms.clear();
+	m_glassModels.clear();
+	m_glassRefractiveIndices.clear();
+	m_glassOpacities.clear();
+	m_liquidOpacities.clear();
+	m_specimens.clear();
+}
+
+int Scene::addMaterial(const Material& material)
+{
+	int i = findMaterial(material.name);
+	if (i != -1)
+	{
+		m_materials[i] = material;
+		return i;
+	}
+
+	m_materials.push_back(material);
+	return (int)m_materials.size()-1;
+}
+
+int Scene::addBasic(const std::string& model, int material, const float position[3], float scale, const float axis[3], float angle)
+{
+	m_basicTransforms.push_back(m_transforms.add(position, scale, axis, angle));
+	m_basicModels.push_back(findModel(model));
+	m_basicMaterials.push_back(material);
+
+	return (int)m_basicTransforms.size()-1;
+}
+
+int Scene::addGlass(const std::string& model, const float position[3], float scale, const float axis[3], float angle, float refractiveIndex, float opacity, float liquidOpacity, bool specimen)
+{
+	m_glassTransforms.push_back(m_transforms.add(position, scale, axis, angle));
+	m_glassModels.push_back(findModel(model));
+	m_glassRefractiveIndices.push_back(refractiveIndex);
+	m_glassOpacities.push_back(opacity);
+	m_liquidOpacities.push_back(liquidOpacity);
+	m_specimens.push_back((specimen) ? 1 : 0);
+
+	return (int)m_glassTransforms.size()-1;
+}
+
+SceneTransforms& Scene::getTransforms()
+{
+	return m_transforms;
+}
+
+int Scene::getModelCount()
+{
+	return (int)m_models.size();
+}
+
+const std::string& Scene::getModelName(int model)
+{
+	return m_models[model];
+}
+
+int Scene::getMaterialCount()
+{
+	return (int)m_materials.size();
+}
+
+const Scene::Material& Scene::getMaterial(int material)
+{
+	return m_materials[material];
+}
+
+int Scene::findMaterial(const std::string& name)
+{
+	for (int i = 0; i < (int)m_materials.size(); i++)
+		if (m_materials[i].name == name)
+			return i;
+
+	return -1;
+}
+
+int Scene::getBasicCount()
+{
+	return (int)m_basicTransforms.size();
+}
+
+int Scene::getBasicTransform(int i)
+{
+	return m_basicTransforms[i];
+}
+
+int Scene::getBasicModel(int i)
+{
+	return m_basicModels[i];
+}
+
+int Scene::getBasicMaterial(int i)
+{
+	return m_basicMaterials[i];
+}
+
+int Scene::getGlassCount()
+{
+	return (int)m_glassTransforms.size();
+}
+
+int Scene::getGlassTransform(int i)
+{
+	return m_glassTransforms[i];
+}
+
+int Scene::getGlassModel(int i)
+{
+	return m_glassModels[i];
+}
+
+float Scene::getGlassRefractiveIndex(int i)
+{
+	return m_glassRefractiveIndices[i];
+}
+
+float Scene::getGlassOpacity(int i)
+{
+	return m_glassOpacities[i];
+}
+
+float Scene::getLiquidOpacity(int i)
+{
+	return m_liquidOpacities[i];
+}
+
+bool Scene::getSpecimen(int i)
+{
+	return m_specimens[i] != 0;
+}
+
+bool Scene::benchmarkLoad(int count, int repeats, std::string& report)
+{
+	// One glass object in every ten, like the jars among the pores
+	std::mt19937 random(502);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	Scene scene;
+	for (int i = 0; i < 4; i++)
+		scene.addMaterial({ "material" + std::to_string(i), "spherical_pores", "spherical_pores_nm" });
+	for (int i = 0; i < count; i++)
+	{
+		float position[3] = { 100.0f*unit(random), 100.0f*unit(random), 100.0f*unit(random) };
+		float axis[3] = { unit(random), unit(random), unit(random) };
+		if (i%10 == 0)
+			scene.addGlass("sphere", position, 1.0f+unit(random), axis, unit(random), 1.33f, 0.01f, 0.5f, false);
+		else
+			scene.addBasic("sphere", random()%4, position, 1.0f+unit(random), axis, unit(random));
+	}
+
+	report = "Loading " + std::to_string(count) + " objects (and building their world matrices):\n";
+	const char* formats[2] = { "text", "binary" };
+	bool passed = true;
+	for (int format = 0; format < 2; format++)
+	{
+		std::string filename = std::string("scene_benchmark.") + ((format == 0) ? "txt" : "bin");
+		if (!((format == 0) ? scene.saveText(filename) : scene.saveBinary(filename)))
+		{
+			report += "  Could not write " + filename + "\n";
+			return false;
+		}
+
+		double total = 0.0;
+		bool loaded = true;
+		for (int r = 0; r < repeats; r++)
+		{
+			Scene loading;
+			auto start = std::chrono::high_resolution_clock::now();
+			loaded = loading.load(filename) && loaded;
+			loading.getTransforms().Update();
+			loaded = loaded && loading.getBasicCount() == scene.getBasicCount() && loading.getGlassCount() == scene.getGlassCount();
+			auto end = std::chrono::high_resolution_clock::now();
+
+			total += std::chrono::duration<double, std::milli>(end-start).count();
+		}
+
+		FILE* file = fopen(filename.c_str(), "rb");
+		long bytes = 0;
+		if (file)
+		{
+			fseek(file, 0, SEEK_END);
+			bytes = ftell(file);
+			fclose(file);
+		}
+		remove(filename.c_str());
+
+		char line[128];
+		snprintf(line, sizeof(line), "  %-6s %8.2fms, from %6ld KB%s\n", formats[format], total/repeats, bytes/1024, (loaded) ? "" : " (FAILED)");
+		report += line;
+		passed = passed && loaded;
+	}
+
+	return passed;
+}
+
+bool Scene::loadText(FILE* file)
+{
+	char line[512];
+	while (fgets(line, sizeof(line), file))
+	{
+		for (char* c = line; *c; c++)
+			if (*c == '#')
+				*c = '\0';
+
+		char keyword[64], model[128], material[128], normalMap[128];
+		float position[3], scale, axis[3], angle;
+		if (sscanf(line, "%63s", keyword) != 1)
+			continue;
+
+		// NB: Anything unrecognised or incomplete fails the whole scene, rather than leaving objects quietly missing
+		if (strcmp(keyword, "material") == 0)
+		{
+			if (sscanf(line, "%*s %127s %127s %127s", model, material, normalMap) != 3)
+				return false;
+
+			addMaterial({ model, material, normalMap });
+		}
+		else if (strcmp(keyword, "basic") == 0)
+		{
+			if (sscanf(line, "%*s %127s %127s %f %f %f %f %f %f %f %f", model, material, &position[0], &position[1], &position[2], &scale, &axis[0], &axis[1], &axis[2], &angle) != 10)
+				return false;
+
+			int index = findMaterial(material);
+			if (index == -1)
+				return false;
+
+			addBasic(model, index, position, scale, axis, angle*DegreesToRadians);
+		}
+		else if (strcmp(keyword, "glass") == 0)
+		{
+			float refractiveIndex, opacity, liquidOpacity;
+			int specimen;
+			if (sscanf(line, "%*s %127s %f %f %f %f %f %f %f %f %f %f %f %d", model, &position[0], &position[1], &position[2], &scale, &axis[0], &axis[1], &axis[2], &angle, &refractiveIndex, &opacity, &liquidOpacity, &specimen) != 13)
+				return false;
+
+			addGlass(model, position, scale, axis, angle*DegreesToRadians, refractiveIndex, opacity, liquidOpacity, specimen != 0);
+		}
+		else
+			return false;
+	}
+
+	return true;
+}
+
+bool Scene::loadBinary(FILE* file)
+{
+	unsigned int version, count;
+	if (fread(&version, sizeof(version), 1, file) != 1 || version != BinaryVersion)
+		return false;
+
+	if (fread(&count, sizeof(count), 1, file) != 1 || count > MaxBlock)
+		return false;
+	m_models.resize(count);
+	for (int i = 0; i < (int)m_models.size(); i++)
+		if (!ReadString(file, m_models[i]))
+			return false;
+
+	if (fread(&count, sizeof(count), 1, file) != 1 || count > MaxBlock)
+		return false;
+	m_materials.resize(count);
+	for (int i = 0; i < (int)m_materials.size(); i++)
+		if (!ReadString(file, m_materials[i].name) || !ReadString(file, m_materials[i].texture) || !ReadString(file, m_materials[i].normalMap))
+			return false;
+
+	SceneTransforms& t = m_transforms;
+	if (!ReadBlock(file, t.m_positionX) || !ReadBlock(file, t.m_positionY) || !ReadBlock(file, t.m_positionZ) || !ReadBlock(file, t.m_scale)
+		|| !ReadBlock(file, t.m_rotationX) || !ReadBlock(file, t.m_rotationY) || !ReadBlock(file, t.m_rotationZ) || !ReadBlock(file, t.m_rotationW))
+		return false;
+	if (!ReadBlock(file, m_basicTransforms) || !ReadBlock(file, m_basicModels) || !ReadBlock(file, m_basicMaterials))
+		return false;
+	if (!ReadBlock(file, m_glassTransforms) || !ReadBlock(file, m_glassModels) || !ReadBlock(file, m_glassRefractiveIndices)
+		|| !ReadBlock(file, m_glassOpacities) || !ReadBlock(file, m_liquidOpacities) || !ReadBlock(file, m_specimens))
+		return false;
+
+	// NB: Every block of a kind must be as long as the others, and every index in range, so a truncated or mismatched file is never trusted
+	size_t transforms = t.m_positionX.size(), basics = m_basicTransforms.size(), glasses = m_glassTransforms.size();
+	if (t.m_positionY.size() != transforms || t.m_positionZ.size() != transforms || t.m_scale.size() != transforms
+		|| t.m_rotationX.size() != transforms || t.m_rotationY.size() != transforms || t.m_rotationZ.size() != transforms || t.m_rotationW.size() != transforms)
+		return false;
+	if (m_basicModels.size() != basics || m_basicMaterials.size() != basics)
+		return false;
+	if (m_glassModels.size() != glasses || m_glassRefractiveIndices.size() != glasses || m_glassOpacities.size() != glasses || m_liquidOpacities.size() != glasses || m_specimens.size() != glasses)
+		return false;
+
+	t.m_dirty.assign(transforms, 1);
+	t.m_world.assign(16*transforms, 0.0f);
+
+	int models = (int)m_models.size(), materials = (int)m_materials.size();
+	return Within(m_basicTransforms, (int)transforms) && Within(m_basicModels, models) && Within(m_basicMaterials, materials)
+		&& Within(m_glassTransforms, (int)transforms) && Within(m_glassModels, models);
+}
+
+int Scene::findModel(const std::string& name)
+{
+	for (int i = 0; i < (int)m_models.size(); i++)
+		if (m_models[i] == name)
+			return i;
+
+	m_models.push_back(name);
+	return (int)m_models.size()-1;
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Any number of objects' transforms, kept as structure-of-arrays so a pass over one component reads it contiguously.
+// Each transform's world matrix is only rebuilt after something sets it, so static objects cost nothing per frame
+class SceneTransforms
+{
+public:
+	SceneTransforms();
+
+	void							clear();
+	int								add(const float position[3], float scale, const float axis[3], float angle);	// Radians; returns the new transform's index
+
+	// Each marks the transform dirty
+	void							setPosition(int i, float x, float y, float z);
+	void							setScale(int i, float scale);
+	void							setRotation(int i, const float axis[3], float angle);
+	void							setRotation(int i, const float quaternion[4]);		// x, y, z, w; normalised here
+
+	// Rebuild every dirty world matrix, returning how many were. Update does eight at a time with AVX where the CPU has it, otherwise four with SSE;
+	// UpdateReference is the scalar equivalent
+	int								Update();
+	int								UpdateReference();
+
+	int								getCount();
+	bool							getDirty(int i);
+	float*							getWorld(int i);	// 16 floats, row-major: scaled, then rotated, then translated. Same layout as SimpleMath::Matrix
+	void							getAxisAngle(int i, float axis[3], float& angle);
+
+	// Components, one element per transform
+	const float*					getPositionX();
+	const float*					getPositionY();
+	const float*					getPositionZ();
+	const float*					getScale();
+	const float*					getRotationX();		// Unit quaternion
+	const float*					getRotationY();
+	const float*					getRotationZ();
+	const float*					getRotationW();
+
+	// Updates count transforms (all dirty, then a tenth dirty) every way for each count, reporting the averages and how far apart they came; false if further than rounding
+	static bool						benchmarkUpdate(const std::vector<int>& counts, int repeats, std::string& report);
+
+private:
+	int								update(bool avx);
+	void							build(int i);
+	void							buildFour(int first);		// With SSE: first to first+3, straight from the components
+	void							buildEight(int first);		// With AVX: first to first+7
+
+	std::vector<float>				m_positionX, m_positionY, m_positionZ;
+	std::vector<float>				m_scale;
+	std::vector<float>				m_rotationX, m_rotationY, m_rotationZ, m_rotationW;
+	std::vector<unsigned char>		m_dirty;
+	std::vector<float>				m_world;		// 16 per transform
+
+	friend class Scene;		// NB: Reads and writes the components wholesale when loading and saving binary scenes
+};
+
+// What gets drawn, as data rather than code: materials, basic models, and glass jars (each with a liquid, and maybe a specimen).
+// Models and textures are named, for whoever draws the scene to resolve; transforms live in one SceneTransforms.
+// Loads from either format, told apart by the binary one's header:
+//   text, for editing; one object per line, anything after a # being a comment, angles in degrees
+//     material <name> <texture> <normal map>
+//     basic <model> <material> <x> <y> <z> <scale> <axis x> <axis y> <axis z> <angle>
+//     glass <model> <x> <y> <z> <scale> <axis x> <axis y> <axis z> <angle> <refractive index> <opacity> <liquid opacity> <specimen 0/1>
+//   binary, for loading fast; each component is one block, read straight into place
+class Scene
+{
+public:
+	struct Material
+	{
+		std::string		name;
+		std::string		texture;
+		std::string		normalMap;
+	};
+
+	Scene();
+
+	bool							load(const std::string& filename);			// False, leaving the scene empty, if missing or malformed
+	bool							saveText(const std::string& filename);
+	bool							saveBinary(const std::string& filename);
+	void							clear();
+
+	int								addMaterial(const Material& material);	// Replaces any of the same name; returns its index
+	int								addBasic(const std::string& model, int material, const float position[3], float scale, const float axis[3], float angle);
+	int								addGlass(const std::string& model, const float position[3], float scale, const float axis[3], float angle, float refractiveIndex, float opacity, float liquidOpacity, bool specimen);
+
+	SceneTransforms&				getTransforms();
+	int								getModelCount();
+	const std::string&				getModelName(int model);
+	int								getMaterialCount();
+	const Material&					getMaterial(int material);
+	int								findMaterial(const std::string& name);		// -1 if none
+
+	int								getBasicCount();
+	int								getBasicTransform(int i);
+	int								getBasicModel(int i);
+	int								getBasicMaterial(int i);
+
+	int								getGlassCount();
+	int								getGlassTransform(int i);
+	int								getGlassModel(int i);
+	float							getGlassRefractiveIndex(int i);
+	float							getGlassOpacity(int i);
+	float							getLiquidOpacity(int i);
+	bool							getSpecimen(int i);
+
+	// Loads a made-up scene of count objects in each format, repeats times, reporting the average of each; false if either failed to load all of them back
+	static bool						benchmarkLoad(int count, int repeats, std::string& report);
+
+private:
+	bool							loadText(FILE* file);
+	bool							loadBinary(FILE* file);
+	int								findModel(const std::string& name);	// Adding it if new
+
+	SceneTransforms					m_transforms;
+	std::vector<std::string>		m_models;
+	std::vector<Material>			m_materials;
+
+	// Basic models
+	std::vector<int>				m_basicTransforms;
+	std::vector<int>				m_basicModels;
+	std::vector<int>				m_basicMaterials;
+
+	// Glass objects
+	std::vector<int>				m_glassTransforms;
+	std::vector<int>				m_glassModels;
+	std::vector<float>				m_glassRefractiveIndices;
+	std::vector<float>				m_glassOpacities;
+	std::vector<float>				m_liquidOpacities;
+	std::vector<unsigned char>		m_specimens;
+};
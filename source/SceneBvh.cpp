@@ -0,0 +1,477 @@
+#include "pch.h"
+#include "SceneBvh.h"
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <emmintrin.h>
+#include <random>
+
+namespace
+{
+	enum Containment
+	{
+		Outside,
+		Intersecting,
+		Inside
+	};
+
+	// A frustum's planes, four to a register; padding planes, (0, 0, 0, 1), have everything inside them
+	struct PlaneGroups
+	{
+		int		count;
+		__m128	a[2], b[2], c[2], d[2];
+		__m128	absA[2], absB[2], absC[2];
+	};
+
+	PlaneGroups GroupPlanes(const SceneBvh::Frustum& frustum)
+	{
+		const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+		int planeCount = std::min(frustum.planeCount, (int)SceneBvh::MaxPlanes);
+
+		PlaneGroups groups;
+		groups.count = (planeCount+3)/4;
+		for (int g = 0; g < groups.count; g++)
+		{
+			float components[4][4];
+			for (int k = 0; k < 4; k++)
+			{
+				int plane = 4*g+k;
+				for (int j = 0; j < 4; j++)
+					components[j][k] = (plane < planeCount) ? frustum.planes[plane][j] : ((j == 3) ? 1.0f : 0.0f);
+			}
+
+			groups.a[g] = _mm_loadu_ps(components[0]);
+			groups.b[g] = _mm_loadu_ps(components[1]);
+			groups.c[g] = _mm_loadu_ps(components[2]);
+			groups.d[g] = _mm_loadu_ps(components[3]);
+			groups.absA[g] = _mm_and_ps(groups.a[g], absMask);
+			groups.absB[g] = _mm_and_ps(groups.b[g], absMask);
+			groups.absC[g] = _mm_and_ps(groups.c[g], absMask);
+		}
+
+		return groups;
+	}
+
+	// Against four planes at once: the box's centre's distance from each, give or take how far its corners reach towards it
+	Containment TestBox(const PlaneGroups& planes, const float min[3], const float max[3])
+	{
+		const __m128 zero = _mm_setzero_ps();
+		__m128 cx = _mm_set1_ps(0.5f*(min[0]+max[0])), cy = _mm_set1_ps(0.5f*(min[1]+max[1])), cz = _mm_set1_ps(0.5f*(min[2]+max[2]));
+		__m128 ex = _mm_set1_ps(0.5f*(max[0]-min[0])), ey = _mm_set1_ps(0.5f*(max[1]-min[1])), ez = _mm_set1_ps(0.5f*(max[2]-min[2]));
+
+		bool inside = true;
+		for (int g = 0; g < planes.count; g++)
+		{
+			__m128 centre = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(planes.a[g], cx), _mm_mul_ps(planes.b[g], cy)), _mm_mul_ps(planes.c[g], cz)), planes.d[g]);
+			__m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes.absA[g], ex), _mm_mul_ps(planes.absB[g], ey)), _mm_mul_ps(planes.absC[g], ez));
+
+			if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(centre, reach), zero)))
+				return Outside;
+			if (_mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(centre, reach), zero)))
+				inside = false;
+		}
+
+		return (inside) ? Inside : Intersecting;
+	}
+
+	// Looking from the origin along forward, spreading tanX and tanY either side
+	SceneBvh::Frustum MakeView(const float forward[3], const float right[3], const float up[3], float tanX, float tanY, float nearPlane)
+	{
+		SceneBvh::Frustum frustum;
+		frustum.planeCount = 5;
+		for (int j = 0; j < 3; j++)
+		{
+			frustum.planes[0][j] = tanX*forward[j]+right[j];
+			frustum.planes[1][j] = tanX*forward[j]-right[j];
+			frustum.planes[2][j] = tanY*forward[j]+up[j];
+			frustum.planes[3][j] = tanY*forward[j]-up[j];
+			frustum.planes[4][j] = forward[j];
+		}
+		for (int i = 0; i < 4; i++)
+			frustum.planes[i][3] = 0.0f;
+		frustum.planes[4][3] = -nearPlane;
+
+		return frustum;
+	}
+}
+
+SceneBvh::SceneBvh()
+{
+}
+
+void SceneBvh::clear()
+{
+	m_objectMin.clear();
+	m_objectMax.clear();
+	m_order.clear();
+	m_nodes.clear();
+}
+
+int SceneBvh::add(const float min[3], const float max[3])
+{
+	m_objectMin.insert(m_objectMin.end(), min, min+3);
+	m_objectMax.insert(m_objectMax.end(), max, max+3);
+
+	return getObjectCount()-1;
+}
+
+void SceneBvh::setBounds(int object, const float min[3], const float max[3])
+{
+	for (int j = 0; j < 3; j++)
+	{
+		m_objectMin[3*object+j] = min[j];
+		m_objectMax[3*object+j] = max[j];
+	}
+}
+
+void SceneBvh::getBounds(int object, float min[3], float max[3])
+{
+	for (int j = 0; j < 3; j++)
+	{
+		min[j] = m_objectMin[3*object+j];
+		max[j] = m_objectMax[3*object+j];
+	}
+}
+
+void SceneBvh::Build()
+{
+	int count = getObjectCount();
+	m_order.resize(count);
+	for (int i = 0; i < count; i++)
+		m_order[i] = i;
+
+	m_nodes.clear();
+	if (count == 0)
+		return;
+
+	m_nodes.reserve(2*(count/LeafSize+1));
+	m_nodes.push_back(Node());
+	buildNode(0, 0, count);
+}
+
+void SceneBvh::Refit()
+{
+	// NB: Children always come after their parents, so going backwards fits every node after its children
+	for (int i = (int)m_nodes.size()-1; i >= 0; i--)
+		fitNode(i);
+}
+
+int SceneBvh::Cull(const Frustum& frustum, std::vector<unsigned char>& visible)
+{
+	visible.assign(getObjectCount(), 0);
+	if (m_nodes.empty())
+		return 0;
+
+	PlaneGroups planes = GroupPlanes(frustum);
+
+	int visibleCount = 0;
+	m_stack.clear();
+	m_stack.push_back(0);
+	while (!m_stack.empty())
+	{
+		int n = m_stack.back();
+		const Node& node = m_nodes[n];
+		m_stack.pop_back();
+
+		Containment containment = TestBox(planes, node.min, node.max);
+		if (containment == Outside)
+			continue;
+
+		// Nothing beneath a node wholly inside needs testing
+		if (containment == Inside)
+		{
+			addObjects(n, visible, visibleCount);
+			continue;
+		}
+
+		if (node.count == 0)
+		{
+			m_stack.push_back(node.first+1);
+			m_stack.push_back(node.first);
+			continue;
+		}
+
+		for (int i = node.first; i < node.first+node.count; i++)
+		{
+			int object = m_order[i];
+			if (TestBox(planes, &m_objectMin[3*object], &m_objectMax[3*object]) != Outside)
+			{
+				visible[object] = 1;
+				visibleCount++;
+			}
+		}
+	}
+
+	return visibleCount;
+}
+
+int SceneBvh::CullReference(const Frustum& frustum, std::vector<unsigned char>& visible)
+{
+	int count = getObjectCount();
+	int planeCount = std::min(frustum.planeCount, (int)MaxPlanes);
+	visible.assign(count, 0);
+
+	// Same sums as TestBox, so either gives the same objects
+	int visibleCount = 0;
+	for (int i = 0; i < count; i++)
+	{
+		const float* min = &m_objectMin[3*i];
+		const float* max = &m_objectMax[3*i];
+		float cx = 0.5f*(min[0]+max[0]), cy = 0.5f*(min[1]+max[1]), cz = 0.5f*(min[2]+max[2]);
+		float ex = 0.5f*(max[0]-min[0]), ey = 0.5f*(max[1]-min[1]), ez = 0.5f*(max[2]-min[2]);
+
+		bool outside = false;
+		for (int p = 0; p < planeCount && !outside; p++)
+		{
+			const float* plane = frustum.planes[p];
+			float centre = plane[0]*cx+plane[1]*cy+plane[2]*cz+plane[3];
+			float reach = fabsf(plane[0])*ex+fabsf(plane[1])*ey+fabsf(plane[2])*ez;
+			outside = (centre+reach < 0.0f);
+		}
+
+		if (!outside)
+		{
+			visible[i] = 1;
+			visibleCount++;
+		}
+	}
+
+	return visibleCount;
+}
+
+int SceneBvh::getObjectCount()
+{
+	return (int)m_objectMin.size()/3;
+}
+
+int SceneBvh::getNodeCount()
+{
+	return (int)m_nodes.size();
+}
+
+SceneBvh::Frustum SceneBvh::makeFrustum(const float viewProjection[16])
+{
+	// NB: Straight from the combined matrix's columns, so reflected views need no special treatment
+	const float* m = viewProjection;
+	Frustum frustum;
+	frustum.planeCount = 5;
+	for (int row = 0; row < 4; row++)
+	{
+		frustum.planes[0][row] = m[4*row+3]+m[4*row+0];	// Left
+		frustum.planes[1][row] = m[4*row+3]-m[4*row+0];	// Right
+		frustum.planes[2][row] = m[4*row+3]+m[4*row+1];	// Bottom
+		frustum.planes[3][row] = m[4*row+3]-m[4*row+1];	// Top
+		frustum.planes[4][row] = m[4*row+2];				// Near
+	}
+
+	return frustum;
+}
+
+void SceneBvh::transformBounds(const float min[3], const float max[3], const float world[16], float worldMin[3], float worldMax[3])
+{
+	// Row vectors, as SimpleMath: the centre moves with the matrix, and each axis of the box reaches as far as its row's magnitudes
+	float centre[3] = { 0.5f*(min[0]+max[0]), 0.5f*(min[1]+max[1]), 0.5f*(min[2]+max[2]) };
+	float extent[3] = { 0.5f*(max[0]-min[0]), 0.5f*(max[1]-min[1]), 0.5f*(max[2]-min[2]) };
+	for (int j = 0; j < 3; j++)
+	{
+		float c = world[12+j], e = 0.0f;
+		for (int i = 0; i < 3; i++)
+		{
+			c += centre[i]*world[4*i+j];
+			e += extent[i]*fabsf(world[4*i+j]);
+		}
+
+		worldMin[j] = c-e;
+		worldMax[j] = c+e;
+	}
+}
+
+bool SceneBvh::benchmarkCull(const std::vector<int>& counts, int repeats, std::string& report)
+{
+	std::mt19937 random(502);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	// From the origin: a cube map's six faces, then a main camera looking down a diagonal
+	const float axes[6][3] = { { -1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, -1.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f } };
+	const float ups[6][3] = { { 0.0f, 1.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, -1.0f }, { 0.0f, 0.0f, 1.0f } };
+	std::vector<Frustum> frustums;
+	for (int f = 0; f < 6; f++)
+	{
+		const float* forward = axes[f];
+		const float* up = ups[f];
+		float right[3] = { up[1]*forward[2]-up[2]*forward[1], up[2]*forward[0]-up[0]*forward[2], up[0]*forward[1]-up[1]*forward[0] };
+		frustums.push_back(MakeView(forward, right, up, 1.0f, 1.0f, 0.1f));
+	}
+	const float diagonal = 0.57735027f, forward[3] = { diagonal, diagonal, diagonal }, right[3] = { 0.70710678f, 0.0f, -0.70710678f }, up[3] = { -0.40824829f, 0.81649658f, -0.40824829f };
+	frustums.push_back(MakeView(forward, right, up, 0.76980036f, 0.43301270f, 0.1f));	// 75 by 47 degrees, as 16:9
+
+	report = "Culling against a cube map's faces and a main camera, every object against the tree:\n";
+	bool passed = true;
+	for (int c = 0; c < (int)counts.size(); c++)
+	{
+		SceneBvh bvh;
+		for (int i = 0; i < counts[c]; i++)
+		{
+			float centre[3] = { 100.0f*unit(random), 100.0f*unit(random), 100.0f*unit(random) };
+			float size = 1.25f+0.75f*unit(random);
+			float min[3] = { centre[0]-size, centre[1]-size, centre[2]-size };
+			float max[3] = { centre[0]+size, centre[1]+size, centre[2]+size };
+			bvh.add(min, max);
+		}
+
+		auto buildStart = std::chrono::high_resolution_clock::now();
+		bvh.Build();
+		auto buildEnd = std::chrono::high_resolution_clock::now();
+
+		double referenceTime = 0.0, treeTime = 0.0;
+		int visibleCount = 0, differing = 0;
+		std::vector<unsigned char> reference, tree;
+		for (int r = 0; r < repeats; r++)
+		{
+			for (int f = 0; f < (int)frustums.size(); f++)
+			{
+				auto start = std::chrono::high_resolution_clock::now();
+				int expected = bvh.CullReference(frustums[f], reference);
+				auto middle = std::chrono::high_resolution_clock::now();
+				bvh.Cull(frustums[f], tree);
+				auto end = std::chrono::high_resolution_clock::now();
+
+				referenceTime += std::chrono::duration<double, std::micro>(middle-start).count();
+				treeTime += std::chrono::duration<double, std::micro>(end-middle).count();
+
+				if (r == 0)
+				{
+					visibleCount += expected;
+					for (int i = 0; i < counts[c]; i++)
+						differing += (reference[i] != tree[i]);
+				}
+			}
+		}
+
+		// A tenth of the objects drift, as specimens do in their jars
+		double refitTime = 0.0;
+		for (int r = 0; r < repeats; r++)
+		{
+			for (int i = 0; i < counts[c]; i += 10)
+			{
+				float offset = 0.1f*unit(random);
+				float min[3], max[3];
+				for (int j = 0; j < 3; j++)
+				{
+					min[j] = bvh.m_objectMin[3*i+j]+offset;
+					max[j] = bvh.m_objectMax[3*i+j]+offset;
+				}
+				bvh.setBounds(i, min, max);
+			}
+
+			auto start = std::chrono::high_resolution_clock::now();
+			bvh.Refit();
+			auto end = std::chrono::high_resolution_clock::now();
+			refitTime += std::chrono::duration<double, std::micro>(end-start).count();
+		}
+
+		char line[256];
+		snprintf(line, sizeof(line), "  %7d objects: %9.1fus every object, %9.1fus tree (%.2fx), %d of %d visible in all, %d differing; %.1fus to build, %.1fus to refit\n",
+			counts[c], referenceTime/repeats, treeTime/repeats, (treeTime > 0.0) ? referenceTime/treeTime : 0.0, visibleCount, (int)frustums.size()*counts[c], differing,
+			std::chrono::duration<double, std::micro>(buildEnd-buildStart).count(), refitTime/repeats);
+		report += line;
+		passed = passed && differing == 0;
+	}
+
+	return passed;
+}
+
+void SceneBvh::buildNode(int node, int first, int count)
+{
+	m_nodes[node].first = first;
+	m_nodes[node].count = count;
+	if (count <= LeafSize)
+	{
+		fitNode(node);
+		return;
+	}
+
+	// Halved along the longest axis of the objects' centres; not the tightest of trees, but built in a blink
+	float low[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, high[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (int i = first; i < first+count; i++)
+	{
+		int object = m_order[i];
+		for (int j = 0; j < 3; j++)
+		{
+			float centre = m_objectMin[3*object+j]+m_objectMax[3*object+j];
+			low[j] = std::min(low[j], centre);
+			high[j] = std::max(high[j], centre);
+		}
+	}
+
+	int axis = 0;
+	for (int j = 1; j < 3; j++)
+		if (high[j]-low[j] > high[axis]-low[axis])
+			axis = j;
+
+	int half = count/2;
+	std::nth_element(m_order.begin()+first, m_order.begin()+first+half, m_order.begin()+first+count, [&](int a, int b) {
+		return m_objectMin[3*a+axis]+m_objectMax[3*a+axis] < m_objectMin[3*b+axis]+m_objectMax[3*b+axis];
+	});
+
+	int child = (int)m_nodes.size();
+	m_nodes.push_back(Node());
+	m_nodes.push_back(Node());
+	m_nodes[node].first = child;
+	m_nodes[node].count = 0;
+
+	buildNode(child, first, half);
+	buildNode(child+1, first+half, count-half);
+	fitNode(node);
+}
+
+void SceneBvh::fitNode(int node)
+{
+	Node& fitting = m_nodes[node];
+	for (int j = 0; j < 3; j++)
+	{
+		fitting.min[j] = FLT_MAX;
+		fitting.max[j] = -FLT_MAX;
+	}
+
+	if (fitting.count == 0)
+	{
+		for (int c = 0; c < 2; c++)
+		{
+			const Node& child = m_nodes[fitting.first+c];
+			for (int j = 0; j < 3; j++)
+			{
+				fitting.min[j] = std::min(fitting.min[j], child.min[j]);
+				fitting.max[j] = std::max(fitting.max[j], child.max[j]);
+			}
+		}
+		return;
+	}
+
+	for (int i = fitting.first; i < fitting.first+fitting.count; i++)
+	{
+		int object = m_order[i];
+		for (int j = 0; j < 3; j++)
+		{
+			fitting.min[j] = std::min(fitting.min[j], m_objectMin[3*object+j]);
+			fitting.max[j] = std::max(fitting.max[j], m_objectMax[3*object+j]);
+		}
+	}
+}
+
+void SceneBvh::addObjects(int node, std::vector<unsigned char>& visible, int& visibleCount)
+{
+	const Node& adding = m_nodes[node];
+	if (adding.count == 0)
+	{
+		addObjects(adding.first, visible, visibleCount);
+		addObjects(adding.first+1, visible, visibleCount);
+		return;
+	}
+
+	for (int i = adding.first; i < adding.first+adding.count; i++)
+	{
+		visible[m_order[i]] = 1;
+		visibleCount++;
+	}
+}
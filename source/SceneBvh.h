@@ -0,0 +1,63 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Bounding volume hierarchy over scene objects' world-space boxes, for culling them against cameras' frustums.
+// Built top-down once every object is added; moving objects only need their boxes set again and a Refit, which keeps the tree's shape
+class SceneBvh
+{
+public:
+	static const int				LeafSize = 4;		// Most objects a leaf holds
+	static const int				MaxPlanes = 8;
+
+	// Each plane is (a, b, c, d), with inside being where ax+by+cz+d >= 0
+	struct Frustum
+	{
+		int		planeCount;
+		float	planes[MaxPlanes][4];
+	};
+
+	SceneBvh();
+
+	void							clear();
+	int								add(const float min[3], const float max[3]);		// Returns the object's index
+	void							setBounds(int object, const float min[3], const float max[3]);
+	void							getBounds(int object, float min[3], float max[3]);
+
+	void							Build();		// After adding; objects added since are never visible until it is run again
+	void							Refit();		// After setting bounds; only boxes change, so it costs one pass over the nodes
+
+	// Objects at least partly inside the frustum, as a flag per object. Cull walks the tree with SSE; CullReference tests every object, one plane at a time
+	int								Cull(const Frustum& frustum, std::vector<unsigned char>& visible);			// Returns how many are visible
+	int								CullReference(const Frustum& frustum, std::vector<unsigned char>& visible);
+
+	int								getObjectCount();
+	int								getNodeCount();
+
+	static Frustum					makeFrustum(const float viewProjection[16]);	// Left, right, bottom, top and near planes of a row-major (SimpleMath) matrix
+	static void						transformBounds(const float min[3], const float max[3], const float world[16], float worldMin[3], float worldMax[3]);	// Box around a transformed box
+
+	// Culls count made-up objects against a cube map's six faces and a main camera, both ways, repeats times; then moves a tenth of them and refits.
+	// False if the tree ever disagreed with testing every object
+	static bool						benchmarkCull(const std::vector<int>& counts, int repeats, std::string& report);
+
+private:
+	// NB: Children are allocated together, so an interior node's are first and first+1
+	struct Node
+	{
+		float	min[3];
+		float	max[3];
+		int		first;		// Into m_order if a leaf; otherwise the first child
+		int		count;		// Objects, or 0 if interior
+	};
+
+	void							buildNode(int node, int first, int count);	// Fitting node around them
+	void							fitNode(int node);
+	void							addObjects(int node, std::vector<unsigned char>& visible, int& visibleCount);		// Every object beneath node, untested
+
+	std::vector<float>				m_objectMin;	// 3 per object
+	std::vector<float>				m_objectMax;
+	std::vector<int>				m_order;		// Objects, grouped by leaf
+	std::vector<Node>				m_nodes;		// Root first; children always after their parent
+	std::vector<int>				m_stack;		// Kept between culls, so walking the tree allocates nothing
+};
@@ -0,0 +1,175 @@
+#include "pch.h"
+#include "SelfTest.h"
+#include "Benchmark.h"
+#include "CommandListRecorder.h"
+#include "DrawQueue.h"
+#include "EnvironmentBaker.h"
+#include "EnvironmentDetail.h"
+#include "EnvironmentProjection.h"
+#include "Game.h"
+#include "OcclusionBuffer.h"
+#include "ProgressiveQueue.h"
+#include "RenderGraph.h"
+#include "RenderTexturePool.h"
+#include "Scene.h"
+#include "SceneBvh.h"
+#include "SoftwareRenderer.h"
+#include "StaticCache.h"
+#include "TriangleBvh.h"
+#include "modelclass.h"
+#include <cstdio>
+#include <thread>
+
+namespace
+{
+	// Writes a summary holding only what Benchmark::compare reads
+	bool WriteSummary(const char* filename, double frame, double pass)
+	{
+		FILE* file = fopen(filename, "w");
+		if (!file)
+			return false;
+
+		fprintf(file, "{\n\t\"metrics\": {\n\t\t\"frame.mean\": %.4f,\n\t\t\"Scene.mean\": %.4f\n\t}\n}\n", frame, pass);
+		fclose(file);
+
+		return true;
+	}
+
+	// That a run is not flagged against itself, but is against a baseline it is a fifth slower than
+	bool CheckComparison(std::string& report)
+	{
+		if (!WriteSummary("selftest_baseline.json", 10.0, 2.0) || !WriteSummary("selftest_slower.json", 10.0, 2.4))
+		{
+			report = "Could not write the summaries to compare\n";
+			return false;
+		}
+
+		std::string same, slower;
+		bool passed = !Benchmark::compare("selftest_baseline.json", "selftest_baseline.json", 0.1, same) && Benchmark::compare("selftest_baseline.json", "selftest_slower.json", 0.1, slower);
+		report = same+slower;
+
+		remove("selftest_baseline.json");
+		remove("selftest_slower.json");
+
+		return passed;
+	}
+
+	// Loads a model as Game does, through a device that creates nothing, keeping only its mesh; empty if the model is missing
+	void LoadMesh(const std::string& filename, std::vector<float>& triangles, std::vector<float>& vertices)
+	{
+		NullRenderDeviceBackend backend;
+		RenderDevice device;
+		device.Initialise(&backend);
+
+		std::vector<char> name(filename.begin(), filename.end());
+		name.push_back('\0');
+		ModelClass model;
+		model.InitializeModel(&device, name.data());
+		model.GetTriangles(triangles);
+		model.GetVertices(vertices);
+		model.Shutdown();
+	}
+}
+
+SelfTest::SelfTest()
+{
+	m_checkCount = 0;
+	m_failedCount = 0;
+}
+
+bool SelfTest::run()
+{
+	m_report.clear();
+	m_checkCount = 0;
+	m_failedCount = 0;
+	std::string report;
+
+	check("Benchmark comparison", CheckComparison(report), report);
+
+	// That the frame graph culls, orders and aliases as it should, compiled headlessly
+	check("Render graph", RenderGraph::verify(report), report);
+
+	// What three glass objects' maps (six faces of four captures each, and two projections) hold as they change tier, with and without trimming
+	std::vector<int> tierWidths, tierHeights;
+	for (int i = 0; i < EnvironmentDetail::getTierCount(); i++)
+	{
+		tierWidths.push_back(EnvironmentDetail::getTierWidth(i));
+		tierHeights.push_back(EnvironmentDetail::getTierHeight(i));
+	}
+	check("Render texture pool", RenderTexturePool::simulate(tierWidths, tierHeights, 3, 4*6+2, EnvironmentDetail::getHoldFrames(), 600, report), report);
+
+	// What sorting draws costs, and what it saves, at far more draws than the scene has yet
+	check("Draw queue sort", DrawQueue::benchmarkSort(10000, 16, report), report);
+	check("Draw queue state changes", DrawQueue::compareStateChanges(10000, 8, 64, report), report);
+
+	// How recording a frame's environment faces scales with threads (three glass objects' worth)
+	check("Command list recording", CommandListRecorder::benchmark(18, 64, 16, report), report);
+
+	// What either scene format costs to load, at far more objects than the scene has yet
+	check("Scene loading", Scene::benchmarkLoad(10000, 4, report), report);
+
+	// What rebuilding world matrices costs, scalar, with SSE and with AVX, at far more objects than the scene has yet
+	check("Scene transforms", SceneTransforms::benchmarkUpdate({ 1000, 10000, 100000 }, 16, report), report);
+
+	// What culling costs, object by object and through the BVH
+	check("Scene BVH culling", SceneBvh::benchmarkCull({ 1000, 10000, 100000 }, 16, report), report);
+
+	// What occlusion culling costs, and how much it hides compared to a finer buffer
+	check("Occlusion culling", OcclusionBuffer::benchmark(12, 2000, 16, report), report);
+
+	// The densest meshes, and as many threads as the machine has
+	std::vector<float> sphereTriangles, sphere, deathStarTriangles, deathStar, cubeTriangles, cube;
+	LoadMesh("Unit Sphere (High Poly).obj", sphereTriangles, sphere);
+	LoadMesh("death_star.obj", deathStarTriangles, deathStar);
+	LoadMesh("cube.obj", cubeTriangles, cube);
+	int threads = std::max(1, (int)std::thread::hardware_concurrency());
+
+	// What tracing rays against them costs, and building the trees to do it
+	check("Triangle BVH (sphere)", TriangleBvh::benchmark("Unit Sphere (High Poly)", sphereTriangles, 1 << 18, threads, report), report);
+	check("Triangle BVH (death star)", TriangleBvh::benchmark("death_star", deathStarTriangles, 1 << 18, threads, report), report);
+
+	// What a frame of captures, glass and overlay costs on the CPU, and how it scales across cores
+	check("Software rendering", SoftwareRenderer::benchmark(sphere, cube, 640, 360, { 1, 2, 4, threads }, 2, report), report);
+
+	// What ray tracing a capture in place of the static passes costs, and holds
+	check("Environment baking", EnvironmentBaker::benchmark(sphere, cube, 256, threads, report), report);
+
+	// What caching the static results costs to write and read, and how far they pack
+	check("Static cache", StaticCache::benchmark(1280, 720, threads, report), report);
+
+	// What resampling six captured faces into one target costs on the CPU, and how much of them survives it
+	check("Environment projection", EnvironmentProjection::benchmark(1280, 720, { 180, 360, 720 }, 200000, report), report);
+
+	// How many frames progressive startup spreads the static faces of three glass objects over, at a few budgets
+	check("Progressive queue", ProgressiveQueue::simulate(6*3, { 1.0, 4.0, 16.0 }, report), report);
+
+	// The game's own frames on null backends: the passes its graph schedules, the draws they submit, and that nothing is still being created once it settles
+	check("Game frame", Game::verifyHeadless(8, report), report);
+
+	// What shadowing the pipeline state saves the game's own frames, against a render context that passes everything on
+	check("Game state shadowing", Game::compareShadowing(4, report), report);
+
+	// What resampling each capture into one target costs the game's frames in draws, besides what the cube layout draws
+	check("Game projection draws", Game::compareProjections(4, report), report);
+
+	m_report += std::to_string(m_failedCount) + " of " + std::to_string(m_checkCount) + " checks failed\n";
+	return m_failedCount == 0;
+}
+
+std::string SelfTest::getReport()
+{
+	return m_report;
+}
+
+int SelfTest::getFailedCount()
+{
+	return m_failedCount;
+}
+
+void SelfTest::check(const char* name, bool passed, std::string& report)
+{
+	m_report += std::string((passed) ? "PASS " : "FAIL ") + name + "\n" + report;
+	m_checkCount++;
+	m_failedCount += (passed) ? 0 : 1;
+	report.clear();
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+
+// Runs each module's synthetic benchmark (-selftest) with checks on what it computed, as well as what it cost.
+// Nothing here needs a window or a device, so none of it runs at startup; meshes are loaded through a null RenderDevice
+class SelfTest
+{
+public:
+	SelfTest();
+
+	bool							run();				// False if any check failed
+	std::string						getReport();		// Each check's report under whether it passed, then a tally
+	int								getFailedCount();
+
+private:
+	void							check(const char* name, bool passed, std::string& report);	// Files report under name, and empties it
+
+	std::string						m_report;
+	int								m_checkCount;
+	int								m_failedCount;
+};
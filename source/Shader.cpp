@@ -4,6 +4,14 @@
 
 Shader::Shader()
 {
+	m_device = nullptr;
+	m_vertexShader = nullptr;
+	m_pixelShader = nullptr;
+	m_layout = nullptr;
+	m_sampleState = nullptr;
+	m_matrixBuffer = nullptr;
+	m_viewBuffer = nullptr;
+	m_timeBuffer = nullptr;
 }
 
 
@@ -11,12 +19,15 @@ Shader::~Shader()
 {
 }
 
-bool Shader::InitShader(ID3D11Device* device, WCHAR* vsFilename, WCHAR* psFilename)
+bool Shader::InitShader(RenderDevice* device, WCHAR* vsFilename, WCHAR* psFilename, bool instanced)
 {
+	Shutdown();
+	m_device = device;
+
 	//LOAD SHADER:	VERTEX
 	auto vertexShaderBuffer = DX::ReadData(vsFilename);
-	HRESULT result = device->CreateVertexShader(vertexShaderBuffer.data(), vertexShaderBuffer.size(), NULL, &m_vertexShader);
-	if (result != S_OK)
+	m_vertexShader = device->CreateVertexShader(vertexShaderBuffer.data(), vertexShaderBuffer.size());
+	if (!m_vertexShader)
 	{
 		//if loading failed.  
 		return false;
@@ -24,113 +35,128 @@ bool Shader::InitShader(ID3D11Device* device, WCHAR* vsFilename, WCHAR* psFilena
 
 	// Create the vertex input layout description.
 	// This setup needs to match the VertexType stucture in the MeshClass and in the shader.
-	D3D11_INPUT_ELEMENT_DESC polygonLayout[] = {
-		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
-		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-		{ "TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-		{ "BINORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+	RenderInputElement polygonLayout[] = {
+		{ "POSITION", 0, RenderFormatRgb32Float, 0, false },
+		{ "TEXCOORD", 0, RenderFormatRg32Float, 0, false },
+		{ "NORMAL", 0, RenderFormatRgb32Float, 0, false },
+		{ "TANGENT", 0, RenderFormatRgb32Float, 0, false },
+		{ "BINORMAL", 0, RenderFormatRgb32Float, 0, false }
 	};
 
-	// Get a count of the elements in the layout.
-	unsigned int numElements;
-	numElements = sizeof(polygonLayout) / sizeof(polygonLayout[0]);
+	// Per-instance streams, one per InstanceBatch array: the world matrix's rows in slot 1, and the material index in slot 2.
+	RenderInputElement instanceLayout[] = {
+		{ "WORLD", 0, RenderFormatRgba32Float, 1, true },
+		{ "WORLD", 1, RenderFormatRgba32Float, 1, true },
+		{ "WORLD", 2, RenderFormatRgba32Float, 1, true },
+		{ "WORLD", 3, RenderFormatRgba32Float, 1, true },
+		{ "MATERIAL", 0, RenderFormatR32Uint, 2, true }
+	};
+
+	std::vector<RenderInputElement> layout(polygonLayout, polygonLayout + sizeof(polygonLayout) / sizeof(polygonLayout[0]));
+	if (instanced)
+		layout.insert(layout.end(), instanceLayout, instanceLayout + sizeof(instanceLayout) / sizeof(instanceLayout[0]));
 
 	// Create the vertex input layout.
-	device->CreateInputLayout(polygonLayout, numElements, vertexShaderBuffer.data(), vertexShaderBuffer.size(), &m_layout);
+	m_layout = device->CreateInputLayout(layout.data(), (unsigned int)layout.size(), vertexShaderBuffer.data(), vertexShaderBuffer.size());
 
 
 	//LOAD SHADER:	PIXEL
 	auto pixelShaderBuffer = DX::ReadData(psFilename);
-	result = device->CreatePixelShader(pixelShaderBuffer.data(), pixelShaderBuffer.size(), NULL, &m_pixelShader);
-	if (result != S_OK)
+	m_pixelShader = device->CreatePixelShader(pixelShaderBuffer.data(), pixelShaderBuffer.size());
+	if (!m_pixelShader)
 	{
 		//if loading failed. 
 		return false;
 	}
 
-	// Create a texture sampler state description.
-	D3D11_SAMPLER_DESC samplerDesc;
-	samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
-	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
-	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
-	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
-	samplerDesc.MipLODBias = 0.0f;
-	samplerDesc.MaxAnisotropy = 1;
-	samplerDesc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
-	samplerDesc.BorderColor[0] = 0;
-	samplerDesc.BorderColor[1] = 0;
-	samplerDesc.BorderColor[2] = 0;
-	samplerDesc.BorderColor[3] = 0;
-	samplerDesc.MinLOD = 0;
-	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+	// Create the texture sampler state; linear and wrapped.
+	m_sampleState = device->CreateSamplerState({ false, false });
 
-	// Create the texture sampler state.
-	device->CreateSamplerState(&samplerDesc, &m_sampleState);
-
-	// Setup the description of the dynamic matrix constant buffer that is in the vertex shader.
-	D3D11_BUFFER_DESC matrixBufferDesc;
-	matrixBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-	matrixBufferDesc.ByteWidth = sizeof(MatrixBufferType);
-	matrixBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	matrixBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	matrixBufferDesc.MiscFlags = 0;
-	matrixBufferDesc.StructureByteStride = 0;
-
-	// Create the constant buffer pointer so we can access the vertex shader constant buffer from within this class.
-	device->CreateBuffer(&matrixBufferDesc, NULL, &m_matrixBuffer);
-
-	// Setup the description of the dynamic matrix constant buffer that is in the vertex shader.
-	D3D11_BUFFER_DESC timeBufferDesc;
-	timeBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-	timeBufferDesc.ByteWidth = sizeof(MatrixBufferType);
-	timeBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	timeBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	timeBufferDesc.MiscFlags = 0;
-	timeBufferDesc.StructureByteStride = 0;
-
-	// Create the constant buffer pointer so we can access the vertex shader constant buffer from within this class.
-	device->CreateBuffer(&timeBufferDesc, NULL, &m_timeBuffer);
+	// Create the constant buffers, split by how often they change, so we can access the shaders' constant buffers from within this class.
+	m_matrixBuffer = device->CreateBuffer({ sizeof(ObjectBufferType), RenderBindConstantBuffer, true });
+	m_viewBuffer = device->CreateBuffer({ sizeof(ViewBufferType), RenderBindConstantBuffer, true });
+	m_timeBuffer = device->CreateBuffer({ sizeof(TimeBufferType), RenderBindConstantBuffer, true });
 
+	// NB: These buffers are only written when the device has no constant ring; see WriteConstants
 	return true;
 }
 
-bool Shader::SetShaderParameters(ID3D11DeviceContext* context, DirectX::SimpleMath::Matrix* world, DirectX::SimpleMath::Matrix* view, DirectX::SimpleMath::Matrix* projection, float time)
-{ 
-	D3D11_MAPPED_SUBRESOURCE mappedResource;
-	context->Map(m_matrixBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-
-	MatrixBufferType* dataPtr = (MatrixBufferType*)mappedResource.pData;
-	dataPtr->world = world->Transpose(); 	// Transpose the matrices to prepare them for the shader.
-	dataPtr->view = view->Transpose();
-	dataPtr->projection = projection->Transpose();
+void Shader::Shutdown()
+{
+	if (!m_device)
+		return;
+
+	m_device->Release(m_vertexShader);
+	m_device->Release(m_pixelShader);
+	m_device->Release(m_layout);
+	m_device->Release(m_sampleState);
+	m_device->Release(m_matrixBuffer);
+	m_device->Release(m_viewBuffer);
+	m_device->Release(m_timeBuffer);
+
+	m_vertexShader = nullptr;
+	m_pixelShader = nullptr;
+	m_layout = nullptr;
+	m_sampleState = nullptr;
+	m_matrixBuffer = nullptr;
+	m_viewBuffer = nullptr;
+	m_timeBuffer = nullptr;
+}
 
-	context->Unmap(m_matrixBuffer, 0);
-	context->VSSetConstantBuffers(0, 1, &m_matrixBuffer);	//note the first variable is the mapped buffer ID.  Corresponding to what you set in the VS;
+bool Shader::SetShaderParameters(RenderContext* context, DirectX::SimpleMath::Matrix* world, DirectX::SimpleMath::Matrix* view, DirectX::SimpleMath::Matrix* projection, float time)
+{ 
+	ObjectBufferType object;
+	object.world = world->Transpose(); 	// Transpose the matrices to prepare them for the shader.
+	context->VSSetConstants(0, WriteConstants(context, ConstantRing::Object, m_matrixBuffer, &object, sizeof(object)));	//note the first variable is the mapped buffer ID.  Corresponding to what you set in the VS;
+
+	// Environment maps are no longer all 1280x720, so screen-space lookups need the bound target's size
+	RenderViewport viewport = context->RSGetViewport();
+
+	ViewBufferType viewData;
+	viewData.view = view->Transpose();
+	viewData.projection = projection->Transpose();
+	viewData.screenSize = DirectX::SimpleMath::Vector2(viewport.Width, viewport.Height);
+	viewData.padding = DirectX::SimpleMath::Vector2(0.0, 0.0);
+	ConstantBinding viewBinding = WriteConstants(context, ConstantRing::View, m_viewBuffer, &viewData, sizeof(viewData));
+	context->VSSetConstants(4, viewBinding);
+	context->PSSetConstants(4, viewBinding);
+
+	TimeBufferType timeData;
+	timeData.time = time;
+	timeData.padding = DirectX::SimpleMath::Vector3(0.0, 0.0, 0.0);
+	context->PSSetConstants(0, WriteConstants(context, ConstantRing::Frame, m_timeBuffer, &timeData, sizeof(timeData)));	//note the first variable is the mapped buffer ID.  Corresponding to what you set in the PS
 
-	context->Map(m_timeBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+	return false;
+}
 
-	TimeBufferType* timePtr = (TimeBufferType*)mappedResource.pData;
-	timePtr->time = time;
-	timePtr->padding = DirectX::SimpleMath::Vector3(0.0, 0.0, 0.0);
-	context->Unmap(m_timeBuffer, 0);
-	context->PSSetConstantBuffers(0, 1, &m_timeBuffer);	//note the first variable is the mapped buffer ID.  Corresponding to what you set in the PS
+ConstantBinding Shader::WriteConstants(RenderContext* context, ConstantRing::Tier tier, ID3D11Buffer* buffer, const void* data, unsigned int bytes)
+{
+	// NB: Object, view and frame constants are the same whichever shader draws with them, so only materials are told apart
+	ConstantRing* ring = context->getConstantRing();
+	if (ring)
+		return ring->write(context, tier, (tier == ConstantRing::Material) ? buffer : nullptr, data, bytes);
 
-	timePtr->time = time;
-	timePtr->padding = DirectX::SimpleMath::Vector3(0.0, 0.0, 0.0);
+	void* mapped = context->Map(buffer, bytes);
+	memcpy(mapped, data, bytes);
+	context->Unmap(buffer);
 
-	return false;
+	return { buffer, 0, 0 };
 }
 
-void Shader::EnableShader(ID3D11DeviceContext* context)
+void Shader::EnableShader(RenderContext* context)
 {
 	context->IASetInputLayout(m_layout);							//set the input layout for the shader to match out geometry
-	context->VSSetShader(m_vertexShader.Get(), 0, 0);				//turn on vertex shader
-	context->PSSetShader(m_pixelShader.Get(), 0, 0);				//turn on pixel shader
+	context->VSSetShader(m_vertexShader, 0, 0);						//turn on vertex shader
+	context->PSSetShader(m_pixelShader, 0, 0);						//turn on pixel shader
 	context->PSSetSamplers(0, 1, &m_sampleState);					// Set the sampler state in the pixel shader.
 
 }
 
+ID3D11Buffer* Shader::getTimeBuffer()
+{
+	return m_timeBuffer;
+}
+
 /*bool Shader::InitStandard(ID3D11Device* device, WCHAR* vsFilename, WCHAR* psFilename)
 {
 	D3D11_BUFFER_DESC	matrixBufferDesc;
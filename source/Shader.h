@@ -2,6 +2,9 @@
 
 #include "DeviceResources.h"
 #include "Light.h"
+#include "RenderContext.h"
+#include "ConstantRing.h"
+#include "RenderDevice.h"
 
 //Class from which we create all shader objects used by the framework
 //This single class can be expanded to accomodate shaders of all different types with different parameters
@@ -13,25 +16,35 @@ public:
 
 	//we could extend this to load in only a vertex shader, only a pixel shader etc.  or specialised init for Geometry or domain shader. 
 	//All the methods here simply create new versions corresponding to your needs
-	bool InitShader(ID3D11Device* device, WCHAR* vsFilename, WCHAR* psFilename); //Loads the Vert / pixel Shader pair
+	bool InitShader(RenderDevice* device, WCHAR* vsFilename, WCHAR* psFilename, bool instanced = false); //Loads the Vert / pixel Shader pair; instanced vertex shaders also read InstanceBatch's streams
+	virtual void Shutdown();	// Releases what InitShader created, through the device it was created on; InitShader calls it first, so a restored device can re-initialise
 
-	bool SetShaderParameters(ID3D11DeviceContext* context,
+	bool SetShaderParameters(RenderContext* context,
 		DirectX::SimpleMath::Matrix* world,
 		DirectX::SimpleMath::Matrix* view,
 		DirectX::SimpleMath::Matrix* projection,
 		float time);
 
-	void EnableShader(ID3D11DeviceContext * context);
+	void EnableShader(RenderContext* context);
+
+	ID3D11Buffer* getTimeBuffer();	// For patching the time into recorded passes
 
 protected:
-	//standard matrix buffer supplied to all shaders
-	struct MatrixBufferType
+	// Writes a block of constants into the context's ring when it has one, otherwise into buffer, and returns what to bind
+	ConstantBinding WriteConstants(RenderContext* context, ConstantRing::Tier tier, ID3D11Buffer* buffer, const void* data, unsigned int bytes);
+
+	//standard buffers supplied to all shaders, split by how often they change
+	struct ObjectBufferType
 	{
 		DirectX::XMMATRIX world;
+	};
+
+	struct ViewBufferType
+	{
 		DirectX::XMMATRIX view;
 		DirectX::XMMATRIX projection;
-		float time;
-		DirectX::SimpleMath::Vector3 padding;
+		DirectX::SimpleMath::Vector2 screenSize;	// Dimensions of the bound render target, for screen-space lookups
+		DirectX::SimpleMath::Vector2 padding;
 	};
 
 	struct TimeBufferType
@@ -63,14 +76,17 @@ protected:
 		float padding;
 	};*/
 
+	RenderDevice*															m_device;
+
 	//Shaders
-	Microsoft::WRL::ComPtr<ID3D11VertexShader>								m_vertexShader;
-	Microsoft::WRL::ComPtr<ID3D11PixelShader>								m_pixelShader;
+	ID3D11VertexShader*														m_vertexShader;
+	ID3D11PixelShader*														m_pixelShader;
 	ID3D11InputLayout*														m_layout;
 
 	ID3D11SamplerState*														m_sampleState;
-	ID3D11Buffer*															m_matrixBuffer;
-	ID3D11Buffer*															m_timeBuffer;
+	ID3D11Buffer*															m_matrixBuffer;		// VS b0, per object
+	ID3D11Buffer*															m_viewBuffer;		// VS and PS b4, per view
+	ID3D11Buffer*															m_timeBuffer;		// PS b0, per frame
 };
 
 /*class GlassShader : Shader
@@ -0,0 +1,105 @@
+#include "pch.h"
+#include "SharedCapture.h"
+
+SharedCapture::SharedCapture()
+{
+	m_pool = nullptr;
+	m_reuseCount = 0;
+	m_drawsSaved = 0;
+	m_pixelsSaved = 0;
+}
+
+SharedCapture::~SharedCapture()
+{
+}
+
+void SharedCapture::Initialise(RenderTexturePool* pool)
+{
+	m_pool = pool;
+	m_captures.clear();
+}
+
+void SharedCapture::newFrame()
+{
+	for (int i = 0; i < (int)m_captures.size(); i++)
+		if (m_captures[i].pooled)
+			m_pool->release(m_captures[i].texture);
+
+	m_captures.clear();
+
+	m_reuseCount = 0;
+	m_drawsSaved = 0;
+	m_pixelsSaved = 0;
+}
+
+RenderTexture* SharedCapture::find(int face, int width, int height)
+{
+	for (int i = 0; i < (int)m_captures.size(); i++)
+		if (m_captures[i].face == face && m_captures[i].width == width && m_captures[i].height == height)
+			return m_captures[i].texture;
+
+	return nullptr;
+}
+
+RenderTexture* SharedCapture::create(int face, int width, int height)
+{
+	Capture capture;
+	capture.face = face;
+	capture.width = width;
+	capture.height = height;
+	capture.texture = m_pool->acquire(width, height);
+	capture.pooled = true;
+	capture.draws = 0;
+	m_captures.push_back(capture);
+
+	return capture.texture;
+}
+
+void SharedCapture::setDraws(RenderTexture* texture, int draws)
+{
+	for (int i = 0; i < (int)m_captures.size(); i++)
+		if (m_captures[i].texture == texture)
+			m_captures[i].draws = draws;
+}
+
+void SharedCapture::store(int face, RenderTexture* texture, int draws)
+{
+	Capture capture;
+	capture.face = face;
+	capture.width = texture->getTextureWidth();
+	capture.height = texture->getTextureHeight();
+	capture.texture = texture;
+	capture.pooled = false;
+	capture.draws = draws;
+	m_captures.push_back(capture);
+}
+
+void SharedCapture::recordReuse(RenderTexture* texture)
+{
+	// NB: The skybox alone covers every pixel, so this is a lower bound on fragments not shaded
+	for (int i = 0; i < (int)m_captures.size(); i++)
+	{
+		if (m_captures[i].texture != texture)
+			continue;
+
+		m_reuseCount++;
+		m_drawsSaved += m_captures[i].draws;
+		m_pixelsSaved += (long long)m_captures[i].width*m_captures[i].height;
+		return;
+	}
+}
+
+int SharedCapture::getReuseCount()
+{
+	return m_reuseCount;
+}
+
+int SharedCapture::getDrawsSaved()
+{
+	return m_drawsSaved;
+}
+
+long long SharedCapture::getPixelsSaved()
+{
+	return m_pixelsSaved;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "RenderTexturePool.h"
+
+// Caches the camera-centred background (skybox + basic models) of each cube face once per frame,
+// so every glass object's capture can start from a copy instead of re-rendering it
+class SharedCapture
+{
+public:
+	SharedCapture();
+	~SharedCapture();
+
+	void							Initialise(RenderTexturePool* pool);
+	void							newFrame();										// Forgets last frame's backgrounds, returning pooled ones
+
+	RenderTexture*					find(int face, int width, int height);			// Background already rendered this frame, or nullptr
+	RenderTexture*					create(int face, int width, int height);		// Pooled target for the caller to render a background into, then pass to setDraws
+	void							setDraws(RenderTexture* texture, int draws);	// What rendering a created background took
+	void							store(int face, RenderTexture* texture, int draws);	// Registers a background owned elsewhere (e.g. m_DynamicEnvironment)
+
+	void							recordReuse(RenderTexture* texture);			// Tallies the draws and pixels a copy of texture stood in for
+
+	int								getReuseCount();
+	int								getDrawsSaved();
+	long long						getPixelsSaved();
+
+private:
+	struct Capture
+	{
+		int				face;
+		int				width;
+		int				height;
+		RenderTexture*	texture;
+		bool			pooled;
+		int				draws;		// Issued rendering it
+	};
+
+	RenderTexturePool*				m_pool;
+	std::vector<Capture>			m_captures;
+
+	int								m_reuseCount;
+	int								m_drawsSaved;
+	long long						m_pixelsSaved;
+};
@@ -1,7 +1,7 @@
 #include "pch.h"
 #include "SkyboxShader.h"
 
-bool SkyboxShader::InitSkyboxShader(ID3D11Device* device, WCHAR* vsFilename, WCHAR* psFilename)
+bool SkyboxShader::InitSkyboxShader(RenderDevice* device, WCHAR* vsFilename, WCHAR* psFilename)
 {
 	if (!InitShader(device, vsFilename, psFilename))
 	{
@@ -11,7 +11,7 @@ bool SkyboxShader::InitSkyboxShader(ID3D11Device* device, WCHAR* vsFilename, WCH
 	return true;
 }
 
-bool SkyboxShader::SetSkyboxShaderParameters(ID3D11DeviceContext* context, DirectX::SimpleMath::Matrix* world, DirectX::SimpleMath::Matrix* view, DirectX::SimpleMath::Matrix* projection, float time, ID3D11ShaderResourceView* environmentMap[6])
+bool SkyboxShader::SetSkyboxShaderParameters(RenderContext* context, DirectX::SimpleMath::Matrix* world, DirectX::SimpleMath::Matrix* view, DirectX::SimpleMath::Matrix* projection, float time, ID3D11ShaderResourceView* environmentMap[6])
 {
 	SetShaderParameters(context, world, view, projection, time);
 
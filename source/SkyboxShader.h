@@ -9,8 +9,8 @@ public:
 	using Shader::SetShaderParameters;
 	using Shader::EnableShader;
 
-	bool InitSkyboxShader(ID3D11Device* device, WCHAR* vsFilename, WCHAR* psFilename);
-	bool SetSkyboxShaderParameters(ID3D11DeviceContext* context,
+	bool InitSkyboxShader(RenderDevice* device, WCHAR* vsFilename, WCHAR* psFilename);
+	bool SetSkyboxShaderParameters(RenderContext* context,
 		DirectX::SimpleMath::Matrix* world,
 		DirectX::SimpleMath::Matrix* view,
 		DirectX::SimpleMath::Matrix* projection,
@@ -0,0 +1,1036 @@
+#include "pch.h"
+#include "SoftwareRenderer.h"
+#include "RenderGraph.h"
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <thread>
+
+namespace
+{
+	const float PI = 3.14159265f;
+
+	// Attribute offsets, into SoftwareRenderer::Vertex::attributes
+	const int TextureAttribute = 0;
+	const int WorldAttribute = 2;
+	const int ModelAttribute = 5;
+	const int NormalAttribute = 8;
+	const int TangentAttribute = 11;
+	const int BinormalAttribute = 14;
+
+	// Row-major, row vectors: a then b
+	void Multiply(const float a[16], const float b[16], float product[16])
+	{
+		for (int row = 0; row < 4; row++)
+			for (int column = 0; column < 4; column++)
+				product[4*row+column] = a[4*row]*b[column]+a[4*row+1]*b[4+column]+a[4*row+2]*b[8+column]+a[4*row+3]*b[12+column];
+	}
+
+	float Dot(const float a[3], const float b[3])
+	{
+		return a[0]*b[0]+a[1]*b[1]+a[2]*b[2];
+	}
+
+	void Normalize(float v[3])
+	{
+		float inverseLength = 1.0f/sqrtf(Dot(v, v));
+		for (int j = 0; j < 3; j++)
+			v[j] *= inverseLength;
+	}
+
+	float Saturate(float x)
+	{
+		return std::min(std::max(x, 0.0f), 1.0f);
+	}
+
+	// Runs work(0..count-1) on threadCount threads, each taking the next index as it finishes the last
+	void ParallelFor(int count, int threadCount, const std::function<void(int)>& work)
+	{
+		std::atomic<int> next(0);
+		auto run = [&]() {
+			for (int i = next++; i < count; i = next++)
+				work(i);
+		};
+
+		std::vector<std::thread> threads;
+		for (int i = 1; i < std::min(threadCount, count); i++)
+			threads.push_back(std::thread(run));
+		run();
+		for (int i = 0; i < (int)threads.size(); i++)
+			threads[i].join();
+	}
+
+	// As glass_ps/refraction_ps find a face and its coordinates; face is -1 if none
+	void FindEnvironmentSt(const float v[3], float st[2], int& face)
+	{
+		float extremity = std::max(fabsf(v[0]), std::max(fabsf(v[1]), fabsf(v[2])));
+		float extremities[6] = { -v[0], v[2], v[0], -v[2], v[1], -v[1] };
+		float sts[6][2] = { { -v[2], -v[1] }, { -v[0], -v[1] }, { v[2], -v[1] }, { v[0], -v[1] }, { -v[0], -v[2] }, { -v[0], v[2] } };
+		for (int i = 0; i < 6; i++)
+		{
+			if (extremity == extremities[i])
+			{
+				st[0] = 0.5f*(sts[i][0]/extremity+1.0f);
+				st[1] = 0.5f*(sts[i][1]/extremity+1.0f);
+				face = i;
+				return;
+			}
+		}
+
+		st[0] = st[1] = 0.0f;
+		face = -1;
+	}
+
+	// As skybox_ps does, pulling each face's corners in
+	void FindSkyboxSt(const float v[3], float st[2], int& face)
+	{
+		float extremity = std::max(fabsf(v[0]), std::max(fabsf(v[1]), fabsf(v[2])));
+		float extremities[6] = { -v[0], v[2], v[0], -v[2], v[1], -v[1] };
+		float sts[6][2] = { { -v[2], -v[1] }, { -v[0], -v[1] }, { v[2], -v[1] }, { v[0], -v[1] }, { -v[0], -v[2] }, { -v[0], v[2] } };
+		for (int i = 0; i < 6; i++)
+		{
+			if (extremity == extremities[i])
+			{
+				float s = sts[i][0]/extremity, t = sts[i][1]/extremity;
+				float edge = std::max(fabsf(s), fabsf(t));
+				float edgeS = s/edge, edgeT = t/edge;
+				float proportion = sqrtf(s*s+t*t)/sqrtf(edgeS*edgeS+edgeT*edgeT);
+				float scale = sinf(proportion*PI/3.0f)/sinf(PI/3.0f);
+
+				st[0] = 0.5f*(scale*edgeS+1.0f);
+				st[1] = 0.5f*(scale*edgeT+1.0f);
+				face = i;
+				return;
+			}
+		}
+
+		st[0] = st[1] = 0.0f;
+		face = -1;
+	}
+
+	// NB: Must match EnvironmentProjection::encodeOctahedral/encodeParaboloid, as find_projection_st does
+	void FindProjectionSt(const float direction[3], float width, float projection, float st[2])
+	{
+		float v[3] = { direction[0], direction[1], direction[2] };
+		Normalize(v);
+		if (projection == 1.0f)
+		{
+			float sum = fabsf(v[0])+fabsf(v[1])+fabsf(v[2]);
+			float p[2] = { v[0]/sum, v[1]/sum };
+			if (v[2] < 0.0f)
+			{
+				float folded[2] = { (1.0f-fabsf(p[1]))*((p[0] >= 0.0f) ? 1.0f : -1.0f), (1.0f-fabsf(p[0]))*((p[1] >= 0.0f) ? 1.0f : -1.0f) };
+				p[0] = folded[0];
+				p[1] = folded[1];
+			}
+			st[0] = 0.5f*(p[0]+1.0f);
+			st[1] = 0.5f*(p[1]+1.0f);
+			return;
+		}
+
+		st[0] = 0.5f*(v[0]/(1.0f+fabsf(v[2]))+1.0f);
+		st[1] = 0.5f*(v[1]/(1.0f+fabsf(v[2]))+1.0f);
+		st[0] = std::min(std::max(0.5f*st[0], 0.5f/width), 0.5f-0.5f/width);
+		if (v[2] < 0.0f)
+			st[0] += 0.5f;
+	}
+
+	// HLSL's refract, which (as there) expects but doesn't insist on a normalised incident vector
+	void Refract(const float incident[3], const float normal[3], float eta, float refracted[3])
+	{
+		float d = Dot(incident, normal);
+		float k = 1.0f-eta*eta*(1.0f-d*d);
+		for (int j = 0; j < 3; j++)
+			refracted[j] = (k < 0.0f) ? 0.0f : eta*incident[j]-(eta*d+sqrtf(k))*normal[j];
+	}
+
+	// Six faces from slot, or a single target there, as the glass shaders sample them
+	void SampleEnvironment(const SoftwareRenderer::Material& material, int slot, const float v[3], float colour[4])
+	{
+		colour[0] = colour[1] = colour[2] = 0.0f;
+		colour[3] = 1.0f;
+
+		float st[2];
+		if (material.projection > 0.0f)
+		{
+			const SoftwareRenderer::Texture* texture = material.textures[slot];
+			if (texture)
+			{
+				FindProjectionSt(v, (float)texture->width, material.projection, st);
+				SoftwareRenderer::Sample(*texture, st[0], st[1], colour);
+			}
+			return;
+		}
+
+		int face;
+		FindEnvironmentSt(v, st, face);
+		if (face >= 0 && material.textures[slot+face])
+			SoftwareRenderer::Sample(*material.textures[slot+face], st[0], st[1], colour);
+	}
+
+	// Clips a polygon to where distance(vertex) >= 0, interpolating everything
+	int ClipPolygon(const float* in, int count, float* out, int floats, const std::function<float(const float*)>& distance)
+	{
+		int outCount = 0;
+		for (int i = 0; i < count; i++)
+		{
+			const float* a = &in[floats*i];
+			const float* b = &in[floats*((i+1)%count)];
+			float da = distance(a), db = distance(b);
+			if (da >= 0.0f)
+			{
+				std::copy(a, a+floats, &out[floats*outCount]);
+				outCount++;
+			}
+			if ((da >= 0.0f) != (db >= 0.0f))
+			{
+				float t = da/(da-db);
+				for (int k = 0; k < floats; k++)
+					out[floats*outCount+k] = a[k]+t*(b[k]-a[k]);
+				outCount++;
+			}
+		}
+
+		return outCount;
+	}
+
+	// Right-handed, as SimpleMath's CreateLookAt and CreatePerspectiveFieldOfView make them
+	void MakeView(const float eye[3], const float right[3], const float up[3], const float back[3], float view[16])
+	{
+		const float* axes[3] = { right, up, back };
+		for (int row = 0; row < 3; row++)
+		{
+			for (int column = 0; column < 3; column++)
+				view[4*row+column] = axes[column][row];
+			view[4*row+3] = 0.0f;
+		}
+		for (int column = 0; column < 3; column++)
+			view[12+column] = -Dot(axes[column], eye);
+		view[15] = 1.0f;
+	}
+
+	void MakeProjection(float fov, float aspectRatio, float nearPlane, float farPlane, float projection[16])
+	{
+		float yScale = 1.0f/tanf(0.5f*fov);
+		for (int i = 0; i < 16; i++)
+			projection[i] = 0.0f;
+		projection[0] = yScale/aspectRatio;
+		projection[5] = yScale;
+		projection[10] = farPlane/(nearPlane-farPlane);
+		projection[11] = -1.0f;
+		projection[14] = nearPlane*farPlane/(nearPlane-farPlane);
+	}
+
+	void MakeWorld(float scale, float x, float y, float z, float world[16])
+	{
+		for (int i = 0; i < 16; i++)
+			world[i] = (i%5 == 0) ? scale : 0.0f;
+		world[12] = x;
+		world[13] = y;
+		world[14] = z;
+		world[15] = 1.0f;
+	}
+
+	// Runs each pass as the graph schedules it; every texture is imported, so there is nothing to acquire
+	class SoftwareGraphBackend : public RenderGraphBackend
+	{
+	public:
+		RenderTexture*			acquire(int width, int height) override { return nullptr; }
+		void					release(RenderTexture* texture) override {}
+
+		void					beginPass(const std::string& name) override { m_passes.push_back(name); }
+		void					endPass() override {}
+
+		bool					getExecutes() override { return true; }
+
+		std::vector<std::string>	m_passes;
+	};
+}
+
+SoftwareRenderer::SoftwareRenderer()
+{
+	m_threadCount = 1;
+	m_target = nullptr;
+	for (int i = 0; i < 16; i++)
+		m_view[i] = m_projection[i] = (i%5 == 0) ? 1.0f : 0.0f;
+	m_cameraPosition[0] = m_cameraPosition[1] = m_cameraPosition[2] = 0.0f;
+	m_tilesX = 0;
+	m_tilesY = 0;
+	m_pixelCount = 0;
+}
+
+void SoftwareRenderer::setThreadCount(int threadCount)
+{
+	m_threadCount = std::max(1, threadCount);
+}
+
+void SoftwareRenderer::BeginPass(Texture* target, const float view[16], const float projection[16], const float cameraPosition[3], const float clear[4])
+{
+	m_target = target;
+	for (int i = 0; i < 16; i++)
+	{
+		m_view[i] = view[i];
+		m_projection[i] = projection[i];
+	}
+	for (int j = 0; j < 3; j++)
+		m_cameraPosition[j] = cameraPosition[j];
+
+	m_depth.assign(target->width*target->height, 1.0f);
+	if (clear)
+		for (int i = 0; i < target->width*target->height; i++)
+			std::copy(clear, clear+4, &target->texels[4*i]);
+
+	m_draws.clear();
+	m_triangles.clear();
+	m_pixelCount = 0;
+}
+
+void SoftwareRenderer::Draw(const float* vertices, int vertexCount, const float world[16], const Material& material, const Lighting& lighting)
+{
+	DrawCall draw;
+	draw.vertices = vertices;
+	draw.vertexCount = vertexCount;
+	std::copy(world, world+16, draw.world);
+	draw.material = material;
+	draw.lighting = lighting;
+	m_draws.push_back(draw);
+}
+
+void SoftwareRenderer::EndPass()
+{
+	// Draws' vertices shared between threads, each draw's triangles kept apart so they still bin in order
+	std::vector<std::vector<Triangle>> drawn(m_draws.size());
+	ParallelFor((int)m_draws.size(), m_threadCount, [&](int draw) { transformDraw(draw, drawn[draw]); });
+
+	m_triangles.clear();
+	for (int i = 0; i < (int)drawn.size(); i++)
+		m_triangles.insert(m_triangles.end(), drawn[i].begin(), drawn[i].end());
+
+	m_tilesX = (m_target->width+TileSize-1)/TileSize;
+	m_tilesY = (m_target->height+TileSize-1)/TileSize;
+	m_tiles.resize(m_tilesX*m_tilesY);
+	for (int i = 0; i < (int)m_tiles.size(); i++)
+		m_tiles[i].clear();
+	for (int t = 0; t < (int)m_triangles.size(); t++)
+	{
+		const Triangle& triangle = m_triangles[t];
+		for (int ty = triangle.minY/TileSize; ty <= triangle.maxY/TileSize; ty++)
+			for (int tx = triangle.minX/TileSize; tx <= triangle.maxX/TileSize; tx++)
+				m_tiles[ty*m_tilesX+tx].push_back(t);
+	}
+
+	// NB: Tiles share nothing they write, and each draws its triangles in order, so the result is the same on any number of threads
+	std::atomic<int> pixels(0);
+	ParallelFor((int)m_tiles.size(), m_threadCount, [&](int tile) { pixels += shadeTile(tile); });
+	m_pixelCount = pixels;
+}
+
+int SoftwareRenderer::getTriangleCount()
+{
+	return (int)m_triangles.size();
+}
+
+int SoftwareRenderer::getPixelCount()
+{
+	return m_pixelCount;
+}
+
+void SoftwareRenderer::makeTexture(int width, int height, const float colour[4], Texture& texture)
+{
+	texture.width = width;
+	texture.height = height;
+	texture.texels.resize(4*width*height);
+	for (int i = 0; i < width*height; i++)
+		std::copy(colour, colour+4, &texture.texels[4*i]);
+}
+
+void SoftwareRenderer::Sample(const Texture& texture, float s, float t, float colour[4])
+{
+	// NB: Coordinates the shaders make NaN of sample the first texel rather than trip the conversion
+	if (!std::isfinite(s) || !std::isfinite(t))
+		s = t = 0.0f;
+
+	float u = s*texture.width-0.5f, v = t*texture.height-0.5f;
+	float x = floorf(u), y = floorf(v);
+	float fx = u-x, fy = v-y;
+	int x0 = (int)fmodf(x, (float)texture.width), y0 = (int)fmodf(y, (float)texture.height);
+	if (x0 < 0)
+		x0 += texture.width;
+	if (y0 < 0)
+		y0 += texture.height;
+	int x1 = (x0+1)%texture.width, y1 = (y0+1)%texture.height;
+
+	const float* texels = texture.texels.data();
+	const float* c00 = &texels[4*(y0*texture.width+x0)];
+	const float* c10 = &texels[4*(y0*texture.width+x1)];
+	const float* c01 = &texels[4*(y1*texture.width+x0)];
+	const float* c11 = &texels[4*(y1*texture.width+x1)];
+	for (int k = 0; k < 4; k++)
+		colour[k] = (1.0f-fy)*((1.0f-fx)*c00[k]+fx*c10[k])+fy*((1.0f-fx)*c01[k]+fx*c11[k]);
+}
+
+void SoftwareRenderer::SampleSkybox(const Texture* const faces[6], const float direction[3], float colour[4])
+{
+	float st[2];
+	int face;
+	FindSkyboxSt(direction, st, face);
+	if (face >= 0 && faces[face])
+	{
+		Sample(*faces[face], st[0], st[1], colour);
+		return;
+	}
+
+	colour[0] = colour[1] = colour[2] = 0.0f;
+	colour[3] = 1.0f;
+}
+
+double SoftwareRenderer::comparePsnr(const Texture& a, const Texture& b)
+{
+	if (a.width != b.width || a.height != b.height)
+		return 0.0;
+
+	// Colour only; alpha isn't shown
+	double error = 0.0;
+	for (int i = 0; i < a.width*a.height; i++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			double difference = Saturate(a.texels[4*i+k])-Saturate(b.texels[4*i+k]);
+			error += difference*difference;
+		}
+	}
+	if (error == 0.0)
+		return INFINITY;
+
+	return -10.0*log10(error/(3.0*a.width*a.height));
+}
+
+bool SoftwareRenderer::savePpm(const Texture& texture, const std::string& filename)
+{
+	FILE* file = fopen(filename.c_str(), "wb");
+	if (!file)
+		return false;
+
+	fprintf(file, "P6\n%d %d\n255\n", texture.width, texture.height);
+	std::vector<unsigned char> bytes(3*texture.width*texture.height);
+	for (int i = 0; i < texture.width*texture.height; i++)
+		for (int k = 0; k < 3; k++)
+			bytes[3*i+k] = (unsigned char)(255.0f*Saturate(texture.texels[4*i+k])+0.5f);
+	bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	fclose(file);
+
+	return written;
+}
+
+bool SoftwareRenderer::loadPpm(const std::string& filename, Texture& texture)
+{
+	FILE* file = fopen(filename.c_str(), "rb");
+	if (!file)
+		return false;
+
+	int width = 0, height = 0, maximum = 0;
+	if (fscanf(file, "P6 %d %d %d", &width, &height, &maximum) != 3 || width <= 0 || height <= 0 || maximum != 255 || fgetc(file) == EOF)
+	{
+		fclose(file);
+		return false;
+	}
+
+	std::vector<unsigned char> bytes(3*width*height);
+	bool read = fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	fclose(file);
+	if (!read)
+		return false;
+
+	const float opaque[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	makeTexture(width, height, opaque, texture);
+	for (int i = 0; i < width*height; i++)
+		for (int k = 0; k < 3; k++)
+			texture.texels[4*i+k] = bytes[3*i+k]/255.0f;
+
+	return true;
+}
+
+bool SoftwareRenderer::readTexels(int format, const void* data, int rowPitch, int width, int height, Texture& texture)
+{
+	// DXGI_FORMAT_R32G32B32A32_FLOAT, R8G8B8A8_UNORM(_SRGB), B8G8R8A8_UNORM/B8G8R8X8_UNORM and BC1_UNORM(_SRGB)
+	const unsigned char* bytes = (const unsigned char*)data;
+	const float opaque[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	if (format == 2)
+	{
+		makeTexture(width, height, opaque, texture);
+		for (int y = 0; y < height; y++)
+			std::copy((const float*)(bytes+y*rowPitch), (const float*)(bytes+y*rowPitch)+4*width, &texture.texels[4*width*y]);
+		return true;
+	}
+
+	if (format == 28 || format == 29 || format == 87 || format == 88)
+	{
+		// NB: sRGB is left encoded, where the shaders would see it linearised
+		bool bgra = format >= 87;
+		makeTexture(width, height, opaque, texture);
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				const unsigned char* texel = bytes+y*rowPitch+4*x;
+				float* colour = &texture.texels[4*(width*y+x)];
+				colour[0] = texel[(bgra) ? 2 : 0]/255.0f;
+				colour[1] = texel[1]/255.0f;
+				colour[2] = texel[(bgra) ? 0 : 2]/255.0f;
+				colour[3] = (format == 88) ? 1.0f : texel[3]/255.0f;
+			}
+		}
+		return true;
+	}
+
+	if (format == 71 || format == 72)
+	{
+		// Blocks of 4x4 texels: two RGB565 endpoints, then two bits a texel choosing between them and the colours between
+		makeTexture(width, height, opaque, texture);
+		for (int by = 0; by < (height+3)/4; by++)
+		{
+			for (int bx = 0; bx < (width+3)/4; bx++)
+			{
+				const unsigned char* block = bytes+by*rowPitch+8*bx;
+				int endpoints[2] = { block[0] | (block[1] << 8), block[2] | (block[3] << 8) };
+				float palette[4][4];
+				for (int e = 0; e < 2; e++)
+				{
+					palette[e][0] = ((endpoints[e] >> 11) & 31)/31.0f;
+					palette[e][1] = ((endpoints[e] >> 5) & 63)/63.0f;
+					palette[e][2] = (endpoints[e] & 31)/31.0f;
+					palette[e][3] = 1.0f;
+				}
+				for (int k = 0; k < 4; k++)
+				{
+					if (endpoints[0] > endpoints[1])
+					{
+						palette[2][k] = (2.0f*palette[0][k]+palette[1][k])/3.0f;
+						palette[3][k] = (palette[0][k]+2.0f*palette[1][k])/3.0f;
+					}
+					else
+					{
+						palette[2][k] = 0.5f*(palette[0][k]+palette[1][k]);
+						palette[3][k] = 0.0f;
+					}
+				}
+
+				unsigned int indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((unsigned int)block[7] << 24);
+				for (int i = 0; i < 16; i++)
+				{
+					int x = 4*bx+i%4, y = 4*by+i/4;
+					if (x < width && y < height)
+						std::copy(palette[(indices >> 2*i) & 3], palette[(indices >> 2*i) & 3]+4, &texture.texels[4*(width*y+x)]);
+				}
+			}
+		}
+		return true;
+	}
+
+	return false;
+}
+
+bool SoftwareRenderer::benchmark(const std::vector<float>& sphere, const std::vector<float>& cube, int width, int height, const std::vector<int>& threadCounts, int frames, std::string& report)
+{
+	// Textures: a checked base, flat normals, tinted glass, and a skybox that is a different colour each way
+	const float flat[4] = { 0.5f, 0.5f, 1.0f, 1.0f }, glassColour[4] = { 0.8f, 0.9f, 1.0f, 1.0f }, clear[4] = { 0.0f, 0.0f, 0.0f, 1.0f }, alphaColour[4] = { 0.25f, 0.25f, 0.25f, 1.0f };
+	Texture checker, normals, glass, alpha, sky[6];
+	makeTexture(64, 64, flat, checker);
+	for (int y = 0; y < 64; y++)
+	{
+		for (int x = 0; x < 64; x++)
+		{
+			float shade = (((x/8)+(y/8))%2) ? 0.9f : 0.3f;
+			float colour[4] = { shade, 0.6f*shade, 0.4f*shade, 1.0f };
+			std::copy(colour, colour+4, &checker.texels[4*(64*y+x)]);
+		}
+	}
+	makeTexture(1, 1, flat, normals);
+	makeTexture(1, 1, glassColour, glass);
+	makeTexture(1, 1, alphaColour, alpha);
+	for (int f = 0; f < 6; f++)
+	{
+		makeTexture(32, 32, clear, sky[f]);
+		for (int y = 0; y < 32; y++)
+		{
+			for (int x = 0; x < 32; x++)
+			{
+				float colour[4] = { 0.2f+0.1f*f, 0.4f+0.5f*y/32.0f, 0.9f-0.1f*f, 1.0f };
+				std::copy(colour, colour+4, &sky[f].texels[4*(32*y+x)]);
+			}
+		}
+	}
+
+	Lighting lighting = { { 0.2f, 0.2f, 0.2f, 1.0f }, { 1.0f, 1.0f, 1.0f, 1.0f }, { 0.0f, 3.0f, 3.0f }, 10.0f };
+	Material skybox = {}, lit = {}, specimen = {}, refraction = {}, overlay = {};
+	skybox.shading = Skybox;
+	skybox.cull = CullCounterClockwise;
+	for (int f = 0; f < 6; f++)
+		skybox.textures[f] = &sky[f];
+	lit.shading = Light;
+	lit.textures[0] = &checker;
+	lit.textures[1] = &normals;
+	lit.cull = CullClockwise;
+	lit.depthTest = true;
+
+	// Glass sampling the capture, then a specimen inside it sampling the last frame, and an overlay over both
+	int faceSize = std::max(16, height/4);
+	Texture faces[6], frame, previous, overlaid;
+	for (int f = 0; f < 6; f++)
+		makeTexture(faceSize, faceSize, clear, faces[f]);
+	makeTexture(width, height, clear, frame);
+	makeTexture(width, height, clear, previous);
+	makeTexture(width, height, clear, overlaid);
+
+	refraction.shading = Glass;
+	refraction.textures[0] = &glass;
+	refraction.textures[1] = &normals;
+	for (int f = 0; f < 6; f++)
+		refraction.textures[2+f] = refraction.textures[8+f] = &faces[f];
+	refraction.opacity = 0.1f;
+	refraction.refractiveIndex = 1.0f/1.5f;
+	refraction.culling = 1.0f;
+	refraction.cull = CullClockwise;
+	refraction.depthTest = true;
+	specimen.shading = Specimen;
+	specimen.textures[0] = &checker;
+	specimen.textures[1] = &normals;
+	specimen.textures[2] = &previous;
+	specimen.opacity = 0.5f;
+	specimen.cull = CullClockwise;
+	specimen.depthTest = true;
+	overlay.shading = Overlay;
+	overlay.textures[0] = &frame;
+	overlay.textures[1] = &checker;
+	overlay.textures[2] = &alpha;
+	overlay.cull = CullClockwise;
+
+	// A ring of lit spheres around the glass, seen from above and behind
+	std::vector<std::vector<float>> spheres;
+	for (int i = 0; i < 8; i++)
+	{
+		float world[16];
+		MakeWorld(0.5f, 2.5f*cosf(0.25f*PI*i), 0.3f*sinf(0.5f*PI*i), 2.5f*sinf(0.25f*PI*i), world);
+		spheres.push_back(std::vector<float>(world, world+16));
+	}
+	float identity[16], specimenWorld[16], origin[3] = { 0.0f, 0.0f, 0.0f };
+	MakeWorld(1.0f, 0.0f, 0.0f, 0.0f, identity);
+	MakeWorld(0.35f, 0.0f, 0.0f, 0.0f, specimenWorld);
+
+	// Capture faces laid out as find_environment_st expects; the up and down faces come out mirrored, so cull the other way, as Game's reflected cameras do
+	const float rights[6][3] = { { 0, 0, -1 }, { -1, 0, 0 }, { 0, 0, 1 }, { 1, 0, 0 }, { -1, 0, 0 }, { -1, 0, 0 } };
+	const float ups[6][3] = { { 0, 1, 0 }, { 0, 1, 0 }, { 0, 1, 0 }, { 0, 1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+	const float backs[6][3] = { { 1, 0, 0 }, { 0, 0, -1 }, { -1, 0, 0 }, { 0, 0, 1 }, { 0, -1, 0 }, { 0, 1, 0 } };
+	float faceProjection[16], mainView[16], mainProjection[16];
+	MakeProjection(0.5f*PI, 1.0f, 0.01f, 100.0f, faceProjection);
+	const float eye[3] = { 0.0f, 1.5f, -4.0f }, right[3] = { -1.0f, 0.0f, 0.0f }, up[3] = { 0.0f, 0.93632918f, 0.35112344f }, back[3] = { 0.0f, 0.35112344f, -0.93632918f };
+	MakeView(eye, right, up, back, mainView);
+	MakeProjection(0.25f*PI, (float)width/height, 0.01f, 100.0f, mainProjection);
+
+	float eyeWorld[16];
+	MakeWorld(1.0f, eye[0], eye[1], eye[2], eyeWorld);
+	int sphereCount = (int)sphere.size()/VertexFloats, cubeCount = (int)cube.size()/VertexFloats;
+
+	// NB: Passes are declared to a RenderGraph, as Game declares its own, and run in the order it schedules them.
+	// Last frame's image is read by the scene but only copied after the graph has run, as a write in it would have the scene wait on itself
+	RenderGraph graph;
+	SoftwareGraphBackend backend;
+	auto renderFrame = [&](SoftwareRenderer& renderer) {
+		int triangles = 0;
+		graph.Reset();
+		int capture = graph.importTexture("Capture", faceSize, faceSize, 6, 4*sizeof(float)*faceSize*faceSize, nullptr);
+		int history = graph.importTexture("Previous frame", width, height, 1, 4*sizeof(float)*width*height, nullptr);
+		int scene = graph.importTexture("Frame", width, height, 1, 4*sizeof(float)*width*height, nullptr);
+		int output = graph.importTexture("Overlaid", width, height, 1, 4*sizeof(float)*width*height, nullptr);
+		graph.markOutput(output);
+
+		int pass = graph.addPass("Capture", [&]() {
+			for (int f = 0; f < 6; f++)
+			{
+				float view[16];
+				MakeView(origin, rights[f], ups[f], backs[f], view);
+				Material faceSkybox = skybox, faceLit = lit;
+				if (f >= 4)
+				{
+					faceSkybox.cull = CullClockwise;
+					faceLit.cull = CullCounterClockwise;
+				}
+
+				renderer.BeginPass(&faces[f], view, faceProjection, origin, clear);
+				renderer.Draw(cube.data(), cubeCount, identity, faceSkybox, lighting);
+				for (int i = 0; i < (int)spheres.size(); i++)
+					renderer.Draw(sphere.data(), sphereCount, spheres[i].data(), faceLit, lighting);
+				renderer.EndPass();
+			}
+		});
+		graph.write(pass, capture);
+
+		pass = graph.addPass("Scene", [&]() {
+			renderer.BeginPass(&frame, mainView, mainProjection, eye, clear);
+			renderer.Draw(cube.data(), cubeCount, eyeWorld, skybox, lighting);
+			for (int i = 0; i < (int)spheres.size(); i++)
+				renderer.Draw(sphere.data(), sphereCount, spheres[i].data(), lit, lighting);
+			renderer.Draw(cube.data(), cubeCount, specimenWorld, specimen, lighting);
+			renderer.Draw(sphere.data(), sphereCount, identity, refraction, lighting);
+			renderer.EndPass();
+			triangles = renderer.getTriangleCount();
+		});
+		graph.read(pass, capture);
+		graph.read(pass, history);
+		graph.write(pass, scene);
+
+		pass = graph.addPass("Overlay", [&]() {
+			overlaid.texels = frame.texels;
+			renderer.BeginPass(&overlaid, mainView, mainProjection, eye, nullptr);
+			renderer.Draw(sphere.data(), sphereCount, identity, overlay, lighting);
+			renderer.EndPass();
+		});
+		graph.read(pass, scene);
+		graph.write(pass, output);
+
+		graph.Compile();
+		graph.Execute(&backend);
+
+		previous.texels = frame.texels;
+		return triangles;
+	};
+
+	char line[256];
+	report = "Software rendering " + std::to_string(width) + "x" + std::to_string(height) + " (six " + std::to_string(faceSize) + "x" + std::to_string(faceSize) + " faces, then the scene and an overlay), on " + std::to_string(std::thread::hardware_concurrency()) + " hardware thread(s):\n";
+	int passCount = 0;
+	double singleTime = 0.0;
+	Texture first;
+	bool passed = sphere.size() > 0 && cube.size() > 0;
+	for (int c = 0; c < (int)threadCounts.size(); c++)
+	{
+		SoftwareRenderer renderer;
+		renderer.setThreadCount(threadCounts[c]);
+		std::fill(previous.texels.begin(), previous.texels.end(), 0.0f);
+
+		int triangles = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		backend.m_passes.clear();
+		for (int f = 0; f < frames; f++)
+			triangles = renderFrame(renderer);
+		auto end = std::chrono::high_resolution_clock::now();
+		passCount = (int)backend.m_passes.size();
+		double time = std::chrono::duration<double>(end-start).count()/frames;
+		if (c == 0)
+		{
+			singleTime = time;
+			first = overlaid;
+		}
+
+		// NB: Tiles never share texels, so however many threads draw them the image must come out the same
+		double psnr = comparePsnr(first, overlaid);
+		passed = passed && triangles > 0 && psnr == INFINITY;
+
+		snprintf(line, sizeof(line), "  %2d thread(s): %8.2fms a frame, %6.2f fps (%.2fx), %d triangles in the scene, PSNR against the first %.1f dB\n",
+			threadCounts[c], 1000.0*time, 1.0/time, singleTime/time, triangles, psnr);
+		report += line;
+	}
+
+	// Each frame must have run all three passes, the capture first, as nothing else could be scheduled
+	std::string schedule;
+	for (int i = 0; i < (int)backend.m_passes.size() && i < 3; i++)
+		schedule += ((i > 0) ? ", " : "") + backend.m_passes[i];
+	passed = passed && passCount == 3*frames && graph.getScheduledPassCount() == 3 && schedule == "Capture, Scene, Overlay";
+	report += "  Passes run as RenderGraph scheduled them: " + schedule + " (" + std::to_string(passCount) + " over " + std::to_string(frames) + " frame(s))\n";
+
+	return passed;
+}
+
+void SoftwareRenderer::transformDraw(int draw, std::vector<Triangle>& triangles)
+{
+	const DrawCall& call = m_draws[draw];
+	float viewProjection[16], worldViewProjection[16];
+	Multiply(m_view, m_projection, viewProjection);
+	Multiply(call.world, viewProjection, worldViewProjection);
+	const float* world = call.world;
+
+	// As the vertex shaders do
+	std::vector<Vertex> vertices(call.vertexCount);
+	for (int i = 0; i < call.vertexCount; i++)
+	{
+		const float* in = &call.vertices[VertexFloats*i];
+		Vertex& vertex = vertices[i];
+		for (int j = 0; j < 4; j++)
+			vertex.clip[j] = in[0]*worldViewProjection[j]+in[1]*worldViewProjection[4+j]+in[2]*worldViewProjection[8+j]+worldViewProjection[12+j];
+
+		float* attributes = vertex.attributes;
+		attributes[TextureAttribute] = in[3];
+		attributes[TextureAttribute+1] = in[4];
+		for (int j = 0; j < 3; j++)
+		{
+			attributes[WorldAttribute+j] = in[0]*world[j]+in[1]*world[4+j]+in[2]*world[8+j]+world[12+j];
+			attributes[ModelAttribute+j] = in[j];
+			attributes[NormalAttribute+j] = in[5]*world[j]+in[6]*world[4+j]+in[7]*world[8+j];
+			attributes[TangentAttribute+j] = in[8]*world[j]+in[9]*world[4+j]+in[10]*world[8+j];
+			attributes[BinormalAttribute+j] = in[11]*world[j]+in[12]*world[4+j]+in[13]*world[8+j];
+		}
+		Normalize(&attributes[NormalAttribute]);
+		Normalize(&attributes[TangentAttribute]);
+		Normalize(&attributes[BinormalAttribute]);
+	}
+
+	// Clipped to the near and far planes; the rest only need the screen bounds
+	const int floats = 4+AttributeFloats;
+	for (int i = 0; i+2 < call.vertexCount; i += 3)
+	{
+		const Vertex* corners = &vertices[i];
+		bool inside = true;
+		for (int k = 0; k < 3; k++)
+			inside = inside && corners[k].clip[2] >= 0.0f && corners[k].clip[2] <= corners[k].clip[3];
+		if (inside)
+		{
+			setupTriangle(draw, corners, triangles);
+			continue;
+		}
+
+		// Polygons are clipped as rows of floats, clip position first
+		float polygon[5*floats], clipped[5*floats];
+		for (int k = 0; k < 3; k++)
+		{
+			std::copy(corners[k].clip, corners[k].clip+4, &polygon[floats*k]);
+			std::copy(corners[k].attributes, corners[k].attributes+AttributeFloats, &polygon[floats*k+4]);
+		}
+		int count = ClipPolygon(polygon, 3, clipped, floats, [](const float* v) { return v[2]; });
+		count = ClipPolygon(clipped, count, polygon, floats, [](const float* v) { return v[3]-v[2]; });
+
+		for (int k = 1; k+1 < count; k++)
+		{
+			Vertex fan[3];
+			const int corner[3] = { 0, k, k+1 };
+			for (int c = 0; c < 3; c++)
+			{
+				const float* row = &polygon[floats*corner[c]];
+				std::copy(row, row+4, fan[c].clip);
+				std::copy(row+4, row+floats, fan[c].attributes);
+			}
+			setupTriangle(draw, fan, triangles);
+		}
+	}
+}
+
+void SoftwareRenderer::setupTriangle(int draw, const Vertex vertices[3], std::vector<Triangle>& triangles)
+{
+	const Material& material = m_draws[draw].material;
+
+	Triangle triangle;
+	triangle.draw = draw;
+	float x[3], y[3];
+	int order[3] = { 0, 1, 2 };
+	for (int v = 0; v < 3; v++)
+	{
+		if (vertices[v].clip[3] <= 0.0f)
+			return;
+
+		float inverseW = 1.0f/vertices[v].clip[3];
+		x[v] = (0.5f+0.5f*vertices[v].clip[0]*inverseW)*m_target->width;
+		y[v] = (0.5f-0.5f*vertices[v].clip[1]*inverseW)*m_target->height;
+	}
+
+	// Positive is clockwise on screen, as y runs down it
+	float area = (x[1]-x[0])*(y[2]-y[0])-(x[2]-x[0])*(y[1]-y[0]);
+	if (fabsf(area) < 1e-8f)
+		return;
+	if ((material.cull == CullClockwise && area > 0.0f) || (material.cull == CullCounterClockwise && area < 0.0f))
+		return;
+	if (area < 0.0f)
+	{
+		std::swap(x[1], x[2]);
+		std::swap(y[1], y[2]);
+		std::swap(order[1], order[2]);
+		area = -area;
+	}
+
+	triangle.minX = (int)std::max(0.0f, floorf(std::min(x[0], std::min(x[1], x[2]))));
+	triangle.maxX = (int)std::min((float)(m_target->width-1), floorf(std::max(x[0], std::max(x[1], x[2]))));
+	triangle.minY = (int)std::max(0.0f, floorf(std::min(y[0], std::min(y[1], y[2]))));
+	triangle.maxY = (int)std::min((float)(m_target->height-1), floorf(std::max(y[0], std::max(y[1], y[2]))));
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+		return;
+
+	for (int i = 0; i < 3; i++)
+	{
+		int j = (i+1)%3;
+		triangle.edgeA[i] = y[i]-y[j];
+		triangle.edgeB[i] = x[j]-x[i];
+		triangle.edgeC[i] = -(triangle.edgeA[i]*x[i]+triangle.edgeB[i]*y[i]);
+	}
+	triangle.inverseArea = 1.0f/area;
+
+	for (int v = 0; v < 3; v++)
+	{
+		const Vertex& vertex = vertices[order[v]];
+		triangle.inverseW[v] = 1.0f/vertex.clip[3];
+		triangle.depth[v] = vertex.clip[2]*triangle.inverseW[v];
+		for (int k = 0; k < AttributeFloats; k++)
+			triangle.attributes[v][k] = vertex.attributes[k]*triangle.inverseW[v];
+	}
+
+	triangles.push_back(triangle);
+}
+
+int SoftwareRenderer::shadeTile(int tile)
+{
+	int tileX = (tile%m_tilesX)*TileSize, tileY = (tile/m_tilesX)*TileSize;
+	int pixels = 0;
+	for (int i = 0; i < (int)m_tiles[tile].size(); i++)
+	{
+		const Triangle& triangle = m_triangles[m_tiles[tile][i]];
+		const DrawCall& draw = m_draws[triangle.draw];
+		int minX = std::max(triangle.minX, tileX), maxX = std::min(triangle.maxX, tileX+TileSize-1);
+		int minY = std::max(triangle.minY, tileY), maxY = std::min(triangle.maxY, tileY+TileSize-1);
+
+		for (int y = minY; y <= maxY; y++)
+		{
+			float py = (float)y+0.5f;
+			for (int x = minX; x <= maxX; x++)
+			{
+				float px = (float)x+0.5f;
+				float edges[3];
+				for (int e = 0; e < 3; e++)
+					edges[e] = triangle.edgeA[e]*px+triangle.edgeB[e]*py+triangle.edgeC[e];
+				if (edges[0] < 0.0f || edges[1] < 0.0f || edges[2] < 0.0f)
+					continue;
+
+				// Each vertex's weight is the edge opposite it
+				float weights[3] = { edges[1]*triangle.inverseArea, edges[2]*triangle.inverseArea, edges[0]*triangle.inverseArea };
+				float depth = weights[0]*triangle.depth[0]+weights[1]*triangle.depth[1]+weights[2]*triangle.depth[2];
+				int pixel = y*m_target->width+x;
+				if (draw.material.depthTest)
+				{
+					if (depth > m_depth[pixel])
+						continue;
+					m_depth[pixel] = depth;
+				}
+
+				// Perspective-correct, as the rasteriser interpolates
+				float inverseW = weights[0]*triangle.inverseW[0]+weights[1]*triangle.inverseW[1]+weights[2]*triangle.inverseW[2];
+				float attributes[AttributeFloats];
+				for (int k = 0; k < AttributeFloats; k++)
+					attributes[k] = (weights[0]*triangle.attributes[0][k]+weights[1]*triangle.attributes[1][k]+weights[2]*triangle.attributes[2][k])/inverseW;
+
+				shade(draw, attributes, px, py, &m_target->texels[4*pixel]);
+				pixels++;
+			}
+		}
+	}
+
+	return pixels;
+}
+
+void SoftwareRenderer::shade(const DrawCall& draw, const float attributes[AttributeFloats], float x, float y, float colour[4])
+{
+	const Material& material = draw.material;
+	const Lighting& lighting = draw.lighting;
+	const float zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float screen[2] = { x/m_target->width, y/m_target->height };
+	auto sample = [&](int slot, float s, float t, float result[4]) {
+		if (material.textures[slot])
+			Sample(*material.textures[slot], s, t, result);
+		else
+			std::copy(zero, zero+4, result);
+	};
+
+	if (material.shading == Overlay)
+	{
+		float textureColour[4], overlayColour[4], overlayAlpha[4];
+		sample(0, screen[0], screen[1], textureColour);
+		sample(1, screen[0], screen[1], overlayColour);
+		sample(2, screen[0], screen[1], overlayAlpha);
+		for (int k = 0; k < 4; k++)
+			colour[k] = (1.0f-overlayAlpha[0])*textureColour[k]+overlayAlpha[0]*overlayColour[k];
+		return;
+	}
+
+	if (material.shading == Skybox)
+	{
+		SampleSkybox(material.textures, &attributes[ModelAttribute], colour);
+		return;
+	}
+
+	// STEPS 1-3, shared by every lit shader: base colour, normal-mapped normal and the point light
+	float textureColour[4], normalMap[4];
+	sample(0, attributes[TextureAttribute], attributes[TextureAttribute+1], textureColour);
+	sample(1, attributes[TextureAttribute], attributes[TextureAttribute+1], normalMap);
+
+	float normal[3];
+	for (int j = 0; j < 3; j++)
+		normal[j] = (2.0f*normalMap[0]-1.0f)*attributes[TangentAttribute+j]+(2.0f*normalMap[1]-1.0f)*attributes[BinormalAttribute+j]+(2.0f*normalMap[2]-1.0f)*attributes[NormalAttribute+j];
+	Normalize(normal);
+	if (material.shading == Refraction || material.shading == Glass)
+		for (int j = 0; j < 3; j++)
+			normal[j] *= material.culling;
+
+	const float* position = &attributes[WorldAttribute];
+	float lightDirection[3] = { position[0]-lighting.position[0], position[1]-lighting.position[1], position[2]-lighting.position[2] };
+	float lightDistance = std::max(sqrtf(Dot(lightDirection, lightDirection)), sqrtf(lighting.strength));
+	Normalize(lightDirection);
+	float lightIntensity = lighting.strength*Saturate(-Dot(normal, lightDirection))/(lightDistance*lightDistance);
+	float lightColour[4];
+	for (int k = 0; k < 4; k++)
+		lightColour[k] = Saturate(lighting.ambient[k]+lighting.diffuse[k]*lightIntensity);
+
+	float mixed[4];
+	if (material.shading == Light)
+	{
+		std::copy(textureColour, textureColour+4, mixed);
+	}
+	else if (material.shading == Specimen)
+	{
+		float specimenColour[4];
+		sample(2, screen[0], screen[1], specimenColour);
+		for (int k = 0; k < 4; k++)
+			mixed[k] = material.opacity*textureColour[k]+(1.0f-material.opacity)*specimenColour[k];
+	}
+	else
+	{
+		float incident[3] = { position[0]-m_cameraPosition[0], position[1]-m_cameraPosition[1], position[2]-m_cameraPosition[2] };
+		float refracted[3], refractionColour[4];
+		Refract(incident, normal, material.refractiveIndex, refracted);
+		SampleEnvironment(material, 2, refracted, refractionColour);
+
+		float environmentColour[4];
+		std::copy(refractionColour, refractionColour+4, environmentColour);
+		if (material.shading == Glass)
+		{
+			float reflected[3], reflectionColour[4];
+			float d = -Dot(normal, incident);
+			for (int j = 0; j < 3; j++)
+				reflected[j] = 2.0f*d*normal[j]+incident[j];
+			SampleEnvironment(material, 8, reflected, reflectionColour);
+
+			// Fresnel, with both indices 1.00 as glass_ps has them
+			float ior = 1.0f, etai = 1.0f, etat = ior;
+			float cosi = std::max(-1.0f, std::min(1.0f, Dot(incident, normal)));
+			if (cosi > 0.0f)
+			{
+				etai = ior;
+				etat = 1.0f;
+			}
+			float sint = etai/etat*sqrtf(std::max(0.0f, 1.0f-cosi*cosi));
+			float kr = 1.0f;
+			if (sint < 1.0f)
+			{
+				float cost = sqrtf(std::max(0.0f, 1.0f-sint*sint));
+				cosi = fabsf(cosi);
+				float rs = ((etat*cosi)-(etai*cost))/((etat*cosi)+(etai*cost));
+				float rp = ((etai*cosi)-(etat*cost))/((etai*cosi)+(etat*cost));
+				kr = 0.5f*(rs*rs+rp*rp);
+			}
+
+			for (int k = 0; k < 4; k++)
+				environmentColour[k] = (1.0f-kr)*refractionColour[k]+kr*reflectionColour[k];
+		}
+
+		for (int k = 0; k < 4; k++)
+			mixed[k] = material.opacity*textureColour[k]+(1.0f-material.opacity)*environmentColour[k];
+	}
+
+	for (int k = 0; k < 4; k++)
+		colour[k] = lightColour[k]*mixed[k];
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Rasterises meshes on the CPU with the same shading as the pixel shaders (light_ps, specimen_ps, refraction_ps, glass_ps, overlay_ps and skybox_ps),
+// for reference frames and offline captures where there is no GPU. Draws are collected for a pass, then its screen tiles are shaded in parallel.
+// Matrices are row-major (SimpleMath) with row vectors, and depth is Direct3D's, as the vertex shaders leave it.
+// NB: Its passes are issued by its callers: the baker, benchmark below (scheduled by a RenderGraph, as Game's are), and Game's -reference run, which compares its faces with the GPU's
+class SoftwareRenderer
+{
+public:
+	static const int				TileSize = 32;		// Pixels along each side of a tile
+	static const int				VertexFloats = 14;	// Position, texture, normal, tangent and binormal, as ModelClass::GetVertices gives them
+
+	// RGBA floats, row by row, as RenderTexture's targets are; sampled bilinearly and wrapping, as Shader's sampler does (but from the top level only)
+	struct Texture
+	{
+		int					width;
+		int					height;
+		std::vector<float>	texels;
+	};
+
+	enum Shading
+	{
+		Light,
+		Specimen,
+		Refraction,
+		Glass,
+		Overlay,
+		Skybox,
+	};
+
+	// As CommonStates names them; clockwise on screen is front-facing
+	enum Cull
+	{
+		CullNone,
+		CullClockwise,
+		CullCounterClockwise,
+	};
+
+	// LightBuffer
+	struct Lighting
+	{
+		float	ambient[4];
+		float	diffuse[4];
+		float	position[3];
+		float	strength;
+	};
+
+	// Everything else a draw's shaders read, in the slots they read it from
+	// NB: Environment maps are six faces from slot 2 (and 8, for glass's reflections) unless projection says they are a single target
+	struct Material
+	{
+		Shading			shading;
+		const Texture*	textures[14];
+		float			opacity;
+		float			refractiveIndex;
+		float			culling;		// 1, or -1 to turn normals inward (RefractionBuffer)
+		float			projection;		// 0: six faces, 1: octahedral, 2: dual paraboloid (see EnvironmentProjection)
+		Cull			cull;
+		bool			depthTest;		// Less-equal, writing depth as it goes; otherwise neither
+	};
+
+	SoftwareRenderer();
+
+	void							setThreadCount(int threadCount);
+
+	// One target per pass, its depth cleared at the start; clear may be null to draw over what is there
+	void							BeginPass(Texture* target, const float view[16], const float projection[16], const float cameraPosition[3], const float clear[4]);
+	void							Draw(const float* vertices, int vertexCount, const float world[16], const Material& material, const Lighting& lighting);	// A triangle list; the arrays must outlive the pass
+	void							EndPass();		// Shades every draw, in order, tile by tile
+
+	int								getTriangleCount();		// Shaded in the last pass, after clipping and culling
+	int								getPixelCount();
+
+	static void						makeTexture(int width, int height, const float colour[4], Texture& texture);
+	static void						Sample(const Texture& texture, float s, float t, float colour[4]);
+	static void						SampleSkybox(const Texture* const faces[6], const float direction[3], float colour[4]);		// As skybox_ps does; opaque black where a face is missing
+	static double					comparePsnr(const Texture& a, const Texture& b);	// In decibels over [0, 1], or infinity if identical
+	static bool						savePpm(const Texture& texture, const std::string& filename);	// Clamped to 8 bits, for comparing against captures from the GPU
+	static bool						loadPpm(const std::string& filename, Texture& texture);
+	static bool						readTexels(int format, const void* data, int rowPitch, int width, int height, Texture& texture);	// From a mapped DXGI format: RGBA floats, RGBA or BGRA bytes, or BC1. False if another
+
+	// Runs a frame of the game's passes (six capture faces, the scene with glass sampling them, then an overlay) through a RenderGraph, frames times for each thread count.
+	// False if nothing was drawn, the graph ran other than those three passes in that order, or any thread count's image differs from the first's
+	static bool						benchmark(const std::vector<float>& sphere, const std::vector<float>& cube, int width, int height, const std::vector<int>& threadCounts, int frames, std::string& report);
+
+private:
+	static const int				AttributeFloats = 17;	// Texture, world position, model position, normal, tangent, binormal
+
+	struct Vertex
+	{
+		float	clip[4];
+		float	attributes[AttributeFloats];
+	};
+
+	struct DrawCall
+	{
+		const float*	vertices;
+		int				vertexCount;
+		float			world[16];
+		Material		material;
+		Lighting		lighting;
+	};
+
+	// Ready to rasterise: screen bounds, edge functions (inside where all three are >= 0), and attributes over w at each vertex
+	struct Triangle
+	{
+		int		draw;
+		int		minX, minY, maxX, maxY;
+		float	edgeA[3], edgeB[3], edgeC[3];
+		float	inverseArea;
+		float	depth[3];
+		float	inverseW[3];
+		float	attributes[3][AttributeFloats];
+	};
+
+	void							transformDraw(int draw, std::vector<Triangle>& triangles);
+	void							setupTriangle(int draw, const Vertex vertices[3], std::vector<Triangle>& triangles);
+	int								shadeTile(int tile);		// Returns pixels shaded
+	void							shade(const DrawCall& draw, const float attributes[AttributeFloats], float x, float y, float colour[4]);
+
+	int								m_threadCount;
+	Texture*						m_target;
+	float							m_view[16];
+	float							m_projection[16];
+	float							m_cameraPosition[3];
+	std::vector<float>				m_depth;
+	std::vector<DrawCall>			m_draws;
+	std::vector<Triangle>			m_triangles;		// In draw order
+	std::vector<std::vector<int>>	m_tiles;			// Indices: tile, row by row; values: triangles touching it, in draw order
+	int								m_tilesX;
+	int								m_tilesY;
+	int								m_pixelCount;
+};
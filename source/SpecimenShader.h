@@ -4,8 +4,11 @@
 class SpecimenShader : public LightShader
 {
 public:
-	bool InitSpecimenShader(ID3D11Device* device, WCHAR* vsFilename, WCHAR* psFilename);
-	bool SetSpecimenShaderParameters(ID3D11DeviceContext* context,
+	SpecimenShader();
+
+	bool InitSpecimenShader(RenderDevice* device, WCHAR* vsFilename, WCHAR* psFilename);
+	void Shutdown() override;
+	bool SetSpecimenShaderParameters(RenderContext* context,
 		DirectX::SimpleMath::Matrix* world,
 		DirectX::SimpleMath::Matrix* view,
 		DirectX::SimpleMath::Matrix* projection,
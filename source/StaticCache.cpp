@@ -0,0 +1,379 @@
+#include "pch.h"
+#include "StaticCache.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+namespace
+{
+	const int FileVersion = 1;
+	const int MinRun = 3;		// Repeats shorter than this are cheaper as literals
+	const int MaxRun = 130;
+	const int MaxLiterals = 128;
+
+	// Runs work(0..count-1) on threadCount threads, each taking the next index as it finishes the last
+	void ParallelFor(int count, int threadCount, const std::function<void(int)>& work)
+	{
+		std::atomic<int> next(0);
+		auto run = [&]() {
+			for (int i = next++; i < count; i = next++)
+				work(i);
+		};
+
+		std::vector<std::thread> threads;
+		for (int t = 1; t < std::min(threadCount, count); t++)
+			threads.emplace_back(run);
+		run();
+
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+
+	// The most a texture of this many floats can pack to: every byte a literal, plus a control byte for each run of them
+	size_t GetMaxPackedBytes(size_t floats)
+	{
+		size_t bytes = floats*sizeof(float);
+		return bytes+(bytes+MaxLiterals-1)/MaxLiterals;
+	}
+}
+
+StaticCache::StaticCache()
+{
+	m_threadCount = 1;
+	m_key = 0;
+	m_fileBytes = 0;
+}
+
+void StaticCache::setThreadCount(int threadCount)
+{
+	m_threadCount = std::max(1, threadCount);
+}
+
+void StaticCache::clear()
+{
+	m_textures.clear();
+	m_key = 0;
+	m_fileBytes = 0;
+}
+
+void StaticCache::add(const Texture& texture)
+{
+	m_textures.push_back(texture);
+}
+
+int StaticCache::getTextureCount()
+{
+	return (int)m_textures.size();
+}
+
+StaticCache::Texture& StaticCache::getTexture(int i)
+{
+	return m_textures[i];
+}
+
+uint64_t StaticCache::getKey()
+{
+	return m_key;
+}
+
+size_t StaticCache::getBytes()
+{
+	size_t bytes = 0;
+	for (const Texture& texture : m_textures)
+		bytes += texture.texels.size()*sizeof(float);
+
+	return bytes;
+}
+
+size_t StaticCache::getFileBytes()
+{
+	return m_fileBytes;
+}
+
+bool StaticCache::save(const std::string& filename, uint64_t key)
+{
+	std::vector<std::vector<unsigned char>> packed(m_textures.size());
+	ParallelFor((int)m_textures.size(), m_threadCount, [&](int i) { pack(m_textures[i], packed[i]); });
+
+	FILE* file = fopen(filename.c_str(), "wb");
+	if (!file)
+		return false;
+
+	// A header and the key, then each texture's size and packed bytes
+	int header[4] = { 0x43415453, FileVersion, (int)m_textures.size(), 0 };	// "STAC"
+	bool written = fwrite(header, sizeof(header), 1, file) == 1 && fwrite(&key, sizeof(key), 1, file) == 1;
+	size_t fileBytes = sizeof(header)+sizeof(key);
+	for (size_t i = 0; written && i < m_textures.size(); i++)
+	{
+		int size[2] = { m_textures[i].width, m_textures[i].height };
+		uint64_t bytes = packed[i].size();
+		written = fwrite(size, sizeof(size), 1, file) == 1 && fwrite(&bytes, sizeof(bytes), 1, file) == 1 && fwrite(packed[i].data(), 1, packed[i].size(), file) == packed[i].size();
+		fileBytes += sizeof(size)+sizeof(bytes)+packed[i].size();
+	}
+	fclose(file);
+
+	if (written)
+	{
+		m_key = key;
+		m_fileBytes = fileBytes;
+	}
+
+	return written;
+}
+
+bool StaticCache::load(const std::string& filename, uint64_t key)
+{
+	clear();
+
+	FILE* file = fopen(filename.c_str(), "rb");
+	if (!file)
+		return false;
+
+	int header[4];
+	uint64_t fileKey;
+	if (fread(header, sizeof(header), 1, file) != 1 || header[0] != 0x43415453 || header[1] != FileVersion || header[2] < 0 || fread(&fileKey, sizeof(fileKey), 1, file) != 1 || fileKey != key)
+	{
+		fclose(file);
+		return false;
+	}
+
+	// NB: Read in order, then unpacked in parallel
+	std::vector<std::vector<unsigned char>> packed(header[2]);
+	std::vector<Texture> textures(header[2]);
+	size_t fileBytes = sizeof(header)+sizeof(fileKey);
+	bool read = true;
+	for (int i = 0; read && i < header[2]; i++)
+	{
+		int size[2];
+		uint64_t bytes;
+		read = fread(size, sizeof(size), 1, file) == 1 && fread(&bytes, sizeof(bytes), 1, file) == 1;
+		read = read && size[0] > 0 && size[0] <= 16384 && size[1] > 0 && size[1] <= 16384 && bytes <= GetMaxPackedBytes(4*(size_t)size[0]*size[1]);
+		if (!read)
+			break;
+
+		textures[i].width = size[0];
+		textures[i].height = size[1];
+		packed[i].resize((size_t)bytes);
+		read = fread(packed[i].data(), 1, packed[i].size(), file) == packed[i].size();
+		fileBytes += sizeof(size)+sizeof(bytes)+packed[i].size();
+	}
+	fclose(file);
+	if (!read)
+		return false;
+
+	std::vector<unsigned char> unpacked(header[2], 0);
+	ParallelFor(header[2], m_threadCount, [&](int i) {
+		unpacked[i] = unpack(packed[i].data(), packed[i].size(), textures[i]);
+		std::vector<unsigned char>().swap(packed[i]);
+	});
+	if (std::find(unpacked.begin(), unpacked.end(), 0) != unpacked.end())
+		return false;
+
+	m_textures.swap(textures);
+	m_key = key;
+	m_fileBytes = fileBytes;
+
+	return true;
+}
+
+uint64_t StaticCache::hash(const void* data, size_t bytes, uint64_t seed)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	for (size_t i = 0; i < bytes; i++)
+		seed = (seed ^ p[i])*1099511628211ull;
+
+	return seed;
+}
+
+uint64_t StaticCache::hashString(const std::string& text, uint64_t seed)
+{
+	uint64_t length = text.size();
+	return hash(text.data(), text.size(), hash(&length, sizeof(length), seed));
+}
+
+uint64_t StaticCache::hashFile(const std::string& filename, uint64_t seed)
+{
+	seed = hashString(filename, seed);
+
+	FILE* file = fopen(filename.c_str(), "rb");
+	if (!file)
+		return seed;
+
+	unsigned char buffer[1 << 16];
+	size_t bytes;
+	while ((bytes = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		seed = hash(buffer, bytes, seed);
+	fclose(file);
+
+	return seed;
+}
+
+void StaticCache::pack(const Texture& texture, std::vector<unsigned char>& packed)
+{
+	// Each float XORed with the same channel of the texel before, so flat runs become zeros and gradients lose their high bits...
+	size_t count = texture.texels.size();
+	std::vector<unsigned char> planes(count*sizeof(float));
+	uint32_t previous[4] = { 0, 0, 0, 0 };
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t bits;
+		memcpy(&bits, &texture.texels[i], sizeof(bits));
+		uint32_t delta = bits ^ previous[i%4];
+		previous[i%4] = bits;
+
+		// ...then split into planes, lowest byte first
+		for (size_t b = 0; b < sizeof(float); b++)
+			planes[b*count+i] = (unsigned char)(delta >> (8*b));
+	}
+
+	// Control bytes below 128 are followed by that many literals less one; the rest by one byte, repeated that many times less 125
+	packed.clear();
+	packed.reserve(GetMaxPackedBytes(count)/4);
+	size_t literals = 0;
+	for (size_t i = 0; i < planes.size();)
+	{
+		size_t run = 1;
+		while (i+run < planes.size() && run < MaxRun && planes[i+run] == planes[i])
+			run++;
+
+		if (run >= MinRun || literals == MaxLiterals)
+		{
+			if (literals > 0)
+			{
+				packed.push_back((unsigned char)(literals-1));
+				packed.insert(packed.end(), planes.begin()+(i-literals), planes.begin()+i);
+				literals = 0;
+			}
+			if (run >= MinRun)
+			{
+				packed.push_back((unsigned char)(128+run-MinRun));
+				packed.push_back(planes[i]);
+				i += run;
+				continue;
+			}
+		}
+
+		literals++;
+		i++;
+	}
+	if (literals > 0)
+	{
+		packed.push_back((unsigned char)(literals-1));
+		packed.insert(packed.end(), planes.end()-literals, planes.end());
+	}
+}
+
+bool StaticCache::unpack(const unsigned char* packed, size_t bytes, Texture& texture)
+{
+	size_t count = 4*(size_t)texture.width*texture.height;
+	std::vector<unsigned char> planes(count*sizeof(float));
+
+	size_t p = 0, i = 0;
+	while (p < bytes)
+	{
+		unsigned char control = packed[p++];
+		if (control < 128)
+		{
+			size_t literals = (size_t)control+1;
+			if (p+literals > bytes || i+literals > planes.size())
+				return false;
+
+			memcpy(&planes[i], &packed[p], literals);
+			p += literals;
+			i += literals;
+		}
+		else
+		{
+			size_t run = (size_t)control-128+MinRun;
+			if (p >= bytes || i+run > planes.size())
+				return false;
+
+			memset(&planes[i], packed[p++], run);
+			i += run;
+		}
+	}
+	if (i != planes.size())
+		return false;
+
+	texture.texels.resize(count);
+	uint32_t previous[4] = { 0, 0, 0, 0 };
+	for (size_t j = 0; j < count; j++)
+	{
+		uint32_t delta = 0;
+		for (size_t b = 0; b < sizeof(float); b++)
+			delta |= (uint32_t)planes[b*count+j] << (8*b);
+
+		uint32_t bits = delta ^ previous[j%4];
+		previous[j%4] = bits;
+		memcpy(&texture.texels[j], &bits, sizeof(bits));
+	}
+
+	return true;
+}
+
+bool StaticCache::benchmark(int width, int height, int threadCount, std::string& report)
+{
+	// A sky graded top to bottom, a material with a little noise in every texel, and a face mostly left clear
+	const float clear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	StaticCache cache;
+	Texture sky, material, face;
+	SoftwareRenderer::makeTexture(width, height, clear, sky);
+	SoftwareRenderer::makeTexture(width, height, clear, material);
+	SoftwareRenderer::makeTexture(width, height, clear, face);
+	uint32_t seed = 1;
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			float* texel = &sky.texels[4*(width*y+x)];
+			float t = (float)y/height;
+			texel[0] = 0.2f+0.3f*t; texel[1] = 0.4f+0.3f*t; texel[2] = 0.9f-0.2f*t; texel[3] = 1.0f;
+
+			texel = &material.texels[4*(width*y+x)];
+			for (int j = 0; j < 3; j++)
+			{
+				seed = seed*1664525u+1013904223u;
+				texel[j] = 0.5f+0.1f*(float)(seed >> 8)/(1 << 24);
+			}
+			texel[3] = 1.0f;
+
+			texel = &face.texels[4*(width*y+x)];
+			if ((x-width/2)*(x-width/2)+(y-height/2)*(y-height/2) < height*height/16)
+				texel[0] = texel[1] = texel[2] = texel[3] = 0.75f;
+		}
+	}
+	cache.add(sky);
+	cache.add(material);
+	cache.add(face);
+
+	report = "Static cache of three " + std::to_string(width) + "x" + std::to_string(height) + " textures (" + std::to_string(cache.getBytes()/(1024*1024)) + "MB):\n";
+	int threadCounts[2] = { 1, threadCount };
+	bool passed = true;
+	for (int t = 0; t < 2; t++)
+	{
+		cache.setThreadCount(threadCounts[t]);
+		auto start = std::chrono::high_resolution_clock::now();
+		bool saved = cache.save("static_cache_benchmark.bin", 1);
+		auto saveEnd = std::chrono::high_resolution_clock::now();
+
+		StaticCache loaded;
+		loaded.setThreadCount(threadCounts[t]);
+		bool read = loaded.load("static_cache_benchmark.bin", 1);
+		auto loadEnd = std::chrono::high_resolution_clock::now();
+
+		bool same = saved && read && loaded.getTextureCount() == 3;
+		for (int i = 0; same && i < 3; i++)
+			same = memcmp(loaded.getTexture(i).texels.data(), cache.getTexture(i).texels.data(), cache.getTexture(i).texels.size()*sizeof(float)) == 0;
+
+		char line[256];
+		snprintf(line, sizeof(line), "  %2d thread(s): %.2f:1, saved in %.1fms, loaded in %.1fms%s\n", threadCounts[t], (double)cache.getBytes()/std::max<size_t>(1, cache.getFileBytes()),
+			std::chrono::duration<double, std::milli>(saveEnd-start).count(), std::chrono::duration<double, std::milli>(loadEnd-saveEnd).count(), (same) ? "" : " (NOT THE SAME!)");
+		report += line;
+		passed = passed && same && cache.getFileBytes() < cache.getBytes();
+	}
+	remove("static_cache_benchmark.bin");
+
+	return passed;
+}
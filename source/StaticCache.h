@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "SoftwareRenderer.h"
+
+// Keeps the first frame's static results (procedural textures and environment faces) in one file, keyed by a hash of everything that made them,
+// so later launches load them rather than render them. Textures are kept in the order they were added, for the loader to take back in the same order.
+// Compressed losslessly: each texel's bits are XORed with the texel before's, split into byte planes (where the high bytes are mostly zero), then run-length packed
+class StaticCache
+{
+public:
+	typedef SoftwareRenderer::Texture	Texture;
+
+	StaticCache();
+
+	void							setThreadCount(int threadCount);	// Textures are packed and unpacked in parallel
+	void							clear();
+	void							add(const Texture& texture);
+
+	int								getTextureCount();
+	Texture&						getTexture(int i);
+	uint64_t						getKey();
+	size_t							getBytes();			// Of the textures as held
+	size_t							getFileBytes();		// As last saved or loaded
+
+	bool							save(const std::string& filename, uint64_t key);
+	bool							load(const std::string& filename, uint64_t key);	// False, leaving the cache empty, if missing, malformed or made under another key
+
+	// FNV-1a, folding more into a hash already begun
+	static uint64_t					hash(const void* data, size_t bytes, uint64_t seed = 14695981039346656037ull);
+	static uint64_t					hashString(const std::string& text, uint64_t seed);		// Its length too, so concatenations differ
+	static uint64_t					hashFile(const std::string& filename, uint64_t seed);	// Its contents, or just its name if missing
+
+	// Packs made-up textures (a gradient sky, a noisy material and a mostly empty face) on 1 and threadCount threads, reporting the ratio and times of each.
+	// False if they do not load back bit for bit, or the file is no smaller than the textures
+	static bool						benchmark(int width, int height, int threadCount, std::string& report);
+
+private:
+	static void						pack(const Texture& texture, std::vector<unsigned char>& packed);
+	static bool						unpack(const unsigned char* packed, size_t bytes, Texture& texture);	// False if malformed; the texture's size is set first
+
+	int								m_threadCount;
+	std::vector<Texture>			m_textures;
+	uint64_t						m_key;
+	size_t							m_fileBytes;
+};
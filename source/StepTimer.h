@@ -165,6 +165,18 @@ namespace DX
             }
         }
 
+        // Call Update exactly once, a fixed step on, however long has really passed (e.g. so benchmarks see the same times every run).
+        template<typename TUpdate>
+        void Step(const TUpdate& update)
+        {
+            m_elapsedTicks = m_targetElapsedTicks;
+            m_totalTicks += m_targetElapsedTicks;
+            m_leftOverTicks = 0;
+            m_frameCount++;
+
+            update();
+        }
+
     private:
         // Source timing data uses QPC units.
         LARGE_INTEGER m_qpcFrequency;
@@ -0,0 +1,607 @@
+#include "pch.h"
+#include "TriangleBvh.h"
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <emmintrin.h>
+#include <random>
+#include <thread>
+
+namespace
+{
+	// Half a box's surface area; only ever compared, so the half doesn't matter
+	float Area(const float min[3], const float max[3])
+	{
+		float x = max[0]-min[0], y = max[1]-min[1], z = max[2]-min[2];
+		return x*y+y*z+z*x;
+	}
+
+	// Slab test, from the origin out to distance
+	bool HitsBox(const float min[3], const float max[3], const float origin[3], const float inverse[3], float distance)
+	{
+		float nearest = 0.0f, farthest = distance;
+		for (int j = 0; j < 3; j++)
+		{
+			float t0 = (min[j]-origin[j])*inverse[j], t1 = (max[j]-origin[j])*inverse[j];
+			nearest = std::max(nearest, std::min(t0, t1));
+			farthest = std::min(farthest, std::max(t0, t1));
+		}
+
+		return nearest <= farthest;
+	}
+
+	// Moller-Trumbore, against a triangle stored as its first vertex and two edges
+	// NB: Tests are written so NaNs (from edge-on triangles) fail them, as in the SSE version, and sums run in the same order, so both find the same hits
+	void HitTriangle(const float* triangle, const float origin[3], const float direction[3], int index, TriangleBvh::Hit& hit)
+	{
+		const float* v0 = triangle;
+		const float* e1 = triangle+3;
+		const float* e2 = triangle+6;
+
+		float p[3] = { direction[1]*e2[2]-direction[2]*e2[1], direction[2]*e2[0]-direction[0]*e2[2], direction[0]*e2[1]-direction[1]*e2[0] };
+		float inverse = 1.0f/(e1[0]*p[0]+e1[1]*p[1]+e1[2]*p[2]);
+		float s[3] = { origin[0]-v0[0], origin[1]-v0[1], origin[2]-v0[2] };
+		float u = (s[0]*p[0]+s[1]*p[1]+s[2]*p[2])*inverse;
+		if (!(u >= 0.0f && u <= 1.0f))
+			return;
+
+		float q[3] = { s[1]*e1[2]-s[2]*e1[1], s[2]*e1[0]-s[0]*e1[2], s[0]*e1[1]-s[1]*e1[0] };
+		float v = (direction[0]*q[0]+direction[1]*q[1]+direction[2]*q[2])*inverse;
+		if (!(v >= 0.0f && u+v <= 1.0f))
+			return;
+
+		float t = (e2[0]*q[0]+e2[1]*q[1]+e2[2]*q[2])*inverse;
+		if (!(t > 0.0f && t < hit.distance))
+			return;
+
+		hit.distance = t;
+		hit.triangle = index;
+		hit.u = u;
+		hit.v = v;
+	}
+}
+
+TriangleBvh::TriangleBvh()
+{
+}
+
+void TriangleBvh::Build(const float* triangles, int triangleCount, int threadCount)
+{
+	m_nodes.clear();
+	m_triangles.clear();
+	m_order.resize(triangleCount);
+	if (triangleCount == 0)
+		return;
+
+	m_centroids.resize(3*triangleCount);
+	m_boundsMin.resize(3*triangleCount);
+	m_boundsMax.resize(3*triangleCount);
+	for (int i = 0; i < triangleCount; i++)
+	{
+		const float* vertices = &triangles[9*i];
+		for (int j = 0; j < 3; j++)
+		{
+			m_boundsMin[3*i+j] = std::min(vertices[j], std::min(vertices[3+j], vertices[6+j]));
+			m_boundsMax[3*i+j] = std::max(vertices[j], std::max(vertices[3+j], vertices[6+j]));
+			m_centroids[3*i+j] = 0.5f*(m_boundsMin[3*i+j]+m_boundsMax[3*i+j]);
+		}
+		m_order[i] = i;
+	}
+
+	// Enough levels on this thread to leave a few subtrees per thread, so uneven ones still share out
+	int levels = 0;
+	while (threadCount > 1 && (1 << levels) < 4*threadCount)
+		levels++;
+
+	std::vector<Task> tasks;
+	m_nodes.resize(1);
+	buildTop(0, 0, triangleCount, 1, levels, tasks);
+
+	// Each subtree into nodes of its own, spliced in after
+	std::vector<std::vector<Node>> subtrees(tasks.size());
+	std::atomic<int> next(0);
+	auto work = [&]() {
+		for (int t = next++; t < (int)tasks.size(); t = next++)
+		{
+			subtrees[t].resize(1);
+			buildNode(subtrees[t], 0, tasks[t].first, tasks[t].count, tasks[t].depth);
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (int i = 1; i < std::min(threadCount, (int)tasks.size()); i++)
+		threads.push_back(std::thread(work));
+	work();
+	for (int i = 0; i < (int)threads.size(); i++)
+		threads[i].join();
+
+	// NB: A subtree's root takes the place left for it; the rest follow on, their children moved with them
+	for (int t = 0; t < (int)tasks.size(); t++)
+	{
+		int offset = (int)m_nodes.size()-1;
+		for (int k = 0; k < (int)subtrees[t].size(); k++)
+		{
+			Node node = subtrees[t][k];
+			if (node.count < 0)
+				node.first += offset;
+
+			if (k == 0)
+				m_nodes[tasks[t].node] = node;
+			else
+				m_nodes.push_back(node);
+		}
+	}
+
+	// Triangles in leaf order, as the first vertex and edges tracing wants
+	m_triangles.resize(9*triangleCount);
+	for (int i = 0; i < triangleCount; i++)
+	{
+		const float* vertices = &triangles[9*m_order[i]];
+		for (int j = 0; j < 3; j++)
+		{
+			m_triangles[9*i+j] = vertices[j];
+			m_triangles[9*i+3+j] = vertices[3+j]-vertices[j];
+			m_triangles[9*i+6+j] = vertices[6+j]-vertices[j];
+		}
+	}
+
+	m_centroids.clear();
+	m_boundsMin.clear();
+	m_boundsMax.clear();
+}
+
+bool TriangleBvh::Intersect(const Ray& ray, Hit& hit)
+{
+	hit.distance = ray.maxDistance;
+	hit.triangle = -1;
+	hit.u = 0.0f;
+	hit.v = 0.0f;
+	if (m_nodes.empty())
+		return false;
+
+	float inverse[3] = { 1.0f/ray.direction[0], 1.0f/ray.direction[1], 1.0f/ray.direction[2] };
+
+	int stack[MaxDepth];
+	int size = 0;
+	stack[size++] = 0;
+	while (size > 0)
+	{
+		const Node& node = m_nodes[stack[--size]];
+		if (!HitsBox(node.min, node.max, ray.origin, inverse, hit.distance))
+			continue;
+
+		if (node.count > 0)
+		{
+			for (int i = node.first; i < node.first+node.count; i++)
+				HitTriangle(&m_triangles[9*i], ray.origin, ray.direction, m_order[i], hit);
+			continue;
+		}
+
+		// Nearer child pushed last, so visited first
+		int backwards = (ray.direction[-1-node.count] < 0.0f);
+		stack[size++] = node.first+1-backwards;
+		stack[size++] = node.first+backwards;
+	}
+
+	return hit.triangle >= 0;
+}
+
+void TriangleBvh::Intersect4(const Ray rays[4], Hit hits[4])
+{
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+
+	__m128 origin[3], direction[3], inverse[3];
+	for (int j = 0; j < 3; j++)
+	{
+		origin[j] = _mm_setr_ps(rays[0].origin[j], rays[1].origin[j], rays[2].origin[j], rays[3].origin[j]);
+		direction[j] = _mm_setr_ps(rays[0].direction[j], rays[1].direction[j], rays[2].direction[j], rays[3].direction[j]);
+		inverse[j] = _mm_div_ps(one, direction[j]);
+	}
+	__m128 distance = _mm_setr_ps(rays[0].maxDistance, rays[1].maxDistance, rays[2].maxDistance, rays[3].maxDistance);
+	__m128i triangle = _mm_set1_epi32(-1);
+	__m128 u = zero, v = zero;
+
+	// NB: Children are ordered by the packet's direction as a whole, so rays heading against it may visit the farther one first
+	float heading[3];
+	for (int j = 0; j < 3; j++)
+		heading[j] = rays[0].direction[j]+rays[1].direction[j]+rays[2].direction[j]+rays[3].direction[j];
+
+	int stack[MaxDepth];
+	int size = 0;
+	if (!m_nodes.empty())
+		stack[size++] = 0;
+	while (size > 0)
+	{
+		const Node& node = m_nodes[stack[--size]];
+
+		__m128 nearest = zero, farthest = distance;
+		for (int j = 0; j < 3; j++)
+		{
+			__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min[j]), origin[j]), inverse[j]);
+			__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max[j]), origin[j]), inverse[j]);
+			nearest = _mm_max_ps(nearest, _mm_min_ps(t0, t1));
+			farthest = _mm_min_ps(farthest, _mm_max_ps(t0, t1));
+		}
+		if (!_mm_movemask_ps(_mm_cmple_ps(nearest, farthest)))
+			continue;
+
+		if (node.count < 0)
+		{
+			int backwards = (heading[-1-node.count] < 0.0f);
+			stack[size++] = node.first+1-backwards;
+			stack[size++] = node.first+backwards;
+			continue;
+		}
+
+		for (int i = node.first; i < node.first+node.count; i++)
+		{
+			const float* vertices = &m_triangles[9*i];
+			__m128 v0[3], e1[3], e2[3];
+			for (int j = 0; j < 3; j++)
+			{
+				v0[j] = _mm_set1_ps(vertices[j]);
+				e1[j] = _mm_set1_ps(vertices[3+j]);
+				e2[j] = _mm_set1_ps(vertices[6+j]);
+			}
+
+			__m128 p[3] = {
+				_mm_sub_ps(_mm_mul_ps(direction[1], e2[2]), _mm_mul_ps(direction[2], e2[1])),
+				_mm_sub_ps(_mm_mul_ps(direction[2], e2[0]), _mm_mul_ps(direction[0], e2[2])),
+				_mm_sub_ps(_mm_mul_ps(direction[0], e2[1]), _mm_mul_ps(direction[1], e2[0])),
+			};
+			__m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1[0], p[0]), _mm_mul_ps(e1[1], p[1])), _mm_mul_ps(e1[2], p[2]));
+			__m128 inverseDeterminant = _mm_div_ps(one, determinant);
+			__m128 s[3] = { _mm_sub_ps(origin[0], v0[0]), _mm_sub_ps(origin[1], v0[1]), _mm_sub_ps(origin[2], v0[2]) };
+			__m128 hitU = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(s[0], p[0]), _mm_mul_ps(s[1], p[1])), _mm_mul_ps(s[2], p[2])), inverseDeterminant);
+
+			__m128 q[3] = {
+				_mm_sub_ps(_mm_mul_ps(s[1], e1[2]), _mm_mul_ps(s[2], e1[1])),
+				_mm_sub_ps(_mm_mul_ps(s[2], e1[0]), _mm_mul_ps(s[0], e1[2])),
+				_mm_sub_ps(_mm_mul_ps(s[0], e1[1]), _mm_mul_ps(s[1], e1[0])),
+			};
+			__m128 hitV = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(direction[0], q[0]), _mm_mul_ps(direction[1], q[1])), _mm_mul_ps(direction[2], q[2])), inverseDeterminant);
+			__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2[0], q[0]), _mm_mul_ps(e2[1], q[1])), _mm_mul_ps(e2[2], q[2])), inverseDeterminant);
+
+			__m128 valid = _mm_and_ps(_mm_cmpge_ps(hitU, zero), _mm_cmple_ps(hitU, one));
+			valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(hitV, zero), _mm_cmple_ps(_mm_add_ps(hitU, hitV), one)));
+			valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(t, zero), _mm_cmplt_ps(t, distance)));
+			if (!_mm_movemask_ps(valid))
+				continue;
+
+			__m128i validInteger = _mm_castps_si128(valid);
+			distance = _mm_or_ps(_mm_and_ps(valid, t), _mm_andnot_ps(valid, distance));
+			u = _mm_or_ps(_mm_and_ps(valid, hitU), _mm_andnot_ps(valid, u));
+			v = _mm_or_ps(_mm_and_ps(valid, hitV), _mm_andnot_ps(valid, v));
+			triangle = _mm_or_si128(_mm_and_si128(validInteger, _mm_set1_epi32(m_order[i])), _mm_andnot_si128(validInteger, triangle));
+		}
+	}
+
+	float distances[4], us[4], vs[4];
+	int triangles[4];
+	_mm_storeu_ps(distances, distance);
+	_mm_storeu_ps(us, u);
+	_mm_storeu_ps(vs, v);
+	_mm_storeu_si128((__m128i*)triangles, triangle);
+	for (int k = 0; k < 4; k++)
+	{
+		hits[k].distance = distances[k];
+		hits[k].triangle = triangles[k];
+		hits[k].u = us[k];
+		hits[k].v = vs[k];
+	}
+}
+
+int TriangleBvh::getTriangleCount()
+{
+	return (int)m_order.size();
+}
+
+int TriangleBvh::getNodeCount()
+{
+	return (int)m_nodes.size();
+}
+
+int TriangleBvh::getDepth()
+{
+	return m_nodes.empty() ? 0 : getDepth(0);
+}
+
+bool TriangleBvh::benchmark(const std::string& name, const std::vector<float>& triangles, int rays, int threadCount, std::string& report)
+{
+	int triangleCount = (int)triangles.size()/9;
+	if (triangleCount == 0)
+	{
+		report = name + ": no triangles to trace\n";
+		return false;
+	}
+
+	TriangleBvh bvh;
+	auto start = std::chrono::high_resolution_clock::now();
+	bvh.Build(triangles.data(), triangleCount, 1);
+	auto middle = std::chrono::high_resolution_clock::now();
+	bvh.Build(triangles.data(), triangleCount, threadCount);
+	auto end = std::chrono::high_resolution_clock::now();
+	double singleBuildTime = std::chrono::duration<double, std::milli>(middle-start).count();
+	double buildTime = std::chrono::duration<double, std::milli>(end-middle).count();
+
+	// Views of 64x64 pixels from all around the mesh, each pixel's ray next to the rest of its 2x2 block
+	float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (int i = 0; i < 3*triangleCount; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			min[j] = std::min(min[j], triangles[3*i+j]);
+			max[j] = std::max(max[j], triangles[3*i+j]);
+		}
+	}
+	float centre[3] = { 0.5f*(min[0]+max[0]), 0.5f*(min[1]+max[1]), 0.5f*(min[2]+max[2]) };
+	float radius = 0.5f*sqrtf((max[0]-min[0])*(max[0]-min[0])+(max[1]-min[1])*(max[1]-min[1])+(max[2]-min[2])*(max[2]-min[2]));
+
+	std::mt19937 random(502);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	const int side = 64;
+	std::vector<Ray> cast;
+	while ((int)cast.size()+side*side <= std::max(rays, side*side))
+	{
+		float forward[3] = { unit(random), unit(random), unit(random) };
+		float length = sqrtf(forward[0]*forward[0]+forward[1]*forward[1]+forward[2]*forward[2]);
+		if (length < 0.1f)
+			continue;
+		for (int j = 0; j < 3; j++)
+			forward[j] /= length;
+
+		float right[3] = { forward[2], 0.0f, -forward[0] };
+		length = sqrtf(right[0]*right[0]+right[2]*right[2]);
+		if (length < 0.1f)
+			continue;
+		right[0] /= length;
+		right[2] /= length;
+		float up[3] = { forward[1]*right[2]-forward[2]*right[1], forward[2]*right[0]-forward[0]*right[2], forward[0]*right[1]-forward[1]*right[0] };
+
+		for (int block = 0; block < side*side/4; block++)
+		{
+			for (int k = 0; k < 4; k++)
+			{
+				int x = 2*(block%(side/2))+(k & 1), y = 2*(block/(side/2))+(k >> 1);
+				float sx = 0.5f*((2.0f*x+1.0f)/side-1.0f), sy = 0.5f*((2.0f*y+1.0f)/side-1.0f);
+
+				Ray ray;
+				for (int j = 0; j < 3; j++)
+				{
+					ray.origin[j] = centre[j]-1.75f*radius*forward[j];
+					ray.direction[j] = forward[j]+sx*right[j]+sy*up[j];
+				}
+				ray.maxDistance = FLT_MAX;
+				cast.push_back(ray);
+			}
+		}
+	}
+	int count = (int)cast.size();
+
+	std::vector<Hit> single(count), packets(count), threaded(count);
+	start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < count; i++)
+		bvh.Intersect(cast[i], single[i]);
+	middle = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < count; i += 4)
+		bvh.Intersect4(&cast[i], &packets[i]);
+	end = std::chrono::high_resolution_clock::now();
+	double singleTime = std::chrono::duration<double>(middle-start).count();
+	double packetTime = std::chrono::duration<double>(end-middle).count();
+
+	// Packets again, shared out between threads
+	std::atomic<int> next(0);
+	auto work = [&]() {
+		for (int i = 4*(next++); i < count; i = 4*(next++))
+			bvh.Intersect4(&cast[i], &threaded[i]);
+	};
+	start = std::chrono::high_resolution_clock::now();
+	std::vector<std::thread> threads;
+	for (int i = 1; i < threadCount; i++)
+		threads.push_back(std::thread(work));
+	work();
+	for (int i = 0; i < (int)threads.size(); i++)
+		threads[i].join();
+	end = std::chrono::high_resolution_clock::now();
+	double threadedTime = std::chrono::duration<double>(end-start).count();
+
+	int hitCount = 0, differing = 0;
+	for (int i = 0; i < count; i++)
+	{
+		hitCount += (single[i].triangle >= 0);
+		differing += (single[i].distance != packets[i].distance || packets[i].distance != threaded[i].distance);
+	}
+
+	char text[512];
+	snprintf(text, sizeof(text), "%s: %d triangles, %d nodes, %d levels\n"
+		"  Building:    %8.2fms on 1 thread, %8.2fms on %d\n"
+		"  Tracing %d rays (%d hit): %6.2fM rays/s single, %6.2fM rays/s in packets of 4 (%.2fx), %6.2fM rays/s on %d threads; %d differing\n",
+		name.c_str(), triangleCount, bvh.getNodeCount(), bvh.getDepth(),
+		singleBuildTime, buildTime, threadCount,
+		count, hitCount, count/singleTime*1e-6, count/packetTime*1e-6, (packetTime > 0.0) ? singleTime/packetTime : 0.0, count/threadedTime*1e-6, threadCount, differing);
+	report = text;
+
+	return hitCount > 0 && differing == 0;
+}
+
+void TriangleBvh::buildTop(int node, int first, int count, int depth, int levels, std::vector<Task>& tasks)
+{
+	int axis = 0;
+	fitNode(m_nodes[node], first, count);
+	int left = (levels > 0) ? split(m_nodes[node], first, count, depth, axis) : 0;
+	if (left == 0)
+	{
+		Task task = { node, first, count, depth };
+		tasks.push_back(task);
+		return;
+	}
+
+	int child = (int)m_nodes.size();
+	m_nodes.resize(child+2);
+	m_nodes[node].first = child;
+	m_nodes[node].count = -1-axis;
+
+	buildTop(child, first, left, depth+1, levels-1, tasks);
+	buildTop(child+1, first+left, count-left, depth+1, levels-1, tasks);
+}
+
+void TriangleBvh::buildNode(std::vector<Node>& nodes, int node, int first, int count, int depth)
+{
+	int axis = 0;
+	fitNode(nodes[node], first, count);
+	int left = split(nodes[node], first, count, depth, axis);
+	if (left == 0)
+	{
+		nodes[node].first = first;
+		nodes[node].count = count;
+		return;
+	}
+
+	// NB: Growing nodes may move them, so they are only ever reached by index
+	int child = (int)nodes.size();
+	nodes.resize(child+2);
+	nodes[node].first = child;
+	nodes[node].count = -1-axis;
+
+	buildNode(nodes, child, first, left, depth+1);
+	buildNode(nodes, child+1, first+left, count-left, depth+1);
+}
+
+void TriangleBvh::fitNode(Node& node, int first, int count)
+{
+	for (int j = 0; j < 3; j++)
+	{
+		node.min[j] = FLT_MAX;
+		node.max[j] = -FLT_MAX;
+	}
+
+	for (int i = first; i < first+count; i++)
+	{
+		int triangle = m_order[i];
+		for (int j = 0; j < 3; j++)
+		{
+			node.min[j] = std::min(node.min[j], m_boundsMin[3*triangle+j]);
+			node.max[j] = std::max(node.max[j], m_boundsMax[3*triangle+j]);
+		}
+	}
+}
+
+int TriangleBvh::split(const Node& node, int first, int count, int depth, int& axis)
+{
+	if (count <= LeafSize || depth >= MaxDepth-1)
+		return 0;
+
+	float centroidMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, centroidMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (int i = first; i < first+count; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			centroidMin[j] = std::min(centroidMin[j], m_centroids[3*m_order[i]+j]);
+			centroidMax[j] = std::max(centroidMax[j], m_centroids[3*m_order[i]+j]);
+		}
+	}
+
+	// Every axis binned by centroid; the cost of a split is each side's area times its triangles
+	float bestCost = FLT_MAX;
+	int bestAxis = -1, bestBin = 0;
+	for (int a = 0; a < 3; a++)
+	{
+		float extent = centroidMax[a]-centroidMin[a];
+		if (extent <= 0.0f)
+			continue;
+		float scale = BinCount/extent;
+
+		int binCounts[BinCount] = {};
+		float binMin[BinCount][3], binMax[BinCount][3];
+		for (int b = 0; b < BinCount; b++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				binMin[b][j] = FLT_MAX;
+				binMax[b][j] = -FLT_MAX;
+			}
+		}
+
+		for (int i = first; i < first+count; i++)
+		{
+			int triangle = m_order[i];
+			int b = std::min(BinCount-1, (int)((m_centroids[3*triangle+a]-centroidMin[a])*scale));
+			binCounts[b]++;
+			for (int j = 0; j < 3; j++)
+			{
+				binMin[b][j] = std::min(binMin[b][j], m_boundsMin[3*triangle+j]);
+				binMax[b][j] = std::max(binMax[b][j], m_boundsMax[3*triangle+j]);
+			}
+		}
+
+		// Right of each boundary, swept from the far end
+		float rightCosts[BinCount];
+		float sweepMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, sweepMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		int sweepCount = 0;
+		for (int b = BinCount-1; b > 0; b--)
+		{
+			sweepCount += binCounts[b];
+			for (int j = 0; j < 3; j++)
+			{
+				sweepMin[j] = std::min(sweepMin[j], binMin[b][j]);
+				sweepMax[j] = std::max(sweepMax[j], binMax[b][j]);
+			}
+			rightCosts[b] = (sweepCount > 0) ? sweepCount*Area(sweepMin, sweepMax) : -1.0f;
+		}
+
+		for (int j = 0; j < 3; j++)
+		{
+			sweepMin[j] = FLT_MAX;
+			sweepMax[j] = -FLT_MAX;
+		}
+		sweepCount = 0;
+		for (int b = 1; b < BinCount; b++)
+		{
+			sweepCount += binCounts[b-1];
+			for (int j = 0; j < 3; j++)
+			{
+				sweepMin[j] = std::min(sweepMin[j], binMin[b-1][j]);
+				sweepMax[j] = std::max(sweepMax[j], binMax[b-1][j]);
+			}
+			if (sweepCount == 0 || rightCosts[b] < 0.0f)
+				continue;
+
+			float cost = sweepCount*Area(sweepMin, sweepMax)+rightCosts[b];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = a;
+				bestBin = b;
+			}
+		}
+	}
+
+	// Triangles that cannot be told apart by centroid are halved as they are, if too many for a leaf
+	if (bestAxis < 0)
+	{
+		axis = 0;
+		return (count > MaxLeafSize) ? count/2 : 0;
+	}
+
+	// NB: Visiting a node costs about as much as testing a triangle
+	float leafCost = count*Area(node.min, node.max);
+	if (count <= MaxLeafSize && Area(node.min, node.max)+bestCost >= leafCost)
+		return 0;
+
+	axis = bestAxis;
+	float scale = BinCount/(centroidMax[axis]-centroidMin[axis]);
+	int* middle = std::partition(&m_order[first], &m_order[first]+count, [&](int triangle) {
+		return std::min(BinCount-1, (int)((m_centroids[3*triangle+axis]-centroidMin[axis])*scale)) < bestBin;
+	});
+
+	return (int)(middle-&m_order[first]);
+}
+
+int TriangleBvh::getDepth(int node)
+{
+	if (m_nodes[node].count >= 0)
+		return 1;
+
+	return 1+std::max(getDepth(m_nodes[node].first), getDepth(m_nodes[node].first+1));
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Bounding volume hierarchy over a mesh's triangles, for casting rays at it on the CPU (picking, reference renders, precomputing visibility).
+// Built top-down by binned surface area heuristic; the top few levels are split on one thread, then each subtree beneath them is built on its own.
+class TriangleBvh
+{
+public:
+	static const int				BinCount = 16;		// Candidate splits per axis, per node
+	static const int				LeafSize = 4;		// Fewest triangles a leaf holds before splitting is considered
+	static const int				MaxLeafSize = 16;	// Most triangles a leaf holds, unless they cannot be told apart
+	static const int				MaxDepth = 64;		// Levels, so tracing can keep its stack on the stack
+
+	struct Ray
+	{
+		float	origin[3];
+		float	direction[3];	// Needn't be normalised; distances are in multiples of it
+		float	maxDistance;
+	};
+
+	struct Hit
+	{
+		float	distance;
+		int		triangle;		// As given to Build, or -1 if nothing was hit
+		float	u, v;			// Barycentrics of the second and third vertices
+	};
+
+	TriangleBvh();
+
+	void							Build(const float* triangles, int triangleCount, int threadCount);	// Nine floats each (three positions)
+
+	// Nearest hit. Intersect takes one ray; Intersect4 traces four together with SSE, and is fastest when they travel alike (e.g. a 2x2 block of pixels)
+	bool							Intersect(const Ray& ray, Hit& hit);
+	void							Intersect4(const Ray rays[4], Hit hits[4]);
+
+	int								getTriangleCount();
+	int								getNodeCount();
+	int								getDepth();		// Levels, the root's included
+
+	// Builds over a mesh on 1 and threadCount threads, then traces rays from a camera orbiting it, 2x2 packets against single rays.
+	// False if the mesh is empty, nothing was hit, or packets (on any thread) found a different nearest hit than single rays
+	static bool						benchmark(const std::string& name, const std::vector<float>& triangles, int rays, int threadCount, std::string& report);
+
+private:
+	// NB: 32 bytes, two to a cache line. Children are allocated together, so an interior node's are first and first+1
+	struct Node
+	{
+		float	min[3];
+		float	max[3];
+		int		first;		// Into m_triangles if a leaf; otherwise the first child
+		int		count;		// Triangles if a leaf; otherwise -1 less the axis it was split along
+	};
+
+	struct Task
+	{
+		int		node;
+		int		first;
+		int		count;
+		int		depth;
+	};
+
+	void							buildTop(int node, int first, int count, int depth, int levels, std::vector<Task>& tasks);	// Splits levels deep, leaving a task for each subtree beneath
+	void							buildNode(std::vector<Node>& nodes, int node, int first, int count, int depth);
+	void							fitNode(Node& node, int first, int count);
+	int								split(const Node& node, int first, int count, int depth, int& axis);	// Reorders the range, returning how many go left; 0 if it is best left a leaf
+	int								getDepth(int node);
+
+	std::vector<Node>				m_nodes;		// Root first
+	std::vector<float>				m_triangles;	// Nine floats each, in leaf order: first vertex, then the edges to the second and third
+	std::vector<int>				m_order;		// Indices: position in m_triangles; values: triangle as given to Build
+
+	// Only while building
+	std::vector<float>				m_centroids;	// 3 per triangle
+	std::vector<float>				m_boundsMin;	// 3 per triangle
+	std::vector<float>				m_boundsMax;
+};
@@ -6,6 +6,13 @@ cbuffer TimeBuffer : register(b0)
     float time;
 };
 
+cbuffer ViewBuffer : register(b4)
+{
+    matrix viewMatrix;
+    matrix projectionMatrix;
+    float2 screenSize;
+};
+
 cbuffer AlphaBuffer : register(b1)
 {
     float alpha;
@@ -19,7 +26,7 @@ struct InputType
 
 float4 main(InputType input) : SV_TARGET
 {
-    float baseAlpha = textures[0].Sample(SampleType, float2(input.position.x/1280, input.position.y/720));
+    float baseAlpha = textures[0].Sample(SampleType, input.position.xy/screenSize);
     baseAlpha = 1.0-(1.0-baseAlpha)*(1.0-alpha);
 
     return float4(baseAlpha, baseAlpha, baseAlpha, 1.0);
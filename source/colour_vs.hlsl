@@ -2,11 +2,16 @@
 // Simple geometry pass
 // texture coordinates and normals will be ignored.
 
-cbuffer MatrixBuffer : register(b0)
+cbuffer ObjectBuffer : register(b0)
 {
 	matrix worldMatrix;
+};
+
+cbuffer ViewBuffer : register(b4)
+{
 	matrix viewMatrix;
 	matrix projectionMatrix;
+	float2 screenSize;
 };
 
 struct InputType
@@ -19,6 +19,7 @@ cbuffer RefractionBuffer : register(b2)
     float opacity;
     float refractiveIndex;
     float culling;
+    float projection;   // 0: six faces, 1: octahedral, 2: dual paraboloid (see EnvironmentProjection)
 }
 
 cbuffer CameraBuffer : register(b3)
@@ -57,6 +58,26 @@ float3 find_environment_st(float3 v)
     return float3(0, 0, -1);
 }
 
+// NB: Must match EnvironmentProjection::encodeOctahedral/encodeParaboloid
+float2 find_projection_st(float3 v, float width)
+{
+    v = normalize(v);
+    if (projection == 1.0)
+    {
+        float2 p = v.xy/(abs(v.x)+abs(v.y)+abs(v.z));
+        if (v.z < 0.0)
+            p = (1.0-abs(p.yx))*float2(p.x >= 0.0 ? 1.0 : -1.0, p.y >= 0.0 ? 1.0 : -1.0);
+        return 0.5*(p+float2(1.0, 1.0));
+    }
+
+    // Dual paraboloid: +z hemisphere on the left half, -z on the right, each kept clear of the other's texels
+    float2 st = 0.5*(v.xy/(1.0+abs(v.z))+float2(1.0, 1.0));
+    st.x = clamp(0.5*st.x, 0.5/width, 0.5-0.5/width);
+    if (v.z < 0.0)
+        st.x += 0.5;
+    return st;
+}
+
 float4 main(InputType input) : SV_TARGET
 {
     // STEP 1: Sample from the base textures to calculate the pixel's base colour
@@ -82,26 +103,45 @@ float4 main(InputType input) : SV_TARGET
 
     // STEP 4: Calculate point on first environment map light is refracted from
     float3 vRefraction = refract((input.position3D-cameraPosition), normal, refractiveIndex);
-    float3 stRefraction = find_environment_st(vRefraction);
     float4 refractionColor = float4(0.0, 0.0, 0.0, 1.0);
-    for (int i = 0; i < 6; i++)
-        if (i == (int)stRefraction.z)
-            refractionColor = textures[2+i].Sample(SampleType, stRefraction.xy);
+    if (projection > 0.0)
+    {
+        // Single target, so a single sample
+        float width, height;
+        textures[2].GetDimensions(width, height);
+        refractionColor = textures[2].SampleLevel(SampleType, find_projection_st(vRefraction, width), 0);
+    }
+    else
+    {
+        float3 stRefraction = find_environment_st(vRefraction);
+        for (int i = 0; i < 6; i++)
+            if (i == (int)stRefraction.z)
+                refractionColor = textures[2+i].Sample(SampleType, stRefraction.xy);
+    }
 
     // STEP 5: Calculate point on second environment map light is reflected from
     float3 vReflection = 2.0*dot(normal, -(input.position3D-cameraPosition))*normal+(input.position3D-cameraPosition); // ??
-    float3 stReflection = find_environment_st(vReflection);
     float4 reflectionColor = float4(0.0, 0.0, 0.0, 1.0);
-    for (int i = 0; i < 6; i++)
-        if (i == (int)stReflection.z)
-            reflectionColor = textures[8+i].Sample(SampleType, stReflection.xy);
+    if (projection > 0.0)
+    {
+        float width, height;
+        textures[8].GetDimensions(width, height);
+        reflectionColor = textures[8].SampleLevel(SampleType, find_projection_st(vReflection, width), 0);
+    }
+    else
+    {
+        float3 stReflection = find_environment_st(vReflection);
+        for (int i = 0; i < 6; i++)
+            if (i == (int)stReflection.z)
+                reflectionColor = textures[8+i].Sample(SampleType, stReflection.xy);
+    }
 
     /* --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------- */
     /* This enclosed section has been copied from: Scratchapixel (no date) Introduction to Shading: Reflection, Refraction and Fresnel. Available at https://www.scratchapixel.com/lessons/3d-basic-rendering/introduction-to-shading/reflection-refraction-fresnel (Accessed: 8 January 2023) */
     
     // STEP 6: Apply Fresnel equations
     float ior = 1.00;
-    float cosi = clamp(-1, 1, dot(input.position3D-cameraPosition, normal));
+    float cosi = clamp(dot(input.position3D-cameraPosition, normal), -1, 1);
     float etai = 1, etat = ior;
     if (cosi > 0) { etai = ior; etat = 1; }
     // Compute sini using Snell's law
@@ -0,0 +1,67 @@
+// Instanced variant of light_vs: the world matrix comes from the instance streams rather than ObjectBuffer
+cbuffer ViewBuffer : register(b4)
+{
+    matrix viewMatrix;
+    matrix projectionMatrix;
+    float2 screenSize;
+};
+
+struct InputType
+{
+    float4 position : POSITION;
+    float2 tex : TEXCOORD0;
+    float3 normal : NORMAL;
+    float3 tangent: TANGENT;
+    float3 binormal : BINORMAL;
+
+    float4 world0 : WORLD0;
+    float4 world1 : WORLD1;
+    float4 world2 : WORLD2;
+    float4 world3 : WORLD3;
+    uint material : MATERIAL;
+};
+
+struct OutputType
+{
+    float4 position : SV_POSITION;
+    float2 tex : TEXCOORD0;
+    float3 position3D : TEXCOORD2;
+    float3 normal : NORMAL;
+    float3 tangent: TANGENT;
+    float3 binormal : BINORMAL;
+    nointerpolation uint material : TEXCOORD6;
+};
+
+OutputType main(InputType input)
+{
+    OutputType output;
+
+    // STEP 1: Rebuild the instance's world matrix from its rows (NB: streamed as-is, so no transpose, unlike constant buffers)
+    matrix worldMatrix = matrix(input.world0, input.world1, input.world2, input.world3);
+
+    // STEP 2: Change the position vector to be 4 units for proper matrix calculations
+    input.position.w = 1.0f;
+
+    // STEP 3: Calculate the vertex's position
+    output.position = mul(input.position, worldMatrix);
+    output.position = mul(output.position, viewMatrix);
+    output.position = mul(output.position, projectionMatrix);
+
+    // STEP 4: 'Pass on' texture coordinates and material
+    output.tex = input.tex;
+    output.material = input.material;
+
+    // STEP 5: Calculate vertex's 3D position, normal, tangent and binormal
+    output.position3D = (float3)mul(input.position, worldMatrix);
+
+    output.normal = mul(input.normal, (float3x3)worldMatrix);
+    output.normal = normalize(output.normal);
+
+    output.tangent = mul(input.tangent, (float3x3)worldMatrix);
+    output.tangent = normalize(output.tangent);
+
+    output.binormal = mul(input.binormal, (float3x3)worldMatrix);
+    output.binormal = normalize(output.binormal);
+
+    return output;
+}
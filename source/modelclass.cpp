@@ -8,16 +8,18 @@ using namespace DirectX;
 
 ModelClass::ModelClass()
 {
+	m_device = 0;
 	m_vertexBuffer = 0;
 	m_indexBuffer = 0;
-
+	m_boundsMin = DirectX::SimpleMath::Vector3::Zero;
+	m_boundsMax = DirectX::SimpleMath::Vector3::Zero;
 }
 ModelClass::~ModelClass()
 {
 }
 
 
-bool ModelClass::InitializeModel(ID3D11Device *device, char* filename)
+bool ModelClass::InitializeModel(RenderDevice *device, char* filename)
 {
 	LoadModel(filename);
 
@@ -41,7 +43,7 @@ void ModelClass::Shutdown()
 }
 
 
-void ModelClass::Render(ID3D11DeviceContext* deviceContext)
+void ModelClass::Render(RenderContext* deviceContext)
 {
 	// Put the vertex and index buffers on the graphics pipeline to prepare them for drawing.
 	RenderBuffers(deviceContext);
@@ -51,19 +53,71 @@ void ModelClass::Render(ID3D11DeviceContext* deviceContext)
 }
 
 
+void ModelClass::RenderInstanced(RenderContext* deviceContext, int instanceCount, int firstInstance)
+{
+	// Put the vertex and index buffers on the graphics pipeline, alongside the per-instance streams in the later slots.
+	RenderBuffers(deviceContext);
+	deviceContext->DrawIndexedInstanced(m_indexCount, instanceCount, 0, 0, firstInstance);
+
+	return;
+}
+
+
 int ModelClass::GetIndexCount()
 {
 	return m_indexCount;
 }
 
+DirectX::SimpleMath::Vector3 ModelClass::GetBoundsMin()
+{
+	return m_boundsMin;
+}
+
+DirectX::SimpleMath::Vector3 ModelClass::GetBoundsMax()
+{
+	return m_boundsMax;
+}
 
-bool ModelClass::InitializeBuffers(ID3D11Device* device)
+void ModelClass::GetTriangles(std::vector<float>& triangles)
+{
+	triangles.clear();
+	triangles.reserve(3*preFabIndices.size());
+	for (int i = 0; i+2 < (int)preFabIndices.size(); i += 3)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			const DirectX::SimpleMath::Vector3& position = preFabVertices[preFabIndices[i+k]].position;
+			triangles.push_back(position.x);
+			triangles.push_back(position.y);
+			triangles.push_back(position.z);
+		}
+	}
+}
+
+void ModelClass::GetVertices(std::vector<float>& vertices)
+{
+	vertices.clear();
+	vertices.reserve(14*preFabIndices.size());
+	for (int i = 0; i < (int)preFabIndices.size(); i++)
+	{
+		const VertexType& vertex = preFabVertices[preFabIndices[i]];
+		const float values[14] = {
+			vertex.position.x, vertex.position.y, vertex.position.z,
+			vertex.texture.x, vertex.texture.y,
+			vertex.normal.x, vertex.normal.y, vertex.normal.z,
+			vertex.tangent.x, vertex.tangent.y, vertex.tangent.z,
+			vertex.binormal.x, vertex.binormal.y, vertex.binormal.z,
+		};
+		vertices.insert(vertices.end(), values, values+14);
+	}
+}
+
+
+bool ModelClass::InitializeBuffers(RenderDevice* device)
 {
 	VertexType* vertices;
 	unsigned long* indices;
-	D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
-    D3D11_SUBRESOURCE_DATA vertexData, indexData;
-	HRESULT result;
+	RenderBufferDesc vertexBufferDesc, indexBufferDesc;
 	int i;
 
 	// Create the vertex array.
@@ -95,41 +149,26 @@ bool ModelClass::InitializeBuffers(ID3D11Device* device)
 	}
 
 	// Set up the description of the static vertex buffer.
-    vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-    vertexBufferDesc.ByteWidth = sizeof(VertexType) * m_vertexCount;
-    vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    vertexBufferDesc.CPUAccessFlags = 0;
-    vertexBufferDesc.MiscFlags = 0;
-	vertexBufferDesc.StructureByteStride = 0;
-
-	// Give the subresource structure a pointer to the vertex data.
-    vertexData.pSysMem = vertices;
-	vertexData.SysMemPitch = 0;
-	vertexData.SysMemSlicePitch = 0;
-
-	// Now create the vertex buffer.
-    result = device->CreateBuffer(&vertexBufferDesc, &vertexData, &m_vertexBuffer);
-	if(FAILED(result))
+	vertexBufferDesc.bytes = sizeof(VertexType) * m_vertexCount;
+	vertexBufferDesc.bind = RenderBindVertexBuffer;
+	vertexBufferDesc.dynamic = false;
+
+	// Now create the vertex buffer, from the vertex data.
+	m_device = device;
+	m_vertexBuffer = device->CreateBuffer(vertexBufferDesc, vertices);
+	if(!m_vertexBuffer)
 	{
 		return false;
 	}
 
 	// Set up the description of the static index buffer.
-    indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-    indexBufferDesc.ByteWidth = sizeof(unsigned long) * m_indexCount;
-    indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-    indexBufferDesc.CPUAccessFlags = 0;
-    indexBufferDesc.MiscFlags = 0;
-	indexBufferDesc.StructureByteStride = 0;
-
-	// Give the subresource structure a pointer to the index data.
-    indexData.pSysMem = indices;
-	indexData.SysMemPitch = 0;
-	indexData.SysMemSlicePitch = 0;
+	indexBufferDesc.bytes = sizeof(unsigned long) * m_indexCount;
+	indexBufferDesc.bind = RenderBindIndexBuffer;
+	indexBufferDesc.dynamic = false;
 
 	// Create the index buffer.
-	result = device->CreateBuffer(&indexBufferDesc, &indexData, &m_indexBuffer);
-	if(FAILED(result))
+	m_indexBuffer = device->CreateBuffer(indexBufferDesc, indices);
+	if(!m_indexBuffer)
 	{
 		return false;
 	}
@@ -150,14 +189,14 @@ void ModelClass::ShutdownBuffers()
 	// Release the index buffer.
 	if(m_indexBuffer)
 	{
-		m_indexBuffer->Release();
+		m_device->Release(m_indexBuffer);
 		m_indexBuffer = 0;
 	}
 
 	// Release the vertex buffer.
 	if(m_vertexBuffer)
 	{
-		m_vertexBuffer->Release();
+		m_device->Release(m_vertexBuffer);
 		m_vertexBuffer = 0;
 	}
 
@@ -165,7 +204,7 @@ void ModelClass::ShutdownBuffers()
 }
 
 
-void ModelClass::RenderBuffers(ID3D11DeviceContext* deviceContext)
+void ModelClass::RenderBuffers(RenderContext* deviceContext)
 {
 	unsigned int stride;
 	unsigned int offset;
@@ -290,6 +329,17 @@ bool ModelClass::LoadModel(char* filename)
 
 	m_indexCount = vIndex;
 
+	// Bounds, for culling
+	if (!verts.empty())
+	{
+		m_boundsMin = m_boundsMax = verts[0];
+		for (int v = 1; v < (int)verts.size(); v++)
+		{
+			m_boundsMin = DirectX::SimpleMath::Vector3::Min(m_boundsMin, verts[v]);
+			m_boundsMax = DirectX::SimpleMath::Vector3::Max(m_boundsMax, verts[v]);
+		}
+	}
+
 	verts.clear();
 	norms.clear();
 	texCs.clear();
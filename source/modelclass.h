@@ -9,6 +9,8 @@
 // INCLUDES //
 //////////////
 #include "pch.h"
+#include "RenderContext.h"
+#include "RenderDevice.h"
 //#include <d3dx10math.h>
 //#include <fstream>
 //using namespace std;
@@ -36,17 +38,22 @@ public:
 	ModelClass();
 	~ModelClass();
 
-	bool InitializeModel(ID3D11Device *device, char* filename);
+	bool InitializeModel(RenderDevice *device, char* filename);
 	void Shutdown();
-	void Render(ID3D11DeviceContext*);
+	void Render(RenderContext*);
+	void RenderInstanced(RenderContext*, int instanceCount, int firstInstance);	// Instance streams must already be bound
 	
 	int GetIndexCount();
+	DirectX::SimpleMath::Vector3 GetBoundsMin();	// Of the vertices, in model space
+	DirectX::SimpleMath::Vector3 GetBoundsMax();
+	void GetTriangles(std::vector<float>& triangles);	// Nine floats each (three positions), in model space, for tracing rays against
+	void GetVertices(std::vector<float>& vertices);		// Fourteen floats each (position, texture, normal, tangent, binormal), as a triangle list, for SoftwareRenderer
 
 
 private:
-	bool InitializeBuffers(ID3D11Device*);
+	bool InitializeBuffers(RenderDevice*);
 	void ShutdownBuffers();
-	void RenderBuffers(ID3D11DeviceContext*);
+	void RenderBuffers(RenderContext*);
 	bool LoadModel(char*);
 
 	void ReleaseModel();
@@ -55,8 +62,10 @@ private:
 	void CalculateNormalTangentBinormal(VertexPositionNormalTexture vertex1, VertexPositionNormalTexture vertex2, VertexPositionNormalTexture vertex3, DirectX::SimpleMath::Vector3& normal, DirectX::SimpleMath::Vector3& tangent, DirectX::SimpleMath::Vector3& binormal);
 
 private:
+	RenderDevice *m_device;
 	ID3D11Buffer *m_vertexBuffer, *m_indexBuffer;
 	int m_vertexCount, m_indexCount;
+	DirectX::SimpleMath::Vector3 m_boundsMin, m_boundsMax;
 
 	//arrays for our generated objects Made by directX
 	std::vector<VertexType> preFabVertices;
@@ -6,6 +6,13 @@ cbuffer TimeBuffer : register(b0)
     float time;
 };
 
+cbuffer ViewBuffer : register(b4)
+{
+    matrix viewMatrix;
+    matrix projectionMatrix;
+    float2 screenSize;
+};
+
 struct InputType
 {
     float4 position : SV_POSITION;
@@ -13,9 +20,9 @@ struct InputType
 
 float4 main(InputType input) : SV_TARGET
 {
-    float4 textureColor = textures[0].Sample(SampleType, float2(input.position.x/1280, input.position.y/720));
-    float4 overlayColor = textures[1].Sample(SampleType, float2(input.position.x/1280, input.position.y/720));
-    float overlayAlpha = textures[2].Sample(SampleType, float2(input.position.x/1280, input.position.y/720));
+    float4 textureColor = textures[0].Sample(SampleType, input.position.xy/screenSize);
+    float4 overlayColor = textures[1].Sample(SampleType, input.position.xy/screenSize);
+    float overlayAlpha = textures[2].Sample(SampleType, input.position.xy/screenSize);
 
     float4 color = (1.0-overlayAlpha)*textureColor+overlayAlpha*overlayColor;
 
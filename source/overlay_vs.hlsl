@@ -1,8 +1,13 @@
-cbuffer MatrixBuffer : register(b0)
+cbuffer ObjectBuffer : register(b0)
 {
 	matrix worldMatrix;
+};
+
+cbuffer ViewBuffer : register(b4)
+{
 	matrix viewMatrix;
 	matrix projectionMatrix;
+	float2 screenSize;
 };
 
 struct InputType
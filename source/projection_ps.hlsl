@@ -0,0 +1,77 @@
+Texture2D textures[6];
+SamplerState SampleType;
+
+cbuffer TimeBuffer : register(b0)
+{
+    float time;
+};
+
+cbuffer ViewBuffer : register(b4)
+{
+    matrix viewMatrix;
+    matrix projectionMatrix;
+    float2 screenSize;
+};
+
+cbuffer ProjectionBuffer : register(b1)
+{
+    float mode;
+};
+
+struct InputType
+{
+    float4 position : SV_POSITION;
+};
+
+// NB: Must match EnvironmentProjection::decodeOctahedral/decodeParaboloid
+float3 find_projection_v(float2 st)
+{
+    if (mode == 1.0)
+    {
+        float2 p = 2.0*st-float2(1.0, 1.0);
+        float3 v = float3(p.x, p.y, 1.0-abs(p.x)-abs(p.y));
+        if (v.z < 0.0)
+            v.xy = (1.0-abs(p.yx))*float2(p.x >= 0.0 ? 1.0 : -1.0, p.y >= 0.0 ? 1.0 : -1.0);
+        return normalize(v);
+    }
+
+    // Dual paraboloid: +z hemisphere on the left half, -z on the right
+    float back = (st.x >= 0.5) ? 1.0 : 0.0;
+    float2 p = float2(2.0*(2.0*st.x-back)-1.0, 2.0*st.y-1.0);
+    float r2 = dot(p, p);
+    float3 v = float3(2.0*p.x, 2.0*p.y, 1.0-r2)/(1.0+r2);
+    v.z = (back == 1.0) ? -v.z : v.z;
+    return v;
+}
+
+float3 find_environment_st(float3 v)
+{
+    float extremity = max(length(v.x), max(length(v.y), length(v.z)));
+    float extremities[6] = { -v.x, v.z, v.x, -v.z, v.y, -v.y };
+    float2 sts[6] = { float2(-v.z, -v.y), float2(-v.x, -v.y), float2(v.z, -v.y), float2(v.x, -v.y), float2(-v.x, -v.z), float2(-v.x, v.z) };
+    for (int i = 0; i < 6; i++)
+    {
+        if (extremity == extremities[i])
+        {
+            float2 st = sts[i]/extremity;
+            st = 0.5*(st+float2(1.0, 1.0));
+            return float3(st.x, st.y, i);
+        }
+    }
+
+    return float3(0, 0, -1);
+}
+
+float4 main(InputType input) : SV_TARGET
+{
+    // STEP 1: Find the direction this texel stores...
+    float3 v = find_projection_v(input.position.xy/screenSize);
+
+    // STEP 2: ...and look it up in the six faces
+    float3 st = find_environment_st(v);
+    for (int i = 0; i < 6; i++)
+        if (i == (int)st.z)
+            return textures[i].SampleLevel(SampleType, st.xy, 0);
+
+    return float4(0.0, 0.0, 0.0, 1.0);
+}
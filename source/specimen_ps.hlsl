@@ -6,6 +6,13 @@ cbuffer TimeBuffer : register(b0)
     float time;
 };
 
+cbuffer ViewBuffer : register(b4)
+{
+    matrix viewMatrix;
+    matrix projectionMatrix;
+    float2 screenSize;
+};
+
 cbuffer LightBuffer : register(b1)
 {
     float4 ambientColor;
@@ -54,7 +61,7 @@ float4 main(InputType input) : SV_TARGET
     lightColor = saturate(lightColor);
 
     // STEP 4:
-    float4 specimenColor = textures[2].Sample(SampleType, float2(input.position.x/1280, input.position.y/720));
+    float4 specimenColor = textures[2].Sample(SampleType, input.position.xy/screenSize);
 
     // STEP 5: Applying lighting to pixel's base colour.
     float4 color = lightColor * (opacity*textureColor+(1.0-opacity)*specimenColor);